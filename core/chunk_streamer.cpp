@@ -0,0 +1,445 @@
+#include "chunk_streamer.hpp"
+#include "tmx_level.hpp"
+#include <lib/error.hpp>
+
+using namespace world;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  int FloorDiv(int a, int b)
+  {
+    int q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T>
+  size_t VectorBytes(const vector<T>& v)
+  {
+    return v.capacity() * sizeof(T);
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T>
+  void ShrinkToFit(vector<T>* v)
+  {
+    vector<T>(*v).swap(*v);
+  }
+}
+
+//------------------------------------------------------------------------------
+ChunkStreamer::~ChunkStreamer()
+{
+  Stop();
+}
+
+//------------------------------------------------------------------------------
+u64 ChunkStreamer::ChunkKey(int x, int y)
+{
+  return ((u64)(u32)x << 32) | (u32)y;
+}
+
+//------------------------------------------------------------------------------
+bool ChunkStreamer::Start(const TmxLevel* level, const ChunkStreamerDesc& desc)
+{
+  Stop();
+
+  if (level->chunkWidth <= 0 || level->chunkHeight <= 0)
+  {
+    LOG_WARN("Invalid chunk size: ", level->chunkWidth, "x", level->chunkHeight);
+    return false;
+  }
+
+  _level = level;
+  _desc = desc;
+  _chunkSize = vec2{(float)(level->chunkWidth * level->tileWidth),
+      (float)(level->chunkHeight * level->tileHeight)};
+
+  for (u32 i = 0; i < (u32)level->layers.size(); ++i)
+  {
+    const TmxLayer& layer = level->layers[i];
+    for (u32 j = 0; j < (u32)layer.chunks.size(); ++j)
+    {
+      const TmxChunk& chunk = layer.chunks[j];
+      Source* source = FindOrAddSource(
+          FloorDiv(chunk.x, level->chunkWidth), FloorDiv(chunk.y, level->chunkHeight));
+      source->layerChunks.push_back(make_pair(i, j));
+    }
+  }
+
+  AddCollision(level->collision);
+
+  // Every tile can end up as a quad, and a span of its own, and the traced outlines
+  // usually have fewer corners than the rects they're made from. A chunk that still
+  // comes in over its bound is evicted on the next Update, if it's out of range.
+  size_t tilesPerChunk = (size_t)level->chunkWidth * level->chunkHeight;
+  size_t meshChunksPerChunk =
+      ((level->chunkWidth + TileMesh::CHUNK_SIZE - 1) / TileMesh::CHUNK_SIZE)
+      * ((level->chunkHeight + TileMesh::CHUNK_SIZE - 1) / TileMesh::CHUNK_SIZE);
+  size_t bytesPerLayer = tilesPerChunk * (4 * sizeof(PosTex) + sizeof(TileMesh::Span) + sizeof(u32))
+      + meshChunksPerChunk * sizeof(TileMesh::Chunk) + sizeof(TileMesh::Layer);
+
+  for (auto& kv : _sources)
+  {
+    Source& source = kv.second;
+    size_t numPoints = 4 * source.rects.size() + source.polylinePoints.size();
+    source.maxBytes = source.layerChunks.size() * bytesPerLayer + numPoints * sizeof(vec2)
+        + (source.rects.size() + source.polylineSizes.size()) * sizeof(u32);
+  }
+
+  _stats = Stats();
+  _stats.numSources = (u32)_sources.size();
+
+  _stop = false;
+  _thread = std::thread([this]() { LoaderThread(); });
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::Stop(ChunkStreamTarget* target)
+{
+  if (_thread.joinable())
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _queueCv.notify_all();
+    _thread.join();
+  }
+
+  for (StreamedChunk* chunk : _done)
+    delete chunk;
+
+  for (StreamedChunk* chunk : _resident)
+  {
+    if (target)
+      target->ChunkEvicted(*chunk);
+    delete chunk;
+  }
+
+  _done.clear();
+  _queue.clear();
+  _resident.clear();
+  _residentByKey.clear();
+  _reserved.clear();
+  _sources.clear();
+  _level = nullptr;
+}
+
+//------------------------------------------------------------------------------
+ChunkStreamer::Source* ChunkStreamer::FindOrAddSource(int x, int y)
+{
+  u64 key = ChunkKey(x, y);
+  auto it = _sources.find(key);
+  if (it != _sources.end())
+    return &it->second;
+
+  Source& source = _sources[key];
+  source.x = x;
+  source.y = y;
+  source.key = key;
+  source.maxBytes = 0;
+  return &source;
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::AddCollision(const TmxCollision& collision)
+{
+  // split the rects along the chunk borders. The borders are always at the same
+  // coordinates, so the pieces line up exactly
+  for (const CookedRect& rect : collision.rects)
+  {
+    float x0 = rect.x;
+    float y0 = rect.y;
+    float x1 = rect.x + rect.width;
+    float y1 = rect.y + rect.height;
+    int cx0 = (int)floorf(x0 / _chunkSize.x);
+    int cx1 = (int)ceilf(x1 / _chunkSize.x) - 1;
+    int cy0 = (int)floorf(y0 / _chunkSize.y);
+    int cy1 = (int)ceilf(y1 / _chunkSize.y) - 1;
+
+    for (int cy = cy0; cy <= cy1; ++cy)
+    {
+      for (int cx = cx0; cx <= cx1; ++cx)
+      {
+        OutlineRect clipped;
+        clipped.minPos = vec2{max(x0, cx * _chunkSize.x), max(y0, cy * _chunkSize.y)};
+        clipped.maxPos = vec2{min(x1, (cx + 1) * _chunkSize.x), min(y1, (cy + 1) * _chunkSize.y)};
+        if (clipped.minPos.x < clipped.maxPos.x && clipped.minPos.y < clipped.maxPos.y)
+          FindOrAddSource(cx, cy)->rects.push_back(clipped);
+      }
+    }
+  }
+
+  for (const CookedPolyline& polyline : collision.polylines)
+  {
+    if (polyline.numPoints < 2)
+      continue;
+
+    const CookedPoint& first = collision.points[polyline.firstPoint];
+    Source* source = FindOrAddSource((int)floorf(first.x / _chunkSize.x), (int)floorf(first.y / _chunkSize.y));
+    for (u32 i = 0; i < polyline.numPoints; ++i)
+    {
+      const CookedPoint& pt = collision.points[polyline.firstPoint + i];
+      source->polylinePoints.push_back(vec2{pt.x, pt.y});
+    }
+    source->polylineSizes.push_back(polyline.numPoints);
+  }
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::Update(const vec2& cameraPos, ChunkStreamTarget* target)
+{
+  if (!IsRunning())
+    return;
+
+  ++_frame;
+
+  vector<StreamedChunk*> done;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    done.swap(_done);
+
+    // drop the requests that haven't been started. They're queued again below, in the
+    // order for the new camera position
+    for (const Source* source : _queue)
+      Release(source->key);
+    _queue.clear();
+  }
+
+  for (StreamedChunk* chunk : done)
+  {
+    Release(chunk->key);
+    chunk->lastUsed = _frame;
+    _resident.push_back(chunk);
+    _residentByKey[chunk->key] = chunk;
+    _stats.residentBytes += chunk->bytes;
+    _stats.numLoaded++;
+    Commit(chunk->bytes);
+    target->ChunkLoaded(*chunk);
+  }
+
+  // find the chunks in range. nb: the map's rows go down from the zero level
+  float radius = _desc.loadRadius;
+  float zeroLevel = _level->zeroLevel;
+  int cx0 = (int)floorf((cameraPos.x - radius) / _chunkSize.x);
+  int cx1 = (int)floorf((cameraPos.x + radius) / _chunkSize.x);
+  int cy0 = (int)floorf((zeroLevel - cameraPos.y - radius) / _chunkSize.y);
+  int cy1 = (int)floorf((zeroLevel - cameraPos.y + radius) / _chunkSize.y);
+
+  vector<pair<float, const Source*>> wanted;
+  for (int cy = cy0; cy <= cy1; ++cy)
+  {
+    for (int cx = cx0; cx <= cx1; ++cx)
+    {
+      float minX = cx * _chunkSize.x;
+      float maxY = zeroLevel - cy * _chunkSize.y;
+      float dx = max(0.f, max(minX - cameraPos.x, cameraPos.x - (minX + _chunkSize.x)));
+      float dy = max(0.f, max((maxY - _chunkSize.y) - cameraPos.y, cameraPos.y - maxY));
+      float distSq = dx * dx + dy * dy;
+      if (distSq > radius * radius)
+        continue;
+
+      u64 key = ChunkKey(cx, cy);
+      auto resident = _residentByKey.find(key);
+      if (resident != _residentByKey.end())
+      {
+        resident->second->lastUsed = _frame;
+        continue;
+      }
+
+      auto source = _sources.find(key);
+      if (source != _sources.end() && !_reserved.count(key))
+        wanted.push_back(make_pair(distSq, &source->second));
+    }
+  }
+
+  sort(wanted.begin(), wanted.end(), [](const pair<float, const Source*>& a, const pair<float, const Source*>& b) {
+    return a.first < b.first;
+  });
+
+  // make up for any chunks that came in over their bound
+  Evict(0, target);
+
+  vector<const Source*> requests;
+  for (const pair<float, const Source*>& w : wanted)
+  {
+    const Source* source = w.second;
+    if (!Evict(source->maxBytes, target))
+      break;
+
+    _reserved[source->key] = source->maxBytes;
+    Commit(source->maxBytes);
+    requests.push_back(source);
+  }
+
+  if (requests.empty())
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _queue.insert(_queue.end(), requests.begin(), requests.end());
+  }
+  _queueCv.notify_one();
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::LoadAround(const vec2& cameraPos, ChunkStreamTarget* target)
+{
+  Update(cameraPos, target);
+
+  // every reserved chunk is being loaded, so this always makes progress
+  while (!_reserved.empty())
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _doneCv.wait(lock, [this]() { return !_done.empty(); });
+    }
+    Update(cameraPos, target);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ChunkStreamer::Evict(size_t bytesNeeded, ChunkStreamTarget* target)
+{
+  while (_stats.committedBytes + bytesNeeded > _desc.memoryBudget)
+  {
+    // the least recently used chunk that's out of range
+    size_t lru = _resident.size();
+    for (size_t i = 0; i < _resident.size(); ++i)
+    {
+      u64 lastUsed = _resident[i]->lastUsed;
+      if (lastUsed < _frame && (lru == _resident.size() || lastUsed < _resident[lru]->lastUsed))
+        lru = i;
+    }
+
+    if (lru == _resident.size())
+      return false;
+
+    StreamedChunk* chunk = _resident[lru];
+    target->ChunkEvicted(*chunk);
+
+    _resident[lru] = _resident.back();
+    _resident.pop_back();
+    _residentByKey.erase(chunk->key);
+    _stats.residentBytes -= chunk->bytes;
+    _stats.committedBytes -= chunk->bytes;
+    _stats.numEvicted++;
+    delete chunk;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::Release(u64 key)
+{
+  auto it = _reserved.find(key);
+  if (it == _reserved.end())
+    return;
+
+  _stats.committedBytes -= it->second;
+  _reserved.erase(it);
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::Commit(size_t bytes)
+{
+  _stats.committedBytes += bytes;
+  _stats.peakCommittedBytes = max(_stats.peakCommittedBytes, _stats.committedBytes);
+}
+
+//------------------------------------------------------------------------------
+void ChunkStreamer::LoaderThread()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    _queueCv.wait(lock, [this]() { return _stop || !_queue.empty(); });
+    if (_stop)
+      break;
+
+    const Source* source = _queue.front();
+    _queue.pop_front();
+    lock.unlock();
+
+    StreamedChunk* chunk = LoadChunk(*source);
+
+    lock.lock();
+    _done.push_back(chunk);
+    _doneCv.notify_all();
+  }
+}
+
+//------------------------------------------------------------------------------
+StreamedChunk* ChunkStreamer::LoadChunk(const Source& source)
+{
+  const TmxLevel& level = *_level;
+  float zeroLevel = level.zeroLevel;
+  float ppm = _desc.pixelsPerMeter;
+
+  StreamedChunk* chunk = new StreamedChunk();
+  chunk->x = source.x;
+  chunk->y = source.y;
+  chunk->key = source.key;
+  chunk->minPos = vec2{source.x * _chunkSize.x, zeroLevel - (source.y + 1) * _chunkSize.y};
+  chunk->maxPos = vec2{(source.x + 1) * _chunkSize.x, zeroLevel - source.y * _chunkSize.y};
+
+  // decode the tiles for all the layers, and bake them into a single mesh. A layer that
+  // fails to decode is left out
+  TileMeshDesc desc = _desc.meshDesc;
+  desc.layers.clear();
+  desc.origin = vec2{chunk->minPos.x, chunk->maxPos.y};
+
+  _tiles.resize(max(_tiles.size(), source.layerChunks.size()));
+  for (size_t i = 0; i < source.layerChunks.size(); ++i)
+  {
+    const TmxLayer& layer = level.layers[source.layerChunks[i].first];
+    const TmxChunk& src = layer.chunks[source.layerChunks[i].second];
+    if (!DecodeTmxChunk(level.jsonFile.Data(), layer, src, &_decodeScratch, &_tiles[i]))
+    {
+      LOG_WARN("Invalid tile data for chunk: ", src.x, ", ", src.y, " of layer: ", layer.name);
+      continue;
+    }
+
+    desc.layers.push_back(TileMeshDesc::Layer{_tiles[i].data(), src.width, src.height});
+  }
+
+  TileMesh& mesh = chunk->mesh;
+  mesh.Bake(desc);
+
+  // the gid tables are only needed for baking
+  vector<u16>().swap(mesh.gidToTileset);
+  vector<SpriteQuad>().swap(mesh.gidSprites);
+  ShrinkToFit(&mesh.spans);
+  ShrinkToFit(&mesh.chunkSpans);
+  ShrinkToFit(&mesh.layers);
+
+  // trace the merged outlines of the rects, in Box2D space, where y is up
+  auto toBox2d = [=](float x, float y) { return vec2{x / ppm, (zeroLevel - y) / ppm}; };
+
+  vector<OutlineRect> rects;
+  for (const OutlineRect& rect : source.rects)
+  {
+    vec2 topLeft = toBox2d(rect.minPos.x, rect.minPos.y);
+    vec2 bottomRight = toBox2d(rect.maxPos.x, rect.maxPos.y);
+    rects.push_back(OutlineRect{vec2{topLeft.x, bottomRight.y}, vec2{bottomRight.x, topLeft.y}});
+  }
+
+  StaticChains& collision = chunk->collision;
+  TraceRectOutlines(rects.data(), (u32)rects.size(), &collision.points, &collision.loopSizes);
+  for (const vec2& pt : source.polylinePoints)
+    collision.points.push_back(toBox2d(pt.x, pt.y));
+  collision.chainSizes = source.polylineSizes;
+
+  ShrinkToFit(&collision.points);
+  ShrinkToFit(&collision.loopSizes);
+
+  chunk->bytes = VectorBytes(mesh.vertices) + VectorBytes(mesh.spans) + VectorBytes(mesh.chunks)
+      + VectorBytes(mesh.chunkSpans) + VectorBytes(mesh.layers) + VectorBytes(collision.points)
+      + VectorBytes(collision.loopSizes) + VectorBytes(collision.chainSizes);
+
+  return chunk;
+}
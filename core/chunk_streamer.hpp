@@ -0,0 +1,146 @@
+#pragma once
+#include <core/tile_mesh.hpp>
+#include <lib/rect_outline.hpp>
+#include <condition_variable>
+#include <mutex>
+
+namespace world
+{
+  struct TmxLevel;
+  struct TmxCollision;
+
+  //------------------------------------------------------------------------------
+  // One chunk position of an infinite map, with the tiles of all the layers baked into
+  // quads, and the collision traced into chains in Box2D space
+  struct StreamedChunk
+  {
+    // in chunks, with y going down like in the map
+    int x, y;
+    u64 key;
+    // world space bounds
+    vec2 minPos, maxPos;
+
+    TileMesh mesh;
+    StaticChains collision;
+
+    // memory used by the mesh and the collision
+    size_t bytes = 0;
+    u64 lastUsed = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // Gets told about the chunks streaming in and out, from the thread calling Update
+  struct ChunkStreamTarget
+  {
+    virtual ~ChunkStreamTarget() {}
+    virtual void ChunkLoaded(const StreamedChunk& chunk) = 0;
+    virtual void ChunkEvicted(const StreamedChunk& chunk) = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  struct ChunkStreamerDesc
+  {
+    // chunks closer than this to the camera are loaded, closest first
+    float loadRadius = 2048;
+    size_t memoryBudget = 64 * 1024 * 1024;
+    float pixelsPerMeter = 16;
+    // the tilesets, tile size and z for the chunk meshes. The layers are ignored
+    TileMeshDesc meshDesc;
+  };
+
+  //------------------------------------------------------------------------------
+  // Streams the chunks of an infinite map in and out around the camera. The chunks are
+  // decoded, baked and have their collision traced on a background thread, and Update
+  // hands the finished ones to the target.
+  //
+  // The memory for the resident chunks, plus an upper bound for the ones being loaded,
+  // is kept within the budget. When a chunk doesn't fit, the least recently used chunks
+  // outside of the load radius are evicted, and if that's not enough, the chunk isn't
+  // loaded until something else goes out of range.
+  //
+  // Rects crossing a chunk border are clipped, so each chunk has its own collision, but
+  // polylines go with the chunk of their first point.
+  class ChunkStreamer
+  {
+  public:
+    ~ChunkStreamer();
+
+    // 'level' needs to stay unchanged until Stop
+    bool Start(const TmxLevel* level, const ChunkStreamerDesc& desc);
+    // Drops all the chunks, and tells 'target' about the resident ones, if given
+    void Stop(ChunkStreamTarget* target = nullptr);
+    bool IsRunning() const { return _level != nullptr; }
+
+    // Picks up the loaded chunks, evicts and queues chunks for the new camera position.
+    // Main thread only, like the rest of the interface
+    void Update(const vec2& cameraPos, ChunkStreamTarget* target);
+    // Like Update, but blocks until the chunks around the camera are loaded
+    void LoadAround(const vec2& cameraPos, ChunkStreamTarget* target);
+
+    const vector<StreamedChunk*>& Resident() const { return _resident; }
+
+    struct Stats
+    {
+      size_t residentBytes = 0;
+      // the resident bytes, plus the upper bounds for the chunks being loaded
+      size_t committedBytes = 0;
+      size_t peakCommittedBytes = 0;
+      u32 numSources = 0;
+      u32 numLoaded = 0;
+      u32 numEvicted = 0;
+    };
+
+    const Stats& GetStats() const { return _stats; }
+
+    static u64 ChunkKey(int x, int y);
+
+  private:
+    struct Source
+    {
+      int x, y;
+      u64 key;
+      // (layer, chunk) pairs, in layer order
+      vector<pair<u32, u32>> layerChunks;
+      // rects clipped to the chunk, and the polylines starting in it, in map space
+      vector<OutlineRect> rects;
+      vector<vec2> polylinePoints;
+      vector<u32> polylineSizes;
+      // upper bound of StreamedChunk::bytes
+      size_t maxBytes;
+    };
+
+    Source* FindOrAddSource(int x, int y);
+    void AddCollision(const TmxCollision& collision);
+    void LoaderThread();
+    StreamedChunk* LoadChunk(const Source& source);
+
+    bool Evict(size_t bytesNeeded, ChunkStreamTarget* target);
+    void Release(u64 key);
+    void Commit(size_t bytes);
+
+    const TmxLevel* _level = nullptr;
+    ChunkStreamerDesc _desc;
+    vec2 _chunkSize;
+    unordered_map<u64, Source> _sources;
+
+    vector<StreamedChunk*> _resident;
+    unordered_map<u64, StreamedChunk*> _residentByKey;
+    // upper bounds of the chunks queued or being loaded
+    unordered_map<u64, size_t> _reserved;
+    u64 _frame = 0;
+    Stats _stats;
+
+    // shared with the loader thread
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _queueCv;
+    std::condition_variable _doneCv;
+    deque<const Source*> _queue;
+    vector<StreamedChunk*> _done;
+    bool _stop = false;
+
+    // loader thread only
+    vector<vector<u32>> _tiles;
+    vector<u8> _decodeScratch;
+  };
+}
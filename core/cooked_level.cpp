@@ -0,0 +1,87 @@
+#include "cooked_level.hpp"
+#include <lib/error.hpp>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+bool CookedLevel::CheckArray(u32 ofs, u64 count, u64 elemSize) const
+{
+  return ofs % CookedLevelHeader::ALIGNMENT == 0 && ofs + count * elemSize <= _size;
+}
+
+//------------------------------------------------------------------------------
+bool CookedLevel::Init(const char* data, size_t size)
+{
+  _data = data;
+  _size = size;
+  _header = (const CookedLevelHeader*)data;
+
+  if (size < sizeof(CookedLevelHeader) || _header->magic != CookedLevelHeader::MAGIC)
+  {
+    LOG_WARN("Not a cooked level");
+    return false;
+  }
+
+  const CookedLevelHeader& h = *_header;
+  if (h.version != CookedLevelHeader::VERSION)
+  {
+    LOG_WARN("Cooked level version mismatch. Expected: ",
+        (u32)CookedLevelHeader::VERSION,
+        ", got: ",
+        h.version);
+    return false;
+  }
+
+  if (h.headerSize < sizeof(CookedLevelHeader) || h.fileSize != size
+      || !CheckArray(h.layersOfs, h.numLayers, sizeof(CookedLayer))
+      || !CheckArray(h.tilesetsOfs, h.numTilesets, sizeof(CookedTileset))
+      || !CheckArray(h.rectsOfs, h.numRects, sizeof(CookedRect))
+      || !CheckArray(h.polylinesOfs, h.numPolylines, sizeof(CookedPolyline))
+      || !CheckArray(h.pointsOfs, h.numPoints, sizeof(CookedPoint))
+      || !CheckArray(h.stringsOfs, h.stringsSize, 1))
+  {
+    LOG_WARN("Cooked level is truncated or corrupt");
+    return false;
+  }
+
+  // the string table has to end with a terminator, so any offset inside it is a valid
+  // string
+  if (h.stringsSize == 0 || _data[h.stringsOfs + h.stringsSize - 1] != 0)
+  {
+    LOG_WARN("Invalid cooked level string table");
+    return false;
+  }
+
+  for (u32 i = 0; i < h.numLayers; ++i)
+  {
+    const CookedLayer& layer = Layers()[i];
+    if (layer.width < 0 || layer.height < 0 || layer.nameOfs >= h.stringsSize
+        || !CheckArray(layer.tilesOfs, (u64)layer.width * layer.height, sizeof(u32)))
+    {
+      LOG_WARN("Invalid cooked level layer: ", i);
+      return false;
+    }
+  }
+
+  for (u32 i = 0; i < h.numTilesets; ++i)
+  {
+    const CookedTileset& tileset = Tilesets()[i];
+    if (tileset.nameOfs >= h.stringsSize || tileset.imageOfs >= h.stringsSize)
+    {
+      LOG_WARN("Invalid cooked level tileset: ", i);
+      return false;
+    }
+  }
+
+  for (u32 i = 0; i < h.numPolylines; ++i)
+  {
+    const CookedPolyline& polyline = Polylines()[i];
+    if ((u64)polyline.firstPoint + polyline.numPoints > h.numPoints)
+    {
+      LOG_WARN("Invalid cooked level polyline: ", i);
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // On disk format for cooked levels, written by scripts/cook_level.py:
+  //
+  //  CookedLevelHeader
+  //  CookedLayer[numLayers]
+  //  CookedTileset[numTilesets]
+  //  CookedRect[numRects]
+  //  CookedPolyline[numPolylines]
+  //  CookedPoint[numPoints]
+  //  string table, zero terminated strings
+  //  tiles for each layer, as u32 gids, width * height per layer
+  //
+  // Everything is little endian, and the offsets are from the start of the file. All the
+  // arrays start on ALIGNMENT bytes, so the tiles can be used straight from the mapped
+  // file. The collision objects from all the collision layers are concatenated, and are
+  // in TMX pixel coordinates.
+  struct CookedLevelHeader
+  {
+    enum
+    {
+      MAGIC = 0x4c56454c, // 'LEVL'
+      VERSION = 1,
+      ALIGNMENT = 16,
+    };
+
+    u32 magic;
+    u32 version;
+    u32 headerSize;
+    u32 fileSize;
+
+    s32 width, height;
+    s32 tileWidth, tileHeight;
+    float zeroLevel;
+
+    u32 numLayers, layersOfs;
+    u32 numTilesets, tilesetsOfs;
+    u32 numRects, rectsOfs;
+    u32 numPolylines, polylinesOfs;
+    u32 numPoints, pointsOfs;
+    u32 stringsSize, stringsOfs;
+  };
+
+  struct CookedLayer
+  {
+    u32 nameOfs;
+    s32 x, y;
+    s32 width, height;
+    u32 tilesOfs;
+  };
+
+  struct CookedTileset
+  {
+    u32 nameOfs;
+    u32 imageOfs;
+    s32 firstGid;
+    s32 imageWidth, imageHeight;
+    s32 margin, spacing;
+    s32 tileCount;
+    s32 tileWidth, tileHeight;
+  };
+
+  struct CookedRect
+  {
+    float x, y;
+    float width, height;
+    float rotation;
+  };
+
+  struct CookedPolyline
+  {
+    u32 firstPoint;
+    u32 numPoints;
+  };
+
+  struct CookedPoint
+  {
+    float x, y;
+  };
+
+  //------------------------------------------------------------------------------
+  // View of a cooked level in memory. Init checks the header, and that all the arrays
+  // and strings are inside the buffer, so the accessors don't have to.
+  class CookedLevel
+  {
+  public:
+    bool Init(const char* data, size_t size);
+
+    const CookedLevelHeader& Header() const { return *_header; }
+
+    const CookedLayer* Layers() const { return Array<CookedLayer>(_header->layersOfs); }
+    const CookedTileset* Tilesets() const { return Array<CookedTileset>(_header->tilesetsOfs); }
+    const CookedRect* Rects() const { return Array<CookedRect>(_header->rectsOfs); }
+    const CookedPolyline* Polylines() const { return Array<CookedPolyline>(_header->polylinesOfs); }
+    const CookedPoint* Points() const { return Array<CookedPoint>(_header->pointsOfs); }
+
+    const u32* Tiles(const CookedLayer& layer) const { return Array<u32>(layer.tilesOfs); }
+    const char* String(u32 ofs) const { return _data + _header->stringsOfs + ofs; }
+
+  private:
+    template <typename T>
+    const T* Array(u32 ofs) const
+    {
+      return (const T*)(_data + ofs);
+    }
+
+    bool CheckArray(u32 ofs, u64 count, u64 elemSize) const;
+
+    const char* _data = nullptr;
+    size_t _size = 0;
+    const CookedLevelHeader* _header = nullptr;
+  };
+}
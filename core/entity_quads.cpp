@@ -0,0 +1,149 @@
+#include "entity_quads.hpp"
+#include <core/entity_store.hpp>
+#include <lib/job_pool.hpp>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+u32 EntityQuadBuilder::Prepare(const EntityStore& entities,
+    const SpriteQuad* sprites,
+    const u16* textureSlot,
+    u32 numTextures,
+    const vec2& minPos,
+    const vec2& maxPos,
+    JobPool* pool)
+{
+  u32 numEntities = entities.Size();
+  const vec2* entityPos = entities.Pos();
+  const u16* entitySprite = entities.Sprites();
+
+  _sprites = sprites;
+  _numTextures = numTextures;
+  _numChunks = numTextures ? (numEntities + CHUNK_SIZE - 1) / CHUNK_SIZE : 0;
+  _numQuads = 0;
+  _draws.assign(numTextures, Draw{0, 0});
+  if (!_numChunks)
+    return 0;
+
+  _counts.assign(_numChunks * numTextures, 0);
+  _offsets.resize(_numChunks * numTextures);
+  _pos.resize(numEntities);
+  _ids.resize(numEntities);
+
+  // each chunk counts its visible entities per texture, and then scatters them into
+  // its own range of the bucket arrays
+  pool->ParallelFor(_numChunks,
+      [&](u32 chunk)
+      {
+        u32 visible[CHUNK_SIZE];
+        u16 slots[CHUNK_SIZE];
+        u32* counts = &_counts[chunk * numTextures];
+        u32* cursors = &_offsets[chunk * numTextures];
+        u32 begin = chunk * CHUNK_SIZE;
+        u32 end = min(begin + CHUNK_SIZE, numEntities);
+
+        u32 numVisible = 0;
+        for (u32 i = begin; i < end; ++i)
+        {
+          u16 sprite = entitySprite[i];
+          if (sprite == INVALID_SPRITE)
+            continue;
+
+          const vec2& p = entityPos[i];
+          const SpriteQuad& quad = sprites[sprite];
+          if (p.x < maxPos.x && p.x + quad.width > minPos.x && p.y > minPos.y
+              && p.y - quad.height < maxPos.y)
+          {
+            u16 slot = textureSlot[sprite];
+            visible[numVisible] = i;
+            slots[numVisible] = slot;
+            numVisible++;
+            counts[slot]++;
+          }
+        }
+
+        u32 ofs = begin;
+        for (u32 t = 0; t < numTextures; ++t)
+        {
+          cursors[t] = ofs;
+          ofs += counts[t];
+        }
+
+        for (u32 j = 0; j < numVisible; ++j)
+        {
+          u32 dst = cursors[slots[j]]++;
+          _pos[dst] = entityPos[visible[j]];
+          _ids[dst] = entitySprite[visible[j]];
+        }
+      });
+
+  // exclusive prefix sum over the counts, texture major, so the quads for each texture
+  // end up contiguous, and are drawn together
+  u32 ofs = 0;
+  for (u32 t = 0; t < numTextures; ++t)
+  {
+    Draw& draw = _draws[t];
+    draw.firstQuad = ofs;
+    for (u32 c = 0; c < _numChunks; ++c)
+    {
+      _offsets[c * numTextures + t] = ofs;
+      ofs += _counts[c * numTextures + t];
+    }
+    draw.numQuads = ofs - draw.firstQuad;
+  }
+
+  _numQuads = ofs;
+  return _numQuads;
+}
+
+//------------------------------------------------------------------------------
+void EntityQuadBuilder::Build(u32 first, u32 count, PosTex* out, JobPool* pool) const
+{
+  // each chunk writes the part of its ranges that falls inside [first, first + count)
+  u32 last = first + count;
+  pool->ParallelFor(_numChunks,
+      [&](u32 chunk)
+      {
+        const u32* counts = &_counts[chunk * _numTextures];
+        const u32* offsets = &_offsets[chunk * _numTextures];
+        u32 src = chunk * CHUNK_SIZE;
+        for (u32 t = 0; t < _numTextures; ++t)
+        {
+          u32 lo = max(offsets[t], first);
+          u32 hi = min(offsets[t] + counts[t], last);
+          if (lo < hi)
+          {
+            u32 skip = src + lo - offsets[t];
+            BuildQuads(&_pos[skip], &_ids[skip], hi - lo, _sprites, 0.5f, out + (lo - first) * 4);
+          }
+          src += counts[t];
+        }
+      });
+}
+
+//------------------------------------------------------------------------------
+void EntityQuadBuilder::Submit(
+    const ObjectHandle* textures, MappedQuadTarget* target, JobPool* pool) const
+{
+  // a texture with more visible entities than fit in the buffer is split over multiple
+  // mappings
+  u32 maxQuads = max(1u, target->MaxQuads());
+  for (u32 first = 0; first < _numQuads; first += maxQuads)
+  {
+    u32 cnt = min(_numQuads - first, maxQuads);
+    PosTex* vtx = target->Map(cnt);
+    if (!vtx)
+      return;
+    Build(first, cnt, vtx, pool);
+    target->Unmap();
+
+    for (u32 t = 0; t < _numTextures; ++t)
+    {
+      const Draw& draw = _draws[t];
+      u32 lo = max(draw.firstQuad, first);
+      u32 hi = min(draw.firstQuad + draw.numQuads, first + cnt);
+      if (lo < hi)
+        target->Draw(textures[t], lo - first, hi - lo);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <core/object_handle.hpp>
+#include <core/quad_kernel.hpp>
+
+namespace world
+{
+  class EntityStore;
+  class JobPool;
+
+  //------------------------------------------------------------------------------
+  // Receives the entity quads. The quads are written straight into the mapped buffer by
+  // the jobs, and the ranges for each texture are drawn once it's unmapped.
+  struct MappedQuadTarget
+  {
+    virtual ~MappedQuadTarget() {}
+    // Max number of quads that can be mapped in one go
+    virtual u32 MaxQuads() const = 0;
+    // Returns room for 'numQuads' quads, or null if the buffer can't be mapped
+    virtual PosTex* Map(u32 numQuads) = 0;
+    virtual void Unmap() = 0;
+    // Draws 'numQuads' quads, starting at 'firstQuad' of the last mapping
+    virtual void Draw(ObjectHandle texture, u32 firstQuad, u32 numQuads) = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // Builds the quads for the entities overlapping the view, grouped by texture, on a job
+  // pool. Prepare splits the entities into CHUNK_SIZE chunks, and each chunk buckets its
+  // visible entities by texture in a single pass. A prefix sum over the bucket sizes
+  // then gives every chunk a disjoint range of the output for each texture, so the
+  // quads for a texture are contiguous, and in entity order.
+  class EntityQuadBuilder
+  {
+  public:
+    enum
+    {
+      CHUNK_SIZE = 1024,
+      // entities without a sprite are never drawn
+      INVALID_SPRITE = 0xffff,
+    };
+
+    struct Draw
+    {
+      u32 firstQuad;
+      u32 numQuads;
+    };
+
+    // 'textureSlot' gives the texture of each sprite, in [0, numTextures). The sprite
+    // table has to stay valid until the quads are built. Returns the number of quads.
+    u32 Prepare(const EntityStore& entities,
+        const SpriteQuad* sprites,
+        const u16* textureSlot,
+        u32 numTextures,
+        const vec2& minPos,
+        const vec2& maxPos,
+        JobPool* pool);
+
+    // Writes the quads [first, first + count) of the prepared quads to 'out'
+    void Build(u32 first, u32 count, PosTex* out, JobPool* pool) const;
+
+    // Builds the prepared quads into the target's buffer, and draws them, mapping it once
+    // for every MaxQuads quads. 'textures' is indexed by texture slot.
+    void Submit(const ObjectHandle* textures, MappedQuadTarget* target, JobPool* pool) const;
+
+    u32 NumQuads() const { return _numQuads; }
+    // One per texture slot
+    const vector<Draw>& Draws() const { return _draws; }
+
+  private:
+    const SpriteQuad* _sprites = nullptr;
+    u32 _numTextures = 0;
+    u32 _numChunks = 0;
+    u32 _numQuads = 0;
+
+    // per chunk and texture, the number of visible entities, and where their quads go
+    vector<u32> _counts;
+    vector<u32> _offsets;
+    // the visible entities, bucketed by texture within each chunk's range
+    vector<vec2> _pos;
+    vector<u32> _ids;
+    vector<Draw> _draws;
+  };
+}
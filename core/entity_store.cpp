@@ -0,0 +1,100 @@
+#include "entity_store.hpp"
+#include <lib/utils.hpp>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+EntityStore::~EntityStore()
+{
+  Clear();
+}
+
+//------------------------------------------------------------------------------
+u32 EntityStore::Index(u32 id) const
+{
+  u32 page = id >> PAGE_BITS;
+  if (page >= _pages.size() || !_pages[page].indices)
+    return INVALID_INDEX;
+
+  return _pages[page].indices[id & PAGE_MASK];
+}
+
+//------------------------------------------------------------------------------
+bool EntityStore::Add(u32 id, const vec2& pos, u16 sprite)
+{
+  u32 pageIdx = id >> PAGE_BITS;
+  if (pageIdx >= _pages.size())
+    _pages.resize(pageIdx + 1);
+
+  Page& page = _pages[pageIdx];
+  if (!page.indices)
+  {
+    page.indices = new u32[PAGE_SIZE];
+    memset(page.indices, 0xff, PAGE_SIZE * sizeof(u32));
+  }
+
+  u32& idx = page.indices[id & PAGE_MASK];
+  if (idx != INVALID_INDEX)
+    return false;
+
+  idx = (u32)_ids.size();
+  page.numLive++;
+
+  _pos.push_back(pos);
+  _sprites.push_back(sprite);
+  _ids.push_back(id);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool EntityStore::Remove(u32 id)
+{
+  u32 idx = Index(id);
+  if (idx == INVALID_INDEX)
+    return false;
+
+  // move the last entity into the hole
+  u32 last = (u32)_ids.size() - 1;
+  if (idx != last)
+  {
+    u32 lastId = _ids[last];
+    _pos[idx] = _pos[last];
+    _sprites[idx] = _sprites[last];
+    _ids[idx] = lastId;
+    _pages[lastId >> PAGE_BITS].indices[lastId & PAGE_MASK] = idx;
+  }
+
+  _pos.pop_back();
+  _sprites.pop_back();
+  _ids.pop_back();
+
+  Page& page = _pages[id >> PAGE_BITS];
+  page.indices[id & PAGE_MASK] = INVALID_INDEX;
+  if (--page.numLive == 0)
+    SAFE_ADELETE(page.indices);
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool EntityStore::SetPos(u32 id, const vec2& pos)
+{
+  u32 idx = Index(id);
+  if (idx == INVALID_INDEX)
+    return false;
+
+  _pos[idx] = pos;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EntityStore::Clear()
+{
+  for (Page& page : _pages)
+    SAFE_ADELETE(page.indices);
+  _pages.clear();
+
+  _pos.clear();
+  _sprites.clear();
+  _ids.clear();
+}
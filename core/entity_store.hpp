@@ -0,0 +1,59 @@
+#pragma once
+#include <lib/tano_math.hpp>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // The render state for the entities, stored as dense parallel arrays so the quad
+  // building can iterate them linearly. Entity ids are mapped to dense indices through a
+  // sparse set, and removing swaps the last entity into the hole, so adding, removing and
+  // looking up are all O(1). The order of the dense arrays is not stable over removes.
+  //
+  // The ids are handed out sequentially and never reused, so the sparse side is paged:
+  // a page is allocated when the first id in it is added, and freed again when its last
+  // id is removed. That keeps the memory bounded by the live ids, rather than by the
+  // number of entities ever spawned.
+  class EntityStore
+  {
+  public:
+    ~EntityStore();
+
+    // Returns false if the id is already in the store
+    bool Add(u32 id, const vec2& pos, u16 sprite);
+    // Returns false if the id isn't in the store
+    bool Remove(u32 id);
+    bool SetPos(u32 id, const vec2& pos);
+    bool Contains(u32 id) const { return Index(id) != INVALID_INDEX; }
+    void Clear();
+
+    u32 Size() const { return (u32)_ids.size(); }
+    const vec2* Pos() const { return _pos.data(); }
+    const u16* Sprites() const { return _sprites.data(); }
+    const u32* Ids() const { return _ids.data(); }
+
+  private:
+    enum
+    {
+      PAGE_BITS = 12,
+      PAGE_SIZE = 1 << PAGE_BITS,
+      PAGE_MASK = PAGE_SIZE - 1,
+      INVALID_INDEX = 0xffffffff,
+    };
+
+    struct Page
+    {
+      u32* indices = nullptr;
+      u32 numLive = 0;
+    };
+
+    u32 Index(u32 id) const;
+
+    // dense
+    vector<vec2> _pos;
+    vector<u16> _sprites;
+    vector<u32> _ids;
+
+    // sparse, id -> dense index
+    vector<Page> _pages;
+  };
+}
@@ -0,0 +1,268 @@
+#include "event_log.hpp"
+#include "event_manager.hpp"
+#include <lib/error.hpp>
+
+using namespace world;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // Checks that the frame's records tile it exactly, and can be dispatched as they are
+  bool ValidFrame(const char* begin, const char* end, u32 numEvents)
+  {
+    u32 count = 0;
+    for (const char* cur = begin; cur < end; ++count)
+    {
+      if ((size_t)(end - cur) < sizeof(event::EventHeader))
+        return false;
+
+      const event::EventHeader* header = (const event::EventHeader*)cur;
+      if (header->len < sizeof(event::EventHeader) || (header->len & 7) != 0
+          || header->len > (size_t)(end - cur) || header->type >= event::kEventCount)
+        return false;
+
+      cur += header->len;
+    }
+
+    return count == numEvents;
+  }
+}
+
+//------------------------------------------------------------------------------
+EventRecorder::~EventRecorder()
+{
+  Close();
+}
+
+//------------------------------------------------------------------------------
+bool EventRecorder::Open(const char* filename, u64 startFrame)
+{
+  Close();
+
+  _file = fopen(filename, "wb");
+  if (!_file)
+  {
+    LOG_WARN("Unable to open event log: ", filename);
+    return false;
+  }
+
+  EventLogHeader header = {
+      EventLogHeader::MAGIC, EventLogHeader::VERSION, sizeof(EventLogHeader), 0, startFrame};
+  fwrite(&header, sizeof(header), 1, _file);
+
+  for (vector<char>& buf : _buffers)
+  {
+    buf.clear();
+    buf.reserve(BUFFER_SIZE);
+  }
+
+  _active = 0;
+  _frameOfs = -1;
+  _pending = false;
+  _done = false;
+  _writer = std::thread([this]() { WriterThread(); });
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::Close()
+{
+  if (!_file)
+    return;
+
+  // drop any partially recorded frame
+  if (_frameOfs >= 0)
+  {
+    _buffers[_active].resize((size_t)_frameOfs);
+    _frameOfs = -1;
+  }
+
+  Flush();
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done = true;
+  }
+  _cv.notify_all();
+  _writer.join();
+
+  fclose(exch_null(_file));
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::AppendBytes(const void* data, size_t len)
+{
+  vector<char>& buf = _buffers[_active];
+  size_t ofs = buf.size();
+  buf.resize(ofs + len);
+  memcpy(&buf[ofs], data, len);
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::Record(const event::EventHeader* header)
+{
+  Record((const char*)header, (const char*)header + header->len);
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::Record(const char* begin, const char* end)
+{
+  if (!_file || begin == end)
+    return;
+
+  // reserve space for the frame header on the first event of the frame
+  if (_frameOfs < 0)
+  {
+    _frameOfs = _buffers[_active].size();
+    _frameEvents = 0;
+    EventLogFrame frame = {};
+    AppendBytes(&frame, sizeof(frame));
+  }
+
+  for (const char* cur = begin; cur < end; cur += ((const event::EventHeader*)cur)->len)
+    _frameEvents++;
+  AppendBytes(begin, end - begin);
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::EndFrame(u64 frame)
+{
+  if (!_file || _frameOfs < 0)
+    return;
+
+  vector<char>& buf = _buffers[_active];
+  EventLogFrame* header = (EventLogFrame*)&buf[_frameOfs];
+  header->frame = frame;
+  header->numEvents = _frameEvents;
+  header->size = (u32)(buf.size() - _frameOfs - sizeof(EventLogFrame));
+  _frameOfs = -1;
+
+  if (buf.size() >= FLUSH_SIZE)
+    Flush();
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::Flush()
+{
+  if (_buffers[_active].empty())
+    return;
+
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  // if the writer is still busy with the other buffer, we have to wait for it
+  _cv.wait(lock, [this]() { return !_pending; });
+
+  _pending = true;
+  _active ^= 1;
+  _buffers[_active].clear();
+
+  lock.unlock();
+  _cv.notify_all();
+}
+
+//------------------------------------------------------------------------------
+void EventRecorder::WriterThread()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    _cv.wait(lock, [this]() { return _pending || _done; });
+    if (!_pending)
+      break;
+
+    // the pending buffer is the inactive one, and the main thread won't touch it
+    // until _pending is cleared
+    const vector<char>& buf = _buffers[_active ^ 1];
+    lock.unlock();
+    fwrite(buf.data(), buf.size(), 1, _file);
+    lock.lock();
+
+    _pending = false;
+    _cv.notify_all();
+  }
+}
+
+//------------------------------------------------------------------------------
+EventLogReader::~EventLogReader()
+{
+  Close();
+}
+
+//------------------------------------------------------------------------------
+bool EventLogReader::Open(const char* filename)
+{
+  Close();
+
+  if (!_file.Open(filename))
+    return false;
+
+  _data = _file.Data();
+  _size = _file.Size();
+
+  const EventLogHeader* header = (const EventLogHeader*)_data;
+  if (!_data || _size < sizeof(EventLogHeader) || header->magic != EventLogHeader::MAGIC
+      || header->version != EventLogHeader::VERSION
+      || header->headerSize < sizeof(EventLogHeader) || header->headerSize > _size
+      || (header->headerSize & 7) != 0)
+  {
+    LOG_WARN("Invalid event log: ", filename);
+    Close();
+    return false;
+  }
+
+  _startFrame = header->startFrame;
+
+  // walk the frame headers, and build the seek index. The records are dispatched straight
+  // from the mapping, so every one of them is checked up front, and a log with a bad
+  // record, or with frames out of order, is refused.
+  size_t ofs = header->headerSize;
+  while (ofs + sizeof(EventLogFrame) <= _size)
+  {
+    const EventLogFrame* frame = (const EventLogFrame*)&_data[ofs];
+    if (ofs + sizeof(EventLogFrame) + frame->size > _size)
+    {
+      LOG_WARN("Truncated event log: ", filename);
+      break;
+    }
+
+    const char* begin = (const char*)(frame + 1);
+    if (!ValidFrame(begin, begin + frame->size, frame->numEvents)
+        || frame->frame < _startFrame || (!_frames.empty() && frame->frame <= LastFrame()))
+    {
+      LOG_WARN("Invalid event log, bad record in frame: ", frame->frame, ", ", filename);
+      Close();
+      return false;
+    }
+
+    _frames.push_back(FrameIndex{frame->frame, ofs});
+    ofs += sizeof(EventLogFrame) + frame->size;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventLogReader::Close()
+{
+  _file.Close();
+  _data = nullptr;
+  _size = 0;
+  _frames.clear();
+}
+
+//------------------------------------------------------------------------------
+bool EventLogReader::FrameEvents(u64 frame, const char** begin, const char** end) const
+{
+  auto it = lower_bound(_frames.begin(),
+      _frames.end(),
+      frame,
+      [](const FrameIndex& lhs, u64 rhs) { return lhs.frame < rhs; });
+
+  if (it == _frames.end() || it->frame != frame)
+    return false;
+
+  const EventLogFrame* header = (const EventLogFrame*)&_data[it->ofs];
+  *begin = (const char*)(header + 1);
+  *end = *begin + header->size;
+  return true;
+}
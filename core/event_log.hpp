@@ -0,0 +1,116 @@
+#pragma once
+#include <lib/mapped_file.hpp>
+#include <condition_variable>
+#include <mutex>
+
+namespace world
+{
+  namespace event
+  {
+    struct EventHeader;
+  }
+
+  //------------------------------------------------------------------------------
+  // On disk format for recorded events:
+  //
+  //  EventLogHeader
+  //  EventLogFrame, followed by 'size' bytes of event records
+  //  EventLogFrame, ...
+  //
+  // The event records use the same layout as the event queue (EventHeader followed by the
+  // event, padded to 8 bytes), so a mapped log can be dispatched in place. Frames without
+  // events aren't written.
+  struct EventLogHeader
+  {
+    enum
+    {
+      MAGIC = 0x474c5645, // 'EVLG'
+      VERSION = 1,
+    };
+
+    u32 magic;
+    u32 version;
+    u32 headerSize;
+    u32 reserved;
+    // frame the recording was started on
+    u64 startFrame;
+  };
+
+  struct EventLogFrame
+  {
+    u64 frame;
+    u32 numEvents;
+    u32 size;
+  };
+
+  //------------------------------------------------------------------------------
+  // Appends the dispatched events to one of two buffers on the main thread. Whole frames
+  // are handed off to a writer thread once the active buffer passes the flush size, so the
+  // main thread only pays for a memcpy per event.
+  struct EventRecorder
+  {
+    ~EventRecorder();
+
+    bool Open(const char* filename, u64 startFrame);
+    void Close();
+
+    void Record(const event::EventHeader* header);
+    // Records a run of consecutive event records
+    void Record(const char* begin, const char* end);
+    void EndFrame(u64 frame);
+
+  private:
+    enum
+    {
+      BUFFER_SIZE = 1024 * 1024,
+      FLUSH_SIZE = BUFFER_SIZE - 64 * 1024,
+    };
+
+    void AppendBytes(const void* data, size_t len);
+    void Flush();
+    void WriterThread();
+
+    FILE* _file = nullptr;
+    std::thread _writer;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _pending = false;
+    bool _done = false;
+
+    vector<char> _buffers[2];
+    int _active = 0;
+
+    // offset of the current frame's header in the active buffer, or -1
+    s64 _frameOfs = -1;
+    u32 _frameEvents = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // Memory maps an event log, and indexes the frames for seeking
+  struct EventLogReader
+  {
+    ~EventLogReader();
+
+    bool Open(const char* filename);
+    void Close();
+
+    // Returns the event records of the given frame, or false if the frame has no events
+    bool FrameEvents(u64 frame, const char** begin, const char** end) const;
+
+    u64 StartFrame() const { return _startFrame; }
+    u64 LastFrame() const { return _frames.empty() ? _startFrame : _frames.back().frame; }
+
+  private:
+    struct FrameIndex
+    {
+      u64 frame;
+      size_t ofs;
+    };
+
+    vector<FrameIndex> _frames;
+    u64 _startFrame = 0;
+    MappedFile _file;
+    const char* _data = nullptr;
+    size_t _size = 0;
+  };
+}
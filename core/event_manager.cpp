@@ -1,17 +1,156 @@
 #include <string.h>
 #include <assert.h>
+#include <chrono>
+#include <mutex>
 #include <lib/utils.hpp>
+#include <lib/error.hpp>
 #include "event_manager.hpp"
+#include "event_log.hpp"
 
 using namespace world;
 
 EventManager* world::g_eventManager = nullptr;
+thread_local u32 world::t_mainThreadGeneration = 0;
+
+namespace
+{
+  // Hands out the generations that the producer caches are keyed on. 0 is never handed
+  // out, so an empty cache doesn't match any manager.
+  std::atomic<u32> g_nextGeneration{1};
+
+  // Serializes a thread giving up its ring against the event manager going away
+  std::mutex g_retireMutex;
+
+  //------------------------------------------------------------------------------
+  // Gives up the calling thread's ring. If the event manager is already gone, nothing
+  // else refers to the ring, so it's freed here, otherwise Tick frees it once drained.
+  void ReleaseProducer(EventProducer* producer)
+  {
+    std::lock_guard<std::mutex> lock(g_retireMutex);
+    if (producer->orphaned)
+      delete producer;
+    else
+      producer->retired.store(true, std::memory_order_release);
+  }
+
+  struct ThreadProducer
+  {
+    ~ThreadProducer()
+    {
+      if (producer)
+        ReleaseProducer(producer);
+    }
+
+    u32 generation = 0;
+    EventProducer* producer = nullptr;
+  };
+
+  thread_local ThreadProducer t_producer;
+
+  //------------------------------------------------------------------------------
+  u64 NowMs()
+  {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  //------------------------------------------------------------------------------
+  void WriteRecord(char* dst, event::EventType type, const void* data, int len)
+  {
+    event::EventHeader* header = (event::EventHeader*)dst;
+    header->type = type;
+    header->len = EventManager::RecordSize(len);
+    memcpy(header + 1, data, len);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool EventProducer::Push(event::EventType type, const void* data, int len)
+{
+  u32 alignedLen = EventManager::RecordSize(len);
+  u32 h = head.load(std::memory_order_relaxed);
+  u32 t = tail.load(std::memory_order_acquire);
+
+  // if the event doesn't fit before the end of the ring, the remainder is
+  // filled with a padding event, and the event is written at the start
+  u32 ofs = h & (RING_SIZE - 1);
+  u32 toEnd = RING_SIZE - ofs;
+  u32 padding = toEnd < alignedLen ? toEnd : 0;
+
+  if (h + padding + alignedLen - t > RING_SIZE)
+    return false;
+
+  if (padding)
+  {
+    event::EventHeader* pad = (event::EventHeader*)&buf[ofs];
+    pad->type = event::kEventCount;
+    pad->len = padding;
+    h += padding;
+    ofs = 0;
+  }
+
+  WriteRecord(&buf[ofs], type, data, len);
+
+  head.store(h + alignedLen, std::memory_order_release);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventProducer::Drain(EventManager* mgr, bool dispatch)
+{
+  // only drain up to the head at the start, so a busy producer can't stall the tick
+  u32 h = head.load(std::memory_order_acquire);
+  u32 t = tail.load(std::memory_order_relaxed);
+
+  while (t != h)
+  {
+    const event::EventHeader* header = (const event::EventHeader*)&buf[t & (RING_SIZE - 1)];
+    if (dispatch && header->type != event::kEventCount)
+    {
+      if (mgr->_recorder)
+        mgr->_recorder->Record(header);
+      mgr->Dispatch(header);
+    }
+    t += header->len;
+  }
+
+  tail.store(t, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+EventManager::EventManager() : _generation(g_nextGeneration.fetch_add(1)) {}
+
+//------------------------------------------------------------------------------
+EventManager::~EventManager()
+{
+  StopRecording();
+  StopReplay();
+
+  for (vector<EventPage*>& pages : _pages)
+    SeqDelete(&pages);
+  SeqDelete(&_freePages);
+
+  // the rings of threads that are still around are left for them to free
+  std::lock_guard<std::mutex> lock(g_retireMutex);
+  for (EventProducer* cur = _producers.exchange(nullptr); cur; cur = cur->next)
+    _producerOrder.push_back(cur);
+
+  for (EventProducer* producer : _producerOrder)
+  {
+    if (producer->retired.load(std::memory_order_relaxed))
+      delete producer;
+    else
+      producer->orphaned = true;
+  }
+}
 
 //------------------------------------------------------------------------------
 bool EventManager::Create()
 {
   assert(!g_eventManager);
   g_eventManager = new EventManager();
+  t_mainThreadGeneration = g_eventManager->_generation;
+  g_eventManager->_startTimeMs = NowMs();
   return true;
 }
 
@@ -23,38 +162,435 @@ bool EventManager::Destroy()
 }
 
 //------------------------------------------------------------------------------
-u32 EventManager::RegisterListener(event::EventType type, const fnEventListener& listener)
+ListenerHandle EventManager::AddListener(event::EventType type, const Listener& listener)
 {
+  u32 slot;
+  if (_freeListenerSlots.empty())
+  {
+    slot = (u32)_listenerSlots.size();
+    assert(slot < (1 << ListenerHandle::cIdxBits));
+    // start generations at 1, so a valid handle is never 0
+    _listenerSlots.push_back(ListenerSlot{0, 0, 1});
+  }
+  else
+  {
+    slot = _freeListenerSlots.back();
+    _freeListenerSlots.pop_back();
+  }
+
+  ListenerSlot& s = _listenerSlots[slot];
+  s.type = type;
+  s.idx = (u32)_listeners[type].size();
+
   _listeners[type].push_back(listener);
-  return (u32)_listeners[type].size();
+  _listeners[type].back().slot = slot;
+
+  return ListenerHandle(slot, s.generation);
 }
 
 //------------------------------------------------------------------------------
-void EventManager::AddEvent(event::EventType type, void* data, int len)
+void EventManager::UnregisterListener(ListenerHandle handle)
 {
-  assert(_eventOfs + len + sizeof(u32) < EVENT_BUF_SIZE);
+  u32 slot = handle._idx;
+  if (!handle.IsValid() || slot >= _listenerSlots.size())
+    return;
+
+  ListenerSlot& s = _listenerSlots[slot];
+  if (s.generation != handle._generation)
+    return;
 
-  // hmm, is there a better way to do this?
-  event::EventBase* base = (event::EventBase*)data;
-  base->len = len;
+  // bump the generation, so any copies of the handle become stale. Generation 0 is
+  // skipped to keep the handle non-zero.
+  s.generation = (s.generation + 1) & ((1 << ListenerHandle::cGenerationBits) - 1);
+  if (s.generation == 0)
+    s.generation = 1;
+
+  if (_dispatchDepth > 0)
+  {
+    // swapping listeners around while dispatching would skip listeners, so just
+    // disable this one, and remove it after the tick
+    _listeners[s.type][s.idx].thunk = nullptr;
+    _pendingRemovals.push_back(slot);
+    return;
+  }
 
-  memcpy(&_eventBuf[_eventOfs], data, len);
-  _eventOfs += len;
+  RemoveListener(slot);
+}
+
+//------------------------------------------------------------------------------
+void EventManager::RemoveListener(u32 slot)
+{
+  ListenerSlot& s = _listenerSlots[slot];
+  vector<Listener>& listeners = _listeners[s.type];
+
+  // swap-remove, and patch up the slot of the listener that was moved
+  u32 last = (u32)listeners.size() - 1;
+  if (s.idx != last)
+  {
+    listeners[s.idx] = listeners[last];
+    _listenerSlots[listeners[s.idx].slot].idx = s.idx;
+  }
+  listeners.pop_back();
+
+  _freeListenerSlots.push_back(slot);
+}
+
+//------------------------------------------------------------------------------
+void EventManager::CompactListeners()
+{
+  for (u32 slot : _pendingRemovals)
+    RemoveListener(slot);
+  _pendingRemovals.clear();
+}
+
+//------------------------------------------------------------------------------
+EventProducer* EventManager::GetProducer()
+{
+  if (t_producer.generation == _generation)
+    return t_producer.producer;
+
+  // the thread has moved on from an earlier event manager
+  if (t_producer.producer)
+    ReleaseProducer(t_producer.producer);
+
+  EventProducer* producer = new EventProducer();
+  producer->id = _numProducers.fetch_add(1);
+
+  // push the new producer on the lock free list
+  EventProducer* head = _producers.load(std::memory_order_relaxed);
+  do
+  {
+    producer->next = head;
+  } while (!_producers.compare_exchange_weak(
+      head, producer, std::memory_order_release, std::memory_order_relaxed));
+
+  t_producer.generation = _generation;
+  t_producer.producer = producer;
+  return producer;
+}
+
+//------------------------------------------------------------------------------
+bool EventManager::AddEvent(
+    event::EventType type, const void* data, int len, event::EventPriority priority)
+{
+  if (t_mainThreadGeneration != _generation)
+  {
+    if (!GetProducer()->Push(type, data, len))
+    {
+      LOG_WARN("Event queue full, dropping event: ", type);
+      return false;
+    }
+    return true;
+  }
+
+  // when replaying, only the recorded events are dispatched
+  if (_replay)
+    return true;
+
+  u32 alignedLen = RecordSize(len);
+  assert(alignedLen <= EventPage::PAGE_SIZE);
+
+  LaneWriter& writer = _writers[priority];
+  if ((size_t)(writer.end - writer.cur) < alignedLen)
+  {
+    // carry on with the last page if it has room, which it can after a replay, otherwise
+    // start a new one
+    SyncLane(priority);
+    vector<EventPage*>& pages = _pages[priority];
+    EventPage* page = pages.empty() ? nullptr : pages.back();
+    if (!page || page->used + alignedLen > EventPage::PAGE_SIZE)
+    {
+      if (_freePages.empty())
+      {
+        page = new EventPage();
+        _stats.numPagesAllocated++;
+      }
+      else
+      {
+        page = _freePages.back();
+        _freePages.pop_back();
+      }
+      page->used = 0;
+      pages.push_back(page);
+    }
+    writer.cur = &page->data[page->used];
+    writer.end = &page->data[EventPage::PAGE_SIZE];
+  }
+
+  WriteRecord(writer.cur, type, data, len);
+  writer.cur += alignedLen;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventManager::SyncLane(int lane)
+{
+  const LaneWriter& writer = _writers[lane];
+  if (writer.cur)
+  {
+    EventPage* page = _pages[lane].back();
+    page->used = (u32)(writer.cur - page->data);
+  }
+}
+
+//------------------------------------------------------------------------------
+void EventManager::TrimPages()
+{
+  u32 queued = 0;
+  u32 numPages = 0;
+  for (int i = 0; i < event::kPriorityCount; ++i)
+  {
+    SyncLane(i);
+    _writers[i] = LaneWriter();
+    for (EventPage* page : _pages[i])
+    {
+      queued += page->used;
+      _freePages.push_back(page);
+    }
+    numPages += (u32)_pages[i].size();
+    _pages[i].clear();
+    _cursors[i] = LaneCursor();
+  }
+
+  _stats.highWaterMark = max(_stats.highWaterMark, queued);
+  _recentPeakPages = max(_recentPeakPages, numPages);
+
+  // after a quiet period, free the pages that haven't been needed
+  if (++_frameCount < QUIET_FRAMES)
+    return;
+
+  while (_freePages.size() > _recentPeakPages)
+  {
+    delete _freePages.back();
+    _freePages.pop_back();
+    _stats.numPagesAllocated--;
+  }
+
+  _frameCount = 0;
+  _recentPeakPages = 0;
+}
+
+//------------------------------------------------------------------------------
+bool EventManager::DispatchLane(int lane)
+{
+  // listeners can append to the page being walked, and start new pages, so the end of
+  // the lane is looked up again once the events found so far have been dispatched. The
+  // page lists can grow too, so the cursor holds indices, and not pointers.
+  LaneCursor& cursor = _cursors[lane];
+  const vector<EventPage*>& pages = _pages[lane];
+  const LaneWriter& writer = _writers[lane];
+  bool dispatched = false;
+  while (cursor.page < pages.size())
+  {
+    u32 pageIdx = cursor.page;
+    const EventPage* page = pages[pageIdx];
+    bool last = pageIdx + 1 == pages.size();
+    u32 used = last && writer.cur ? (u32)(writer.cur - page->data) : page->used;
+    if (cursor.ofs < used)
+    {
+      if (_recorder)
+        _recorder->Record(&page->data[cursor.ofs], &page->data[used]);
+
+      // a listener starting a replay moves the cursor to the end of the lane
+      while (cursor.ofs < used && cursor.page == pageIdx)
+      {
+        const event::EventHeader* header = (const event::EventHeader*)&page->data[cursor.ofs];
+        cursor.ofs += header->len;
+        Dispatch(header);
+      }
+      dispatched = true;
+      continue;
+    }
+
+    // stay on the last page, as more events can be appended to it
+    if (last)
+      break;
+    cursor.page++;
+    cursor.ofs = 0;
+  }
+  return dispatched;
+}
+
+//------------------------------------------------------------------------------
+void EventManager::DispatchQueued()
+{
+  // each lane is walked in one go. Listeners can post to a higher priority lane than the
+  // one being walked, so after a lane has dispatched anything, the lanes are checked
+  // again from the top.
+  for (int i = 0; i < event::kPriorityCount;)
+    i = DispatchLane(i) ? 0 : i + 1;
+}
+
+//------------------------------------------------------------------------------
+void EventManager::AddTimedEvent(TimingWheel* wheel,
+    u64 expire,
+    event::EventType type,
+    const void* data,
+    int len,
+    event::EventPriority priority)
+{
+  assert(t_mainThreadGeneration == _generation);
+  assert(len <= MAX_TIMED_EVENT_SIZE);
+
+  u32 idx;
+  if (_freeTimedEvents.empty())
+  {
+    idx = (u32)_timedEvents.size();
+    _timedEvents.push_back(TimedEvent());
+  }
+  else
+  {
+    idx = _freeTimedEvents.back();
+    _freeTimedEvents.pop_back();
+  }
+
+  TimedEvent& e = _timedEvents[idx];
+  e.type = type;
+  e.priority = priority;
+  e.len = len;
+  memcpy(e.data, data, len);
+
+  wheel->Add(expire, idx);
+}
+
+//------------------------------------------------------------------------------
+void EventManager::FireTimedEvent(u32 idx)
+{
+  // copy the event to its lane, so it's dispatched in priority order with the rest
+  const TimedEvent& e = _timedEvents[idx];
+  AddEvent(e.type, e.data, e.len, e.priority);
+  _freeTimedEvents.push_back(idx);
+}
+
+//------------------------------------------------------------------------------
+u64 EventManager::ElapsedMs() const
+{
+  return NowMs() - _startTimeMs;
 }
 
 //------------------------------------------------------------------------------
 void EventManager::Tick()
 {
-  for (char* cur = &_eventBuf[0]; cur < &_eventBuf[_eventOfs];)
+  _frameWheel.Advance(_frameWheel.Now() + 1, [this](u32 idx) { FireTimedEvent(idx); });
+  _timeWheel.Advance(ElapsedMs(), [this](u32 idx) { FireTimedEvent(idx); });
+
+  // the whole tick counts as dispatching, so removed listeners are only disabled until
+  // CompactListeners
+  _dispatchDepth++;
+
+  u64 frame = CurrentFrame();
+  bool replaying = _replay != nullptr;
+  if (replaying)
   {
-    event::EventBase* event = (event::EventBase*)cur;
-    for (const fnEventListener& listener : _listeners[event->type])
+    // map the current frame to the recorded frame
+    u64 recordedFrame = _replay->StartFrame() + (frame - _replayStartFrame);
+    const char* begin;
+    const char* end;
+    if (_replay->FrameEvents(recordedFrame, &begin, &end))
+    {
+      if (_recorder)
+        _recorder->Record(begin, end);
+      for (const char* cur = begin; cur < end;)
+      {
+        const event::EventHeader* header = (const event::EventHeader*)cur;
+        Dispatch(header);
+        cur += header->len;
+      }
+    }
+
+    if (recordedFrame >= _replay->LastFrame())
     {
-      listener(event);
+      LOG_INFO("Event replay done");
+      StopReplay();
     }
-    cur += event->len;
   }
 
-  // reset the event queue
-  _eventOfs = 0;
-}
\ No newline at end of file
+  DispatchQueued();
+
+  // take over the producers registered since the last tick, and keep them sorted on
+  // registration order
+  if (EventProducer* added = _producers.exchange(nullptr, std::memory_order_acquire))
+  {
+    for (EventProducer* cur = added; cur; cur = cur->next)
+      _producerOrder.push_back(cur);
+
+    sort(_producerOrder.begin(),
+        _producerOrder.end(),
+        [](const EventProducer* lhs, const EventProducer* rhs) { return lhs->id < rhs->id; });
+  }
+
+  // a retired ring is freed after draining it. The flag is read first, so everything its
+  // thread posted is in the ring by the time it's drained.
+  size_t numLive = 0;
+  for (EventProducer* producer : _producerOrder)
+  {
+    bool retired = producer->retired.load(std::memory_order_acquire);
+    producer->Drain(this, !replaying);
+    if (retired)
+      delete producer;
+    else
+      _producerOrder[numLive++] = producer;
+  }
+  _producerOrder.resize(numLive);
+
+  // dispatch anything queued by the producer thread's listeners, and reset the queue
+  DispatchQueued();
+  TrimPages();
+
+  _dispatchDepth--;
+  CompactListeners();
+
+  if (_recorder)
+    _recorder->EndFrame(frame);
+}
+
+//------------------------------------------------------------------------------
+bool EventManager::StartRecording(const char* filename)
+{
+  StopRecording();
+
+  _recorder = new EventRecorder();
+  if (!_recorder->Open(filename, CurrentFrame() + 1))
+  {
+    SAFE_DELETE(_recorder);
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventManager::StopRecording()
+{
+  SAFE_DELETE(_recorder);
+}
+
+//------------------------------------------------------------------------------
+bool EventManager::StartReplay(const char* filename)
+{
+  StopReplay();
+
+  _replay = new EventLogReader();
+  if (!_replay->Open(filename))
+  {
+    SAFE_DELETE(_replay);
+    return false;
+  }
+
+  // skip the live events that have been queued up. This can be called while dispatching,
+  // so the pages are left alone, and reclaimed at the end of the tick as usual.
+  for (int i = 0; i < event::kPriorityCount; ++i)
+  {
+    SyncLane(i);
+    _writers[i] = LaneWriter();
+    if (!_pages[i].empty())
+      _cursors[i] = LaneCursor{(u32)_pages[i].size() - 1, _pages[i].back()->used};
+  }
+  _replayStartFrame = CurrentFrame() + 1;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void EventManager::StopReplay()
+{
+  SAFE_DELETE(_replay);
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <lib/timing_wheel.hpp>
 
 namespace world
 {
@@ -13,11 +14,23 @@ namespace world
       kEventCount
     };
 
-    struct EventBase
+    // Main thread events are dispatched in priority order, and in insertion order
+    // within a priority. Events that listeners post to a higher priority are dispatched
+    // once the priority being dispatched has run dry.
+    enum EventPriority
     {
-      EventBase(EventType type) : type(type), len(0) {}
-      EventType type;
-      int len;
+      kPriorityHigh,
+      kPriorityNormal,
+      kPriorityLow,
+
+      kPriorityCount
+    };
+
+    // Header written in front of each queued event
+    struct EventHeader
+    {
+      u32 type;
+      u32 len;
     };
 
     enum KeyModifiers
@@ -27,53 +40,367 @@ namespace world
       kModAlt = 1 << 2,
     };
 
-    struct KeyDown : public EventBase
+    struct KeyDown
     {
-      KeyDown(int key, u8 modifiers = 0) : EventBase(kEventKeyDown), key(key), modifiers(modifiers) {}
+      static const EventType TYPE = kEventKeyDown;
+      KeyDown(int key, u8 modifiers = 0) : key(key), modifiers(modifiers) {}
       int key;
       u8 modifiers = 0;
     };
 
-    struct KeyUp : public EventBase
+    struct KeyUp
     {
-      KeyUp(int key, u8 modifiers = 0) : EventBase(kEventKeyUp), key(key), modifiers(modifiers) {}
+      static const EventType TYPE = kEventKeyUp;
+      KeyUp(int key, u8 modifiers = 0) : key(key), modifiers(modifiers) {}
       int key;
       u8 modifiers = 0;
     };
   }
 
+  struct EventManager;
+  struct EventRecorder;
+  struct EventLogReader;
+
+  //------------------------------------------------------------------------------
+  // Per-thread single producer ring. Threads other than the one that created the
+  // event manager get one of these the first time they post an event, so producers
+  // never contend with each other, and Tick only has to synchronize with each ring's
+  // head/tail pair. When its thread exits, the ring is retired, and Tick frees it once
+  // it has been drained.
+  struct EventProducer
+  {
+    enum { RING_SIZE = 1024 * 1024 };
+    enum { CACHE_LINE = 64 };
+
+    bool Push(event::EventType type, const void* data, int len);
+    void Drain(EventManager* mgr, bool dispatch);
+
+    u32 id = 0;
+    EventProducer* next = nullptr;
+
+    // set by the producer thread when it's done with the ring, and by the event manager
+    // when it goes away first, both under the retire mutex. Whichever side comes second
+    // frees the ring.
+    std::atomic<bool> retired{false};
+    bool orphaned = false;
+
+    // head is written by the producer, and tail by Tick, so they're kept a cache line
+    // apart, and away from the ring, so neither side's writes evict the other's line
+    char pad0[CACHE_LINE];
+    std::atomic<u32> head{0};
+    char pad1[CACHE_LINE - sizeof(std::atomic<u32>)];
+    std::atomic<u32> tail{0};
+    char pad2[CACHE_LINE - sizeof(std::atomic<u32>)];
+    alignas(8) char buf[RING_SIZE];
+  };
+
+  //------------------------------------------------------------------------------
+  // Fixed size chunk of the main thread's event queue. Pages are grabbed from a free
+  // list as the queue grows, and returned to it on Tick.
+  struct EventPage
+  {
+    enum { PAGE_SIZE = 64 * 1024 };
+    u32 used = 0;
+    alignas(8) char data[PAGE_SIZE];
+  };
+
+  //------------------------------------------------------------------------------
+  // Listener handles index into a slot table, and carry the slot's generation, so a
+  // stale handle won't remove a listener that has since reused the slot.
+  struct ListenerHandle
+  {
+    enum
+    {
+      cIdxBits = 20,
+      cGenerationBits = 32 - cIdxBits,
+    };
+
+    ListenerHandle() : _raw(0) {}
+    ListenerHandle(u32 idx, u32 generation) : _idx(idx), _generation(generation) {}
+    bool IsValid() const { return _raw != 0; }
+
+    union
+    {
+      struct
+      {
+        u32 _idx : cIdxBits;
+        u32 _generation : cGenerationBits;
+      };
+      u32 _raw;
+    };
+  };
+
+  // The generation of the event manager that the calling thread created, which makes it
+  // that manager's main thread
+  extern thread_local u32 t_mainThreadGeneration;
+
   //------------------------------------------------------------------------------
   struct EventManager
   {
-    typedef function<void(const event::EventBase*)> fnEventListener;
-    
-    u32 RegisterListener(event::EventType type, const fnEventListener& listener);
-    void UnregisterListener(u32 id);
+    // A listener is a plain function pointer and a context. Member function pointers are
+    // stored inline, and invoked via a per type thunk, so there's no downcasting in the
+    // listener. Methods bound at compile time are called straight from the thunk, which
+    // makes dispatch a single indirect call.
+    struct Listener
+    {
+      typedef void (*fnThunk)(const Listener& listener, const void* event);
+      fnThunk thunk;
+      void* ctx;
+      char method[16];
+      u32 slot;
+    };
+
+    struct ListenerSlot
+    {
+      u32 type;
+      u32 idx;
+      u32 generation;
+    };
+
+    EventManager();
+    ~EventManager();
+
+    template <typename T, typename O>
+    ListenerHandle Subscribe(O* obj, void (O::*method)(const T&))
+    {
+      typedef void (O::*Method)(const T&);
+      static_assert(sizeof(Method) <= sizeof(Listener::method), "Member pointer too large");
+
+      Listener listener;
+      listener.thunk = [](const Listener& l, const void* event)
+      {
+        Method m;
+        memcpy(&m, l.method, sizeof(Method));
+        (((O*)l.ctx)->*m)(*(const T*)event);
+      };
+      listener.ctx = obj;
+      memcpy(listener.method, &method, sizeof(Method));
+      return AddListener(T::TYPE, listener);
+    }
+
+    // The same, with the method bound at compile time, so the thunk calls it directly, and
+    // can inline it, rather than going through the member pointer. Used as
+    // Subscribe<event::KeyDown, Obj, &Obj::OnKeyDown>(obj).
+    template <typename T, typename O, void (O::*Method)(const T&)>
+    ListenerHandle Subscribe(O* obj)
+    {
+      Listener listener;
+      listener.thunk = [](const Listener& l, const void* event)
+      {
+        (((O*)l.ctx)->*Method)(*(const T*)event);
+      };
+      listener.ctx = obj;
+      return AddListener(T::TYPE, listener);
+    }
+
+    template <typename T>
+    ListenerHandle Subscribe(void (*fn)(const T&, void*), void* ctx = nullptr)
+    {
+      typedef void (*Fn)(const T&, void*);
+
+      Listener listener;
+      listener.thunk = [](const Listener& l, const void* event)
+      {
+        Fn f;
+        memcpy(&f, l.method, sizeof(Fn));
+        f(*(const T*)event, l.ctx);
+      };
+      listener.ctx = ctx;
+      memcpy(listener.method, &fn, sizeof(Fn));
+      return AddListener(T::TYPE, listener);
+    }
+
+    ListenerHandle AddListener(event::EventType type, const Listener& listener);
+
+    // Removing a listener is O(1). Listeners removed during Tick are disabled
+    // immediately, and compacted out of the listener arrays once the tick is done.
+    void UnregisterListener(ListenerHandle handle);
+    void RemoveListener(u32 slot);
+    void CompactListeners();
 
     static bool Create();
     static bool Destroy();
 
+    // Fires the expired timed events, and dispatches the events posted by the main thread,
+    // followed by the events from each producer thread, in the order the producers were
+    // registered.
     void Tick();
 
+    // The common case, the main thread appending to the lane's current page, is a bounds
+    // check and a copy. Other threads, full pages and replays take the out of line path.
     template <typename T>
-    void AddEvent(const T& event)
+    bool AddEvent(const T& event, event::EventPriority priority = event::kPriorityNormal)
     {
-      AddEvent(event.type, (void*)&event, sizeof(T));
+      const u32 size = RecordSize(sizeof(T));
+      LaneWriter& writer = _writers[priority];
+      if (t_mainThreadGeneration == _generation && (size_t)(writer.end - writer.cur) >= size)
+      {
+        event::EventHeader* header = (event::EventHeader*)writer.cur;
+        header->type = T::TYPE;
+        header->len = size;
+        new (header + 1) T(event);
+        writer.cur += size;
+        return true;
+      }
+      return AddEventSlow(event, priority);
     }
 
-    void AddEvent(event::EventType type, void* data, int len);
+    // Takes the event by value, so the caller's copy doesn't have to be in memory on the
+    // fast path
+    template <typename T>
+    bool AddEventSlow(T event, event::EventPriority priority)
+    {
+      return AddEvent(T::TYPE, &event, sizeof(T), priority);
+    }
 
-    enum { EVENT_BUF_SIZE = 32 * 1024 * 1024 };
-    char _eventBuf[EVENT_BUF_SIZE];
-    u32 _eventOfs = 0;
+    // Safe to call from any thread. Returns false if the calling thread's queue is full.
+    // nb: events from other threads than the main thread ignore the priority.
+    bool AddEvent(event::EventType type,
+        const void* data,
+        int len,
+        event::EventPriority priority = event::kPriorityNormal);
 
-    struct Listener
+    // Queues the event to be dispatched on the Tick of the given frame. Main thread only.
+    template <typename T>
+    void AddEventAtFrame(
+        const T& event, u64 frame, event::EventPriority priority = event::kPriorityNormal)
+    {
+      static_assert(sizeof(T) <= MAX_TIMED_EVENT_SIZE, "Event too large to be timed");
+      AddTimedEvent(&_frameWheel, frame, T::TYPE, &event, sizeof(T), priority);
+    }
+
+    // Queues the event to be dispatched on the first Tick after 'seconds' have passed,
+    // counting from the call, and not from the last Tick. Main thread only.
+    template <typename T>
+    void AddEventDelayed(
+        const T& event, float seconds, event::EventPriority priority = event::kPriorityNormal)
+    {
+      static_assert(sizeof(T) <= MAX_TIMED_EVENT_SIZE, "Event too large to be timed");
+      u64 expire = ElapsedMs() + (u64)(max(0.f, seconds) * 1000);
+      AddTimedEvent(&_timeWheel, expire, T::TYPE, &event, sizeof(T), priority);
+    }
+
+    void AddTimedEvent(TimingWheel* wheel,
+        u64 expire,
+        event::EventType type,
+        const void* data,
+        int len,
+        event::EventPriority priority);
+    void FireTimedEvent(u32 idx);
+
+    u64 CurrentFrame() const { return _frameWheel.Now(); }
+
+    // Milliseconds since the event manager was created, which is the time wheel's clock
+    u64 ElapsedMs() const;
+
+    // Streams every dispatched event to a binary log, starting with the next Tick
+    bool StartRecording(const char* filename);
+    void StopRecording();
+
+    // Dispatches the events from a recorded log in place of the live events. Events posted
+    // while replaying, including the ones from timers and listeners, are discarded.
+    bool StartReplay(const char* filename);
+    void StopReplay();
+
+    // Queued events are padded to keep the following event aligned
+    enum { EVENT_ALIGNMENT = 8 };
+    static u32 RecordSize(int len)
+    {
+      return (sizeof(event::EventHeader) + len + EVENT_ALIGNMENT - 1) & ~(EVENT_ALIGNMENT - 1);
+    }
+
+    EventProducer* GetProducer();
+    // Calls the event's listeners. Only called from Tick, which holds the dispatch depth
+    // for the whole tick, and records the events in runs, so this is just the listener loop.
+    void Dispatch(const event::EventHeader* header)
+    {
+      // nb: the listener array can grow if a listener subscribes during dispatch, so each
+      // listener is looked up by index, and the thunks don't touch the listener after
+      // calling it. New listeners don't see the event being dispatched.
+      const void* event = header + 1;
+      const vector<Listener>& listeners = _listeners[header->type];
+      for (size_t i = 0, e = listeners.size(); i < e; ++i)
+      {
+        const Listener& listener = listeners[i];
+        if (listener.thunk)
+          listener.thunk(listener, event);
+      }
+    }
+
+    // Returns true if any events were dispatched
+    bool DispatchLane(int lane);
+    void DispatchQueued();
+
+    void SyncLane(int lane);
+    void TrimPages();
+
+    // Number of frames the queue has to stay below the allocated page count
+    // before the unused pages are freed
+    enum { QUIET_FRAMES = 120 };
+
+    struct Stats
+    {
+      // max number of bytes queued in a single frame
+      u32 highWaterMark = 0;
+      u32 numPagesAllocated = 0;
+    };
+
+    struct LaneCursor
+    {
+      u32 page = 0;
+      u32 ofs = 0;
+    };
+
+    // The main thread's write position on the last page of a lane. The page's used count
+    // is only brought up to date by SyncLane, so posting doesn't touch the page header.
+    // Both are null while replaying, which sends every event down the slow path.
+    struct LaneWriter
+    {
+      char* cur = nullptr;
+      char* end = nullptr;
+    };
+
+    vector<EventPage*> _pages[event::kPriorityCount];
+    LaneWriter _writers[event::kPriorityCount];
+    LaneCursor _cursors[event::kPriorityCount];
+    vector<EventPage*> _freePages;
+    u32 _recentPeakPages = 0;
+    u32 _frameCount = 0;
+    Stats _stats;
+
+    // The producers' thread local caches, and the main thread check, are keyed on this,
+    // rather than on the manager's address, which can be reused by a later manager
+    u32 _generation = 0;
+    // new producers are pushed here, and moved over to _producerOrder on Tick
+    std::atomic<EventProducer*> _producers{nullptr};
+    std::atomic<u32> _numProducers{0};
+    vector<EventProducer*> _producerOrder;
+
+    enum { MAX_TIMED_EVENT_SIZE = 64 };
+    struct TimedEvent
     {
       event::EventType type;
-      fnEventListener listener;
+      event::EventPriority priority;
+      int len;
+      char data[MAX_TIMED_EVENT_SIZE];
     };
 
-    vector<fnEventListener> _listeners[event::kEventCount];
+    // The frame wheel ticks once per Tick, and the time wheel ticks in milliseconds
+    TimingWheel _frameWheel;
+    TimingWheel _timeWheel;
+    vector<TimedEvent> _timedEvents;
+    vector<u32> _freeTimedEvents;
+    u64 _startTimeMs = 0;
+
+    EventRecorder* _recorder = nullptr;
+    EventLogReader* _replay = nullptr;
+    u64 _replayStartFrame = 0;
+
+    vector<Listener> _listeners[event::kEventCount];
+    vector<ListenerSlot> _listenerSlots;
+    vector<u32> _freeListenerSlots;
+    vector<u32> _pendingRemovals;
+    int _dispatchDepth = 0;
   };
 
   extern EventManager* g_eventManager;
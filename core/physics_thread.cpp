@@ -0,0 +1,255 @@
+#include "physics_thread.hpp"
+#include <lib/error.hpp>
+#include <lib/utils.hpp>
+#include <chrono>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+PhysicsThread::~PhysicsThread()
+{
+  Stop();
+}
+
+//------------------------------------------------------------------------------
+double PhysicsThread::Now()
+{
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+bool PhysicsThread::Start(b2World* world, double stepSize, int maxSteps)
+{
+  Stop();
+
+  _world = world;
+  _timestep = FixedTimestep(stepSize, maxSteps);
+  DrainBodyCommands();
+
+  // seed all the slots, so the renderer has the current state before the first step
+  double now = Now();
+  for (int i = 0; i < 3; ++i)
+  {
+    PhysicsSnapshot& snapshot = _snapshots.Slot(i);
+    snapshot.prev.resize(_bodies.size());
+    snapshot.cur.resize(_bodies.size());
+    for (size_t j = 0; j < _bodies.size(); ++j)
+      snapshot.prev[j] = snapshot.cur[j] = _bodies[j]->GetTransform();
+    snapshot.stepTime = now;
+  }
+
+  _stop = false;
+  _thread = std::thread([this]() { SimThread(); });
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::Stop()
+{
+  if (!_thread.joinable())
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _stopCv.notify_all();
+  _thread.join();
+  DrainBodyCommands();
+  _world = nullptr;
+
+  // drop any forces queued after the last step
+  _commandTail.store(_commandHead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+u32 PhysicsThread::TrackBody(b2Body* body)
+{
+  assert(!IsRunning());
+  _bodies.push_back(body);
+  return (u32)_bodies.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::ClearBodies()
+{
+  assert(!IsRunning());
+  _bodies.clear();
+  _staticBodies.clear();
+
+  // any chains queued since the last step are for the old level
+  {
+    std::unique_lock<std::mutex> lock(_bodyMutex);
+    _bodyCommands.clear();
+  }
+  _bodyCommandsTmp.clear();
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::ApplyForceToCenter(b2Body* body, const b2Vec2& force)
+{
+  if (!IsRunning())
+  {
+    body->ApplyForceToCenter(force, true);
+    return;
+  }
+
+  u32 head = _commandHead.load(std::memory_order_relaxed);
+  if (head - _commandTail.load(std::memory_order_acquire) == COMMAND_RING_SIZE)
+  {
+    LOG_WARN("Physics command ring full, dropping force");
+    return;
+  }
+
+  _commands[head % COMMAND_RING_SIZE] = ForceCommand{body, force};
+  _commandHead.store(head + 1, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::DrainCommands()
+{
+  u32 tail = _commandTail.load(std::memory_order_relaxed);
+  u32 head = _commandHead.load(std::memory_order_acquire);
+  for (; tail != head; ++tail)
+  {
+    const ForceCommand& cmd = _commands[tail % COMMAND_RING_SIZE];
+    cmd.body->ApplyForceToCenter(cmd.force, true);
+  }
+  _commandTail.store(tail, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::AddStaticBody(u64 key, const StaticChains& chains)
+{
+  std::unique_lock<std::mutex> lock(_bodyMutex);
+  _bodyCommands.push_back(BodyCommand{key, false, chains});
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::RemoveStaticBody(u64 key)
+{
+  std::unique_lock<std::mutex> lock(_bodyMutex);
+  _bodyCommands.push_back(BodyCommand{key, true, StaticChains()});
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::DrainBodyCommands()
+{
+  {
+    std::unique_lock<std::mutex> lock(_bodyMutex);
+    _bodyCommands.swap(_bodyCommandsTmp);
+  }
+
+  for (const BodyCommand& cmd : _bodyCommandsTmp)
+  {
+    auto it = _staticBodies.find(cmd.key);
+    if (it != _staticBodies.end())
+    {
+      _world->DestroyBody(it->second);
+      _staticBodies.erase(it);
+    }
+
+    if (cmd.remove)
+      continue;
+
+    b2BodyDef bodyDef;
+    b2Body* body = _world->CreateBody(&bodyDef);
+    _staticBodies[cmd.key] = body;
+
+    // b2ChainShape copies the points
+    const StaticChains& chains = cmd.chains;
+    _chainPoints.resize(chains.points.size());
+    for (size_t i = 0; i < chains.points.size(); ++i)
+      _chainPoints[i] = b2Vec2(chains.points[i].x, chains.points[i].y);
+
+    u32 firstPoint = 0;
+    for (u32 numPoints : chains.loopSizes)
+    {
+      b2ChainShape chain;
+      chain.CreateLoop(&_chainPoints[firstPoint], numPoints);
+      body->CreateFixture(&chain, 0.0f);
+      firstPoint += numPoints;
+    }
+
+    for (u32 numPoints : chains.chainSizes)
+    {
+      b2ChainShape chain;
+      chain.CreateChain(&_chainPoints[firstPoint], numPoints);
+      body->CreateFixture(&chain, 0.0f);
+      firstPoint += numPoints;
+    }
+  }
+
+  _bodyCommandsTmp.clear();
+}
+
+//------------------------------------------------------------------------------
+const PhysicsSnapshot& PhysicsThread::LatestSnapshot()
+{
+  _snapshots.Update();
+  return _snapshots.Front();
+}
+
+//------------------------------------------------------------------------------
+b2Vec2 PhysicsThread::BodyPosition(const PhysicsSnapshot& snapshot, u32 body) const
+{
+  if (body >= snapshot.cur.size())
+    return b2Vec2(0, 0);
+
+  double stepSize = _timestep.StepSize();
+  float alpha = (float)Clamp(0.0, 1.0, (Now() - snapshot.stepTime) / stepSize);
+  return (1 - alpha) * snapshot.prev[body].p + alpha * snapshot.cur[body].p;
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::Step()
+{
+  DrainCommands();
+  DrainBodyCommands();
+
+  PhysicsSnapshot& snapshot = _snapshots.Back();
+  snapshot.prev.resize(_bodies.size());
+  snapshot.cur.resize(_bodies.size());
+  for (size_t i = 0; i < _bodies.size(); ++i)
+    snapshot.prev[i] = _bodies[i]->GetTransform();
+
+  int velocityIterations = 6;
+  int positionIterations = 2;
+
+  double start = Now();
+  _world->Step((float)_timestep.StepSize(), velocityIterations, positionIterations);
+
+  for (size_t i = 0; i < _bodies.size(); ++i)
+    snapshot.cur[i] = _bodies[i]->GetTransform();
+
+  snapshot.stepTime = Now();
+  snapshot.stepCost = snapshot.stepTime - start;
+  snapshot.stepIndex = ++_stepIndex;
+  snapshot.stats = _timestep.GetStats();
+  _snapshots.Publish();
+}
+
+//------------------------------------------------------------------------------
+void PhysicsThread::SimThread()
+{
+  double lastTime = Now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stop)
+  {
+    lock.unlock();
+
+    double now = Now();
+    int numSteps = _timestep.Advance(now - lastTime);
+    lastTime = now;
+
+    for (int i = 0; i < numSteps; ++i)
+      Step();
+
+    // sleep until the next step is due
+    double wait = (1 - _timestep.Alpha()) * _timestep.StepSize();
+
+    lock.lock();
+    _stopCv.wait_for(lock, std::chrono::duration<double>(wait), [this]() { return _stop; });
+  }
+}
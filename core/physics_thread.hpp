@@ -0,0 +1,110 @@
+#pragma once
+#include <lib/fixed_timestep.hpp>
+#include <lib/triple_buffer.hpp>
+#include <lib/rect_outline.hpp>
+#include <Box2D/Box2D.h>
+#include <condition_variable>
+#include <mutex>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Body transforms from the last two steps, for interpolating at render time
+  struct PhysicsSnapshot
+  {
+    vector<b2Transform> prev;
+    vector<b2Transform> cur;
+
+    // time of the last step, in PhysicsThread::Now time
+    double stepTime = 0;
+    u32 stepIndex = 0;
+    // cost of the last step, in seconds
+    double stepCost = 0;
+    FixedTimestep::Stats stats;
+  };
+
+  //------------------------------------------------------------------------------
+  // Steps a b2World at a fixed rate on its own thread, so the physics cost overlaps with
+  // rendering. After every step the transforms of the tracked bodies are published
+  // through a triple buffer, and forces from the main thread are queued, and applied
+  // before the next step. Between Start and Stop the world belongs to the simulation
+  // thread, and must not be touched from anywhere else.
+  class PhysicsThread
+  {
+  public:
+    ~PhysicsThread();
+
+    bool Start(b2World* world, double stepSize, int maxSteps);
+    void Stop();
+    bool IsRunning() const { return _world != nullptr; }
+
+    // Adds the body to the snapshots, and returns its index in them. Only while stopped
+    u32 TrackBody(b2Body* body);
+    void ClearBodies();
+
+    // Queues a force to apply to the body's center. Main thread only
+    void ApplyForceToCenter(b2Body* body, const b2Vec2& force);
+
+    // Queues the creation or removal of a static body made from chain shapes, for
+    // geometry that comes and goes while the simulation runs. The body is only ever
+    // seen by the thread owning the world, so it's identified by 'key' instead. While
+    // stopped, the commands are held until the next Start. Main thread only
+    void AddStaticBody(u64 key, const StaticChains& chains);
+    void RemoveStaticBody(u64 key);
+
+    // Picks up the most recent snapshot. Render thread only, and the reference stays
+    // valid until the next call
+    const PhysicsSnapshot& LatestSnapshot();
+
+    // Interpolated position of a tracked body. The bodies are drawn one step behind
+    // the simulation, so the interpolation never has to extrapolate
+    b2Vec2 BodyPosition(const PhysicsSnapshot& snapshot, u32 body) const;
+
+    static double Now();
+
+  private:
+    void SimThread();
+    void Step();
+    void DrainCommands();
+    void DrainBodyCommands();
+
+    struct ForceCommand
+    {
+      b2Body* body;
+      b2Vec2 force;
+    };
+
+    // single producer ring for the input forces
+    enum { COMMAND_RING_SIZE = 256 };
+    ForceCommand _commands[COMMAND_RING_SIZE];
+    std::atomic<u32> _commandHead{0};
+    std::atomic<u32> _commandTail{0};
+
+    struct BodyCommand
+    {
+      u64 key;
+      bool remove;
+      StaticChains chains;
+    };
+
+    // the static body commands are rare, and can be large, so they go through a locked
+    // queue instead of the ring
+    std::mutex _bodyMutex;
+    vector<BodyCommand> _bodyCommands;
+    vector<BodyCommand> _bodyCommandsTmp;
+    unordered_map<u64, b2Body*> _staticBodies;
+    // the chain points in Box2D's layout, for creating the shapes
+    vector<b2Vec2> _chainPoints;
+
+    b2World* _world = nullptr;
+    vector<b2Body*> _bodies;
+    FixedTimestep _timestep;
+    TripleBuffer<PhysicsSnapshot> _snapshots;
+    u32 _stepIndex = 0;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _stopCv;
+    bool _stop = false;
+  };
+}
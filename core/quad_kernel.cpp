@@ -0,0 +1,287 @@
+#include "quad_kernel.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WITH_QUAD_KERNEL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define WITH_QUAD_KERNEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC allows AVX intrinsics in any function, but gcc and clang need the function to be
+// compiled for the target
+#if defined(_MSC_VER) || !defined(WITH_QUAD_KERNEL_X86)
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+
+using namespace world;
+
+namespace
+{
+  static_assert(sizeof(PosTex) == 5 * sizeof(float), "The quad kernels assume a packed PosTex");
+
+  typedef void (*fnBuildQuads)(const vec2*, const u32*, u32, const SpriteQuad*, float, PosTex*);
+
+#if WITH_QUAD_KERNEL_X86
+  //------------------------------------------------------------------------------
+  // A quad is 20 floats, so it's written as 5 vectors:
+  //
+  //  r0 = x,    y,    z,    u0
+  //  r1 = v0,   x+w,  y,    z
+  //  r2 = u1,   v0,   x+w,  y-h
+  //  r3 = z,    u1,   v1,   x
+  //  r4 = y-h,  z,    u0,   v1
+  //
+  // where 'a' holds (x, y, x+w, y-h), and 'uv' holds (u0, v0, u1, v1). The shuffles only
+  // work within 128 bit lanes, so the AVX kernel does two quads at a time with the same
+  // code.
+#define QUAD_SHUFFLES(PS, a, uv, zz, r0, r1, r2, r3, r4)                                   \
+  {                                                                                        \
+    auto zu0 = PS##_shuffle_ps(zz, uv, _MM_SHUFFLE(0, 0, 0, 0));                           \
+    auto zu1 = PS##_shuffle_ps(zz, uv, _MM_SHUFFLE(2, 2, 0, 0));                           \
+    auto vx = PS##_shuffle_ps(uv, a, _MM_SHUFFLE(1, 2, 1, 1));                             \
+    auto yz = PS##_shuffle_ps(a, zz, _MM_SHUFFLE(0, 0, 1, 1));                             \
+    auto vx2 = PS##_shuffle_ps(uv, a, _MM_SHUFFLE(0, 0, 3, 3));                            \
+    auto yz2 = PS##_shuffle_ps(a, zz, _MM_SHUFFLE(0, 0, 3, 3));                            \
+    r0 = PS##_shuffle_ps(a, zu0, _MM_SHUFFLE(2, 0, 1, 0));                                 \
+    r1 = PS##_shuffle_ps(vx, yz, _MM_SHUFFLE(2, 0, 2, 0));                                 \
+    r2 = PS##_shuffle_ps(uv, a, _MM_SHUFFLE(3, 2, 1, 2));                                  \
+    r3 = PS##_shuffle_ps(zu1, vx2, _MM_SHUFFLE(2, 0, 2, 0));                               \
+    r4 = PS##_shuffle_ps(yz2, uv, _MM_SHUFFLE(3, 0, 2, 0));                                \
+  }
+
+  //------------------------------------------------------------------------------
+  void BuildQuadsSse(const vec2* pos,
+      const u32* spriteIds,
+      u32 count,
+      const SpriteQuad* sprites,
+      float z,
+      PosTex* out)
+  {
+    __m128 zz = _mm_set1_ps(z);
+    __m128 flip = _mm_setr_ps(1, -1, 0, 0);
+    float* dst = (float*)out;
+
+    for (u32 i = 0; i < count; ++i)
+    {
+      const SpriteQuad& sprite = sprites[spriteIds[i]];
+      __m128 uv = _mm_loadu_ps(&sprite.u0);
+      __m128 size = _mm_mul_ps(_mm_loadu_ps(&sprite.width), flip);
+      __m128 p = _mm_castpd_ps(_mm_load_sd((const double*)&pos[i]));
+      __m128 a = _mm_add_ps(_mm_movelh_ps(p, p), _mm_movelh_ps(_mm_setzero_ps(), size));
+
+      __m128 r0, r1, r2, r3, r4;
+      QUAD_SHUFFLES(_mm, a, uv, zz, r0, r1, r2, r3, r4);
+
+      _mm_storeu_ps(dst + 0, r0);
+      _mm_storeu_ps(dst + 4, r1);
+      _mm_storeu_ps(dst + 8, r2);
+      _mm_storeu_ps(dst + 12, r3);
+      _mm_storeu_ps(dst + 16, r4);
+      dst += 20;
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  TARGET_AVX inline __m256 Combine(__m128 lo, __m128 hi)
+  {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+  }
+
+  //------------------------------------------------------------------------------
+  TARGET_AVX void BuildQuadsAvx(const vec2* pos,
+      const u32* spriteIds,
+      u32 count,
+      const SpriteQuad* sprites,
+      float z,
+      PosTex* out)
+  {
+    __m256 zz = _mm256_set1_ps(z);
+    __m256 flip = _mm256_setr_ps(1, -1, 0, 0, 1, -1, 0, 0);
+    float* dst = (float*)out;
+
+    u32 i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+      // quad i goes in the low lane, and quad i + 1 in the high lane
+      const SpriteQuad& s0 = sprites[spriteIds[i + 0]];
+      const SpriteQuad& s1 = sprites[spriteIds[i + 1]];
+      __m256 uv = Combine(_mm_loadu_ps(&s0.u0), _mm_loadu_ps(&s1.u0));
+      __m256 size = Combine(_mm_loadu_ps(&s0.width), _mm_loadu_ps(&s1.width));
+      size = _mm256_mul_ps(size, flip);
+
+      // (x0, y0, x1, y1) -> (x0, y0, x0, y0 | x1, y1, x1, y1)
+      __m128 pp = _mm_loadu_ps(&pos[i].x);
+      __m256 p = Combine(_mm_movelh_ps(pp, pp), _mm_movehl_ps(pp, pp));
+      __m256 ofs = _mm256_shuffle_ps(_mm256_setzero_ps(), size, _MM_SHUFFLE(1, 0, 0, 0));
+      __m256 a = _mm256_add_ps(p, ofs);
+
+      __m256 r0, r1, r2, r3, r4;
+      QUAD_SHUFFLES(_mm256, a, uv, zz, r0, r1, r2, r3, r4);
+
+      // interleave the lanes, so both quads are written as 160 contiguous bytes
+      _mm256_storeu_ps(dst + 0, _mm256_permute2f128_ps(r0, r1, 0x20));
+      _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(r2, r3, 0x20));
+      _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(r4, r0, 0x30));
+      _mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(r1, r2, 0x31));
+      _mm256_storeu_ps(dst + 32, _mm256_permute2f128_ps(r3, r4, 0x31));
+      dst += 40;
+    }
+
+    _mm256_zeroupper();
+    if (i < count)
+      BuildQuadsSse(pos + i, spriteIds + i, count - i, sprites, z, out + i * 4);
+  }
+
+  //------------------------------------------------------------------------------
+  bool CpuSupportsAvx()
+  {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // check that the os saves the ymm registers
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    // this runs during static initialization, so the cpu info might not be set up yet
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+  }
+#undef QUAD_SHUFFLES
+#endif
+
+#if WITH_QUAD_KERNEL_NEON
+  //------------------------------------------------------------------------------
+  void BuildQuadsNeon(const vec2* pos,
+      const u32* spriteIds,
+      u32 count,
+      const SpriteQuad* sprites,
+      float z,
+      PosTex* out)
+  {
+    float32x2_t zz = vdup_n_f32(z);
+    float* dst = (float*)out;
+
+    for (u32 i = 0; i < count; ++i)
+    {
+      const SpriteQuad& sprite = sprites[spriteIds[i]];
+      float32x2_t uv0 = vld1_f32(&sprite.u0);
+      float32x2_t uv1 = vld1_f32(&sprite.u1);
+      float32x2_t size = vld1_f32(&sprite.width);
+      float32x2_t xy = vld1_f32(&pos[i].x);
+      float32x2_t xy2 = vadd_f32(xy, vmul_f32(size, vset_lane_f32(-1, vdup_n_f32(1), 1)));
+
+      // see the SSE kernel for the layout
+      vst1q_f32(dst + 0, vcombine_f32(xy, vzip1_f32(zz, uv0)));
+      vst1q_f32(dst + 4, vcombine_f32(vext_f32(uv0, xy2, 1), vext_f32(xy, zz, 1)));
+      vst1q_f32(dst + 8, vcombine_f32(vcopy_lane_f32(uv1, 1, uv0, 1), xy2));
+      vst1q_f32(dst + 12, vcombine_f32(vzip1_f32(zz, uv1), vext_f32(uv1, xy, 1)));
+      vst1q_f32(dst + 16, vcombine_f32(vext_f32(xy2, zz, 1), vcopy_lane_f32(uv0, 1, uv1, 1)));
+      dst += 20;
+    }
+  }
+#endif
+
+  //------------------------------------------------------------------------------
+  fnBuildQuads SelectKernel(const char** name)
+  {
+#if WITH_QUAD_KERNEL_X86
+    if (CpuSupportsAvx())
+    {
+      *name = "avx";
+      return BuildQuadsAvx;
+    }
+    *name = "sse";
+    return BuildQuadsSse;
+#elif WITH_QUAD_KERNEL_NEON
+    *name = "neon";
+    return BuildQuadsNeon;
+#else
+    *name = "scalar";
+    return BuildQuadsScalar;
+#endif
+  }
+
+  const char* g_KernelName = nullptr;
+  fnBuildQuads g_Kernel = SelectKernel(&g_KernelName);
+}
+
+//------------------------------------------------------------------------------
+void world::BuildQuadsScalar(const vec2* pos,
+    const u32* spriteIds,
+    u32 count,
+    const SpriteQuad* sprites,
+    float z,
+    PosTex* out)
+{
+  for (u32 i = 0; i < count; ++i)
+  {
+    const SpriteQuad& sprite = sprites[spriteIds[i]];
+    float x = pos[i].x;
+    float y = pos[i].y;
+    float x2 = x + sprite.width;
+    float y2 = y - sprite.height;
+
+    out[0] = PosTex{vec3{x, y, z}, vec2{sprite.u0, sprite.v0}};
+    out[1] = PosTex{vec3{x2, y, z}, vec2{sprite.u1, sprite.v0}};
+    out[2] = PosTex{vec3{x2, y2, z}, vec2{sprite.u1, sprite.v1}};
+    out[3] = PosTex{vec3{x, y2, z}, vec2{sprite.u0, sprite.v1}};
+    out += 4;
+  }
+}
+
+//------------------------------------------------------------------------------
+void world::BuildQuads(const vec2* pos,
+    const u32* spriteIds,
+    u32 count,
+    const SpriteQuad* sprites,
+    float z,
+    PosTex* out)
+{
+  g_Kernel(pos, spriteIds, count, sprites, z, out);
+}
+
+//------------------------------------------------------------------------------
+const char* world::QuadKernelName()
+{
+  return g_KernelName;
+}
+
+//------------------------------------------------------------------------------
+bool world::SetQuadKernel(const char* name)
+{
+  struct Kernel
+  {
+    const char* name;
+    fnBuildQuads fn;
+    bool supported;
+  };
+
+  static const Kernel kernels[] = {
+    {"scalar", BuildQuadsScalar, true},
+#if WITH_QUAD_KERNEL_X86
+    {"sse", BuildQuadsSse, true},
+    {"avx", BuildQuadsAvx, CpuSupportsAvx()},
+#elif WITH_QUAD_KERNEL_NEON
+    {"neon", BuildQuadsNeon, true},
+#endif
+  };
+
+  for (const Kernel& kernel : kernels)
+  {
+    if (strcmp(kernel.name, name) == 0 && kernel.supported)
+    {
+      g_Kernel = kernel.fn;
+      g_KernelName = kernel.name;
+      return true;
+    }
+  }
+  return false;
+}
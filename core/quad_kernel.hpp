@@ -0,0 +1,47 @@
+#pragma once
+#include <core/vertex_types.hpp>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // UV rect and size of a sprite. Sprites are looked up by id in a table of these, so
+  // the atlas position is computed once up front instead of per quad.
+  struct SpriteQuad
+  {
+    float u0, v0, u1, v1;
+    float width, height;
+    float pad[2];
+  };
+
+  //------------------------------------------------------------------------------
+  // Expands 'count' (position, sprite id) pairs into quads, writing 4 vertices per quad.
+  // 'pos' is the top left corner of each quad, and the quad extends right and down (y is
+  // up), using the size from the sprite table. The vertex order matches the indices from
+  // GenerateQuadIndices:
+  //
+  //  0, 1
+  //  3, 2
+  //
+  // BuildQuads picks the widest kernel supported by the cpu (AVX, SSE or NEON), and
+  // BuildQuadsScalar is the reference implementation.
+  void BuildQuads(const vec2* pos,
+      const u32* spriteIds,
+      u32 count,
+      const SpriteQuad* sprites,
+      float z,
+      PosTex* out);
+
+  void BuildQuadsScalar(const vec2* pos,
+      const u32* spriteIds,
+      u32 count,
+      const SpriteQuad* sprites,
+      float z,
+      PosTex* out);
+
+  const char* QuadKernelName();
+
+  // Makes BuildQuads use the kernel with the given name ("scalar", "sse", "avx" or
+  // "neon"), for testing and benchmarking the kernels against each other. Returns false
+  // if the kernel isn't supported by the cpu.
+  bool SetQuadKernel(const char* name);
+}
@@ -4,6 +4,8 @@
 #include <lib/utils.hpp>
 #include <lib/error.hpp>
 #include <lib/file_utils.hpp>
+#include <lib/frame_allocator.hpp>
+#include <lib/mapped_file.hpp>
 
 
 using namespace world;
@@ -87,11 +89,14 @@ void ResourceManager::AddPath(const string& path)
 //------------------------------------------------------------------------------
 bool ResourceManager::LoadImage(const char* filename, u8** data, int* w, int* h, int* channels)
 {
-  vector<char> buf;
-  if (!LoadFile(filename, &buf))
+  // the compressed file is only needed while decoding
+  ScopedArena scratch(g_ScratchMemory.Arena());
+  char* buf;
+  u32 len;
+  if (!LoadFile(filename, &scratch.arena, &buf, &len))
     return false;
 
-  *data = stbi_load_from_memory((const u8*)buf.data(), (int)buf.size(), w, h, channels, 0);
+  *data = stbi_load_from_memory((const u8*)buf, (int)len, w, h, channels, 0);
   return *data != nullptr;
 }
 
@@ -114,6 +119,41 @@ bool ResourceManager::LoadFile(const char* filename, vector<char>* buf)
     return true;
   }
 }
+
+//------------------------------------------------------------------------------
+bool ResourceManager::LoadFile(const char* filename, ArenaAllocator* arena, char** buf, u32* len)
+{
+  LOG_DEBUG("Loading: ", filename);
+  const string& fullPath = ResolveFilename(filename, true);
+  if (fullPath.empty())
+    return false;
+  _readFiles.insert(FileInfo(filename, fullPath));
+
+  if (!world::LoadFile(fullPath.c_str(), arena, buf, len))
+  {
+    LOG_INFO("Unable to load: ", fullPath);
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ResourceManager::MapFile(const char* filename, MappedFile* file)
+{
+  LOG_DEBUG("Mapping: ", filename);
+  const string& fullPath = ResolveFilename(filename, true);
+  if (fullPath.empty())
+    return false;
+  _readFiles.insert(FileInfo(filename, fullPath));
+
+  if (!file->Open(fullPath.c_str()))
+  {
+    LOG_INFO("Unable to map: ", fullPath);
+    return false;
+  }
+  return true;
+}
+
 //------------------------------------------------------------------------------
 bool ResourceManager::FileExists(const char* filename)
 {
@@ -364,6 +404,31 @@ bool PackedResourceManager::LoadFile(const char* filename, vector<char>* buf)
   return res == p->compressedSize;
 }
 
+//------------------------------------------------------------------------------
+bool PackedResourceManager::LoadFile(
+    const char* filename, ArenaAllocator* arena, char** buf, u32* len)
+{
+  PackedFileInfo* p = &_fileInfo[HashLookup(filename)];
+  *buf = arena->AllocTop<char>(p->finalSize, 1);
+  if (!*buf)
+    return false;
+
+  *len = p->finalSize;
+  int res = LZ4_uncompress(&_fileBuffer[p->offset], *buf, p->finalSize);
+  return res == p->compressedSize;
+}
+
+//------------------------------------------------------------------------------
+bool PackedResourceManager::MapFile(const char* filename, MappedFile* file)
+{
+  vector<char> buf;
+  if (!LoadFile(filename, &buf))
+    return false;
+
+  file->Assign(&buf);
+  return true;
+}
+
 //------------------------------------------------------------------------------
 ObjectHandle PackedResourceManager::LoadTexture(
     const char* filename,
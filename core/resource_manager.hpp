@@ -5,6 +5,9 @@
 
 namespace world
 {
+  class ArenaAllocator;
+  class MappedFile;
+
 #if WITH_UNPACKED_RESOURCES
 
   class ResourceManager
@@ -19,6 +22,9 @@ namespace world
     bool FileExists(const char* filename);
     __time64_t ModifiedDate(const char* filename);
     bool LoadFile(const char* filename, vector<char>* buf);
+    bool LoadFile(const char* filename, ArenaAllocator* arena, char** buf, u32* len);
+    // Memory maps the file, for large data that's used in place
+    bool MapFile(const char* filename, MappedFile* file);
     bool LoadImage(const char* filename, u8** buf, int* w, int* h, int* channels);
 
     // file is opened relateive to the app root
@@ -89,6 +95,9 @@ namespace world
     static bool Destroy();
 
     bool LoadFile(const char* filename, vector<char>* buf);
+    bool LoadFile(const char* filename, ArenaAllocator* arena, char** buf, u32* len);
+    // The packed files are compressed, so these are decompressed into the MappedFile
+    bool MapFile(const char* filename, MappedFile* file);
     ObjectHandle LoadTexture(const char* filename,
         bool srgb = false,
         D3DX11_IMAGE_INFO* info = nullptr);
@@ -0,0 +1,100 @@
+#include "sprite_batcher.hpp"
+#include <lib/frame_allocator.hpp>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+u16 SpriteBatcher::TextureSlot(ObjectHandle texture)
+{
+  // sprites tend to come in runs from the same texture
+  if (_lastSlot < _textures.size() && _textures[_lastSlot].ToInt() == texture.ToInt())
+    return _lastSlot;
+
+  for (size_t i = 0; i < _textures.size(); ++i)
+  {
+    if (_textures[i].ToInt() == texture.ToInt())
+      return _lastSlot = (u16)i;
+  }
+
+  _textures.push_back(texture);
+  return _lastSlot = (u16)(_textures.size() - 1);
+}
+
+//------------------------------------------------------------------------------
+void SpriteBatcher::Add(ObjectHandle texture, const SpriteQuad& quad, const vec2& pos)
+{
+  _pos.push_back(pos);
+  _quads.push_back(quad);
+  _slots.push_back(TextureSlot(texture));
+}
+
+//------------------------------------------------------------------------------
+void SpriteBatcher::Flush(SpriteSubmitTarget* target)
+{
+  u32 numSprites = (u32)_pos.size();
+  u32 numTextures = (u32)_textures.size();
+
+  _stats = Stats();
+  _stats.numSprites = numSprites;
+
+  if (numSprites)
+  {
+    // counting sort on the texture slot. This is stable, so the sprites keep their
+    // submission order within each texture
+    _slotOffsets.assign(numTextures + 1, 0);
+    for (u16 slot : _slots)
+      _slotOffsets[slot + 1]++;
+
+    for (u32 i = 0; i < numTextures; ++i)
+      _slotOffsets[i + 1] += _slotOffsets[i];
+
+    _order.resize(numSprites);
+    _sortedPos.resize(numSprites);
+    for (u32 i = 0; i < numSprites; ++i)
+    {
+      u32 dst = _slotOffsets[_slots[i]]++;
+      _order[dst] = i;
+      _sortedPos[dst] = _pos[i];
+    }
+
+    // the offsets now point at the end of each texture's range. Each batch is staged in
+    // its own allocation from the frame's scratch memory, so the target can hang on to it
+    // until the GPU is done. When the scratch memory is full, or not set up, the batches
+    // get disjoint ranges of the heap staging instead, which only last until the next
+    // flush.
+    u32 maxQuads = max(1u, target->MaxQuads());
+    u32 begin = 0;
+    for (u32 slot = 0; slot < numTextures; ++slot)
+    {
+      u32 end = _slotOffsets[slot];
+      if (begin == end)
+        continue;
+
+      _stats.numTextures++;
+      for (u32 first = begin; first < end; first += maxQuads)
+      {
+        u32 cnt = min(end - first, maxQuads);
+        PosTex* staging = g_ScratchMemory.Alloc<PosTex>(cnt * 4);
+        if (!staging)
+        {
+          // sized for all the sprites, so the earlier batches don't move
+          _staging.resize(numSprites * 4);
+          staging = _staging.data() + first * 4;
+        }
+
+        BuildQuads(&_sortedPos[first], &_order[first], cnt, _quads.data(), 0.5f, staging);
+        g_ScratchMemory.CheckAlive(staging);
+        target->Submit(_textures[slot], staging, cnt);
+        _stats.numSubmits++;
+      }
+
+      begin = end;
+    }
+  }
+
+  _pos.clear();
+  _quads.clear();
+  _slots.clear();
+  _textures.clear();
+  _lastSlot = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <core/object_handle.hpp>
+#include <core/quad_kernel.hpp>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Receives the batches from the SpriteBatcher. The renderer uploads them to a dynamic
+  // vertex buffer and draws them, and NullSubmitTarget just keeps count, so the batching
+  // can be run without a GPU.
+  struct SpriteSubmitTarget
+  {
+    virtual ~SpriteSubmitTarget() {}
+    // Max number of quads that can be submitted in one go
+    virtual u32 MaxQuads() const = 0;
+    // 'vtx' comes from the frame's scratch memory, and stays valid until that frame's
+    // arena is recycled. When the scratch memory is full, it's only valid until the next
+    // SpriteBatcher::Flush, so targets that keep it past the call have to check with
+    // g_ScratchMemory.IsAlive.
+    virtual void Submit(ObjectHandle texture, const PosTex* vtx, u32 numQuads) = 0;
+  };
+
+  struct NullSubmitTarget : public SpriteSubmitTarget
+  {
+    NullSubmitTarget(u32 maxQuads) : maxQuads(maxQuads) {}
+    virtual u32 MaxQuads() const override { return maxQuads; }
+    virtual void Submit(ObjectHandle, const PosTex*, u32 numQuads) override
+    {
+      numSubmits++;
+      totalQuads += numQuads;
+    }
+
+    u32 maxQuads;
+    u32 numSubmits = 0;
+    u32 totalQuads = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // Immediate mode sprite batcher. Sprites can be added from any texture during the
+  // frame, and are only stored as (position, quad) pairs until Flush. Flush groups them
+  // by texture, keeping the submission order within a texture, expands them into a CPU
+  // staging buffer, and submits each texture as a single batch, unless it's larger than
+  // what the target can take in one go.
+  class SpriteBatcher
+  {
+  public:
+    void Add(ObjectHandle texture, const SpriteQuad& quad, const vec2& pos);
+    void Flush(SpriteSubmitTarget* target);
+
+    u32 NumSprites() const { return (u32)_pos.size(); }
+
+    struct Stats
+    {
+      u32 numSprites = 0;
+      u32 numTextures = 0;
+      u32 numSubmits = 0;
+    };
+
+    // Stats from the last flush
+    const Stats& GetStats() const { return _stats; }
+
+  private:
+    u16 TextureSlot(ObjectHandle texture);
+
+    vector<ObjectHandle> _textures;
+    u16 _lastSlot = 0;
+
+    // the added sprites
+    vector<vec2> _pos;
+    vector<SpriteQuad> _quads;
+    vector<u16> _slots;
+
+    // scratch space for flushing
+    vector<u32> _order;
+    vector<u32> _slotOffsets;
+    vector<vec2> _sortedPos;
+    // staging for when the scratch memory is full, or not set up. Room for all the
+    // sprites, so every batch keeps its own range
+    vector<PosTex> _staging;
+
+    Stats _stats;
+  };
+}
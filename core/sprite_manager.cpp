@@ -6,6 +6,10 @@
 #include <lib/init_sequence.hpp>
 #include <lib/mesh_utils.hpp>
 #include <lib/string_utils.hpp>
+#include <lib/frame_allocator.hpp>
+#include <lib/path_utils.hpp>
+#include <lib/job_pool.hpp>
+#include <lib/rect_outline.hpp>
 #include <core/vertex_types.hpp>
 #include <core/graphics_context.hpp>
 #include <core/entity.hpp>
@@ -15,16 +19,72 @@ using namespace world::parser;
 
 static const int MAX_SPRITES_PER_BATCH = 32 * 1024;
 static const float PIXELS_PER_METER = 16;
+static const double PHYSICS_STEP_SIZE = 1.0 / 60;
+static const int PHYSICS_MAX_STEPS = 5;
+static const float STREAM_LOAD_RADIUS = 2048;
+static const size_t STREAM_MEMORY_BUDGET = 64 * 1024 * 1024;
 
-//------------------------------------------------------------------------------
-SpriteManager* world::g_SpriteManager = nullptr;
-
-//------------------------------------------------------------------------------
-TmxLevel::TmxLevel()
-  : world(b2Vec2(0.0f, -1.0f))
+namespace
 {
+  //------------------------------------------------------------------------------
+  // Uploads the sprite batches to the dynamic vertex buffer, and draws them. Assumes the
+  // sprite bundle is already set.
+  struct DynamicVbSubmitTarget : public SpriteSubmitTarget, public MappedQuadTarget
+  {
+    DynamicVbSubmitTarget(GraphicsContext* ctx, ObjectHandle vb) : ctx(ctx), vb(vb) {}
+
+    virtual u32 MaxQuads() const override { return MAX_SPRITES_PER_BATCH; }
+
+    virtual void Submit(ObjectHandle texture, const PosTex* vtx, u32 numQuads) override
+    {
+      g_ScratchMemory.CheckAlive(vtx);
+      PosTex* dst = ctx->MapWriteDiscard<PosTex>(vb);
+      if (!dst)
+        return;
+      memcpy(dst, vtx, numQuads * 4 * sizeof(PosTex));
+      ctx->Unmap(vb);
+
+      ctx->SetShaderResource(texture);
+      ctx->DrawIndexed(6 * numQuads, 0, 0);
+    }
+
+    virtual PosTex* Map(u32) override { return ctx->MapWriteDiscard<PosTex>(vb); }
+    virtual void Unmap() override { ctx->Unmap(vb); }
+
+    virtual void Draw(ObjectHandle texture, u32 firstQuad, u32 numQuads) override
+    {
+      ctx->SetShaderResource(texture);
+      ctx->DrawIndexed(6 * numQuads, 0, 4 * firstQuad);
+    }
+
+    GraphicsContext* ctx;
+    ObjectHandle vb;
+  };
+
+  //------------------------------------------------------------------------------
+  // Adds and removes the static bodies for the chunks streaming in and out
+  struct PhysicsChunkTarget : public ChunkStreamTarget
+  {
+    PhysicsChunkTarget(PhysicsThread* physics) : physics(physics) {}
+
+    virtual void ChunkLoaded(const StreamedChunk& chunk) override
+    {
+      if (!chunk.collision.points.empty())
+        physics->AddStaticBody(chunk.key, chunk.collision);
+    }
+
+    virtual void ChunkEvicted(const StreamedChunk& chunk) override
+    {
+      physics->RemoveStaticBody(chunk.key);
+    }
+
+    PhysicsThread* physics;
+  };
 }
 
+//------------------------------------------------------------------------------
+SpriteManager* world::g_SpriteManager = nullptr;
+
 //------------------------------------------------------------------------------
 bool SpriteManager::Create()
 {
@@ -37,6 +97,12 @@ bool SpriteManager::Create()
 //------------------------------------------------------------------------------
 bool SpriteManager::Destroy()
 {
+  // stop streaming and stepping before the world goes away
+  if (g_SpriteManager)
+  {
+    g_SpriteManager->_streamer.Stop();
+    g_SpriteManager->_physics.Stop();
+  }
   return true;
 }
 
@@ -45,8 +111,6 @@ bool SpriteManager::Init()
 {
   BEGIN_INIT_SEQUENCE();
 
-  QueryPerformanceFrequency(&_timerFrequency);
-
   // clang-format off
   INIT(_renderTextureBundle.Create(BundleOptions()
     .DepthStencilDesc(depthDescDepthDisabled)
@@ -67,11 +131,22 @@ bool SpriteManager::Init()
 //------------------------------------------------------------------------------
 void SpriteManager::AddEntity(const Entity* e, const vec2& pos, u16 sprite)
 {
-  assert(_entityCount < MAX_ENTITIES);
-  _entityPos[_entityCount] = pos;
-  _entitySprite[_entityCount] = sprite;
-  _entityMap[e->id] = _entityCount;
-  _entityCount++;
+  if (!_entities.Add(e->id, pos, sprite))
+    LOG_WARN("Entity already added: ", e->id);
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::RemoveEntity(const Entity* e)
+{
+  if (!_entities.Remove(e->id))
+    LOG_WARN("Removing unknown entity: ", e->id);
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::SetEntityPos(const Entity* e, const vec2& pos)
+{
+  if (!_entities.SetPos(e->id, pos))
+    LOG_WARN("Moving unknown entity: ", e->id);
 }
 
 //------------------------------------------------------------------------------
@@ -86,52 +161,22 @@ u16 SpriteManager::AddSprite(const string& name,
   Sprite* sprite = new Sprite{uvTopLeft, uvBottomRight, size, handle, id};
   _spritesByName[name] = sprite;
   _sprites.push_back(sprite);
-  return id;
-}
-//------------------------------------------------------------------------------
-template<typename T, typename TOrg = T, typename U>
-bool CheckedGet(const U& m, const string& key, T* res)
-{
-  auto it = m.find(key);
-  if (it == m.end())
-  {
-    LOG_WARN("Unable to find property: ", key);
-    return false;
-  }
-
-  // perform a cast, as json doesn't support int types, only doubles
-  *res = (T)it->second.get<TOrg>();
-
-  return true;
-}
 
-//------------------------------------------------------------------------------
-bool SpriteManager::LoadSpriteLayer(const picojson::object& layerObj)
-{
-  _tmxLevel.layers.push_back(TmxLayer());
-  TmxLayer& tmxLayer = _tmxLevel.layers.back();
+  // the handle is either the texture, or the sprite sheet it's from
+  ObjectHandle texture = handle;
+  if (handle.type() == ObjectHandle::kSpriteSheet)
+    texture = _spriteSheets[handle.id()].texture;
 
-  if (
-    !CheckedGet(layerObj, "name", &tmxLayer.name) ||
-    !CheckedGet<int, double>(layerObj, "x", &tmxLayer.x) ||
-    !CheckedGet<int, double>(layerObj, "y", &tmxLayer.y) ||
-    !CheckedGet<int, double>(layerObj, "width", &tmxLayer.width) ||
-    !CheckedGet<int, double>(layerObj, "height", &tmxLayer.height))
-  {
-    return false;
-  }
+  auto it = find_if(_spriteTextures.begin(),
+      _spriteTextures.end(),
+      [&](ObjectHandle h) { return h.ToInt() == texture.ToInt(); });
+  if (it == _spriteTextures.end())
+    it = _spriteTextures.insert(_spriteTextures.end(), texture);
 
-  picojson::array data;
-  if (!CheckedGet(layerObj, "data", &data))
-    return false;
-
-  tmxLayer.tiles.reserve(data.size());
-  for (auto& d : data)
-  {
-    tmxLayer.tiles.push_back((int)d.get<double>());
-  }
-
-  return true;
+  _spriteTextureSlot.push_back((u16)(it - _spriteTextures.begin()));
+  _spriteQuads.push_back(SpriteQuad{
+      uvTopLeft.x, uvTopLeft.y, uvBottomRight.x, uvBottomRight.y, size.x, size.y, {0, 0}});
+  return id;
 }
 
 //------------------------------------------------------------------------------
@@ -143,184 +188,233 @@ static b2Vec2 ScreenToBox2d(float x, float y, float zeroLevel)
 }
 
 //------------------------------------------------------------------------------
-bool SpriteManager::LoadCollisionLayer(const picojson::object& layerObj)
+bool SpriteManager::CreateCollisionBodies(const CookedRect* rects,
+    u32 numRects,
+    const CookedPolyline* polylines,
+    u32 numPolylines,
+    const CookedPoint* points)
 {
-  picojson::array objects;
-  if (!CheckedGet(layerObj, "objects", &objects))
-    return false;
+  for (u32 i = 0; i < numPolylines; ++i)
+  {
+    const CookedPolyline& polyline = polylines[i];
 
-  int bbWidth, bbHeight;
-  g_Graphics->GetBackBufferSize(&bbWidth, &bbHeight);
+    ScopedArena scratch(g_ScratchMemory.Arena());
+    b2Vec2* chainPoints = scratch.arena.AllocTop<b2Vec2>(polyline.numPoints);
+    if (!chainPoints)
+      return false;
 
-  for (auto& obj : objects)
-  {
-    picojson::object cur = obj.get<picojson::object>();
-    // determine the collision object type
-    bool ellipse;
-    if (CheckedGet(cur, "ellipse", &ellipse) && ellipse)
+    for (u32 j = 0; j < polyline.numPoints; ++j)
     {
-      int a = 10;
+      const CookedPoint& pt = points[polyline.firstPoint + j];
+      chainPoints[j] = ScreenToBox2d(pt.x, pt.y, _tmxLevel.zeroLevel);
     }
-    else if (cur.count("polygon"))
+
+    // b2ChainShape copies the points
+    b2ChainShape chain;
+    chain.CreateChain(chainPoints, polyline.numPoints);
+
+    b2BodyDef bodyDef;
+    b2Body* body = _world.CreateBody(&bodyDef);
+    body->CreateFixture(&chain, 0.0f);
+  }
+
+  vector<OutlineRect> outlineRects;
+  for (u32 i = 0; i < numRects; ++i)
+  {
+    float x = rects[i].x;
+    float y = rects[i].y;
+    float width = rects[i].width;
+    float height = rects[i].height;
+
+    // axis aligned rects are merged into outlines below
+    if (rects[i].rotation == 0)
     {
-      int a = 10;
+      b2Vec2 topLeft = ScreenToBox2d(x, y, _tmxLevel.zeroLevel);
+      b2Vec2 bottomRight = ScreenToBox2d(x + width, y + height, _tmxLevel.zeroLevel);
+      outlineRects.push_back(OutlineRect{
+          vec2{topLeft.x, bottomRight.y}, vec2{bottomRight.x, topLeft.y}});
+      continue;
     }
-    else if (cur.count("polyline"))
-    {
-      vector<b2Vec2> points;
-      picojson::array polylineObj = cur.find("polyline")->second.get<picojson::array>();
-      for (auto& pt : polylineObj)
-      {
-        picojson::object ptObj = pt.get<picojson::object>();
-        float x, y;
-        if (
-          !CheckedGet<float, double>(ptObj, "x", &x) ||
-          !CheckedGet<float, double>(ptObj, "y", &y))
-        {
-          return false;
-        }
 
-        points.push_back(ScreenToBox2d(x, y, _tmxLevel.zeroLevel));
-      }
+    b2BodyDef bodyDef;
+    b2Vec2 pos = ScreenToBox2d(x + width / 2.f, y + height / 2.f, (float)_tmxLevel.zeroLevel);
+    bodyDef.position.Set(pos.x, pos.y);
+    b2Body* body = _world.CreateBody(&bodyDef);
 
-      b2ChainShape chain;
-      chain.CreateChain(points.data(), (int)points.size());
+    b2PolygonShape box;
 
-      b2BodyDef bodyDef;
-      b2Body* body = _tmxLevel.world.CreateBody(&bodyDef);
-      body->CreateFixture(&chain, 0.0f);
-    }
-    else
+    // The extents are the half-widths of the box.
+    box.SetAsBox(width/ (2 * PIXELS_PER_METER), height / (2 * PIXELS_PER_METER));
+
+    body->CreateFixture(&box, 0.0f);
+  }
+
+  if (outlineRects.empty())
+    return true;
+
+  // Instead of a body and box per rect, the union of the rects is traced, and each
+  // outline becomes a chain loop on a single static body. This gets rid of the internal
+  // edges between neighbouring rects, and most of the broadphase proxies.
+  vector<vec2> outlinePoints;
+  vector<u32> loopSizes;
+  TraceRectOutlines(
+      outlineRects.data(), (u32)outlineRects.size(), &outlinePoints, &loopSizes);
+
+  b2BodyDef bodyDef;
+  b2Body* body = _world.CreateBody(&bodyDef);
+
+  // An outline with 4 corners is an isolated rect, which gets a box fixture, as that's
+  // one broadphase proxy instead of 4, and is solid. Holes wind clockwise, and have to
+  // stay chains, as a box would fill them in.
+  u32 numBoxes = 0;
+  u32 firstPoint = 0;
+  for (u32 numPoints : loopSizes)
+  {
+    const vec2* outline = &outlinePoints[firstPoint];
+    firstPoint += numPoints;
+
+    if (numPoints == 4)
     {
-      // if nothing else is set, then the shape is a rectangle
-      float x ,y;
-      float width, height;
-      float rotation;
-
-      if (
-        !CheckedGet<float, double>(cur, "x", &x) ||
-        !CheckedGet<float, double>(cur, "y", &y) ||
-        !CheckedGet<float, double>(cur, "width", &width) ||
-        !CheckedGet<float, double>(cur, "height", &height) ||
-        !CheckedGet<float, double>(cur, "rotation", &rotation))
+      float area = 0;
+      for (u32 i = 0; i < 4; ++i)
+        area += outline[i].x * outline[(i + 1) % 4].y - outline[(i + 1) % 4].x * outline[i].y;
+
+      if (area > 0)
       {
-        return false;
+        // opposite corners
+        const vec2& a = outline[0];
+        const vec2& b = outline[2];
+        vec2 minPos = vec2(min(a.x, b.x), min(a.y, b.y));
+        vec2 maxPos = vec2(max(a.x, b.x), max(a.y, b.y));
+        b2PolygonShape box;
+        box.SetAsBox((maxPos.x - minPos.x) / 2,
+            (maxPos.y - minPos.y) / 2,
+            b2Vec2((minPos.x + maxPos.x) / 2, (minPos.y + maxPos.y) / 2),
+            0);
+        body->CreateFixture(&box, 0.0f);
+        numBoxes++;
+        continue;
       }
+    }
 
-      b2BodyDef bodyDef;
-      b2Vec2 pos = ScreenToBox2d(x + width / 2.f, y + height / 2.f, (float)_tmxLevel.zeroLevel);
-      bodyDef.position.Set(pos.x, pos.y);
-      b2Body* body = _tmxLevel.world.CreateBody(&bodyDef);
-
-      b2PolygonShape box;
+    ScopedArena scratch(g_ScratchMemory.Arena());
+    b2Vec2* loop = scratch.arena.AllocTop<b2Vec2>(numPoints);
+    if (!loop)
+      return false;
 
-      // The extents are the half-widths of the box.
-      box.SetAsBox(width/ (2 * PIXELS_PER_METER), height / (2 * PIXELS_PER_METER));
+    for (u32 i = 0; i < numPoints; ++i)
+      loop[i] = b2Vec2(outline[i].x, outline[i].y);
 
-      body->CreateFixture(&box, 0.0f);
-    }
+    // b2ChainShape copies the points
+    b2ChainShape chain;
+    chain.CreateLoop(loop, numPoints);
+    body->CreateFixture(&chain, 0.0f);
   }
 
+  LOG_INFO("Collision rects: ",
+      outlineRects.size(),
+      " bodies/fixtures, merged: 1 body, ",
+      loopSizes.size() - numBoxes,
+      " chain fixtures, ",
+      numBoxes,
+      " box fixtures, ",
+      outlinePoints.size() - 4 * numBoxes,
+      " edges");
+
   return true;
 }
 
 //------------------------------------------------------------------------------
-bool SpriteManager::LoadTmx(const char* filename)
+bool SpriteManager::LoadTmxJson(const char* filename)
 {
-  _tmxTexture = g_ResourceManager->LoadTexture("gfx/TinyPlatformQuestTiles.png");
+  // the file is only needed while parsing, unless it's an infinite map
+  _tmxLevel.Reset();
+  MappedFile& file = _tmxLevel.jsonFile;
+  if (!g_ResourceManager->MapFile(filename, &file))
+    return false;
 
-  vector<char> ss;
-  if (!g_ResourceManager->LoadFile("tmx/level1.json", &ss))
+  TmxCollision collision;
+  if (!ReadTmxJson(file.Data(), file.Size(), filename, &_tmxLevel, &collision))
     return false;
 
-  picojson::value res;
-  string err = picojson::parse(res, ss.begin(), ss.end());
-  if (!err.empty())
+  // the collision for infinite maps is created as the chunks stream in
+  if (_tmxLevel.infinite)
   {
-    LOG_WARN("Error loading tmx: ", filename, "error: ", err);
-    return false;
+    std::swap(_tmxLevel.collision, collision);
+    return true;
   }
 
-  const auto& levelObj = res.get<picojson::object>();
+  file.Close();
+  return CreateCollisionBodies(collision.rects.data(),
+      (u32)collision.rects.size(),
+      collision.polylines.data(),
+      (u32)collision.polylines.size(),
+      collision.points.data());
+}
 
-  if (
-    !CheckedGet<int, double>(levelObj, "width", &_tmxLevel.width) ||
-    !CheckedGet<int, double>(levelObj, "height", &_tmxLevel.height) ||
-    !CheckedGet<int, double>(levelObj, "tilewidth", &_tmxLevel.tileWidth) ||
-    !CheckedGet<int, double>(levelObj, "tileheight", &_tmxLevel.tileHeight))
-  {
+//------------------------------------------------------------------------------
+bool SpriteManager::LoadCookedLevel(const char* filename)
+{
+  // the mapping is kept open, as the tile layers point straight into it
+  _tmxLevel.Reset();
+  MappedFile& file = _tmxLevel.cookedFile;
+  if (!g_ResourceManager->MapFile(filename, &file))
     return false;
-  }
 
-  if (levelObj.count("properties"))
+  CookedLevel level;
+  if (!level.Init(file.Data(), file.Size()))
   {
-    // read the zero level
-    const auto& propertiesObj = levelObj.find("properties")->second.get<picojson::object>();
-    string zeroLevel;
-    if (!CheckedGet(propertiesObj, "zerolevel", &zeroLevel))
-    {
-      return false;
-    }
-    _tmxLevel.zeroLevel = (float)atof(zeroLevel.c_str()) * _tmxLevel.tileHeight;
-  }
-
-  picojson::array layers;
-  if (!CheckedGet(levelObj, "layers", &layers))
+    LOG_WARN("Invalid cooked level: ", filename);
+    file.Close();
     return false;
+  }
 
-  for (auto& layer : layers)
-  {
-    const picojson::object& layerObj = layer.get<picojson::object>();
+  ReadCookedLevel(level, &_tmxLevel);
 
-    string name;
-    if (!CheckedGet(layerObj, "name", &name))
-      return false;
+  const CookedLevelHeader& header = level.Header();
+  return CreateCollisionBodies(level.Rects(),
+      header.numRects,
+      level.Polylines(),
+      header.numPolylines,
+      level.Points());
+}
 
-    transform(name.begin(), name.end(), name.begin(), tolower);
-    if (StartsWith(name, "collision"))
-    {
-      if (!LoadCollisionLayer(layerObj))
-        return false;
-    }
-    else
-    {
-      if (!LoadSpriteLayer(layerObj))
-        return false;
-    }
+//------------------------------------------------------------------------------
+bool SpriteManager::LoadTmx(const char* filename)
+{
+  // the removal of the streamed bodies is picked up when the physics stops
+  PhysicsChunkTarget streamTarget(&_physics);
+  _streamer.Stop(&streamTarget);
+  _physics.Stop();
+  _physics.ClearBodies();
+
+  // the bodies and the tile geometry are for the old level. There's no way to release a
+  // single vertex buffer, so the old one is just dropped
+  for (b2Body* body = _world.GetBodyList(); body;)
+  {
+    b2Body* next = body->GetNext();
+    _world.DestroyBody(body);
+    body = next;
   }
+  _dynamicBody = nullptr;
+  _tileVb = ObjectHandle();
 
-  picojson::array tilesets;
-  if (!CheckedGet(levelObj ,"tilesets", &tilesets))
-    return false;
+  _tmxTexture = g_ResourceManager->LoadTexture("gfx/TinyPlatformQuestTiles.png");
 
-  for (auto& tileset : tilesets)
+  // use the cooked level if there is one, and fall back on parsing the json
+  string cookedFilename = ReplaceExtension(filename, "lvl");
+  if (!LoadCookedLevel(cookedFilename.c_str()))
   {
-    _tmxLevel.tilesets.push_back(TmxTileset());
-    TmxTileset& tmxTileset = _tmxLevel.tilesets.back();
-
-    const picojson::object& tilesetObj = tileset.get<picojson::object>();
-
-    if (
-      !CheckedGet(tilesetObj, "name", &tmxTileset.name) ||
-      !CheckedGet(tilesetObj, "image", &tmxTileset.image) ||
-      !CheckedGet<int, double>(tilesetObj, "firstgid", &tmxTileset.firstGid) ||
-      !CheckedGet<int, double>(tilesetObj, "imagewidth", &tmxTileset.imageWidth) ||
-      !CheckedGet<int, double>(tilesetObj, "imageheight", &tmxTileset.imageHeight) ||
-      !CheckedGet<int, double>(tilesetObj, "margin", &tmxTileset.margin) ||
-      !CheckedGet<int, double>(tilesetObj, "spacing", &tmxTileset.spacing) ||
-      !CheckedGet<int, double>(tilesetObj, "tilecount", &tmxTileset.tileCount) ||
-      !CheckedGet<int, double>(tilesetObj, "tilewidth", &tmxTileset.tileWidth) ||
-      !CheckedGet<int, double>(tilesetObj, "tileheight", &tmxTileset.tileHeight))
-    {
+    LOG_INFO("No cooked level, loading: ", filename);
+    if (!LoadTmxJson(filename))
       return false;
-    }
   }
 
   {
     static b2BodyDef bodyDef;
     bodyDef.type = b2_dynamicBody;
     bodyDef.position.Set(12, 20);
-    _dynamicBody = _tmxLevel.world.CreateBody(&bodyDef);
+    _dynamicBody = _world.CreateBody(&bodyDef);
 
     // Define another box shape for our dynamic body.
     static b2PolygonShape dynamicBox;
@@ -338,44 +432,166 @@ bool SpriteManager::LoadTmx(const char* filename)
 
     // Add the shape to the body.
     _dynamicBody->CreateFixture(&fixtureDef);
+    _dynamicBodyIdx = _physics.TrackBody(_dynamicBody);
+  }
+
+  if (!BakeTileMesh(filename))
+    return false;
+
+  // load the chunks around the body before it starts moving, so it has something to
+  // land on
+  if (_streamer.IsRunning())
+  {
+    b2Vec2 pos = _dynamicBody->GetPosition();
+    _cameraPos = vec2{pos.x * PIXELS_PER_METER, pos.y * PIXELS_PER_METER};
+    _streamer.LoadAround(_cameraPos, &streamTarget);
   }
 
+  // the world belongs to the simulation thread from here on
+  _physics.Start(&_world, PHYSICS_STEP_SIZE, PHYSICS_MAX_STEPS);
   return true;
 }
 
 //------------------------------------------------------------------------------
-void SpriteManager::Tick()
+bool SpriteManager::BakeTileMesh(const char* filename)
 {
-  LARGE_INTEGER tmp;
-  QueryPerformanceCounter(&tmp);
-  double now = (double)tmp.QuadPart / _timerFrequency.QuadPart;
-  double delta = 0;
-  if (_lastTick > 0)
+  if (_tmxLevel.layers.empty() || _tmxLevel.tilesets.empty())
+    return true;
+
+  TileMeshDesc desc;
+  desc.origin = vec2{0, _tmxLevel.zeroLevel};
+  desc.tileSize = vec2{(float)_tmxLevel.tileWidth, (float)_tmxLevel.tileHeight};
+
+  // the layers of an infinite map are baked per chunk, as they stream in
+  if (!_tmxLevel.infinite)
   {
-    delta = now - _lastTick;
+    for (const TmxLayer& layer : _tmxLevel.layers)
+      desc.layers.push_back(TileMeshDesc::Layer{layer.Tiles(), layer.width, layer.height});
   }
-  _lastTick = now;
 
-  double UPDATE_FREQUENCY = 60;
-  double UPDATE_INTERVAL = 1.0 / UPDATE_FREQUENCY;
+  // tileset images are relative to the tmx file. Tilesets sharing an image share the
+  // texture, so they can be drawn together
+  string tmxPath = Path::GetPath(filename);
+  unordered_map<string, u16> textureByImage;
+  _tileTextures.clear();
+  for (const TmxTileset& tileset : _tmxLevel.tilesets)
+  {
+    auto it = textureByImage.find(tileset.image);
+    if (it == textureByImage.end())
+    {
+      ObjectHandle texture =
+          g_ResourceManager->LoadTexture(Path::Join(tmxPath, tileset.image).c_str());
+      if (!texture.IsValid())
+      {
+        LOG_WARN("Unable to load tileset image: ", tileset.image);
+        texture = _tmxTexture;
+      }
 
-  _updatedAcc += delta;
-  int numTicks = (int)(_updatedAcc / UPDATE_INTERVAL);
-  _updatedAcc -= numTicks * UPDATE_INTERVAL;
+      it = textureByImage.insert(make_pair(tileset.image, (u16)_tileTextures.size())).first;
+      _tileTextures.push_back(texture);
+    }
+
+    // the tiles of an invalid tileset are left out
+    TileMeshDesc::Tileset ts;
+    if (!TmxTilesetLayout(tileset, &ts))
+    {
+      LOG_WARN("Invalid tileset layout: ", tileset.name);
+      continue;
+    }
 
-  int velocityIterations = 6;
-  int positionIterations = 2;
+    ts.texture = it->second;
+    desc.tilesets.push_back(ts);
+  }
+
+  if (_tmxLevel.infinite)
+    return StartStreaming(desc);
+
+  _tileMesh.Bake(desc);
+  if (_tileMesh.vertices.empty())
+    return true;
 
-  for (int i = 0; i < numTicks; ++i)
+  _tileVb = g_Graphics->CreateBuffer(D3D11_BIND_VERTEX_BUFFER,
+      (int)(_tileMesh.vertices.size() * sizeof(PosTex)),
+      false,
+      _tileMesh.vertices.data(),
+      sizeof(PosTex));
+
+  if (!_tileVb.IsValid())
   {
-    _tmxLevel.world.Step((float)UPDATE_INTERVAL, velocityIterations, positionIterations);
+    LOG_ERROR("Unable to create tile vertex buffer");
+    return false;
   }
 
-  for (b2Contact* c = _tmxLevel.world.GetContactList(); c; c = c->GetNext())
+  vector<PosTex>().swap(_tileMesh.vertices);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool SpriteManager::StartStreaming(const TileMeshDesc& meshDesc)
+{
+  // there's no way to release a single vertex buffer, so the chunks share a dynamic one
+  if (!_streamVb.IsValid())
   {
-    int a = 10;
-    // process c
+    _streamVb = g_Graphics->CreateBuffer(D3D11_BIND_VERTEX_BUFFER,
+        (int)(4 * MAX_SPRITES_PER_BATCH * sizeof(PosTex)),
+        true,
+        nullptr,
+        sizeof(PosTex));
+
+    if (!_streamVb.IsValid())
+    {
+      LOG_ERROR("Unable to create streaming vertex buffer");
+      return false;
+    }
   }
+
+  ChunkStreamerDesc desc;
+  desc.loadRadius = STREAM_LOAD_RADIUS;
+  desc.memoryBudget = STREAM_MEMORY_BUDGET;
+  desc.pixelsPerMeter = PIXELS_PER_METER;
+  desc.meshDesc = meshDesc;
+  return _streamer.Start(&_tmxLevel, desc);
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::Tick()
+{
+  // pick up the latest physics state for this frame
+  _physicsSnapshot = &_physics.LatestSnapshot();
+
+  // the camera follows the body on infinite maps, and the chunks follow the camera
+  if (_streamer.IsRunning())
+  {
+    b2Vec2 p = _physics.BodyPosition(*_physicsSnapshot, _dynamicBodyIdx);
+    _cameraPos = vec2{p.x * PIXELS_PER_METER, p.y * PIXELS_PER_METER};
+
+    PhysicsChunkTarget target(&_physics);
+    _streamer.Update(_cameraPos, &target);
+  }
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::ApplyForce(const b2Vec2& force)
+{
+  if (_dynamicBody)
+    _physics.ApplyForceToCenter(_dynamicBody, force);
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::SubmitEntityQuads(
+    MappedQuadTarget* target, const vec2& minPos, const vec2& maxPos)
+{
+  static_assert(EntityQuadBuilder::INVALID_SPRITE == INVALID_SPRITE, "Sprite id mismatch");
+  u32 numQuads = _entityQuads.Prepare(_entities,
+      _spriteQuads.data(),
+      _spriteTextureSlot.data(),
+      (u32)_spriteTextures.size(),
+      minPos,
+      maxPos,
+      &g_JobPool);
+
+  if (numQuads)
+    _entityQuads.Submit(_spriteTextures.data(), target, &g_JobPool);
 }
 
 //------------------------------------------------------------------------------
@@ -386,59 +602,25 @@ void SpriteManager::Render()
   int bbWidth, bbHeight;
   g_Graphics->GetBackBufferSize(&bbWidth, &bbHeight);
 
-  int numTris = 0;
-  {
-    ObjectHandle h = _renderTextureBundle.objects._vb;
-    PosTex* vtx = ctx->MapWriteDiscard<PosTex>(h);
+  vec2 cameraPos = _streamer.IsRunning() ? _cameraPos : vec2{0, bbHeight / 2.f};
+  vec2 halfSize = vec2{bbWidth / 2.f, bbHeight / 2.f};
+  vec2 minPos = cameraPos - halfSize;
+  vec2 maxPos = cameraPos + halfSize;
 
-    float y = (float)_tmxLevel.zeroLevel;
+  // the physics body is drawn from the start of the dynamic vertex buffer
+  ObjectHandle vb = _renderTextureBundle.objects._vb;
+  {
+    PosTex* vtx = ctx->MapWriteDiscard<PosTex>(vb);
     float yInc = 32;
     float xInc = 32;
-    int idx = 0;
-
     float sx = (float)_tmxLevel.tilesets[0].tileWidth / _tmxLevel.tilesets[0].imageWidth;
     float sy = (float)_tmxLevel.tilesets[0].tileHeight / _tmxLevel.tilesets[0].imageHeight;
 
-    for (int i = 0; i < _tmxLevel.layers[0].height; ++i)
-    {
-      //float x = -bbWidth / 2.f;
-      float x = 0;
-      for (int j = 0; j < _tmxLevel.layers[0].width; ++j)
-      {
-        int spriteId = _tmxLevel.layers[0].tiles[idx];
-        if (spriteId != 0)
-        {
-          spriteId -= 1;
-
-          // 0, 1, 3
-          // 3, 1, 2
-
-          // 0, 1
-          // 3, 2
-          float z = 0.5f;
-
-          int ww = _tmxLevel.tilesets[0].imageWidth / _tmxLevel.tilesets[0].tileWidth;
-          int spriteX = spriteId % ww;
-          int spriteY = spriteId / ww;
-
-          vtx[0] = PosTex{vec3{x, y, z}, vec2{sx * spriteX, sy * spriteY}};
-          vtx[1] = PosTex{vec3{x + xInc, y, z}, vec2{sx * spriteX + sx, sy * spriteY}};
-          vtx[2] = PosTex{vec3{x + xInc, y - yInc, z}, vec2{sx * spriteX + sx, sy * spriteY + sy}};
-          vtx[3] = PosTex{vec3{x, y - yInc, z}, vec2{sx * spriteX, sy * spriteY + sy}};
-
-          vtx += 4;
-          numTris += 2;
-        }
-        x += xInc;
-        idx++;
-      }
-
-      y -= yInc;
-    }
-
     {
       // HACK HACK!
-      b2Vec2 p = _dynamicBody->GetPosition();
+      // the body is drawn between its last two simulated positions, to hide the
+      // difference between the step and frame rates
+      b2Vec2 p = _physics.BodyPosition(*_physicsSnapshot, _dynamicBodyIdx);
       float x = p.x * PIXELS_PER_METER;
       float y = p.y * PIXELS_PER_METER;
       float z = 0.5f;
@@ -449,14 +631,13 @@ void SpriteManager::Render()
       vtx[1] = PosTex{ vec3{ x + xInc, y, z }, vec2{ sx * spriteX + sx, sy * spriteY } };
       vtx[2] = PosTex{ vec3{ x + xInc, y - yInc, z }, vec2{ sx * spriteX + sx, sy * spriteY + sy } };
       vtx[3] = PosTex{ vec3{ x, y - yInc, z }, vec2{ sx * spriteX, sy * spriteY + sy } };
-
-      numTris += 2;
     }
 
-    ctx->Unmap(h);
+    ctx->Unmap(vb);
   }
 
-  mat4x4 view = MatrixLookAtLH(vec3(0, bbHeight/2.f, -1), vec3(0, bbHeight/2.f, 0), vec3(0, 1, 0));
+  mat4x4 view = MatrixLookAtLH(
+      vec3(cameraPos.x, cameraPos.y, -1), vec3(cameraPos.x, cameraPos.y, 0), vec3(0, 1, 0));
   mat4x4 proj = MatrixOrthoLH((float)bbWidth, (float)bbHeight, 0, 10);
 
   mat4x4 viewProj = view * proj;
@@ -465,7 +646,112 @@ void SpriteManager::Render()
   _cbRenderTexture.Set(ctx, 0);
   ctx->SetBundleWithSamplers(_renderTextureBundle, ShaderType::PixelShader);
   ctx->SetShaderResource(_tmxTexture);
-  ctx->DrawIndexed(6 * numTris, 0, 0);
+
+  // the tile chunks for all the layers are drawn from the static vertex buffer, using
+  // the bundle's quad index buffer
+  if (_tileVb.IsValid())
+  {
+    // only draw the chunks overlapping the view. Each draw is capped at the size of the
+    // index buffer, so a large visible set is split over multiple draws
+    _tileDraws.clear();
+    _tileMesh.CullChunks(minPos, maxPos, MAX_SPRITES_PER_BATCH, &_tileDraws);
+    DrawTiles(ctx, _tileVb, _tileDraws.data(), _tileDraws.size());
+  }
+
+  if (_streamer.IsRunning())
+    RenderStreamedChunks(ctx, minPos, maxPos);
+
+  ctx->DrawIndexed(6, 0, 0);
+
+  // the entities and the immediate mode sprites go last, as they remap the dynamic
+  // vertex buffer for every batch
+  DynamicVbSubmitTarget target(ctx, vb);
+  SubmitEntityQuads(&target, minPos, maxPos);
+  _spriteBatcher.Flush(&target);
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::RenderStreamedChunks(
+    GraphicsContext* ctx, const vec2& minPos, const vec2& maxPos)
+{
+  _tileDraws.clear();
+  _streamDrawMeshes.clear();
+  for (const StreamedChunk* chunk : _streamer.Resident())
+  {
+    if (chunk->maxPos.x <= minPos.x || chunk->minPos.x >= maxPos.x || chunk->maxPos.y <= minPos.y
+        || chunk->minPos.y >= maxPos.y)
+      continue;
+
+    chunk->mesh.CullChunks(minPos, maxPos, MAX_SPRITES_PER_BATCH, &_tileDraws);
+    _streamDrawMeshes.resize(_tileDraws.size(), &chunk->mesh);
+  }
+
+  // copy the visible quads to the dynamic vertex buffer, and point the draws at them.
+  // Whenever the buffer fills up, the draws so far are drawn, and the rest of the quads
+  // go in a new batch
+  PosTex* dst = nullptr;
+  u32 numQuads = 0;
+  _streamBatchDraws.clear();
+  auto flush = [&]()
+  {
+    ctx->Unmap(_streamVb);
+    DrawTiles(ctx, _streamVb, _streamBatchDraws.data(), _streamBatchDraws.size());
+    _streamBatchDraws.clear();
+    dst = nullptr;
+    numQuads = 0;
+  };
+
+  for (size_t i = 0; i < _tileDraws.size(); ++i)
+  {
+    const TileMesh::Draw& draw = _tileDraws[i];
+    const PosTex* src = _streamDrawMeshes[i]->vertices.data() + draw.firstVertex;
+    for (u32 first = 0; first < draw.numQuads;)
+    {
+      if (numQuads == MAX_SPRITES_PER_BATCH)
+        flush();
+
+      if (!dst)
+      {
+        dst = ctx->MapWriteDiscard<PosTex>(_streamVb);
+        if (!dst)
+          return;
+      }
+
+      u32 cnt = min(draw.numQuads - first, MAX_SPRITES_PER_BATCH - numQuads);
+      memcpy(dst + numQuads * 4, src + first * 4, cnt * 4 * sizeof(PosTex));
+      _streamBatchDraws.push_back(
+          TileMesh::Draw{numQuads * 4, cnt, draw.layer, draw.texture});
+      numQuads += cnt;
+      first += cnt;
+    }
+  }
+
+  if (dst)
+    flush();
+}
+
+//------------------------------------------------------------------------------
+void SpriteManager::DrawTiles(
+    GraphicsContext* ctx, ObjectHandle vb, const TileMesh::Draw* draws, size_t numDraws)
+{
+  // the draws are sorted on layer and texture, so only bind the texture when it changes
+  ctx->SetVertexBuffer(vb);
+  u32 texture = ~0u;
+  for (size_t i = 0; i < numDraws; ++i)
+  {
+    const TileMesh::Draw& draw = draws[i];
+    if (!draw.numQuads)
+      continue;
+
+    if (draw.texture != texture)
+    {
+      texture = draw.texture;
+      ctx->SetShaderResource(_tileTextures[texture]);
+    }
+    ctx->DrawIndexed(6 * draw.numQuads, 0, draw.firstVertex);
+  }
+  ctx->SetVertexBuffer(_renderTextureBundle.objects._vb);
+  ctx->SetShaderResource(_tmxTexture);
 }
 
 #if 0
@@ -701,6 +987,15 @@ ObjectHandle SpriteManager::LoadSpriteSheet(const char* filename)
   if (!k.Run())
     return ObjectHandle();
 
+  // the sheet image is relative to the sheet file
+  string image = Path::Join(Path::GetPath(filename), sheet.filename);
+  sheet.texture = g_ResourceManager->LoadTexture(image.c_str());
+  if (!sheet.texture.IsValid())
+  {
+    LOG_WARN("Unable to load sprite sheet texture: ", image);
+    return ObjectHandle();
+  }
+
   ObjectHandle res = ObjectHandle(ObjectHandle::kSpriteSheet, (int)_spriteSheets.size());
   _spriteSheets[res.id()] = sheet;
   return res;
@@ -719,45 +1014,36 @@ void SpriteManager::RenderSprites(
 
   const SpriteSheet& sheet = it->second;
 
-  ObjectHandle h = _renderTextureBundle.objects._vb;
-  PosTex* vtx = _ctx->MapWriteDiscard<PosTex>(h);
-
-  for (int i = 0; i < cnt;  ++i)
+  for (int i = 0; i < cnt; ++i)
   {
     int spriteId = spriteIds[i];
-    if (spriteId >= sheet.sprites.size())
+    if (spriteId < 0 || spriteId >= (int)sheet.sprites.size())
     {
       LOG_ERROR("Invalid sprite id: ", spriteId);
       return;
     }
 
+    // the sprite rects are in pixels
     const SpriteSheet::Sprite& sprite = sheet.sprites[spriteId];
-
-    // 0--1
-    // 2--3
-    
-    //vtx[0] = PosTex{ pos.x, pos.y, 0, 0, 0 };
-    //vtx[0] = PosTex{ pos.x, pos.y, 0, 0, 0 };
-    //vtx[0] = PosTex{ pos.x, pos.y, 0, 0, 0 };
-    //vtx[0] = PosTex{ pos.x, pos.y, 0, 0, 0 };
+    vec2 uvTopLeft = vec2{sprite.pos.x / sheet.size.x, sprite.pos.y / sheet.size.y};
+    vec2 uvBottomRight = vec2{
+        (sprite.pos.x + sprite.size.x) / sheet.size.x, (sprite.pos.y + sprite.size.y) / sheet.size.y};
+
+    SpriteQuad quad = SpriteQuad{uvTopLeft.x,
+        uvTopLeft.y,
+        uvBottomRight.x,
+        uvBottomRight.y,
+        sprite.size.x,
+        sprite.size.y,
+        {0, 0}};
+
+    _spriteBatcher.Add(sheet.texture, quad, vec2{(float)pos[i].x, (float)pos[i].y});
   }
-  _ctx->Unmap(h);
 }
 
 //------------------------------------------------------------------------------
 void SpriteManager::RenderSprite(ObjectHandle spriteSheet, int spriteId, int x, int y)
 {
-  auto it = _spriteSheets.find(spriteSheet.id());
-  if (it == _spriteSheets.end())
-  {
-    LOG_ERROR("Invalid sprite sheet id: ", spriteSheet.id());
-    return;
-  }
-
-  const SpriteSheet& sheet = it->second;
-  if (spriteId >= sheet.sprites.size())
-  {
-    LOG_ERROR("Invalid sprite id: ", spriteId);
-    return;
-  }
+  vec2i pos = vec2i{x, y};
+  RenderSprites(spriteSheet, &spriteId, &pos, 1);
 }
@@ -2,44 +2,18 @@
 #include <lib/tano_math.hpp>
 #include <core/object_handle.hpp>
 #include <core/gpu_objects.hpp>
+#include <core/tile_mesh.hpp>
+#include <core/sprite_batcher.hpp>
+#include <core/entity_store.hpp>
+#include <core/entity_quads.hpp>
+#include <core/physics_thread.hpp>
+#include <core/chunk_streamer.hpp>
+#include <core/tmx_level.hpp>
 #include <shaders/out/sprite_vsrendertexture.cbuffers.hpp>
-#include <contrib/picojson.h>
 #include <Box2D/Box2D.h>
 
 namespace world
 {
-  struct TmxLayer
-  {
-    string name;
-    int x, y;
-    int width, height;
-    vector<u32> tiles;
-  };
-
-  struct TmxTileset
-  {
-    int firstGid;
-    string image;
-    int imageWidth, imageHeight;
-    string name;
-    int margin, spacing;
-    int tileCount;
-    int tileWidth, tileHeight;
-  };
-
-  struct TmxLevel
-  {
-    TmxLevel();
-    int width, height;
-    int tileWidth, tileHeight;
-    float zeroLevel;
-
-    vector<TmxLayer> layers;
-    vector<TmxTileset> tilesets;
-
-    b2World world;
-  };
-
   struct SpriteSheet
   {
     struct Sprite
@@ -65,12 +39,21 @@ namespace world
     static bool Destroy();
 
     bool LoadTmx(const char* filename);
-    bool LoadSpriteLayer(const picojson::object& layerObj);
-    bool LoadCollisionLayer(const picojson::object& layerObj);
+    bool LoadTmxJson(const char* filename);
+    bool LoadCookedLevel(const char* filename);
+    bool CreateCollisionBodies(const CookedRect* rects,
+        u32 numRects,
+        const CookedPolyline* polylines,
+        u32 numPolylines,
+        const CookedPoint* points);
+    bool BakeTileMesh(const char* filename);
+    bool StartStreaming(const TileMeshDesc& meshDesc);
 
     ObjectHandle LoadSpriteSheet(const char* filename);
 
     void AddEntity(const Entity* e, const vec2& pos, u16 sprite);
+    void RemoveEntity(const Entity* e);
+    void SetEntityPos(const Entity* e, const vec2& pos);
 
     u16 AddSprite(const string& name,
         const string& sub,
@@ -79,11 +62,21 @@ namespace world
         const vec2& size,
         ObjectHandle handle);
 
+    // Queues sprites for the current frame. 'pos' is the top left corner, in pixels. The
+    // sprites are batched per texture, and drawn at the end of Render
     void RenderSprite(ObjectHandle spriteSheet, int spriteId, int x, int y);
     void RenderSprites(ObjectHandle spriteSheet, const int* spriteIds, const vec2i* pos, int cnt);
 
     void Tick();
+    // Queues a force on the player body, applied before the next physics step
+    void ApplyForce(const b2Vec2& force);
     void Render();
+    void RenderStreamedChunks(GraphicsContext* ctx, const vec2& minPos, const vec2& maxPos);
+    void DrawTiles(
+        GraphicsContext* ctx, ObjectHandle vb, const TileMesh::Draw* draws, size_t numDraws);
+    // Builds the quads for the entities overlapping the view, grouped by texture, straight
+    // into the target's buffer, and draws them in batches of at most target->MaxQuads()
+    void SubmitEntityQuads(MappedQuadTarget* target, const vec2& minPos, const vec2& maxPos);
     u16 GetSpriteIndex(const string& name);
 
     bool Init();
@@ -101,24 +94,46 @@ namespace world
     unordered_map<string, Sprite*> _spritesByName;
     vector<Sprite*> _sprites;
 
+    // uv table and texture slot per sprite, for the quad kernel
+    vector<SpriteQuad> _spriteQuads;
+    vector<u16> _spriteTextureSlot;
+    vector<ObjectHandle> _spriteTextures;
+
     ConstantBufferBundle<cb::SpriteV> _cbRenderTexture;
     GpuBundle _renderTextureBundle;
-    GraphicsContext* _ctx = nullptr;
+    SpriteBatcher _spriteBatcher;
+
+    EntityStore _entities;
 
-    unordered_map<u32, u32> _entityMap;
-    enum { MAX_ENTITIES = 16 * 1024};
-    vec2 _entityPos[MAX_ENTITIES];
-    u16 _entitySprite[MAX_ENTITIES];
-    int _entityCount = 0;
+    EntityQuadBuilder _entityQuads;
 
     ObjectHandle _tmxTexture;
     TmxLevel _tmxLevel;
+    // the level's collision, and the player body
+    b2World _world{b2Vec2(0.0f, -1.0f)};
+
+    // static geometry for the tile layers. The vertices are released once uploaded
+    TileMesh _tileMesh;
+    ObjectHandle _tileVb;
+    vector<ObjectHandle> _tileTextures;
+    vector<TileMesh::Draw> _tileDraws;
+
+    // Infinite maps stream their chunks in around the camera instead. The chunks keep
+    // their vertices, and the visible ones are copied to _streamVb every frame
+    ChunkStreamer _streamer;
+    ObjectHandle _streamVb;
+    vector<const TileMesh*> _streamDrawMeshes;
+    // the draws for the part of the visible quads that's in _streamVb
+    vector<TileMesh::Draw> _streamBatchDraws;
+    vec2 _cameraPos = vec2(0, 0);
 
     b2Body* _dynamicBody = nullptr;
+    u32 _dynamicBodyIdx = 0;
 
-    LARGE_INTEGER _timerFrequency;
-    double _lastTick = 0;
-    double _updatedAcc = 0;
+    // steps _world. Declared after the world, so it's stopped before the world is
+    // destroyed
+    PhysicsThread _physics;
+    const PhysicsSnapshot* _physicsSnapshot = nullptr;
   };
 
   extern SpriteManager* g_SpriteManager;
@@ -0,0 +1,212 @@
+#include "tile_mesh.hpp"
+#include <lib/radix_sort.hpp>
+
+using namespace world;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // Sort keys are (layer, texture, order), where the order is the chunk index when
+  // baking, and the first vertex when culling.
+  u64 MakeSortKey(u32 layer, u32 texture, u32 order)
+  {
+    return ((u64)layer << 48) | ((u64)texture << 32) | order;
+  }
+
+  u32 SortKeyLayer(u64 key)
+  {
+    return (u32)(key >> 48);
+  }
+}
+
+//------------------------------------------------------------------------------
+void TileMesh::Bake(const TileMeshDesc& desc)
+{
+  origin = desc.origin;
+  tileSize = desc.tileSize;
+
+  // build the gid -> tileset lookup
+  u32 maxGid = 0;
+  for (const TileMeshDesc::Tileset& tileset : desc.tilesets)
+    maxGid = max(maxGid, tileset.firstGid + tileset.tileCount);
+
+  // the uv rects are computed here, so building the quads doesn't need any divisions
+  gidToTileset.assign(maxGid, INVALID_TILESET);
+  gidSprites.assign(maxGid, SpriteQuad());
+  for (size_t i = 0; i < desc.tilesets.size(); ++i)
+  {
+    const TileMeshDesc::Tileset& tileset = desc.tilesets[i];
+    for (u32 j = 0; j < tileset.tileCount; ++j)
+    {
+      float u = tileset.uvMargin.x
+                + (tileset.uvSize.x + tileset.uvSpacing.x) * (j % tileset.tilesPerRow);
+      float v = tileset.uvMargin.y
+                + (tileset.uvSize.y + tileset.uvSpacing.y) * (j / tileset.tilesPerRow);
+      gidToTileset[tileset.firstGid + j] = (u16)i;
+      gidSprites[tileset.firstGid + j] = SpriteQuad{u,
+          v,
+          u + tileset.uvSize.x,
+          v + tileset.uvSize.y,
+          desc.tileSize.x,
+          desc.tileSize.y,
+          {0, 0}};
+    }
+  }
+
+  layers.clear();
+  u32 numChunks = 0;
+  for (const TileMeshDesc::Layer& src : desc.layers)
+  {
+    Layer layer;
+    layer.width = src.width;
+    layer.height = src.height;
+    layer.chunksX = (src.width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    layer.chunksY = (src.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    layer.firstChunk = numChunks;
+    numChunks += layer.chunksX * layer.chunksY;
+    layers.push_back(layer);
+  }
+
+  chunks.assign(numChunks, Chunk{0, 0});
+
+  // collect the non-empty tiles, and sort them on layer, texture and chunk. The sort is
+  // stable, so the tiles within a chunk stay in row order
+  vector<SortItem> items;
+  for (size_t l = 0; l < desc.layers.size(); ++l)
+  {
+    const TileMeshDesc::Layer& src = desc.layers[l];
+    const Layer& layer = layers[l];
+    for (int i = 0; i < src.height; ++i)
+    {
+      for (int j = 0; j < src.width; ++j)
+      {
+        u32 idx = i * src.width + j;
+        u32 gid = src.tiles[idx] & GID_MASK;
+        if (gid == 0 || gid >= gidToTileset.size() || gidToTileset[gid] == INVALID_TILESET)
+          continue;
+
+        const TileMeshDesc::Tileset& tileset = desc.tilesets[gidToTileset[gid]];
+        u32 chunk = (i / CHUNK_SIZE) * layer.chunksX + j / CHUNK_SIZE;
+        items.push_back(SortItem{MakeSortKey((u32)l, tileset.texture, chunk), idx});
+      }
+    }
+  }
+
+  vector<SortItem> tmp(items.size());
+  RadixSort64(items.data(), tmp.data(), (u32)items.size());
+
+  // start a new span whenever the key changes, and gather the tile positions and gids
+  // for the quad kernel
+  spans.clear();
+  vector<u32> spanChunk;
+  vector<vec2> pos(items.size());
+  vector<u32> gids(items.size());
+  u64 prevKey = ~0ull;
+  for (size_t i = 0; i < items.size(); ++i)
+  {
+    const SortItem& item = items[i];
+    u32 l = SortKeyLayer(item.key);
+    const TileMeshDesc::Layer& src = desc.layers[l];
+    u32 gid = src.tiles[item.value] & GID_MASK;
+    pos[i] = vec2{desc.origin.x + (item.value % src.width) * desc.tileSize.x,
+        desc.origin.y - (item.value / src.width) * desc.tileSize.y};
+    gids[i] = gid;
+
+    if (item.key != prevKey)
+    {
+      u32 chunk = layers[l].firstChunk + (u32)item.key;
+      spans.push_back(Span{(u32)i * 4, 0, desc.tilesets[gidToTileset[gid]].texture});
+      spanChunk.push_back(chunk);
+      chunks[chunk].numSpans++;
+      prevKey = item.key;
+    }
+
+    spans.back().numQuads++;
+  }
+
+  vertices.resize(items.size() * 4);
+  BuildQuads(
+      pos.data(), gids.data(), (u32)items.size(), gidSprites.data(), desc.z, vertices.data());
+
+  // group the spans by chunk
+  u32 firstSpan = 0;
+  for (Chunk& chunk : chunks)
+  {
+    chunk.firstSpan = firstSpan;
+    firstSpan += chunk.numSpans;
+    chunk.numSpans = 0;
+  }
+
+  chunkSpans.resize(spans.size());
+  for (size_t i = 0; i < spans.size(); ++i)
+  {
+    Chunk& chunk = chunks[spanChunk[i]];
+    chunkSpans[chunk.firstSpan + chunk.numSpans++] = (u32)i;
+  }
+}
+
+//------------------------------------------------------------------------------
+void TileMesh::CullChunks(
+    const vec2& minPos, const vec2& maxPos, u32 maxQuadsPerDraw, vector<Draw>* draws)
+{
+  assert(maxQuadsPerDraw >= MAX_QUADS_PER_CHUNK);
+
+  // convert the rect to tile space. nb: the rows go down from the origin
+  int tx0 = (int)floorf((minPos.x - origin.x) / tileSize.x);
+  int tx1 = (int)floorf((maxPos.x - origin.x) / tileSize.x);
+  int ty0 = (int)floorf((origin.y - maxPos.y) / tileSize.y);
+  int ty1 = (int)floorf((origin.y - minPos.y) / tileSize.y);
+
+  _visible.clear();
+  for (size_t l = 0; l < layers.size(); ++l)
+  {
+    const Layer& layer = layers[l];
+    if (tx1 < 0 || ty1 < 0 || tx0 >= layer.width || ty0 >= layer.height)
+      continue;
+
+    int cx0 = max(tx0, 0) / CHUNK_SIZE;
+    int cx1 = min(tx1, layer.width - 1) / CHUNK_SIZE;
+    int cy0 = max(ty0, 0) / CHUNK_SIZE;
+    int cy1 = min(ty1, layer.height - 1) / CHUNK_SIZE;
+
+    for (int cy = cy0; cy <= cy1; ++cy)
+    {
+      for (int cx = cx0; cx <= cx1; ++cx)
+      {
+        const Chunk& chunk = chunks[layer.firstChunk + cy * layer.chunksX + cx];
+        for (u32 i = 0; i < chunk.numSpans; ++i)
+        {
+          u32 spanIdx = chunkSpans[chunk.firstSpan + i];
+          const Span& span = spans[spanIdx];
+          _visible.push_back(
+              SortItem{MakeSortKey((u32)l, span.texture, span.firstVertex), spanIdx});
+        }
+      }
+    }
+  }
+
+  _sortTmp.resize(_visible.size());
+  RadixSort64(_visible.data(), _sortTmp.data(), (u32)_visible.size());
+
+  // merge the spans into draws
+  Draw cur = {0, 0, 0, 0};
+  for (const SortItem& item : _visible)
+  {
+    const Span& span = spans[item.value];
+    u16 layer = (u16)SortKeyLayer(item.key);
+    if (cur.numQuads && cur.layer == layer && cur.texture == span.texture
+        && cur.firstVertex + cur.numQuads * 4 == span.firstVertex
+        && cur.numQuads + span.numQuads <= maxQuadsPerDraw)
+    {
+      cur.numQuads += span.numQuads;
+      continue;
+    }
+
+    if (cur.numQuads)
+      draws->push_back(cur);
+    cur = Draw{span.firstVertex, span.numQuads, layer, span.texture};
+  }
+
+  if (cur.numQuads)
+    draws->push_back(cur);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <core/vertex_types.hpp>
+#include <core/quad_kernel.hpp>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Describes how a set of tile layers map to quads. Tiles are TMX gids, where 0 is an
+  // empty tile, and each tileset covers the gids [firstGid, firstGid + tileCount).
+  struct TileMeshDesc
+  {
+    struct Layer
+    {
+      const u32* tiles = nullptr;
+      int width = 0;
+      int height = 0;
+    };
+
+    struct Tileset
+    {
+      u32 firstGid = 1;
+      u32 tileCount = 0;
+      int tilesPerRow = 1;
+      vec2 uvSize = vec2(1, 1);
+      // offset of the first tile, and the gap between tiles, in uv space
+      vec2 uvMargin = vec2(0, 0);
+      vec2 uvSpacing = vec2(0, 0);
+      // tilesets sharing a texture can be drawn together
+      u16 texture = 0;
+    };
+
+    vector<Layer> layers;
+    vector<Tileset> tilesets;
+
+    // top left corner of the layers, and the size of each quad. nb: y grows upwards, so
+    // the rows go down from the origin.
+    vec2 origin = vec2(0, 0);
+    vec2 tileSize = vec2(32, 32);
+    float z = 0.5f;
+  };
+
+  //------------------------------------------------------------------------------
+  // Geometry for static tile layers, baked once into CHUNK_SIZE x CHUNK_SIZE chunks. At
+  // bake time, the tiles are radix sorted on (layer, texture, chunk), so the quads for a
+  // given layer and texture are stored in chunk order in a single vertex array. Each
+  // chunk keeps a span per texture it uses, and a run of visible chunks can then be
+  // drawn with a single draw call from a static vertex buffer, using the shared quad
+  // index buffer.
+  struct TileMesh
+  {
+    enum
+    {
+      CHUNK_SIZE = 32,
+      MAX_QUADS_PER_CHUNK = CHUNK_SIZE * CHUNK_SIZE,
+      // TMX stores the flip flags in the top bits of the gid. Flipped tiles are drawn
+      // unflipped
+      GID_MASK = 0x1fffffff,
+      INVALID_TILESET = 0xffff,
+    };
+
+    struct Span
+    {
+      u32 firstVertex;
+      u32 numQuads;
+      u16 texture;
+    };
+
+    struct Chunk
+    {
+      u32 firstSpan;
+      u32 numSpans;
+    };
+
+    struct Layer
+    {
+      int width;
+      int height;
+      int chunksX;
+      int chunksY;
+      u32 firstChunk;
+    };
+
+    struct Draw
+    {
+      u32 firstVertex;
+      u32 numQuads;
+      u16 layer;
+      u16 texture;
+    };
+
+    void Bake(const TileMeshDesc& desc);
+
+    // Appends the draws for the chunks overlapping the world space rect [minPos, maxPos],
+    // ordered by layer and texture. Spans that are adjacent in the vertex buffer are
+    // merged, as long as the draw stays below 'maxQuadsPerDraw', so the cost only depends
+    // on the size of the rect, and not on the size of the layers.
+    void CullChunks(
+        const vec2& minPos, const vec2& maxPos, u32 maxQuadsPerDraw, vector<Draw>* draws);
+
+    vec2 origin = vec2(0, 0);
+    vec2 tileSize = vec2(0, 0);
+
+    // maps a gid to its tileset, and to its uv rect
+    vector<u16> gidToTileset;
+    vector<SpriteQuad> gidSprites;
+
+    vector<Layer> layers;
+    // all the layers' chunks, row major per layer
+    vector<Chunk> chunks;
+    // chunk spans, indexed via Chunk::firstSpan
+    vector<u32> chunkSpans;
+    vector<Span> spans;
+    vector<PosTex> vertices;
+
+  private:
+    struct SortItem
+    {
+      u64 key;
+      u32 value;
+    };
+
+    // scratch space for sorting the visible spans
+    vector<SortItem> _visible;
+    vector<SortItem> _sortTmp;
+  };
+}
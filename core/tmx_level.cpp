@@ -0,0 +1,614 @@
+#include "tmx_level.hpp"
+#include <lib/input_buffer.hpp>
+#include <lib/json_reader.hpp>
+#include <lib/base64.hpp>
+#include <lib/inflate.hpp>
+#include <lib/error.hpp>
+#include <lib/string_utils.hpp>
+#include <lib/frame_allocator.hpp>
+
+using namespace world;
+using namespace world::parser;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // Keeps track of which of the required keys of a json object have been seen. The keys
+  // are kept inline, as there's one of these for every object read
+  struct RequiredKeys
+  {
+    enum
+    {
+      MAX_KEYS = 16
+    };
+
+    RequiredKeys(std::initializer_list<const char*> init)
+    {
+      assert(init.size() <= MAX_KEYS);
+      for (const char* key : init)
+        keys[numKeys++] = key;
+    }
+
+    bool Match(const string& key, const char* name)
+    {
+      if (key != name)
+        return false;
+
+      for (u32 i = 0; i < numKeys; ++i)
+      {
+        if (strcmp(keys[i], name) == 0)
+          found |= 1 << i;
+      }
+      return true;
+    }
+
+    bool Check() const
+    {
+      for (u32 i = 0; i < numKeys; ++i)
+      {
+        if (!(found & (1 << i)))
+        {
+          LOG_WARN("Unable to find property: ", keys[i]);
+          return false;
+        }
+      }
+      return true;
+    }
+
+    const char* keys[MAX_KEYS];
+    u32 numKeys = 0;
+    u32 found = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  bool ReadCollisionPoint(JsonReader& reader, vector<CookedPoint>* points)
+  {
+    RequiredKeys required{"x", "y"};
+    CookedPoint pt;
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "x"))
+        reader.ReadNumber(&pt.x);
+      else if (required.Match(key, "y"))
+        reader.ReadNumber(&pt.y);
+      else
+        reader.SkipValue();
+    }
+
+    if (!reader.Ok() || !required.Check())
+      return false;
+
+    points->push_back(pt);
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReadCollisionObject(JsonReader& reader, TmxCollision* objects)
+  {
+    RequiredKeys required{"x", "y", "width", "height", "rotation"};
+    CookedRect rect;
+    bool ellipse = false;
+    bool polygon = false;
+    bool polyline = false;
+    u32 firstPoint = (u32)objects->points.size();
+
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "x"))
+        reader.ReadNumber(&rect.x);
+      else if (required.Match(key, "y"))
+        reader.ReadNumber(&rect.y);
+      else if (required.Match(key, "width"))
+        reader.ReadNumber(&rect.width);
+      else if (required.Match(key, "height"))
+        reader.ReadNumber(&rect.height);
+      else if (required.Match(key, "rotation"))
+        reader.ReadNumber(&rect.rotation);
+      else if (key == "ellipse")
+        reader.ReadBool(&ellipse);
+      else if (key == "polygon")
+      {
+        polygon = true;
+        reader.SkipValue();
+      }
+      else if (key == "polyline")
+      {
+        polyline = true;
+        reader.BeginArray();
+        while (reader.NextElement())
+        {
+          if (!ReadCollisionPoint(reader, &objects->points))
+            return false;
+        }
+      }
+      else
+      {
+        reader.SkipValue();
+      }
+    }
+
+    if (!reader.Ok())
+      return false;
+
+    // the keys can come in any order, so the object type is only known at the end
+    if (ellipse || polygon)
+    {
+      // not supported yet
+      objects->points.resize(firstPoint);
+      return true;
+    }
+
+    if (polyline)
+    {
+      objects->polylines.push_back(
+          CookedPolyline{firstPoint, (u32)objects->points.size() - firstPoint});
+      return true;
+    }
+
+    // if nothing else is set, then the shape is a rectangle
+    if (!required.Check())
+      return false;
+
+    objects->rects.push_back(rect);
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReadTmxChunk(JsonReader& reader, TmxChunk* chunk)
+  {
+    RequiredKeys required{"x", "y", "width", "height", "data"};
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "x"))
+        reader.ReadNumber(&chunk->x);
+      else if (required.Match(key, "y"))
+        reader.ReadNumber(&chunk->y);
+      else if (required.Match(key, "width"))
+        reader.ReadNumber(&chunk->width);
+      else if (required.Match(key, "height"))
+        reader.ReadNumber(&chunk->height);
+      else if (required.Match(key, "data"))
+      {
+        // only the location is kept, and the data is decoded when the chunk streams in
+        size_t start = reader.Offset();
+        reader.SkipValue();
+        chunk->dataOfs = (u32)start;
+        chunk->dataLen = (u32)(reader.Offset() - start);
+      }
+      else
+      {
+        reader.SkipValue();
+      }
+    }
+
+    return reader.Ok() && required.Check();
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReadTmxLayer(JsonReader& reader, TmxLayer* layer, TmxCollision* objects)
+  {
+    // only the tile layers need a size, and that's checked along with the tile data
+    RequiredKeys required{"name"};
+    layer->x = layer->y = 0;
+    layer->width = layer->height = 0;
+
+    // the encoded data usually points into the json, so it isn't copied
+    const char* encoded = nullptr;
+    size_t encodedLen = 0;
+    string encodedScratch;
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "name"))
+        reader.ReadString(&layer->name);
+      else if (key == "x")
+        reader.ReadNumber(&layer->x);
+      else if (key == "y")
+        reader.ReadNumber(&layer->y);
+      else if (key == "width")
+        reader.ReadNumber(&layer->width);
+      else if (key == "height")
+        reader.ReadNumber(&layer->height);
+      else if (key == "data")
+      {
+        // the data is either an array of gids, or an encoded string that can only be
+        // decoded once the encoding and the layer size have been read
+        if (reader.PeekType() == JsonReader::ValueType::String)
+          reader.ReadString(&encoded, &encodedLen, &encodedScratch);
+        else
+          reader.ReadU32Array(&layer->tiles);
+      }
+      else if (key == "encoding")
+        reader.ReadString(&layer->encoding);
+      else if (key == "compression")
+        reader.ReadString(&layer->compression);
+      else if (key == "chunks")
+      {
+        reader.BeginArray();
+        while (reader.NextElement())
+        {
+          layer->chunks.push_back(TmxChunk());
+          if (!ReadTmxChunk(reader, &layer->chunks.back()))
+            return false;
+        }
+      }
+      else if (key == "objects")
+      {
+        reader.BeginArray();
+        while (reader.NextElement())
+        {
+          if (!ReadCollisionObject(reader, objects))
+            return false;
+        }
+      }
+      else
+      {
+        reader.SkipValue();
+      }
+    }
+
+    if (!reader.Ok() || !required.Check())
+      return false;
+
+    if (!encoded)
+      return true;
+
+    ScopedArena scratch(g_ScratchMemory.Arena());
+    u8* raw = scratch.arena.AllocTop<u8>((u32)Base64DecodedSize(encodedLen));
+    layer->tiles.resize((size_t)layer->width * layer->height);
+    if (!raw
+        || !DecodeTmxTiles(encoded,
+               encodedLen,
+               layer->encoding,
+               layer->compression,
+               raw,
+               layer->tiles.data(),
+               layer->tiles.size()))
+    {
+      LOG_WARN("Invalid tile data for layer: ", layer->name);
+      return false;
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReadTmxTileset(JsonReader& reader, TmxTileset* tileset)
+  {
+    RequiredKeys required{"name",
+        "image",
+        "firstgid",
+        "imagewidth",
+        "imageheight",
+        "margin",
+        "spacing",
+        "tilecount",
+        "tilewidth",
+        "tileheight"};
+
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "name"))
+        reader.ReadString(&tileset->name);
+      else if (required.Match(key, "image"))
+        reader.ReadString(&tileset->image);
+      else if (required.Match(key, "firstgid"))
+        reader.ReadNumber(&tileset->firstGid);
+      else if (required.Match(key, "imagewidth"))
+        reader.ReadNumber(&tileset->imageWidth);
+      else if (required.Match(key, "imageheight"))
+        reader.ReadNumber(&tileset->imageHeight);
+      else if (required.Match(key, "margin"))
+        reader.ReadNumber(&tileset->margin);
+      else if (required.Match(key, "spacing"))
+        reader.ReadNumber(&tileset->spacing);
+      else if (required.Match(key, "tilecount"))
+        reader.ReadNumber(&tileset->tileCount);
+      else if (required.Match(key, "tilewidth"))
+        reader.ReadNumber(&tileset->tileWidth);
+      else if (required.Match(key, "tileheight"))
+        reader.ReadNumber(&tileset->tileHeight);
+      else
+        reader.SkipValue();
+    }
+
+    return reader.Ok() && required.Check();
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReadZeroLevel(JsonReader& reader, float* zeroLevel)
+  {
+    // newer versions of Tiled write the properties as an array, which isn't handled
+    if (reader.PeekType() != JsonReader::ValueType::Object)
+      return reader.SkipValue();
+
+    RequiredKeys required{"zerolevel"};
+    string key;
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (required.Match(key, "zerolevel"))
+      {
+        string value;
+        reader.ReadString(&value);
+        *zeroLevel = (float)atof(value.c_str());
+      }
+      else
+      {
+        reader.SkipValue();
+      }
+    }
+
+    return reader.Ok() && required.Check();
+  }
+
+  //------------------------------------------------------------------------------
+  bool TmxReadError(const JsonReader& reader, const char* filename)
+  {
+    // missing properties have already been logged
+    if (!reader.Ok())
+      LOG_WARN("Error loading tmx: ", filename, " at offset: ", reader.Offset());
+    return false;
+  }
+}
+
+//------------------------------------------------------------------------------
+void TmxLevel::Reset()
+{
+  width = height = 0;
+  tileWidth = tileHeight = 0;
+  zeroLevel = 0;
+  layers.clear();
+  tilesets.clear();
+  cookedFile.Close();
+
+  infinite = false;
+  chunkWidth = chunkHeight = 16;
+  jsonFile.Close();
+  collision = TmxCollision();
+}
+
+//------------------------------------------------------------------------------
+bool world::TmxTilesetLayout(const TmxTileset& tileset, TileMeshDesc::Tileset* layout)
+{
+  if (tileset.tileWidth <= 0 || tileset.tileHeight <= 0 || tileset.imageWidth <= 0
+      || tileset.imageHeight <= 0 || tileset.margin < 0 || tileset.spacing < 0)
+    return false;
+
+  // there's a margin on both sides of the image, and a gap between each pair of tiles
+  int tilesPerRow = (tileset.imageWidth - 2 * tileset.margin + tileset.spacing)
+                    / (tileset.tileWidth + tileset.spacing);
+  int tilesPerColumn = (tileset.imageHeight - 2 * tileset.margin + tileset.spacing)
+                       / (tileset.tileHeight + tileset.spacing);
+  if (tilesPerRow <= 0 || tilesPerColumn <= 0)
+    return false;
+
+  vec2 imageSize = vec2{(float)tileset.imageWidth, (float)tileset.imageHeight};
+  layout->firstGid = tileset.firstGid;
+  layout->tileCount = tileset.tileCount;
+  layout->tilesPerRow = tilesPerRow;
+  layout->uvSize = vec2{tileset.tileWidth / imageSize.x, tileset.tileHeight / imageSize.y};
+  layout->uvMargin = vec2{tileset.margin / imageSize.x, tileset.margin / imageSize.y};
+  layout->uvSpacing = vec2{tileset.spacing / imageSize.x, tileset.spacing / imageSize.y};
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool world::ReadTmxJson(
+    const char* json, size_t len, const char* filename, TmxLevel* level, TmxCollision* collision)
+{
+  // The tile data is the bulk of the file, and goes through the reader's integer array
+  // fast path
+  InputBuffer input(json, len);
+  JsonReader reader(input);
+
+  RequiredKeys required{"width", "height", "tilewidth", "tileheight", "layers", "tilesets"};
+  float zeroLevel = 0;
+
+  string key;
+  reader.BeginObject();
+  while (reader.NextKey(&key))
+  {
+    if (required.Match(key, "width"))
+      reader.ReadNumber(&level->width);
+    else if (required.Match(key, "height"))
+      reader.ReadNumber(&level->height);
+    else if (required.Match(key, "tilewidth"))
+      reader.ReadNumber(&level->tileWidth);
+    else if (required.Match(key, "tileheight"))
+      reader.ReadNumber(&level->tileHeight);
+    else if (key == "infinite")
+      reader.ReadBool(&level->infinite);
+    else if (key == "properties")
+    {
+      if (!ReadZeroLevel(reader, &zeroLevel))
+        return TmxReadError(reader, filename);
+    }
+    else if (required.Match(key, "layers"))
+    {
+      reader.BeginArray();
+      while (reader.NextElement())
+      {
+        // the tiles are decoded straight into the layer, which is dropped again if it
+        // turns out to be a collision layer
+        level->layers.push_back(TmxLayer());
+        TmxLayer& layer = level->layers.back();
+
+        TmxCollision objects;
+        if (!ReadTmxLayer(reader, &layer, &objects))
+          return TmxReadError(reader, filename);
+
+        string name = layer.name;
+        transform(name.begin(), name.end(), name.begin(), tolower);
+        if (StartsWith(name, "collision"))
+        {
+          u32 pointOfs = (u32)collision->points.size();
+          for (CookedPolyline polyline : objects.polylines)
+          {
+            polyline.firstPoint += pointOfs;
+            collision->polylines.push_back(polyline);
+          }
+          collision->rects.insert(
+              collision->rects.end(), objects.rects.begin(), objects.rects.end());
+          collision->points.insert(
+              collision->points.end(), objects.points.begin(), objects.points.end());
+          level->layers.pop_back();
+        }
+        else if (!layer.chunks.empty())
+        {
+          // all the layers use the map's chunk size
+          level->chunkWidth = layer.chunks[0].width;
+          level->chunkHeight = layer.chunks[0].height;
+        }
+        else if (layer.tiles.size() != (size_t)layer.width * layer.height)
+        {
+          LOG_WARN("Invalid tile count for layer: ", layer.name);
+          return false;
+        }
+      }
+    }
+    else if (required.Match(key, "tilesets"))
+    {
+      reader.BeginArray();
+      while (reader.NextElement())
+      {
+        level->tilesets.push_back(TmxTileset());
+        if (!ReadTmxTileset(reader, &level->tilesets.back()))
+          return TmxReadError(reader, filename);
+      }
+    }
+    else
+    {
+      reader.SkipValue();
+    }
+  }
+
+  if (!reader.Ok() || !required.Check())
+    return TmxReadError(reader, filename);
+
+  // the zero level is given in tiles, and the tile height can come after it
+  level->zeroLevel = zeroLevel * level->tileHeight;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void world::ReadCookedLevel(const CookedLevel& cooked, TmxLevel* level)
+{
+  const CookedLevelHeader& header = cooked.Header();
+  level->width = header.width;
+  level->height = header.height;
+  level->tileWidth = header.tileWidth;
+  level->tileHeight = header.tileHeight;
+  level->zeroLevel = header.zeroLevel;
+
+  for (u32 i = 0; i < header.numLayers; ++i)
+  {
+    const CookedLayer& src = cooked.Layers()[i];
+    level->layers.push_back(TmxLayer());
+    TmxLayer& layer = level->layers.back();
+    layer.name = cooked.String(src.nameOfs);
+    layer.x = src.x;
+    layer.y = src.y;
+    layer.width = src.width;
+    layer.height = src.height;
+    layer.cookedTiles = cooked.Tiles(src);
+  }
+
+  for (u32 i = 0; i < header.numTilesets; ++i)
+  {
+    const CookedTileset& src = cooked.Tilesets()[i];
+    TmxTileset tileset;
+    tileset.name = cooked.String(src.nameOfs);
+    tileset.image = cooked.String(src.imageOfs);
+    tileset.firstGid = src.firstGid;
+    tileset.imageWidth = src.imageWidth;
+    tileset.imageHeight = src.imageHeight;
+    tileset.margin = src.margin;
+    tileset.spacing = src.spacing;
+    tileset.tileCount = src.tileCount;
+    tileset.tileWidth = src.tileWidth;
+    tileset.tileHeight = src.tileHeight;
+    level->tilesets.push_back(tileset);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool world::DecodeTmxTiles(const char* encoded,
+    size_t encodedLen,
+    const string& encoding,
+    const string& compression,
+    u8* scratch,
+    u32* tiles,
+    size_t numTiles)
+{
+  if (encoding != "base64")
+  {
+    LOG_WARN("Unsupported tile encoding: ", encoding);
+    return false;
+  }
+
+  size_t rawLen;
+  if (!Base64Decode(encoded, encodedLen, scratch, &rawLen))
+    return false;
+
+  // the decoded data is the little endian gids, which is copied as is
+  size_t numBytes = numTiles * sizeof(u32);
+  if (compression.empty())
+  {
+    if (rawLen != numBytes)
+      return false;
+    memcpy(tiles, scratch, numBytes);
+    return true;
+  }
+
+  if (compression == "zlib")
+    return ZlibInflate(scratch, rawLen, (u8*)tiles, numBytes);
+
+  if (compression == "gzip")
+    return GzipInflate(scratch, rawLen, (u8*)tiles, numBytes);
+
+  // there's no zstd decoder in the tree, so those layers need to be saved with zlib
+  LOG_WARN("Unsupported tile compression: ", compression);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool world::DecodeTmxChunk(const char* json,
+    const TmxLayer& layer,
+    const TmxChunk& chunk,
+    vector<u8>* scratch,
+    vector<u32>* tiles)
+{
+  InputBuffer input(json + chunk.dataOfs, chunk.dataLen);
+  JsonReader reader(input);
+
+  size_t numTiles = (size_t)chunk.width * chunk.height;
+  tiles->clear();
+  if (reader.PeekType() != JsonReader::ValueType::String)
+    return reader.ReadU32Array(tiles) && tiles->size() == numTiles;
+
+  const char* encoded;
+  size_t encodedLen;
+  string encodedScratch;
+  if (!reader.ReadString(&encoded, &encodedLen, &encodedScratch))
+    return false;
+
+  scratch->resize(Base64DecodedSize(encodedLen));
+  tiles->resize(numTiles);
+  return DecodeTmxTiles(encoded,
+      encodedLen,
+      layer.encoding,
+      layer.compression,
+      scratch->data(),
+      tiles->data(),
+      numTiles);
+}
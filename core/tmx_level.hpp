@@ -0,0 +1,116 @@
+#pragma once
+#include <core/cooked_level.hpp>
+#include <core/tile_mesh.hpp>
+#include <lib/mapped_file.hpp>
+
+namespace world
+{
+  // A chunk of a layer in an infinite map. Only the location of the tile data in the
+  // json is kept, and the tiles are decoded when the chunk streams in
+  struct TmxChunk
+  {
+    int x, y;
+    int width, height;
+    u32 dataOfs;
+    u32 dataLen;
+  };
+
+  struct TmxLayer
+  {
+    string name;
+    int x, y;
+    int width, height;
+    vector<u32> tiles;
+    // set instead of 'tiles' when the layer is used in place from a cooked level
+    const u32* cookedTiles = nullptr;
+
+    // set instead of 'tiles' for the layers of an infinite map
+    vector<TmxChunk> chunks;
+    string encoding;
+    string compression;
+
+    const u32* Tiles() const { return cookedTiles ? cookedTiles : tiles.data(); }
+  };
+
+  // The collision objects, in the cooked level layout, so all the formats share the body
+  // creation
+  struct TmxCollision
+  {
+    vector<CookedRect> rects;
+    vector<CookedPolyline> polylines;
+    vector<CookedPoint> points;
+  };
+
+  struct TmxTileset
+  {
+    int firstGid;
+    string image;
+    int imageWidth, imageHeight;
+    string name;
+    int margin, spacing;
+    int tileCount;
+    int tileWidth, tileHeight;
+  };
+
+  struct TmxLevel
+  {
+    // Drops everything loaded so far, as the loaders add to the layers and tilesets
+    void Reset();
+
+    int width = 0, height = 0;
+    int tileWidth = 0, tileHeight = 0;
+    float zeroLevel = 0;
+
+    vector<TmxLayer> layers;
+    vector<TmxTileset> tilesets;
+
+    // keeps a cooked level mapped, for the layers using its tiles in place
+    MappedFile cookedFile;
+
+    // Infinite maps are streamed in chunks. The json stays mapped, as the chunks are
+    // decoded from it, and the collision objects are split up between the chunks
+    bool infinite = false;
+    int chunkWidth = 16, chunkHeight = 16;
+    MappedFile jsonFile;
+    TmxCollision collision;
+  };
+
+  // Sets up the tile mesh layout for a tileset, where the tiles start 'margin' pixels in
+  // from the edges of the image, and are 'spacing' pixels apart. Returns false if the
+  // tile or image size is invalid, or the image doesn't have room for a single tile
+  bool TmxTilesetLayout(const TmxTileset& tileset, TileMeshDesc::Tileset* layout);
+
+  // Reads a map saved as json by Tiled into 'level', in a single pass, without building a
+  // json tree first. The objects of the collision layers go to 'collision', and the
+  // layers of an infinite map only keep the location of their chunks in 'json', so it
+  // needs to stay around for DecodeTmxChunk. 'level' is added to, so it should be Reset
+  // first. 'filename' is only used for the errors.
+  bool ReadTmxJson(const char* json,
+      size_t len,
+      const char* filename,
+      TmxLevel* level,
+      TmxCollision* collision);
+
+  // Fills in 'level' from a cooked level, with the layers using the tiles in place, so
+  // the cooked data has to stay around for as long as the level. The collision objects
+  // are left in 'cooked'. 'level' is added to, so it should be Reset first.
+  void ReadCookedLevel(const CookedLevel& cooked, TmxLevel* level);
+
+  // Decodes base64 tile data, that's optionally zlib or gzip compressed, into exactly
+  // 'numTiles' gids. 'scratch' needs room for Base64DecodedSize(encodedLen) bytes
+  bool DecodeTmxTiles(const char* encoded,
+      size_t encodedLen,
+      const string& encoding,
+      const string& compression,
+      u8* scratch,
+      u32* tiles,
+      size_t numTiles);
+
+  // Decodes the tiles of a chunk of an infinite map, from the json it was read from. Only
+  // touches its arguments, so it can run on any thread
+  bool DecodeTmxChunk(const char* json,
+      const TmxLayer& layer,
+      const TmxChunk& chunk,
+      vector<u8>* scratch,
+      vector<u32>* tiles);
+}
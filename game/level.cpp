@@ -1,56 +1,296 @@
 #include "level.hpp"
-#include <core/resource_manager.hpp>
-#include <core/sprite_manager.hpp>
-#include <lib/init_sequence.hpp>
+#include <lib/utils.hpp>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace world;
 
-static int PAGE_SIZE = 256;
+static const int PAGE_SIZE = BackgroundPage::SIZE;
 
-//------------------------------------------------------------------------------
-bool Level::Load(const char* filename)
+namespace
 {
-  BEGIN_INIT_SEQUENCE();
+  //------------------------------------------------------------------------------
+  // The 64 bit intrinsics are x64 only on MSVC, so the words are split for win32
+  u32 PopCount(u64 v)
+  {
+#ifdef _MSC_VER
+    return __popcnt((u32)v) + __popcnt((u32)(v >> 32));
+#else
+    return (u32)__builtin_popcountll(v);
+#endif
+  }
 
-  u8* buf;
-  int w, h, c;
-  INIT_FATAL(g_ResourceManager->LoadImage(filename, &buf, &w, &h, &c));
-  u32* buf32 = (u32*)buf;
+  //------------------------------------------------------------------------------
+  int LowestBit(u64 v)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    if (_BitScanForward(&idx, (u32)v))
+      return (int)idx;
+    _BitScanForward(&idx, (u32)(v >> 32));
+    return (int)idx + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+  }
 
-  ObjectHandle spriteSheet;
-  INIT_RESOURCE_FATAL(spriteSheet, g_SpriteManager->LoadSpriteSheet("gfx/oryx_16bit_fantasy_world_trans.sheet"));
+  //------------------------------------------------------------------------------
+  int HighestBit(u64 v)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    if (_BitScanReverse(&idx, (u32)(v >> 32)))
+      return (int)idx + 32;
+    _BitScanReverse(&idx, (u32)v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+  }
 
-  int pageCountX = (w + PAGE_SIZE - 1) / PAGE_SIZE;
-  int pageCountY = (h + PAGE_SIZE - 1) / PAGE_SIZE;
+  //------------------------------------------------------------------------------
+  // The bits of word 'w' covering [x0, x1]
+  u64 SpanMask(int x0, int x1, int w)
+  {
+    int lo = max(x0 - w * 64, 0);
+    int hi = min(x1 - w * 64, 63);
+    return (~0ull << lo) & (~0ull >> (63 - hi));
+  }
+
+  //------------------------------------------------------------------------------
+  bool ClipRect(const Level& level, int* x0, int* y0, int* x1, int* y1)
+  {
+    *x0 = max(*x0, 0);
+    *y0 = max(*y0, 0);
+    *x1 = min(*x1, level.width - 1);
+    *y1 = min(*y1, level.height - 1);
+    return *x0 <= *x1 && *y0 <= *y1;
+  }
+
+  //------------------------------------------------------------------------------
+  // Like BackgroundPage::FindWallInRow, but for a level row, that can span pages
+  int FindWallInLevelRow(const Level& level, int row, int x0, int x1, bool reverse)
+  {
+    const BackgroundPage* pageRow = &level.pages[row / PAGE_SIZE * level.pageCountX];
+    int localRow = row % PAGE_SIZE;
+    int p0 = x0 / PAGE_SIZE;
+    int p1 = x1 / PAGE_SIZE;
+    for (int i = 0; i <= p1 - p0; ++i)
+    {
+      int p = reverse ? p1 - i : p0 + i;
+      int lx0 = max(x0 - p * PAGE_SIZE, 0);
+      int lx1 = min(x1 - p * PAGE_SIZE, PAGE_SIZE - 1);
+      int x = pageRow[p].FindWallInRow(localRow, lx0, lx1, reverse);
+      if (x >= 0)
+        return p * PAGE_SIZE + x;
+    }
+    return -1;
+  }
+}
+
+//------------------------------------------------------------------------------
+void Level::Init(const u32* pixels, int w, int h)
+{
+  width = w;
+  height = h;
+  pageCountX = (w + PAGE_SIZE - 1) / PAGE_SIZE;
+  pageCountY = (h + PAGE_SIZE - 1) / PAGE_SIZE;
+  pages.clear();
+  pages.reserve(pageCountX * pageCountY);
 
   for (int pageY = 0; pageY < pageCountY; ++pageY)
   {
     for (int pageX = 0; pageX < pageCountX; ++pageX)
     {
-      pages.push_back(BackgroundPage {pageX * PAGE_SIZE, pageY * PAGE_SIZE, PAGE_SIZE, PAGE_SIZE});
+      // value initialized, so the wall bits start out zeroed
+      pages.emplace_back();
       BackgroundPage& page = pages.back();
+      page.x = pageX * PAGE_SIZE;
+      page.y = pageY * PAGE_SIZE;
+      page.w = PAGE_SIZE;
+      page.h = PAGE_SIZE;
+
+      // the pages along the right and bottom edges can stick out of the image
+      int rows = min(PAGE_SIZE, h - page.y);
+      int cols = min(PAGE_SIZE, w - page.x);
+      for (int i = 0; i < rows; ++i)
+      {
+        const u32* src = pixels + (page.y + i) * w + page.x;
+        for (int j = 0; j < cols; ++j)
+        {
+          if (src[j] > 0xff000000)
+            page.SetWall(j, i);
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool Level::IsWall(int x, int y) const
+{
+  if (x < 0 || y < 0 || x >= width || y >= height)
+    return false;
+
+  const BackgroundPage& page = pages[y / PAGE_SIZE * pageCountX + x / PAGE_SIZE];
+  return page.IsWall(x % PAGE_SIZE, y % PAGE_SIZE);
+}
+
+//------------------------------------------------------------------------------
+u32 Level::CountWalls(int x0, int y0, int x1, int y1) const
+{
+  if (!ClipRect(*this, &x0, &y0, &x1, &y1))
+    return 0;
+
+  u32 res = 0;
+  for (int py = y0 / PAGE_SIZE; py <= y1 / PAGE_SIZE; ++py)
+  {
+    for (int px = x0 / PAGE_SIZE; px <= x1 / PAGE_SIZE; ++px)
+    {
+      const BackgroundPage& page = pages[py * pageCountX + px];
+      res += page.CountWalls(max(x0 - page.x, 0),
+          max(y0 - page.y, 0),
+          min(x1 - page.x, PAGE_SIZE - 1),
+          min(y1 - page.y, PAGE_SIZE - 1));
+    }
+  }
+  return res;
+}
+
+//------------------------------------------------------------------------------
+bool Level::AnyWall(int x0, int y0, int x1, int y1) const
+{
+  if (!ClipRect(*this, &x0, &y0, &x1, &y1))
+    return false;
+
+  for (int py = y0 / PAGE_SIZE; py <= y1 / PAGE_SIZE; ++py)
+  {
+    for (int px = x0 / PAGE_SIZE; px <= x1 / PAGE_SIZE; ++px)
+    {
+      const BackgroundPage& page = pages[py * pageCountX + px];
+      if (page.AnyWall(max(x0 - page.x, 0),
+              max(y0 - page.y, 0),
+              min(x1 - page.x, PAGE_SIZE - 1),
+              min(y1 - page.y, PAGE_SIZE - 1)))
+        return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool Level::Raycast(const vec2& from, const vec2& to, vec2i* hit) const
+{
+  // Visits the rows in the order the segment passes through them, and looks for the
+  // first wall in the span of cells covered on each row. That's a few word tests per
+  // row, instead of a step per cell.
+  float dx = to.x - from.x;
+  float dy = to.y - from.y;
+  bool reverse = dx < 0;
+
+  // the rows outside of the level are empty, so there's no need to walk them
+  int row0 = Clamp(-1, height, (int)floorf(from.y));
+  int row1 = Clamp(-1, height, (int)floorf(to.y));
+  int step = row1 >= row0 ? 1 : -1;
 
-      for (int i = 0; i < PAGE_SIZE; ++i)
+  for (int row = row0;; row += step)
+  {
+    if (row >= 0 && row < height)
+    {
+      // the part of the segment that's within the row
+      float t0 = 0, t1 = 1;
+      if (dy != 0)
+      {
+        t0 = Clamp(0.f, 1.f, (row - from.y) / dy);
+        t1 = Clamp(0.f, 1.f, (row + 1 - from.y) / dy);
+      }
+
+      float xa = from.x + dx * t0;
+      float xb = from.x + dx * t1;
+      int x0 = max((int)floorf(min(xa, xb)), 0);
+      int x1 = min((int)floorf(max(xa, xb)), width - 1);
+
+      if (x0 <= x1)
       {
-        for (int j = 0; j < PAGE_SIZE; ++j)
+        int x = FindWallInLevelRow(*this, row, x0, x1, reverse);
+        if (x >= 0)
         {
-          int xx = pageX * PAGE_SIZE + j;
-          int yy = pageY * PAGE_SIZE + i;
-          u32 cur = buf32[yy * w + xx];
-          if (cur > 0xff000000)
-          {
-            page.walls.push_back(vec2i{j, i});
-            int a = 10;
-          }
+          *hit = vec2i{x, row};
+          return true;
         }
       }
     }
+
+    if (row == row1)
+      break;
   }
 
-  END_INIT_SEQUENCE();
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void BackgroundPage::SetWall(int x, int y)
+{
+  walls[y * ROW_WORDS + (x >> 6)] |= 1ull << (x & 63);
+}
+
+//------------------------------------------------------------------------------
+bool BackgroundPage::IsWall(int x, int y) const
+{
+  return (walls[y * ROW_WORDS + (x >> 6)] >> (x & 63)) & 1;
+}
+
+//------------------------------------------------------------------------------
+u32 BackgroundPage::CountWalls(int x0, int y0, int x1, int y1) const
+{
+  u32 res = 0;
+  int w0 = x0 >> 6;
+  int w1 = x1 >> 6;
+  for (int w = w0; w <= w1; ++w)
+  {
+    u64 mask = SpanMask(x0, x1, w);
+    for (int y = y0; y <= y1; ++y)
+      res += PopCount(walls[y * ROW_WORDS + w] & mask);
+  }
+  return res;
+}
+
+//------------------------------------------------------------------------------
+bool BackgroundPage::AnyWall(int x0, int y0, int x1, int y1) const
+{
+  int w0 = x0 >> 6;
+  int w1 = x1 >> 6;
+  for (int w = w0; w <= w1; ++w)
+  {
+    u64 mask = SpanMask(x0, x1, w);
+    u64 bits = 0;
+    for (int y = y0; y <= y1; ++y)
+      bits |= walls[y * ROW_WORDS + w];
+    if (bits & mask)
+      return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+int BackgroundPage::FindWallInRow(int row, int x0, int x1, bool reverse) const
+{
+  const u64* words = walls + row * ROW_WORDS;
+  int w0 = x0 >> 6;
+  int w1 = x1 >> 6;
+  for (int i = 0; i <= w1 - w0; ++i)
+  {
+    int w = reverse ? w1 - i : w0 + i;
+    u64 bits = words[w] & SpanMask(x0, x1, w);
+    if (bits)
+      return w * 64 + (reverse ? HighestBit(bits) : LowestBit(bits));
+  }
+  return -1;
 }
 
 //------------------------------------------------------------------------------
-void BackgroundPage::RenderToRenderTarget(ObjectHandle renderTarget)
+void BackgroundPage::RenderToRenderTarget(ObjectHandle)
 {
 }
@@ -5,21 +5,54 @@
 namespace world
 {
   //------------------------------------------------------------------------------
+  // A SIZE x SIZE part of the level, with a bit per cell that's set for walls. Each row
+  // is ROW_WORDS words, with x = 0 in the lowest bit of the first word, so the rect and
+  // ray queries test 64 cells at a time.
   struct BackgroundPage
   {
+    enum
+    {
+      SIZE = 256,
+      ROW_WORDS = SIZE / 64,
+    };
+
     int x, y;
     int w, h;
 
     void RenderToRenderTarget(ObjectHandle renderTarget);
 
-    vector<vec2i> walls;
+    // The coordinates are relative to the page, and the rects are inclusive, and
+    // assumed to be within the page
+    void SetWall(int x, int y);
+    bool IsWall(int x, int y) const;
+    u32 CountWalls(int x0, int y0, int x1, int y1) const;
+    bool AnyWall(int x0, int y0, int x1, int y1) const;
+    // Returns the first wall in [x0, x1] on the row, going from x1 to x0 if 'reverse',
+    // or -1 if there isn't one
+    int FindWallInRow(int row, int x0, int x1, bool reverse) const;
+
+    u64 walls[SIZE * ROW_WORDS];
   };
 
   //------------------------------------------------------------------------------
   struct Level
   {
     bool Load(const char* filename);
+    // Builds the wall bits from an RGBA image, where the opaque non-black pixels are walls
+    void Init(const u32* pixels, int width, int height);
+
+    // Level coordinates are in pixels, with y going down, and the cells outside of the
+    // level are empty
+    bool IsWall(int x, int y) const;
+    u32 CountWalls(int x0, int y0, int x1, int y1) const;
+    bool AnyWall(int x0, int y0, int x1, int y1) const;
+    // Finds the first wall cell the segment from 'from' to 'to' passes through. A point
+    // on an edge between cells belongs to the cell to its right, or below it
+    bool Raycast(const vec2& from, const vec2& to, vec2i* hit) const;
 
+    int width = 0, height = 0;
+    int pageCountX = 0, pageCountY = 0;
+    // row major
     vector<BackgroundPage> pages;
   };
-}
\ No newline at end of file
+}
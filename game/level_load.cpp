@@ -0,0 +1,25 @@
+#include "level.hpp"
+#include <core/resource_manager.hpp>
+#include <core/sprite_manager.hpp>
+#include <lib/init_sequence.hpp>
+#include <lib/utils.hpp>
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+bool Level::Load(const char* filename)
+{
+  BEGIN_INIT_SEQUENCE();
+
+  u8* buf;
+  int w, h, c;
+  INIT_FATAL(g_ResourceManager->LoadImage(filename, &buf, &w, &h, &c));
+  DEFER([=]() { stbi_image_free(buf); });
+
+  ObjectHandle spriteSheet;
+  INIT_RESOURCE_FATAL(spriteSheet, g_SpriteManager->LoadSpriteSheet("gfx/oryx_16bit_fantasy_world_trans.sheet"));
+
+  Init((const u32*)buf, w, h);
+
+  END_INIT_SEQUENCE();
+}
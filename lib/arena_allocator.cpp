@@ -1,48 +1,338 @@
 #include "arena_allocator.hpp"
 #include "utils.hpp"
+#include "error.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 using namespace world;
 
-//------------------------------------------------------------------------------
-ArenaAllocator::ArenaAllocator()
+namespace
 {
-  InitializeCriticalSection(&_cs);
+  //------------------------------------------------------------------------------
+  u8* ReserveAddressSpace(u32 size)
+  {
+#ifdef _WIN32
+    return (u8*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* mem = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return mem == MAP_FAILED ? nullptr : (u8*)mem;
+#endif
+  }
+
+  //------------------------------------------------------------------------------
+  void ReleaseAddressSpace(u8* mem, u32 size)
+  {
+#ifdef _WIN32
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, size);
+#endif
+  }
+
+  //------------------------------------------------------------------------------
+  bool CommitPages(u8* mem, u32 size)
+  {
+#ifdef _WIN32
+    return VirtualAlloc(mem, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(mem, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+  }
+
+  //------------------------------------------------------------------------------
+  void DecommitPages(u8* mem, u32 size)
+  {
+#ifdef _WIN32
+    VirtualFree(mem, size, MEM_DECOMMIT);
+#else
+    // mapping over the range drops the backing pages, and makes it inaccessible again
+    mmap(mem, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+  }
+
+  //------------------------------------------------------------------------------
+  u32 RoundUp(u32 value, u32 granularity)
+  {
+    return (value + granularity - 1) & ~(granularity - 1);
+  }
+
+  struct ThreadBlock
+  {
+    const ArenaAllocator* owner = nullptr;
+    u32 generation = 0;
+    uintptr_t cur = 0;
+    uintptr_t end = 0;
+  };
+
+  thread_local ThreadBlock t_block;
 }
 
 //------------------------------------------------------------------------------
 ArenaAllocator::~ArenaAllocator()
 {
-  DeleteCriticalSection(&_cs);
+  Release();
 }
 
 //------------------------------------------------------------------------------
 bool ArenaAllocator::Init(void* start, void* end)
 {
+  Release();
   _mem = (u8*)start;
   _capacity = (u32)((u8*)end - _mem);
+  _ends = PackEnds(0, _capacity);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ArenaAllocator::InitVirtual(u32 reserveSize, u32 keepCommitted)
+{
+  Release();
+
+  u32 capacity = RoundUp(reserveSize, COMMIT_GRANULARITY);
+  if (capacity < reserveSize)
+    return false;
+
+  _mem = ReserveAddressSpace(capacity);
+  if (!_mem)
+  {
+    LOG_ERROR("Unable to reserve arena address space: ", reserveSize);
+    return false;
+  }
+
+  _virtual = true;
+  _capacity = capacity;
+  _keepCommitted = min(RoundUp(keepCommitted, COMMIT_GRANULARITY), capacity / 2);
+  _committed = 0;
+  _topCommitted = capacity;
+  _ends = PackEnds(0, capacity);
+  _peakBottom = 0;
+  _peakTop = capacity;
+  _frameCount = 0;
   return true;
 }
 
+//------------------------------------------------------------------------------
+void ArenaAllocator::Release()
+{
+  if (_virtual && _mem)
+    ReleaseAddressSpace(_mem, _capacity);
+
+  _mem = nullptr;
+  _virtual = false;
+  _capacity = 0;
+  _committed = 0;
+  _topCommitted = 0;
+  _ends = 0;
+  _peakBottom = 0;
+  _peakTop = 0;
+  _frameCount = 0;
+  _generation.fetch_add(1, std::memory_order_release);
+}
+
 //------------------------------------------------------------------------------
 void ArenaAllocator::NewFrame()
 {
-  _idx = 0;
+  NoteUsage();
+  _ends.store(PackEnds(0, _capacity), std::memory_order_relaxed);
+  _generation.fetch_add(1, std::memory_order_release);
+
+  if (_virtual)
+    Decommit();
+}
+
+//------------------------------------------------------------------------------
+bool ArenaAllocator::CommitBottom(u32 end)
+{
+  std::lock_guard<std::mutex> lock(_commitMutex);
+
+  // another thread might have committed the range while we were waiting
+  u32 committed = _committed.load(std::memory_order_relaxed);
+  if (end <= committed)
+    return true;
+
+  // the range can overlap the pages committed for the top, which is fine, as committing
+  // already committed pages is a no-op
+  u32 newCommitted = min(RoundUp(end, COMMIT_GRANULARITY), _capacity);
+  if (!CommitPages(_mem + committed, newCommitted - committed))
+  {
+    LOG_WARN("Unable to commit arena memory: ", newCommitted);
+    return false;
+  }
+
+  _committed.store(newCommitted, std::memory_order_release);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ArenaAllocator::CommitTop(u32 start)
+{
+  std::lock_guard<std::mutex> lock(_commitMutex);
+
+  u32 committed = _topCommitted.load(std::memory_order_relaxed);
+  if (start >= committed)
+    return true;
+
+  u32 newCommitted = start & ~(COMMIT_GRANULARITY - 1);
+  if (!CommitPages(_mem + newCommitted, committed - newCommitted))
+  {
+    LOG_WARN("Unable to commit arena memory: ", _capacity - newCommitted);
+    return false;
+  }
+
+  _topCommitted.store(newCommitted, std::memory_order_release);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+u32 ArenaAllocator::Committed() const
+{
+  if (!_virtual)
+    return _capacity;
+
+  // the bottom can commit pages in the top's range, and the other way around, so the
+  // ranges can overlap
+  u32 bottom = _committed.load(std::memory_order_relaxed);
+  u32 top = _topCommitted.load(std::memory_order_relaxed);
+  return bottom >= top ? _capacity : bottom + (_capacity - top);
+}
+
+//------------------------------------------------------------------------------
+void ArenaAllocator::NoteUsage()
+{
+  u64 ends = _ends.load(std::memory_order_relaxed);
+  _peakBottom = max(_peakBottom, Bottom(ends));
+  _peakTop = min(_peakTop, Top(ends));
+}
+
+//------------------------------------------------------------------------------
+void ArenaAllocator::Decommit()
+{
+  if (++_frameCount < QUIET_FRAMES)
+    return;
+
+  // keep what each end has used since the last decommit, and at least the first and last
+  // 'keepCommitted' bytes, and release everything in between. Both ends can have
+  // committed pages inside the other's range, so the two ranges to decommit are clamped
+  // to the kept ranges.
+  u32 committed = _committed.load(std::memory_order_relaxed);
+  u32 keepBottom = min(max(_keepCommitted, RoundUp(_peakBottom, COMMIT_GRANULARITY)), _capacity);
+  u32 keepTop = min(_capacity - _keepCommitted, _peakTop & ~(COMMIT_GRANULARITY - 1));
+  _frameCount = 0;
+  _peakBottom = 0;
+  _peakTop = _capacity;
+
+  if (committed > keepBottom)
+  {
+    u32 end = min(committed, keepTop);
+    if (end > keepBottom)
+      DecommitPages(_mem + keepBottom, end - keepBottom);
+    _committed.store(keepBottom, std::memory_order_relaxed);
+  }
+
+  u32 topCommitted = _topCommitted.load(std::memory_order_relaxed);
+  if (topCommitted < keepTop)
+  {
+    u32 start = max(topCommitted, keepBottom);
+    if (start < keepTop)
+      DecommitPages(_mem + start, keepTop - start);
+    _topCommitted.store(keepTop, std::memory_order_relaxed);
+  }
 }
 
 //------------------------------------------------------------------------------
 void* ArenaAllocator::Alloc(u32 size, u32 alignment)
 {
-  ScopedCriticalSection cs(&_cs);
+  // The bottom only moves if the whole allocation fits, so a failed allocation leaves
+  // the arena as it was. The pages are committed before the CAS, so the memory is there
+  // as soon as another thread can see the new bottom.
+  uintptr_t mask = alignment - 1;
+  u64 ends = _ends.load(std::memory_order_relaxed);
+  while (true)
+  {
+    uintptr_t res = ((uintptr_t)_mem + Bottom(ends) + mask) & ~mask;
+    u64 end = (u64)(res - (uintptr_t)_mem) + size;
+    if (end > Top(ends))
+      return nullptr;
+
+    if (_virtual && end > _committed.load(std::memory_order_acquire) && !CommitBottom((u32)end))
+      return nullptr;
+
+    if (_ends.compare_exchange_weak(
+            ends, PackEnds((u32)end, Top(ends)), std::memory_order_relaxed))
+      return (void*)res;
+  }
+}
+
+//------------------------------------------------------------------------------
+void* ArenaAllocator::AllocTop(u32 size, u32 alignment)
+{
+  uintptr_t mask = alignment - 1;
+  u64 ends = _ends.load(std::memory_order_relaxed);
+  while (true)
+  {
+    uintptr_t bottom = (uintptr_t)_mem + Bottom(ends);
+    uintptr_t top = (uintptr_t)_mem + Top(ends);
+    if (top - bottom < size)
+      return nullptr;
+
+    uintptr_t res = (top - size) & ~mask;
+    if (res < bottom)
+      return nullptr;
+
+    u32 newTop = (u32)(res - (uintptr_t)_mem);
+    if (_virtual && newTop < _topCommitted.load(std::memory_order_acquire) && !CommitTop(newTop))
+      return nullptr;
+
+    if (_ends.compare_exchange_weak(
+            ends, PackEnds(Bottom(ends), newTop), std::memory_order_relaxed))
+      return (void*)res;
+  }
+}
+
+//------------------------------------------------------------------------------
+ArenaMark ArenaAllocator::Mark() const
+{
+  u64 ends = _ends.load(std::memory_order_relaxed);
+  return ArenaMark{Bottom(ends), Top(ends)};
+}
+
+//------------------------------------------------------------------------------
+void ArenaAllocator::Rewind(const ArenaMark& mark)
+{
+  assert(mark.bottom <= Mark().bottom && mark.top >= Mark().top);
+  NoteUsage();
+  _ends.store(PackEnds(mark.bottom, mark.top), std::memory_order_relaxed);
+
+  // any per-thread blocks could be in the rewound range
+  _generation.fetch_add(1, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void* ArenaAllocator::AllocThreadLocal(u32 size, u32 alignment)
+{
+  if (size > THREAD_BLOCK_SIZE / 4)
+    return Alloc(size, alignment);
+
+  ThreadBlock& block = t_block;
+  u32 generation = _generation.load(std::memory_order_acquire);
+  uintptr_t mask = alignment - 1;
+  uintptr_t res = (block.cur + mask) & ~mask;
 
-  // Calc padding needed for requested alignment
-  u32 mask = alignment - 1;
-  u32 padding = (alignment - (_idx & mask)) & mask;
+  if (block.owner != this || block.generation != generation || res + size > block.end)
+  {
+    u8* mem = (u8*)Alloc(THREAD_BLOCK_SIZE, 16);
+    if (!mem)
+      return nullptr;
 
-  u32 alignedSize = size + padding;
-  if (alignedSize + _idx > _capacity)
-    return nullptr;
+    block.owner = this;
+    block.generation = generation;
+    block.cur = (uintptr_t)mem;
+    block.end = (uintptr_t)mem + THREAD_BLOCK_SIZE;
+    res = (block.cur + mask) & ~mask;
+  }
 
-  u8* res = _mem + _idx + padding;
-  _idx += alignedSize;
-  return res;
+  block.cur = res + size;
+  return (void*)res;
 }
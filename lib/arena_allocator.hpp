@@ -1,17 +1,50 @@
 #pragma once
+#include "utils.hpp"
+#include <mutex>
 
 namespace world
 {
   //------------------------------------------------------------------------------
+  struct ArenaMark
+  {
+    u32 bottom;
+    u32 top;
+  };
+
+  //------------------------------------------------------------------------------
+  // Bump allocator. Alloc and AllocTop are lock free, and safe to call from any thread,
+  // but NewFrame and Rewind must not race with any allocations.
+  //
+  // The arena is double ended: Alloc grows from the bottom, and is meant for data that
+  // lives for the frame, while AllocTop grows down from the top, and is meant for
+  // temporaries that are released with Rewind (or a ScopedArena). Both ends are packed
+  // into a single atomic, so an allocation at either end only succeeds if it doesn't
+  // cross the other end.
+  //
+  // InitVirtual reserves address space instead of using a caller supplied range. Pages
+  // are committed as either end of the arena grows into them. Every QUIET_FRAMES calls
+  // to NewFrame, the pages past what either end has used in that time, and past
+  // 'keepCommitted' bytes, are decommitted. An arena can be sized for the worst case,
+  // and only pay for what is actually used, without committing and decommitting the
+  // same pages every frame.
   class ArenaAllocator
   {
   public:
-    ArenaAllocator();
     ~ArenaAllocator();
 
     bool Init(void* start, void* end);
+    bool InitVirtual(u32 reserveSize, u32 keepCommitted = 0);
+    void Release();
+
     void NewFrame();
     void* Alloc(u32 size, u32 alignment = 16);
+    void* AllocTop(u32 size, u32 alignment = 16);
+
+    template<typename T> T* AllocTop(u32 count, u32 alignment = 16)
+    {
+      return (T*)AllocTop(count * sizeof(T), alignment);
+    }
+
     template<typename T> T* Alloc(u32 count, u32 alignment = 16)
     {
       return (T*)Alloc(count * sizeof(T), alignment);
@@ -25,14 +58,83 @@ namespace world
       return mem;
     }
 
+    // Allocates from a per-thread block carved out of the arena, so threads doing lots
+    // of small allocations don't contend on the shared bump pointer. Large allocations
+    // go directly to the arena. Each thread caches a block for a single arena at a time.
+    void* AllocThreadLocal(u32 size, u32 alignment = 16);
+
+    ArenaMark Mark() const;
+    void Rewind(const ArenaMark& mark);
+
+    u32 Used() const
+    {
+      u64 ends = _ends.load(std::memory_order_relaxed);
+      return Bottom(ends) + (_capacity - Top(ends));
+    }
+    u32 Capacity() const { return _capacity; }
+    u8* Start() const { return _mem; }
+
+    // Bytes at the bottom of the arena that are backed by memory
+    u32 CommittedBottom() const
+    {
+      return _virtual ? _committed.load(std::memory_order_relaxed) : _capacity;
+    }
+
+    // Bytes of physical memory backing the arena. Same as the capacity for fixed arenas.
+    u32 Committed() const;
+
+    enum
+    {
+      THREAD_BLOCK_SIZE = 64 * 1024,
+      COMMIT_GRANULARITY = 64 * 1024,
+      // Number of NewFrames between looking for pages to decommit
+      QUIET_FRAMES = 120,
+    };
+
   private:
+    static u64 PackEnds(u32 bottom, u32 top) { return bottom | ((u64)top << 32); }
+    static u32 Bottom(u64 ends) { return (u32)ends; }
+    static u32 Top(u64 ends) { return (u32)(ends >> 32); }
+
+    bool CommitBottom(u32 end);
+    bool CommitTop(u32 start);
+    void NoteUsage();
+    void Decommit();
 
     u8* _mem = nullptr;
-    u32 _idx = 0;
     u32 _capacity = 0;
 
-    CRITICAL_SECTION _cs;
+    // the bottom end in the low 32 bits, and the top end in the high 32 bits
+    std::atomic<u64> _ends{0};
+
+    // only used for virtual arenas. [0, _committed) and [_topCommitted, _capacity) are
+    // backed by memory
+    bool _virtual = false;
+    u32 _keepCommitted = 0;
+    std::atomic<u32> _committed{0};
+    std::atomic<u32> _topCommitted{0};
+    std::mutex _commitMutex;
+
+    // how far each end has reached since the last decommit, sampled on Rewind and
+    // NewFrame, which are owner only
+    u32 _peakBottom = 0;
+    u32 _peakTop = 0;
+    u32 _frameCount = 0;
+
+    // bumped on NewFrame, to invalidate the per-thread blocks
+    std::atomic<u32> _generation{0};
   };
 
-  extern ArenaAllocator g_ScratchMemory;
+  //------------------------------------------------------------------------------
+  // Rewinds the arena to where it was on construction
+  struct ScopedArena
+  {
+    ScopedArena(ArenaAllocator& arena) : arena(arena), mark(arena.Mark()) {}
+    ~ScopedArena() { arena.Rewind(mark); }
+
+    ArenaAllocator& arena;
+    ArenaMark mark;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedArena);
+  };
 }
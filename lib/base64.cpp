@@ -0,0 +1,201 @@
+#include "base64.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WITH_BASE64_SSSE3 1
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows SSSE3 intrinsics in any function, but gcc and clang need the function to
+// be compiled for the target
+#if defined(_MSC_VER) || !defined(WITH_BASE64_SSSE3)
+#define TARGET_SSSE3
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+using namespace world;
+
+namespace
+{
+  // Decodes whole blocks of 16 characters, and returns the number of characters used.
+  // Stops early at a block with anything but base64 characters (including the padding),
+  // and leaves that to the scalar code
+  typedef size_t (*fnDecodeBlocks)(const char*, size_t, u8*);
+
+  const u8 INVALID_CHAR = 0xff;
+
+  //------------------------------------------------------------------------------
+  struct DecodeTable
+  {
+    DecodeTable()
+    {
+      const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+      memset(values, INVALID_CHAR, sizeof(values));
+      for (u8 i = 0; i < 64; ++i)
+        values[(u8)alphabet[i]] = i;
+    }
+
+    u8 values[256];
+  };
+
+  const DecodeTable g_DecodeTable;
+
+  //------------------------------------------------------------------------------
+  size_t DecodeBlocksNone(const char*, size_t, u8*)
+  {
+    return 0;
+  }
+
+#if WITH_BASE64_SSSE3
+  //------------------------------------------------------------------------------
+  // Classifies the characters by their high and low nibbles with two table lookups,
+  // where any bit set in both lookups means an invalid character. A third lookup on the
+  // high nibble gives the offset from the ascii code to the 6 bit value, and '/' is the
+  // only character that needs special casing. The 4 x 6 bits of each group are then
+  // merged with two multiply-adds, and a shuffle packs the 3 bytes per group together.
+  TARGET_SSSE3 size_t DecodeBlocksSsse3(const char* src, size_t len, u8* dst)
+  {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2f = _mm_set1_epi8(0x2f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    // every block stores 16 bytes, but only 12 of them are decoded data, so stop while
+    // there's still at least another 8 characters to cover the extra 4 bytes
+    size_t i = 0;
+    for (; i + 24 <= len; i += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask2f);
+      __m128i loNibbles = _mm_and_si128(v, mask2f);
+      __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+      __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)) != 0xffff)
+        break;
+
+      __m128i eq2f = _mm_cmpeq_epi8(v, mask2f);
+      __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2f, hiNibbles));
+      v = _mm_add_epi8(v, roll);
+
+      // 00aaaaaa 00bbbbbb -> 0000aaaa aabbbbbb, and then the pairs -> 24 bits per group
+      __m128i merged = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+      merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+      _mm_storeu_si128((__m128i*)(dst + i / 4 * 3), _mm_shuffle_epi8(merged, pack));
+    }
+
+    return i;
+  }
+
+  //------------------------------------------------------------------------------
+  bool CpuSupportsSsse3()
+  {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    // this runs during static initialization, so the cpu info might not be set up yet
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+  }
+#endif
+
+  //------------------------------------------------------------------------------
+  fnDecodeBlocks SelectKernel(const char** name)
+  {
+#if WITH_BASE64_SSSE3
+    if (CpuSupportsSsse3())
+    {
+      *name = "ssse3";
+      return DecodeBlocksSsse3;
+    }
+#endif
+    *name = "scalar";
+    return DecodeBlocksNone;
+  }
+
+  const char* g_KernelName = nullptr;
+  fnDecodeBlocks g_Kernel = SelectKernel(&g_KernelName);
+}
+
+//------------------------------------------------------------------------------
+bool world::Base64DecodeScalar(const char* src, size_t len, u8* dst, size_t* dstLen)
+{
+  const u8* values = g_DecodeTable.values;
+
+  // the padding is only allowed to complete the last group
+  if (len >= 4 && len % 4 == 0 && src[len - 1] == '=')
+  {
+    --len;
+    if (src[len - 1] == '=')
+      --len;
+  }
+
+  if (len % 4 == 1)
+    return false;
+
+  u8* out = dst;
+  size_t i = 0;
+  for (; i + 4 <= len; i += 4)
+  {
+    u32 a = values[(u8)src[i + 0]];
+    u32 b = values[(u8)src[i + 1]];
+    u32 c = values[(u8)src[i + 2]];
+    u32 d = values[(u8)src[i + 3]];
+    if ((a | b | c | d) == INVALID_CHAR)
+      return false;
+
+    u32 v = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = (u8)(v >> 16);
+    out[1] = (u8)(v >> 8);
+    out[2] = (u8)v;
+    out += 3;
+  }
+
+  // a partial group of 2 or 3 characters gives 1 or 2 bytes
+  size_t rest = len - i;
+  if (rest > 0)
+  {
+    u32 a = values[(u8)src[i + 0]];
+    u32 b = values[(u8)src[i + 1]];
+    u32 c = rest == 3 ? values[(u8)src[i + 2]] : 0;
+    if ((a | b | c) == INVALID_CHAR)
+      return false;
+
+    u32 v = (a << 18) | (b << 12) | (c << 6);
+    *out++ = (u8)(v >> 16);
+    if (rest == 3)
+      *out++ = (u8)(v >> 8);
+  }
+
+  *dstLen = out - dst;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool world::Base64Decode(const char* src, size_t len, u8* dst, size_t* dstLen)
+{
+  size_t numChars = g_Kernel(src, len, dst);
+  size_t numBytes = numChars / 4 * 3;
+
+  size_t tailLen;
+  if (!Base64DecodeScalar(src + numChars, len - numChars, dst + numBytes, &tailLen))
+    return false;
+
+  *dstLen = numBytes + tailLen;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+const char* world::Base64KernelName()
+{
+  return g_KernelName;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Upper bound of the decoded size of 'len' base64 characters
+  inline size_t Base64DecodedSize(size_t len)
+  {
+    return (len + 3) / 4 * 3;
+  }
+
+  //------------------------------------------------------------------------------
+  // Decodes standard base64 (with '+' and '/'), where the '=' padding is optional. 'dst'
+  // needs room for Base64DecodedSize(len) bytes, and 'dstLen' is set to the actual
+  // decoded size. Returns false on invalid input, including any whitespace.
+  //
+  // Base64Decode uses an SSSE3 kernel when the cpu supports it, that decodes 16
+  // characters at a time, and Base64DecodeScalar is the reference implementation.
+  bool Base64Decode(const char* src, size_t len, u8* dst, size_t* dstLen);
+  bool Base64DecodeScalar(const char* src, size_t len, u8* dst, size_t* dstLen);
+
+  const char* Base64KernelName();
+}
@@ -109,11 +109,19 @@ void LogSinkConsole::Log(const LogEntry& entry)
     // create clickable console prefix
     char buf[1024];
     sprintf(buf, "%s(%d): ", entry.file, entry.line);
+#ifdef _WIN32
     OutputDebugStringA(buf);
+#else
+    fputs(buf, stderr);
+#endif
   }
 
+#ifdef _WIN32
   OutputDebugStringA(entry.msg);
   OutputDebugStringA("\n");
+#else
+  fprintf(stderr, "%s\n", entry.msg);
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -144,10 +152,12 @@ LogStream::~LogStream()
   for (LogSink* sink : g_logSinks)
     sink->Log(entry);
 
+#ifdef _WIN32
   if (_level == LogLevelError && g_breakOnError)
   {
     DebugBreak();
   }
+#endif
 
 }
 
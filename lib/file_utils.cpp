@@ -1,5 +1,6 @@
 #include "file_utils.hpp"
 #include "utils.hpp"
+#include "arena_allocator.hpp"
 
 #include <sys/stat.h>
 #ifdef _WIN32
@@ -45,6 +46,29 @@ namespace world
 #endif
   }
 
+  //------------------------------------------------------------------------------
+  bool LoadFile(const char* filename, ArenaAllocator* arena, char** buf, u32* len)
+  {
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+      return false;
+
+    DEFER([=]() {
+      fclose(f);
+    });
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    *buf = arena->AllocTop<char>((u32)size, 1);
+    if (!*buf)
+      return false;
+
+    *len = (u32)size;
+    return fread(*buf, 1, size, f) == (size_t)size;
+  }
+
   //------------------------------------------------------------------------------
   bool FileExists(const char* filename)
   {
@@ -78,7 +102,7 @@ namespace world
       fclose(f);
     });
 
-    return fwrite(buf, len, 1, f) == len;
+    return fwrite(buf, 1, len, f) == (size_t)len;
   }
 
   //------------------------------------------------------------------------------
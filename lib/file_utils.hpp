@@ -2,7 +2,11 @@
 
 namespace world
 {
+  class ArenaAllocator;
+
   bool LoadFile(const char* filename, std::vector<char>* buf);
+  // Loads the file into memory allocated from the top of the arena
+  bool LoadFile(const char* filename, ArenaAllocator* arena, char** buf, u32* len);
   bool SaveFile(const char* filename, const void* buf, int len);
   bool FileExists(const char* filename);
   bool DirectoryExists(const char *name);
@@ -0,0 +1,54 @@
+#include "fixed_timestep.hpp"
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+FixedTimestep::FixedTimestep(double stepSize, int maxSteps)
+  : _stepSize(stepSize)
+  , _maxSteps(maxSteps)
+{
+}
+
+//------------------------------------------------------------------------------
+void FixedTimestep::Reset()
+{
+  _acc = 0;
+  _stats = Stats();
+}
+
+//------------------------------------------------------------------------------
+int FixedTimestep::Advance(double frameTime)
+{
+  // the clock can go backwards when switching cores on some machines
+  frameTime = max(0.0, frameTime);
+
+  _acc += frameTime;
+  double numSteps = floor(_acc / _stepSize);
+  _acc -= numSteps * _stepSize;
+
+  // float precision can leave the remainder a hair outside of [0, step)
+  if (_acc < 0)
+    _acc = 0;
+  else if (_acc >= _stepSize)
+    _acc = nextafter(_stepSize, 0.0);
+
+  _stats.frameTime = frameTime;
+  _stats.numFrames++;
+  if (numSteps > _maxSteps)
+  {
+    _stats.droppedTime += (numSteps - _maxSteps) * _stepSize;
+    _stats.numClampedFrames++;
+    numSteps = _maxSteps;
+  }
+
+  _stats.numSteps = (int)numSteps;
+  return _stats.numSteps;
+}
+
+//------------------------------------------------------------------------------
+float FixedTimestep::Alpha() const
+{
+  // a remainder just below the step size rounds up to 1 as a float
+  float alpha = (float)(_acc / _stepSize);
+  return alpha < 1 ? alpha : nextafterf(1, 0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Fixed step scheduler. The frame times are accumulated, and Advance returns how many
+  // whole steps to simulate for the frame. The number of steps per frame is clamped, and
+  // any time past the clamp is dropped, so a long frame slows the simulation down rather
+  // than making the next frames even longer catching up.
+  //
+  // The remainder left in the accumulator is exposed as Alpha, for interpolating between
+  // the previous and current simulation states at render time. Nothing in here reads the
+  // clock, so it can be driven by recorded or synthetic frame times.
+  class FixedTimestep
+  {
+  public:
+    FixedTimestep(double stepSize = 1.0 / 60, int maxSteps = 5);
+
+    void Reset();
+
+    // Adds the frame's time, in seconds, and returns the number of steps to run
+    int Advance(double frameTime);
+
+    // How far, in [0, 1), the current time is past the last step
+    float Alpha() const;
+    double StepSize() const { return _stepSize; }
+
+    struct Stats
+    {
+      double frameTime = 0;
+      int numSteps = 0;
+      // totals since the last reset
+      u32 numFrames = 0;
+      u32 numClampedFrames = 0;
+      double droppedTime = 0;
+    };
+
+    const Stats& GetStats() const { return _stats; }
+
+  private:
+    double _stepSize;
+    int _maxSteps;
+    double _acc = 0;
+    Stats _stats;
+  };
+}
@@ -0,0 +1,147 @@
+#include "frame_allocator.hpp"
+
+using namespace world;
+
+FrameAllocator world::g_ScratchMemory;
+
+//------------------------------------------------------------------------------
+bool FrameAllocator::Init(void* start, void* end, int numFrames)
+{
+  if (numFrames < 1 || numFrames > MAX_FRAMES)
+    return false;
+
+  _numFrames = numFrames;
+  _frame = 0;
+
+  // split the range evenly between the frames
+  u32 frameSize = (u32)(((u8*)end - (u8*)start) / numFrames);
+  u8* cur = (u8*)start;
+  for (int i = 0; i < numFrames; ++i)
+  {
+    _arenas[i].Init(cur, cur + frameSize);
+    cur += frameSize;
+  }
+
+  _stats = Stats();
+  _stats.frameCapacity = frameSize;
+  _stats.committed = frameSize * numFrames;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool FrameAllocator::InitVirtual(u32 reservePerFrame, u32 keepCommitted, int numFrames)
+{
+  if (numFrames < 1 || numFrames > MAX_FRAMES)
+    return false;
+
+  _numFrames = numFrames;
+  _frame = 0;
+
+  for (int i = 0; i < numFrames; ++i)
+  {
+    if (!_arenas[i].InitVirtual(reservePerFrame, keepCommitted))
+      return false;
+  }
+
+  _stats = Stats();
+  _stats.frameCapacity = _arenas[0].Capacity();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void FrameAllocator::NewFrame()
+{
+  u32 used = Cur().Used();
+  _stats.lastFrameUsage = used;
+  _stats.peakFrameUsage = max(_stats.peakFrameUsage, used);
+
+  ++_frame;
+
+  // the arena we're about to reuse was last used 'numFrames' frames ago
+  ArenaAllocator& arena = Cur();
+#if WITH_SCRATCH_MEMORY_CHECKS
+  // only the bottom is poisoned, as any top allocations should be rewound by now, and
+  // only as far as it's backed by memory
+  memset(arena.Start(), POISON_BYTE, min(arena.Mark().bottom, arena.CommittedBottom()));
+#endif
+  arena.NewFrame();
+
+  u32 committed = 0;
+  for (int i = 0; i < _numFrames; ++i)
+    committed += _arenas[i].Committed();
+  _stats.committed = committed;
+}
+
+//------------------------------------------------------------------------------
+void* FrameAllocator::Alloc(u32 size, u32 alignment)
+{
+  if (!_numFrames)
+    return nullptr;
+
+#if WITH_SCRATCH_MEMORY_CHECKS
+  // pad the header to the alignment, so the returned pointer stays aligned
+  u32 headerSize = max((u32)sizeof(AllocHeader), alignment);
+  u8* mem = (u8*)Cur().Alloc(size + headerSize, alignment);
+  if (!mem)
+    return nullptr;
+
+  AllocHeader* header = (AllocHeader*)(mem + headerSize - sizeof(AllocHeader));
+  header->magic = ALLOC_MAGIC;
+  header->size = size;
+  header->frame = _frame;
+  return mem + headerSize;
+#else
+  return Cur().Alloc(size, alignment);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void* FrameAllocator::AllocThreadLocal(u32 size, u32 alignment)
+{
+  return _numFrames ? Cur().AllocThreadLocal(size, alignment) : nullptr;
+}
+
+//------------------------------------------------------------------------------
+const ArenaAllocator* FrameAllocator::FindArena(const void* ptr) const
+{
+  for (int i = 0; i < _numFrames; ++i)
+  {
+    const ArenaAllocator& arena = _arenas[i];
+    if (ptr >= arena.Start() + sizeof(AllocHeader) && ptr < arena.Start() + arena.Capacity())
+      return &arena;
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool FrameAllocator::IsAlive(const void* ptr) const
+{
+#if WITH_SCRATCH_MEMORY_CHECKS
+  const ArenaAllocator* arena = FindArena(ptr);
+  if (!arena)
+    return true;
+
+  // pointers between the two ends are in memory that has been released, and the top
+  // allocations don't have a header, so they can't be checked
+  ArenaMark mark = arena->Mark();
+  const u8* p = (const u8*)ptr;
+  if (p >= arena->Start() + mark.top)
+    return true;
+  if (p > arena->Start() + mark.bottom)
+    return false;
+
+  const AllocHeader* header = (const AllocHeader*)ptr - 1;
+  return header->magic == ALLOC_MAGIC && header->frame + _numFrames > _frame;
+#else
+  (void)ptr;
+  return true;
+#endif
+}
+
+//------------------------------------------------------------------------------
+void FrameAllocator::CheckAlive(const void* ptr) const
+{
+  // nb: the assert compiles away with NDEBUG
+  assert(IsAlive(ptr) && "Scratch pointer is stale, or has been recycled");
+  (void)ptr;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "arena_allocator.hpp"
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Ring of per-frame arenas. Memory allocated on frame N stays valid until the arena is
+  // reused on frame N + numFrames, so render data can outlive the frame that submitted it
+  // until the GPU has consumed it.
+  //
+  // With WITH_SCRATCH_MEMORY_CHECKS, each allocation is prefixed with a header holding
+  // the frame it was allocated on, and arenas are poisoned when reused, so CheckAlive can
+  // catch stale pointers. The submission paths check the buffers they're handed, which
+  // can come from the ring or from anywhere else.
+  class FrameAllocator
+  {
+  public:
+    enum { MAX_FRAMES = 8 };
+
+    bool Init(void* start, void* end, int numFrames = 3);
+    // Backs each frame's arena with 'reservePerFrame' bytes of reserved address space,
+    // see ArenaAllocator::InitVirtual
+    bool InitVirtual(u32 reservePerFrame, u32 keepCommitted, int numFrames = 3);
+    void NewFrame();
+
+    void* Alloc(u32 size, u32 alignment = 16);
+    template<typename T> T* Alloc(u32 count, u32 alignment = 16)
+    {
+      return (T*)Alloc(count * sizeof(T), alignment);
+    }
+
+    template<typename T> T* New(u32 count, u32 alignment = 16)
+    {
+      T* mem = (T*)Alloc(count * sizeof(T), alignment);
+      for (u32 i = 0; i < count; ++i)
+        new(mem + i)T();
+      return mem;
+    }
+
+    // nb: thread local allocations don't get a header, so they can't be checked
+    void* AllocThreadLocal(u32 size, u32 alignment = 16);
+
+    // False if 'ptr' was allocated from the bottom of one of the ring's arenas, and the
+    // arena has been recycled since. Pointers from outside the ring are always alive.
+    // Only checks anything with WITH_SCRATCH_MEMORY_CHECKS.
+    bool IsAlive(const void* ptr) const;
+    // Asserts IsAlive
+    void CheckAlive(const void* ptr) const;
+
+    // The current frame's arena. Useful for temporaries allocated from the top, and
+    // released with a ScopedArena.
+    ArenaAllocator& Arena() { return Cur(); }
+
+    u64 Frame() const { return _frame; }
+    int NumFrames() const { return _numFrames; }
+
+    struct Stats
+    {
+      u32 lastFrameUsage = 0;
+      u32 peakFrameUsage = 0;
+      u32 frameCapacity = 0;
+      // physical memory used by all the frames
+      u32 committed = 0;
+    };
+
+    const Stats& GetStats() const { return _stats; }
+
+  private:
+    enum
+    {
+      ALLOC_MAGIC = 0x5c7a7c4d,
+      POISON_BYTE = 0xdd,
+    };
+
+    struct AllocHeader
+    {
+      u32 magic;
+      u32 size;
+      u64 frame;
+    };
+
+    ArenaAllocator& Cur() { return _arenas[_frame % _numFrames]; }
+    const ArenaAllocator* FindArena(const void* ptr) const;
+
+    ArenaAllocator _arenas[MAX_FRAMES];
+    int _numFrames = 0;
+    u64 _frame = 0;
+    Stats _stats;
+  };
+
+  extern FrameAllocator g_ScratchMemory;
+}
@@ -0,0 +1,82 @@
+#include "inflate.hpp"
+
+using namespace world;
+
+namespace
+{
+  // gzip header flags
+  enum
+  {
+    GZIP_FHCRC = 1 << 1,
+    GZIP_FEXTRA = 1 << 2,
+    GZIP_FNAME = 1 << 3,
+    GZIP_FCOMMENT = 1 << 4,
+  };
+
+  //------------------------------------------------------------------------------
+  bool SkipZeroTerminated(const u8* src, size_t srcLen, size_t* ofs)
+  {
+    while (*ofs < srcLen && src[*ofs] != 0)
+      ++*ofs;
+
+    if (*ofs == srcLen)
+      return false;
+    ++*ofs;
+    return true;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool world::ZlibInflate(const u8* src, size_t srcLen, u8* dst, size_t dstLen)
+{
+  if (srcLen > INT_MAX || dstLen > INT_MAX)
+    return false;
+
+  // stb_image has a complete inflate for the png loader
+  int res = stbi_zlib_decode_buffer((char*)dst, (int)dstLen, (const char*)src, (int)srcLen);
+  return res == (int)dstLen;
+}
+
+//------------------------------------------------------------------------------
+bool world::GzipInflate(const u8* src, size_t srcLen, u8* dst, size_t dstLen)
+{
+  // a gzip file is a header, the raw deflate stream, and a crc32 and the size as a
+  // trailer
+  if (srcLen < 18 || srcLen > INT_MAX || dstLen > INT_MAX)
+    return false;
+
+  if (src[0] != 0x1f || src[1] != 0x8b || src[2] != 8)
+    return false;
+
+  u8 flags = src[3];
+  size_t ofs = 10;
+
+  if (flags & GZIP_FEXTRA)
+  {
+    if (ofs + 2 > srcLen)
+      return false;
+    ofs += 2 + (src[ofs] | (src[ofs + 1] << 8));
+  }
+
+  if ((flags & GZIP_FNAME) && !SkipZeroTerminated(src, srcLen, &ofs))
+    return false;
+
+  if ((flags & GZIP_FCOMMENT) && !SkipZeroTerminated(src, srcLen, &ofs))
+    return false;
+
+  if (flags & GZIP_FHCRC)
+    ofs += 2;
+
+  if (ofs + 8 > srcLen)
+    return false;
+
+  // the size in the trailer is mod 2^32
+  const u8* trailer = src + srcLen - 4;
+  u32 size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((u32)trailer[3] << 24);
+  if (size != (u32)dstLen)
+    return false;
+
+  int res = stbi_zlib_decode_noheader_buffer(
+      (char*)dst, (int)dstLen, (const char*)src + ofs, (int)(srcLen - ofs - 8));
+  return res == (int)dstLen;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Inflates zlib or gzip compressed data into 'dst'. Both fail unless the data expands
+  // to exactly 'dstLen' bytes, which is what's needed for data with a known size, like
+  // tile layers. The checksums aren't verified.
+  bool ZlibInflate(const u8* src, size_t srcLen, u8* dst, size_t dstLen);
+  bool GzipInflate(const u8* src, size_t srcLen, u8* dst, size_t dstLen);
+}
@@ -1,11 +1,12 @@
 #pragma once
+#include <stdexcept>
 namespace world
 {
   namespace parser
   {
-    struct ParseException : std::exception
+    struct ParseException : std::runtime_error
     {
-      ParseException(const char* e) : std::exception(e) {}
+      ParseException(const char* e) : std::runtime_error(e) {}
     };
 
 #define SET_PARSER_SUCCESS(s)                                                                      \
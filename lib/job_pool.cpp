@@ -0,0 +1,102 @@
+#include "job_pool.hpp"
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+JobPool::~JobPool()
+{
+  Close();
+}
+
+//------------------------------------------------------------------------------
+bool JobPool::Init(int numWorkers)
+{
+  Close();
+
+  _done = false;
+  for (int i = 0; i < numWorkers; ++i)
+    _workers.push_back(std::thread([this]() { WorkerThread(); }));
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void JobPool::Close()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done = true;
+  }
+  _wakeCv.notify_all();
+
+  for (std::thread& t : _workers)
+    t.join();
+  _workers.clear();
+}
+
+//------------------------------------------------------------------------------
+void JobPool::ParallelFor(u32 count, const function<void(u32)>& fn)
+{
+  if (_workers.empty() || count <= 1)
+  {
+    for (u32 i = 0; i < count; ++i)
+      fn(i);
+    return;
+  }
+
+  {
+    // workers that woke up late for the previous loop could still be looking at it
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCv.wait(lock, [this]() { return _active == 0; });
+
+    _fn = &fn;
+    _count = count;
+    _next.store(0, std::memory_order_relaxed);
+    _remaining.store(count, std::memory_order_relaxed);
+    _generation++;
+  }
+  _wakeCv.notify_all();
+
+  RunJobs();
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _doneCv.wait(lock, [this]() { return _remaining.load(std::memory_order_acquire) == 0; });
+}
+
+//------------------------------------------------------------------------------
+void JobPool::RunJobs()
+{
+  u32 idx;
+  while ((idx = _next.fetch_add(1, std::memory_order_relaxed)) < _count)
+  {
+    (*_fn)(idx);
+    if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _doneCv.notify_all();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void JobPool::WorkerThread()
+{
+  u32 generation = 0;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true)
+  {
+    _wakeCv.wait(lock, [&]() { return _done || _generation != generation; });
+    if (_done)
+      break;
+
+    generation = _generation;
+    _active++;
+    lock.unlock();
+
+    RunJobs();
+
+    lock.lock();
+    if (--_active == 0)
+      _doneCv.notify_all();
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Fixed set of worker threads for data parallel loops. ParallelFor hands out the
+  // indices through an atomic counter, and the calling thread works on the loop as well,
+  // so a pool without workers just runs the loop inline.
+  class JobPool
+  {
+  public:
+    ~JobPool();
+
+    bool Init(int numWorkers);
+    void Close();
+
+    // Calls fn(i) for every i in [0, count), and returns once all the calls are done.
+    // Should only be called from one thread at a time.
+    void ParallelFor(u32 count, const function<void(u32)>& fn);
+
+    int NumWorkers() const { return (int)_workers.size(); }
+
+  private:
+    void WorkerThread();
+    void RunJobs();
+
+    vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _wakeCv;
+    std::condition_variable _doneCv;
+    bool _done = false;
+
+    // the current loop. Only written when no workers are active
+    const function<void(u32)>* _fn = nullptr;
+    u32 _count = 0;
+    u32 _generation = 0;
+    int _active = 0;
+
+    std::atomic<u32> _next{0};
+    std::atomic<u32> _remaining{0};
+  };
+
+  extern JobPool g_JobPool;
+}
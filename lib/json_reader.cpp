@@ -0,0 +1,519 @@
+#include "json_reader.hpp"
+#include "utils.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WITH_JSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace world
+{
+  namespace parser
+  {
+    namespace
+    {
+      //-----------------------------------------------------------------------------
+      bool IsWhitespace(char ch)
+      {
+        return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+      }
+
+      //-----------------------------------------------------------------------------
+      bool IsDigit(char ch)
+      {
+        return (u8)(ch - '0') < 10;
+      }
+
+      //-----------------------------------------------------------------------------
+      // Converts up to 8 digits, with the first digit in the lowest byte, and 'len'
+      // being the number of digits. The digits are shifted up to the top of the word, so
+      // the bytes past the number drop out, and the zero bytes shifted in act as leading
+      // zeros. Then the digits are combined pairwise, in 3 multiplies.
+      u32 ParseDigitsSwar(u64 chunk, u32 len)
+      {
+        chunk = (chunk << (8 * (8 - len))) & 0x0f0f0f0f0f0f0f0full;
+        chunk = (chunk * (1 + (10 << 8))) >> 8;
+        chunk = ((chunk & 0x00ff00ff00ff00ffull) * (1 + (100 << 16))) >> 16;
+        chunk = ((chunk & 0x0000ffff0000ffffull) * (1 + (10000ull << 32))) >> 32;
+        return (u32)chunk;
+      }
+
+      //-----------------------------------------------------------------------------
+      // Length of the run of digits starting at 'p', looking at no more than 16 bytes
+      u32 DigitRunLength(const char* p, const char* end)
+      {
+#if WITH_JSON_SSE2
+        if (end - p >= 16)
+        {
+          // bytes - '0' as unsigned are < 10 for digits, and the signed compare after
+          // flipping the sign bit is the unsigned compare SSE2 doesn't have
+          __m128i v = _mm_loadu_si128((const __m128i*)p);
+          __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+          __m128i flipped = _mm_xor_si128(d, _mm_set1_epi8((char)0x80));
+          __m128i isDigit = _mm_cmplt_epi8(flipped, _mm_set1_epi8((char)(0x80 + 10)));
+          u32 nonDigits = ~(u32)_mm_movemask_epi8(isDigit) | 0x10000;
+#ifdef _MSC_VER
+          unsigned long idx;
+          _BitScanForward(&idx, nonDigits);
+          return (u32)idx;
+#else
+          return (u32)__builtin_ctz(nonDigits);
+#endif
+        }
+#endif
+        u32 len = 0;
+        while (len < 16 && p + len < end && IsDigit(p[len]))
+          ++len;
+        return len;
+      }
+
+      //-----------------------------------------------------------------------------
+      void AppendUtf8(u32 cp, string* out)
+      {
+        if (cp < 0x80)
+        {
+          out->push_back((char)cp);
+        }
+        else if (cp < 0x800)
+        {
+          out->push_back((char)(0xc0 | (cp >> 6)));
+          out->push_back((char)(0x80 | (cp & 0x3f)));
+        }
+        else if (cp < 0x10000)
+        {
+          out->push_back((char)(0xe0 | (cp >> 12)));
+          out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+          out->push_back((char)(0x80 | (cp & 0x3f)));
+        }
+        else
+        {
+          out->push_back((char)(0xf0 | (cp >> 18)));
+          out->push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+          out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+          out->push_back((char)(0x80 | (cp & 0x3f)));
+        }
+      }
+
+      //-----------------------------------------------------------------------------
+      bool ParseHex4(const char* p, u32* value)
+      {
+        u32 res = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+          char ch = p[i];
+          u32 digit;
+          if (ch >= '0' && ch <= '9')
+            digit = ch - '0';
+          else if (ch >= 'a' && ch <= 'f')
+            digit = ch - 'a' + 10;
+          else if (ch >= 'A' && ch <= 'F')
+            digit = ch - 'A' + 10;
+          else
+            return false;
+          res = res * 16 + digit;
+        }
+        *value = res;
+        return true;
+      }
+    }
+
+    //-----------------------------------------------------------------------------
+    JsonReader::JsonReader(InputBuffer& buf) : _buf(buf) {}
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::Fail()
+    {
+      _error = true;
+      return false;
+    }
+
+    //-----------------------------------------------------------------------------
+    void JsonReader::SkipWhitespace()
+    {
+      while (_buf._idx < _buf._len && IsWhitespace(_buf._buf[_buf._idx]))
+        _buf._idx++;
+    }
+
+    //-----------------------------------------------------------------------------
+    JsonReader::ValueType JsonReader::PeekType()
+    {
+      SkipWhitespace();
+      if (_error || _buf.Eof())
+        return ValueType::Invalid;
+
+      char ch = _buf._buf[_buf._idx];
+      switch (ch)
+      {
+        case '{': return ValueType::Object;
+        case '[': return ValueType::Array;
+        case '"': return ValueType::String;
+        case 't': case 'f': return ValueType::Bool;
+        case 'n': return ValueType::Null;
+      }
+
+      return (ch == '-' || IsDigit(ch)) ? ValueType::Number : ValueType::Invalid;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::BeginObject()
+    {
+      SkipWhitespace();
+      if (_error || !_buf.ConsumeIf('{'))
+        return Fail();
+
+      _afterOpen = true;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::BeginArray()
+    {
+      SkipWhitespace();
+      if (_error || !_buf.ConsumeIf('['))
+        return Fail();
+
+      _afterOpen = true;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::NextItem(char close)
+    {
+      bool first = exch(_afterOpen, false);
+      if (_error)
+        return false;
+
+      SkipWhitespace();
+      if (_buf.ConsumeIf(close))
+        return false;
+
+      if (!first)
+      {
+        if (!_buf.ConsumeIf(','))
+          return Fail();
+        SkipWhitespace();
+      }
+
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::NextKey(string* key)
+    {
+      if (!NextItem('}'))
+        return false;
+
+      if (!ReadString(key))
+        return false;
+
+      SkipWhitespace();
+      if (!_buf.ConsumeIf(':'))
+        return Fail();
+
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::NextElement()
+    {
+      return NextItem(']');
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::ReadString(string* value)
+    {
+      SkipWhitespace();
+      if (_error || !_buf.ConsumeIf('"'))
+        return Fail();
+
+      value->clear();
+      const char* buf = _buf._buf;
+      size_t idx = _buf._idx;
+      size_t len = _buf._len;
+      while (true)
+      {
+        // copy the runs between escapes in one go
+        size_t start = idx;
+        while (idx < len && buf[idx] != '"' && buf[idx] != '\\')
+          ++idx;
+        value->append(buf + start, idx - start);
+
+        if (idx == len)
+          return Fail();
+
+        if (buf[idx++] == '"')
+          break;
+
+        if (idx == len)
+          return Fail();
+
+        char ch = buf[idx++];
+        switch (ch)
+        {
+          case '"': value->push_back('"'); break;
+          case '\\': value->push_back('\\'); break;
+          case '/': value->push_back('/'); break;
+          case 'b': value->push_back('\b'); break;
+          case 'f': value->push_back('\f'); break;
+          case 'n': value->push_back('\n'); break;
+          case 'r': value->push_back('\r'); break;
+          case 't': value->push_back('\t'); break;
+          case 'u':
+          {
+            u32 cp;
+            if (idx + 4 > len || !ParseHex4(buf + idx, &cp))
+              return Fail();
+            idx += 4;
+
+            // combine surrogate pairs
+            if (cp >= 0xd800 && cp < 0xdc00)
+            {
+              u32 low;
+              if (idx + 6 > len || buf[idx] != '\\' || buf[idx + 1] != 'u'
+                  || !ParseHex4(buf + idx + 2, &low) || low < 0xdc00 || low >= 0xe000)
+                return Fail();
+              idx += 6;
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            AppendUtf8(cp, value);
+            break;
+          }
+          default: return Fail();
+        }
+      }
+
+      _buf._idx = idx;
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::ReadNumber(double* value)
+    {
+      SkipWhitespace();
+      if (_error)
+        return false;
+
+      // the buffer isn't zero terminated, so copy the number out for strtod
+      char tmp[64];
+      size_t len = 0;
+      while (_buf._idx < _buf._len && len < sizeof(tmp) - 1)
+      {
+        char ch = _buf._buf[_buf._idx];
+        if (!IsDigit(ch) && ch != '-' && ch != '+' && ch != '.' && ch != 'e' && ch != 'E')
+          break;
+        tmp[len++] = ch;
+        _buf._idx++;
+      }
+      tmp[len] = 0;
+
+      char* end;
+      *value = strtod(tmp, &end);
+      if (len == 0 || end != tmp + len)
+        return Fail();
+
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::ReadBool(bool* value)
+    {
+      SkipWhitespace();
+      if (_error)
+        return false;
+
+      const char* p = _buf._buf + _buf._idx;
+      size_t left = _buf._len - _buf._idx;
+      if (left >= 4 && memcmp(p, "true", 4) == 0)
+      {
+        *value = true;
+        _buf._idx += 4;
+        return true;
+      }
+
+      if (left >= 5 && memcmp(p, "false", 5) == 0)
+      {
+        *value = false;
+        _buf._idx += 5;
+        return true;
+      }
+
+      return Fail();
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::ReadString(const char** str, size_t* len, string* scratch)
+    {
+      SkipWhitespace();
+      if (_error || _buf.Eof() || _buf._buf[_buf._idx] != '"')
+        return Fail();
+
+      const char* start = _buf._buf + _buf._idx + 1;
+      const char* end = _buf._buf + _buf._len;
+      const char* quote = (const char*)memchr(start, '"', end - start);
+      if (quote && !memchr(start, '\\', quote - start))
+      {
+        *str = start;
+        *len = quote - start;
+        _buf._idx = quote + 1 - _buf._buf;
+        return true;
+      }
+
+      if (!ReadString(scratch))
+        return false;
+
+      *str = scratch->data();
+      *len = scratch->size();
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::SkipString()
+    {
+      // assumes the opening quote has been consumed
+      const char* buf = _buf._buf;
+      size_t idx = _buf._idx;
+      while (idx < _buf._len)
+      {
+        char ch = buf[idx++];
+        if (ch == '\\')
+          idx++;
+        else if (ch == '"')
+        {
+          _buf._idx = idx;
+          return true;
+        }
+      }
+
+      return Fail();
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::SkipValue()
+    {
+      SkipWhitespace();
+      if (_error || _buf.Eof())
+        return Fail();
+
+      // scalars end at the next delimiter. Containers are skipped by counting the
+      // nesting depth, and only strings need any care, as they can contain brackets
+      int depth = 0;
+      do
+      {
+        if (_buf.Eof())
+          return Fail();
+
+        char ch = _buf._buf[_buf._idx++];
+        if (ch == '"')
+        {
+          if (!SkipString())
+            return false;
+        }
+        else if (ch == '{' || ch == '[')
+        {
+          depth++;
+        }
+        else if (ch == '}' || ch == ']')
+        {
+          if (--depth < 0)
+            return Fail();
+        }
+        else if (depth == 0)
+        {
+          // scalar
+          while (!_buf.Eof())
+          {
+            char next = _buf._buf[_buf._idx];
+            if (next == ',' || next == '}' || next == ']' || IsWhitespace(next))
+              break;
+            _buf._idx++;
+          }
+        }
+      } while (depth > 0);
+
+      return true;
+    }
+
+    //-----------------------------------------------------------------------------
+    bool JsonReader::ReadU32Array(vector<u32>* out)
+    {
+      if (!BeginArray())
+        return false;
+      _afterOpen = false;
+
+      const char* buf = _buf._buf;
+      const char* p = buf + _buf._idx;
+      const char* end = buf + _buf._len;
+
+      auto skipWhitespace = [&]() {
+        while (p < end && IsWhitespace(*p))
+          ++p;
+      };
+
+      skipWhitespace();
+      if (p < end && *p == ']')
+      {
+        _buf._idx = p + 1 - buf;
+        return true;
+      }
+
+      while (true)
+      {
+        u32 len = DigitRunLength(p, end);
+        if (len == 0 || len > 10)
+          return Fail();
+
+        // the SWAR conversion reads 8 bytes, so the last few numbers in the buffer go
+        // through the scalar path
+        u64 value;
+        if (end - p >= 8 + (len > 8 ? len - 8 : 0))
+        {
+          u32 head = len > 8 ? len - 8 : 0;
+          u64 hi = 0;
+          for (u32 i = 0; i < head; ++i)
+            hi = hi * 10 + (p[i] - '0');
+
+          u64 chunk;
+          memcpy(&chunk, p + head, 8);
+          value = hi * 100000000 + ParseDigitsSwar(chunk, len - head);
+        }
+        else
+        {
+          value = 0;
+          for (u32 i = 0; i < len; ++i)
+            value = value * 10 + (p[i] - '0');
+        }
+
+        if (value > 0xffffffff)
+          return Fail();
+
+        out->push_back((u32)value);
+        p += len;
+
+        // the common case is the comma right after the number
+        if (p < end && *p == ',')
+        {
+          ++p;
+          skipWhitespace();
+          continue;
+        }
+
+        skipWhitespace();
+        if (p == end)
+          return Fail();
+
+        if (*p == ']')
+          break;
+
+        if (*p++ != ',')
+          return Fail();
+        skipWhitespace();
+      }
+
+      _buf._idx = p + 1 - buf;
+      return true;
+    }
+  }
+}
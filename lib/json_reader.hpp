@@ -0,0 +1,88 @@
+#pragma once
+#include "input_buffer.hpp"
+
+namespace world
+{
+  namespace parser
+  {
+    //-----------------------------------------------------------------------------
+    // Streaming pull parser for JSON. Instead of building a DOM, the caller walks the
+    // document, and reads the values it wants straight into its own data structures:
+    //
+    //  reader.BeginObject();
+    //  while (reader.NextKey(&key))
+    //  {
+    //    if (key == "width")
+    //      reader.ReadNumber(&width);
+    //    else
+    //      reader.SkipValue();
+    //  }
+    //
+    // Errors are sticky, so once something fails all the calls return false, and Ok
+    // can be checked at the end.
+    class JsonReader
+    {
+    public:
+      JsonReader(InputBuffer& buf);
+
+      bool BeginObject();
+      // Reads the next key of the current object, or returns false at the end of it
+      bool NextKey(string* key);
+
+      bool BeginArray();
+      // Returns true if the current array has another element, or false at the end of it
+      bool NextElement();
+
+      bool ReadString(string* value);
+      // For large strings, like encoded data. If the string doesn't have any escapes,
+      // 'str' points straight into the input, saving a copy. Otherwise the string is
+      // decoded into 'scratch', and 'str' points to that.
+      bool ReadString(const char** str, size_t* len, string* scratch);
+      bool ReadNumber(double* value);
+      bool ReadBool(bool* value);
+      bool SkipValue();
+
+      template <typename T>
+      bool ReadNumber(T* value)
+      {
+        double tmp;
+        if (!ReadNumber(&tmp))
+          return false;
+        *value = (T)tmp;
+        return true;
+      }
+
+      // Reads an array of unsigned integers, appending them to 'out'. This is the fast
+      // path for tile layer data, and it decodes the digits 8 at a time.
+      bool ReadU32Array(vector<u32>* out);
+
+      enum class ValueType
+      {
+        Object,
+        Array,
+        String,
+        Number,
+        Bool,
+        Null,
+        Invalid,
+      };
+
+      ValueType PeekType();
+
+      bool Ok() const { return !_error; }
+      size_t Offset() const { return _buf._idx; }
+
+    private:
+      bool Fail();
+      void SkipWhitespace();
+      bool NextItem(char close);
+      bool SkipString();
+
+      InputBuffer& _buf;
+      // set right after an open brace or bracket, where there's no comma before the
+      // first item
+      bool _afterOpen = false;
+      bool _error = false;
+    };
+  }
+}
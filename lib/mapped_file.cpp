@@ -0,0 +1,93 @@
+#include "mapped_file.hpp"
+#include "utils.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+//------------------------------------------------------------------------------
+bool MappedFile::Open(const char* filename)
+{
+  Close();
+
+#ifdef _WIN32
+  _file = CreateFileA(
+      filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(_file, &size);
+  _size = (size_t)size.QuadPart;
+  _mapping = _size ? CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+  if (!_mapping)
+  {
+    Close();
+    return false;
+  }
+  _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat s;
+  fstat(fd, &s);
+  _size = (size_t)s.st_size;
+  void* data = _size ? mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  _data = data == MAP_FAILED ? nullptr : (const char*)data;
+#endif
+
+  if (!_data)
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void MappedFile::Assign(vector<char>* buf)
+{
+  Close();
+
+  _buf.swap(*buf);
+  _data = _buf.data();
+  _size = _buf.size();
+}
+
+//------------------------------------------------------------------------------
+void MappedFile::Close()
+{
+  if (_buf.empty())
+  {
+#ifdef _WIN32
+    if (_data)
+      UnmapViewOfFile(_data);
+    if (_mapping)
+      CloseHandle(exch_null(_mapping));
+    if (_file != INVALID_HANDLE_VALUE)
+      CloseHandle(exch(_file, INVALID_HANDLE_VALUE));
+#else
+    if (_data)
+      munmap((void*)_data, _size);
+#endif
+  }
+
+  vector<char>().swap(_buf);
+  _data = nullptr;
+  _size = 0;
+}
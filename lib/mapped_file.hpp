@@ -0,0 +1,35 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Read only view of a file. Open memory maps the file, and Assign takes over a buffer
+  // that's already in memory, for files that can't be mapped (like the ones in a packed
+  // resource file), so the users only have to deal with a pointer and a size.
+  class MappedFile
+  {
+  public:
+    MappedFile() {}
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* filename);
+    void Assign(vector<char>* buf);
+    void Close();
+
+    const char* Data() const { return _data; }
+    size_t Size() const { return _size; }
+    bool IsOpen() const { return _data != nullptr; }
+
+  private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    vector<char> _buf;
+
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = NULL;
+#endif
+  };
+}
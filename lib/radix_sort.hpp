@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Stable LSD radix sort on the 64 bit 'key' member of T, 8 bits per pass. Passes where
+  // every key has the same digit are skipped, so keys that only use a few of their bits
+  // are cheap to sort. 'tmp' must have room for 'count' elements, and the sorted result
+  // always ends up in 'items'.
+  template <typename T>
+  void RadixSort64(T* items, T* tmp, u32 count)
+  {
+    if (count < 2)
+      return;
+
+    u32 histograms[8][256] = {};
+    for (u32 i = 0; i < count; ++i)
+    {
+      u64 key = items[i].key;
+      for (int pass = 0; pass < 8; ++pass)
+        histograms[pass][(key >> (pass * 8)) & 0xff]++;
+    }
+
+    T* src = items;
+    T* dst = tmp;
+    for (int pass = 0; pass < 8; ++pass)
+    {
+      int shift = pass * 8;
+      u32* histogram = histograms[pass];
+      if (histogram[(src[0].key >> shift) & 0xff] == count)
+        continue;
+
+      // convert the counts to offsets
+      u32 ofs = 0;
+      for (int i = 0; i < 256; ++i)
+      {
+        u32 cnt = histogram[i];
+        histogram[i] = ofs;
+        ofs += cnt;
+      }
+
+      for (u32 i = 0; i < count; ++i)
+        dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+
+      std::swap(src, dst);
+    }
+
+    if (src != items)
+      std::copy(src, src + count, items);
+  }
+}
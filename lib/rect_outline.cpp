@@ -0,0 +1,170 @@
+#include "rect_outline.hpp"
+#include <algorithm>
+
+using namespace world;
+
+namespace
+{
+  // edge directions, in counter clockwise order, so (dir + 1) & 3 is a left turn
+  enum
+  {
+    DIR_POS_X,
+    DIR_POS_Y,
+    DIR_NEG_X,
+    DIR_NEG_Y,
+  };
+
+  const u32 INVALID_EDGE = 0xffffffff;
+
+  struct Edge
+  {
+    u32 from;
+    u32 to;
+    u8 dir;
+    bool used;
+  };
+
+  //------------------------------------------------------------------------------
+  void SortUnique(vector<float>* values)
+  {
+    sort(values->begin(), values->end());
+    values->erase(unique(values->begin(), values->end()), values->end());
+  }
+
+  //------------------------------------------------------------------------------
+  u32 CoordIndex(const vector<float>& values, float v)
+  {
+    return (u32)(lower_bound(values.begin(), values.end(), v) - values.begin());
+  }
+}
+
+//------------------------------------------------------------------------------
+void world::TraceRectOutlines(
+    const OutlineRect* rects, u32 count, vector<vec2>* points, vector<u32>* loopSizes)
+{
+  vector<float> xs, ys;
+  for (u32 i = 0; i < count; ++i)
+  {
+    xs.push_back(rects[i].minPos.x);
+    xs.push_back(rects[i].maxPos.x);
+    ys.push_back(rects[i].minPos.y);
+    ys.push_back(rects[i].maxPos.y);
+  }
+
+  SortUnique(&xs);
+  SortUnique(&ys);
+  if (xs.size() < 2 || ys.size() < 2)
+    return;
+
+  // rasterize the rects onto the grid
+  u32 cellsX = (u32)xs.size() - 1;
+  u32 cellsY = (u32)ys.size() - 1;
+  vector<u8> filled(cellsX * cellsY, 0);
+  for (u32 i = 0; i < count; ++i)
+  {
+    u32 x0 = CoordIndex(xs, rects[i].minPos.x);
+    u32 x1 = CoordIndex(xs, rects[i].maxPos.x);
+    u32 y0 = CoordIndex(ys, rects[i].minPos.y);
+    u32 y1 = CoordIndex(ys, rects[i].maxPos.y);
+    for (u32 y = y0; y < y1; ++y)
+    {
+      for (u32 x = x0; x < x1; ++x)
+        filled[y * cellsX + x] = 1;
+    }
+  }
+
+  auto isFilled = [&](int x, int y)
+  {
+    return x >= 0 && y >= 0 && x < (int)cellsX && y < (int)cellsY && filled[y * cellsX + x];
+  };
+
+  // emit a directed edge wherever a filled cell meets an empty one, with the filled
+  // side on the left. Each grid vertex has at most two outgoing edges, where two filled
+  // cells touch diagonally
+  u32 vertsX = cellsX + 1;
+  vector<Edge> edges;
+  vector<u32> outEdges((cellsY + 1) * vertsX * 2, INVALID_EDGE);
+
+  auto addEdge = [&](u32 x0, u32 y0, u32 x1, u32 y1, u8 dir)
+  {
+    u32 from = y0 * vertsX + x0;
+    u32 slot = outEdges[from * 2] == INVALID_EDGE ? 0 : 1;
+    outEdges[from * 2 + slot] = (u32)edges.size();
+    edges.push_back(Edge{from, y1 * vertsX + x1, dir, false});
+  };
+
+  for (u32 y = 0; y <= cellsY; ++y)
+  {
+    for (u32 x = 0; x <= cellsX; ++x)
+    {
+      // horizontal edge from (x, y) to (x + 1, y), between the cells below and above
+      if (x < cellsX)
+      {
+        bool below = isFilled((int)x, (int)y - 1);
+        bool above = isFilled((int)x, (int)y);
+        if (above && !below)
+          addEdge(x, y, x + 1, y, DIR_POS_X);
+        else if (below && !above)
+          addEdge(x + 1, y, x, y, DIR_NEG_X);
+      }
+
+      // vertical edge from (x, y) to (x, y + 1), between the cells to the left and right
+      if (y < cellsY)
+      {
+        bool left = isFilled((int)x - 1, (int)y);
+        bool right = isFilled((int)x, (int)y);
+        if (left && !right)
+          addEdge(x, y, x, y + 1, DIR_POS_Y);
+        else if (right && !left)
+          addEdge(x, y + 1, x, y, DIR_NEG_Y);
+      }
+    }
+  }
+
+  // follow the edges around each loop. At a vertex with two ways out, the left turn
+  // keeps the loop around the cell it's already on, which is what separates shapes
+  // touching at a corner
+  vector<u32> loop;
+  for (u32 start = 0; start < (u32)edges.size(); ++start)
+  {
+    if (edges[start].used)
+      continue;
+
+    loop.clear();
+    u32 cur = start;
+    do
+    {
+      Edge& edge = edges[cur];
+      edge.used = true;
+      loop.push_back(cur);
+
+      u32 next = INVALID_EDGE;
+      for (int i = 0; i < 2; ++i)
+      {
+        u32 candidate = outEdges[edge.to * 2 + i];
+        if (candidate == INVALID_EDGE || (edges[candidate].used && candidate != start))
+          continue;
+        if (next == INVALID_EDGE || edges[candidate].dir == ((edge.dir + 1) & 3))
+          next = candidate;
+      }
+
+      assert(next != INVALID_EDGE);
+      cur = next;
+    } while (cur != start && cur != INVALID_EDGE);
+
+    // only keep the corners
+    u32 numPoints = 0;
+    for (size_t i = 0; i < loop.size(); ++i)
+    {
+      const Edge& edge = edges[loop[i]];
+      const Edge& prev = edges[loop[(i + loop.size() - 1) % loop.size()]];
+      if (edge.dir == prev.dir)
+        continue;
+
+      points->push_back(vec2{xs[edge.from % vertsX], ys[edge.from / vertsX]});
+      numPoints++;
+    }
+
+    loopSizes->push_back(numPoints);
+  }
+}
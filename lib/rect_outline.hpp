@@ -0,0 +1,33 @@
+#pragma once
+#include "tano_math.hpp"
+
+namespace world
+{
+  struct OutlineRect
+  {
+    vec2 minPos;
+    vec2 maxPos;
+  };
+
+  //------------------------------------------------------------------------------
+  // Unions a set of axis aligned rects, and traces the outlines of the merged shapes.
+  // Each outline is appended to 'points' as a closed loop, without repeating the first
+  // point, and its number of points is appended to 'loopSizes'. Outer outlines wind
+  // counter clockwise (with y up), holes wind clockwise, and only the corners are kept.
+  // Shapes that just touch at a corner get separate outlines.
+  //
+  // The rects are rasterized onto a grid made from their unique edge coordinates, so
+  // edges that should line up need bit-identical coordinates.
+  void TraceRectOutlines(
+      const OutlineRect* rects, u32 count, vector<vec2>* points, vector<u32>* loopSizes);
+
+  //------------------------------------------------------------------------------
+  // Static chain shapes for a single body, in world space. The points are shared by the
+  // closed loops, followed by the open chains, in order
+  struct StaticChains
+  {
+    vector<vec2> points;
+    vector<u32> loopSizes;
+    vector<u32> chainSizes;
+  };
+}
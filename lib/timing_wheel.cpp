@@ -0,0 +1,109 @@
+#include "timing_wheel.hpp"
+
+using namespace world;
+
+//------------------------------------------------------------------------------
+TimingWheel::TimingWheel()
+{
+}
+
+//------------------------------------------------------------------------------
+void TimingWheel::Add(u64 expire, u32 value)
+{
+  u32 idx;
+  if (_freeNodes != INVALID_NODE)
+  {
+    idx = _freeNodes;
+    _freeNodes = _nodes[idx].next;
+  }
+  else
+  {
+    idx = (u32)_nodes.size();
+    _nodes.push_back(Node());
+  }
+
+  Node& node = _nodes[idx];
+  node.expire = max(expire, _now + 1);
+  node.seq = _nextSeq++;
+  node.value = value;
+  _numPending++;
+
+  Insert(idx);
+}
+
+//------------------------------------------------------------------------------
+void TimingWheel::Insert(u32 idx)
+{
+  Node& node = _nodes[idx];
+  node.next = INVALID_NODE;
+
+  // timers out of range are parked at the furthest slot, and re-inserted when cascaded
+  u64 expire = min(node.expire, _now + MAX_RANGE);
+
+  // find the level from the highest bit that differs between the expiry and now
+  u64 diff = expire ^ _now;
+  u32 level = 0;
+  while (level < NUM_LEVELS - 1 && (diff >> ((level + 1) * SLOT_BITS)) != 0)
+    ++level;
+
+  Slot& slot = _slots[level][(expire >> (level * SLOT_BITS)) & SLOT_MASK];
+  if (slot.tail == INVALID_NODE)
+    slot.head = idx;
+  else
+    _nodes[slot.tail].next = idx;
+  slot.tail = idx;
+}
+
+//------------------------------------------------------------------------------
+void TimingWheel::Cascade()
+{
+  // when the low bits of now wrap around, the timers in the matching slot on the level
+  // above are moved down. Start from the top, as timers can cascade several levels.
+  u32 topLevel = 0;
+  while (topLevel < NUM_LEVELS - 1 && (_now & ((1ull << ((topLevel + 1) * SLOT_BITS)) - 1)) == 0)
+    ++topLevel;
+
+  for (u32 level = topLevel; level > 0; --level)
+  {
+    Slot& slot = _slots[level][(_now >> (level * SLOT_BITS)) & SLOT_MASK];
+    u32 cur = exch(slot.head, (u32)INVALID_NODE);
+    slot.tail = INVALID_NODE;
+    while (cur != INVALID_NODE)
+    {
+      u32 next = _nodes[cur].next;
+      Insert(cur);
+      cur = next;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void TimingWheel::CollectExpired()
+{
+  Slot& slot = _slots[0][_now & SLOT_MASK];
+  _expired.clear();
+  bool sorted = true;
+  for (u32 cur = exch(slot.head, (u32)INVALID_NODE); cur != INVALID_NODE; cur = _nodes[cur].next)
+  {
+    sorted = sorted && (_expired.empty() || _nodes[_expired.back()].seq < _nodes[cur].seq);
+    _expired.push_back(cur);
+  }
+  slot.tail = INVALID_NODE;
+
+  // timers cascaded from the levels above are appended after the ones that were added
+  // straight to this slot, even if they were added before them
+  if (!sorted)
+  {
+    sort(_expired.begin(), _expired.end(), [this](u32 a, u32 b) {
+      return _nodes[a].seq < _nodes[b].seq;
+    });
+  }
+}
+
+//------------------------------------------------------------------------------
+void TimingWheel::FreeNode(u32 idx)
+{
+  _nodes[idx].next = _freeNodes;
+  _freeNodes = idx;
+  _numPending--;
+}
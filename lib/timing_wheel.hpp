@@ -0,0 +1,84 @@
+#pragma once
+#include "utils.hpp"
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Hierarchical timing wheel. Each level has 64 slots, and covers 64 times the range of
+  // the level below it. Timers are inserted into the level of the highest bits that
+  // differ between the expiry and the current tick, and are cascaded down a level
+  // whenever the current tick crosses into their slot, so both insert and expire are
+  // O(1) per timer. Timers further away than the wheel's range are parked in the top
+  // level and re-inserted as they cascade.
+  class TimingWheel
+  {
+  public:
+    TimingWheel();
+
+    // Adds a timer firing at the absolute tick 'expire'. 'value' is passed back when the
+    // timer fires. Timers that have already expired fire on the next advance.
+    void Add(u64 expire, u32 value);
+
+    // Advances the wheel to 'now', calling fn(value) for every timer that expires, in
+    // expiry order. Timers expiring on the same tick fire in insertion order.
+    template <typename Fn>
+    void Advance(u64 now, const Fn& fn)
+    {
+      while (_now < now)
+      {
+        ++_now;
+        Cascade();
+        CollectExpired();
+
+        // fn can add new timers, so the nodes are only freed after it's been called
+        for (u32 idx : _expired)
+        {
+          fn(_nodes[idx].value);
+          FreeNode(idx);
+        }
+      }
+    }
+
+    u64 Now() const { return _now; }
+    u32 NumPending() const { return _numPending; }
+
+  private:
+    enum
+    {
+      SLOT_BITS = 6,
+      NUM_SLOTS = 1 << SLOT_BITS,
+      SLOT_MASK = NUM_SLOTS - 1,
+      NUM_LEVELS = 4,
+      INVALID_NODE = ~0u,
+    };
+
+    static const u64 MAX_RANGE = (1ull << (SLOT_BITS * NUM_LEVELS)) - 1;
+
+    struct Node
+    {
+      u64 expire;
+      u64 seq;
+      u32 value;
+      u32 next;
+    };
+
+    struct Slot
+    {
+      u32 head = INVALID_NODE;
+      u32 tail = INVALID_NODE;
+    };
+
+    void Insert(u32 idx);
+    void Cascade();
+    void CollectExpired();
+    void FreeNode(u32 idx);
+
+    vector<Node> _nodes;
+    vector<u32> _expired;
+    u32 _freeNodes = INVALID_NODE;
+    u32 _numPending = 0;
+    u64 _now = 0;
+    u64 _nextSeq = 0;
+    Slot _slots[NUM_LEVELS][NUM_SLOTS];
+  };
+}
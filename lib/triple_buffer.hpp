@@ -0,0 +1,54 @@
+#pragma once
+
+namespace world
+{
+  //------------------------------------------------------------------------------
+  // Lock-free single producer, single consumer triple buffer. The producer fills the
+  // back slot and swaps it with the middle one on Publish, and the consumer swaps its
+  // front slot with the middle one when there is something new. Neither side ever
+  // waits, and the consumer always gets the most recently published value; values
+  // published faster than they're read are skipped.
+  //
+  // The slots are reused, so containers in T keep their capacity between frames.
+  template <typename T>
+  class TripleBuffer
+  {
+  public:
+    // Producer side
+    T& Back() { return _slots[_back]; }
+
+    void Publish()
+    {
+      u32 prev = _middle.exchange(_back | DIRTY_BIT, std::memory_order_acq_rel);
+      _back = prev & INDEX_MASK;
+    }
+
+    // Consumer side. Returns true if a new value was published since the last call
+    bool Update()
+    {
+      if (!(_middle.load(std::memory_order_relaxed) & DIRTY_BIT))
+        return false;
+
+      u32 prev = _middle.exchange(_front, std::memory_order_acq_rel);
+      _front = prev & INDEX_MASK;
+      return true;
+    }
+
+    const T& Front() const { return _slots[_front]; }
+
+    // Only safe when neither side is running
+    T& Slot(int idx) { return _slots[idx]; }
+
+  private:
+    enum
+    {
+      INDEX_MASK = 0x3,
+      DIRTY_BIT = 0x4,
+    };
+
+    T _slots[3];
+    u32 _back = 0;
+    std::atomic<u32> _middle{1};
+    u32 _front = 2;
+  };
+}
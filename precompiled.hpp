@@ -8,6 +8,12 @@
 #define WITH_IMGUI 1
 #define WITH_DEBUG_SHADERS 1
 
+#if defined(_DEBUG)
+#define WITH_SCRATCH_MEMORY_CHECKS 1
+#else
+#define WITH_SCRATCH_MEMORY_CHECKS 0
+#endif
+
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -46,6 +52,7 @@
 #include <functional>
 #include <memory>
 #include <thread>
+#include <atomic>
 
 #include <stb/stb_image.h>
 
@@ -0,0 +1,165 @@
+# cooks a tmx level exported as json into the binary format loaded by
+# SpriteManager::LoadCookedLevel. see core/cooked_level.hpp for the layout.
+# the cooked level is written next to the json, with a .lvl extension, unless
+# an output file is given.
+
+import argparse
+import base64
+import gzip
+import io
+import json
+import os
+import struct
+import zlib
+
+MAGIC = 0x4c56454c
+VERSION = 1
+ALIGNMENT = 16
+
+HEADER = struct.Struct('<IIII iiii f IIIIIIIIIIII')
+LAYER = struct.Struct('<IiiiiI')
+TILESET = struct.Struct('<IIiiiiiiii')
+RECT = struct.Struct('<fffff')
+POLYLINE = struct.Struct('<II')
+POINT = struct.Struct('<ff')
+
+
+def align(ofs):
+    return (ofs + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+
+class StringTable(object):
+    def __init__(self):
+        self.data = bytearray()
+        self.offsets = {}
+
+    def add(self, s):
+        if s not in self.offsets:
+            self.offsets[s] = len(self.data)
+            self.data += s.encode('utf-8') + b'\0'
+        return self.offsets[s]
+
+
+def layer_tiles(layer):
+    data = layer['data']
+    if isinstance(data, list):
+        return struct.pack('<%dI' % len(data), *data)
+
+    raw = base64.b64decode(data)
+    compression = layer.get('compression', '')
+    if compression == 'zlib':
+        raw = zlib.decompress(raw)
+    elif compression == 'gzip':
+        raw = gzip.GzipFile(fileobj=io.BytesIO(raw)).read()
+    elif compression == 'zstd':
+        # the game can't decode zstd, but the cooked level is stored uncompressed
+        try:
+            import zstandard
+        except ImportError:
+            raise SystemExit('zstd compressed layers need the zstandard module')
+        raw = zstandard.ZstdDecompressor().decompressobj().decompress(raw)
+    elif compression:
+        raise SystemExit('unsupported layer compression: %s' % compression)
+    return raw
+
+
+def cook(level):
+    strings = StringTable()
+    layers = []
+    tilesets = []
+    rects = []
+    polylines = []
+    points = []
+
+    zero_level = 0.0
+    props = level.get('properties', {})
+    if 'zerolevel' in props:
+        zero_level = float(props['zerolevel']) * level['tileheight']
+
+    for layer in level['layers']:
+        if layer['name'].lower().startswith('collision'):
+            for obj in layer.get('objects', []):
+                if obj.get('ellipse') or 'polygon' in obj:
+                    continue
+                if 'polyline' in obj:
+                    polylines.append((len(points), len(obj['polyline'])))
+                    points.extend((pt['x'], pt['y']) for pt in obj['polyline'])
+                else:
+                    rects.append((obj['x'], obj['y'], obj['width'], obj['height'], obj['rotation']))
+        else:
+            tiles = layer_tiles(layer)
+            if len(tiles) != layer['width'] * layer['height'] * 4:
+                raise SystemExit('layer %s has the wrong number of tiles' % layer['name'])
+            layers.append((strings.add(layer['name']), layer['x'], layer['y'],
+                           layer['width'], layer['height'], tiles))
+
+    for ts in level['tilesets']:
+        tilesets.append((strings.add(ts['name']), strings.add(ts['image']), ts['firstgid'],
+                         ts['imagewidth'], ts['imageheight'], ts['margin'], ts['spacing'],
+                         ts['tilecount'], ts['tilewidth'], ts['tileheight']))
+
+    # the string table can't be empty, as it has to end with a terminator
+    strings.add('')
+
+    # lay out the arrays
+    ofs = align(HEADER.size)
+    layers_ofs = ofs
+    ofs = align(ofs + len(layers) * LAYER.size)
+    tilesets_ofs = ofs
+    ofs = align(ofs + len(tilesets) * TILESET.size)
+    rects_ofs = ofs
+    ofs = align(ofs + len(rects) * RECT.size)
+    polylines_ofs = ofs
+    ofs = align(ofs + len(polylines) * POLYLINE.size)
+    points_ofs = ofs
+    ofs = align(ofs + len(points) * POINT.size)
+    strings_ofs = ofs
+    ofs = align(ofs + len(strings.data))
+
+    tiles_ofs = []
+    for layer in layers:
+        tiles_ofs.append(ofs)
+        ofs = align(ofs + len(layer[5]))
+    file_size = ofs
+
+    out = bytearray(file_size)
+    HEADER.pack_into(out, 0, MAGIC, VERSION, HEADER.size, file_size,
+                     level['width'], level['height'], level['tilewidth'], level['tileheight'],
+                     zero_level,
+                     len(layers), layers_ofs,
+                     len(tilesets), tilesets_ofs,
+                     len(rects), rects_ofs,
+                     len(polylines), polylines_ofs,
+                     len(points), points_ofs,
+                     len(strings.data), strings_ofs)
+
+    for i, layer in enumerate(layers):
+        LAYER.pack_into(out, layers_ofs + i * LAYER.size, *(layer[:5] + (tiles_ofs[i],)))
+        out[tiles_ofs[i]:tiles_ofs[i] + len(layer[5])] = layer[5]
+    for i, ts in enumerate(tilesets):
+        TILESET.pack_into(out, tilesets_ofs + i * TILESET.size, *ts)
+    for i, rect in enumerate(rects):
+        RECT.pack_into(out, rects_ofs + i * RECT.size, *rect)
+    for i, polyline in enumerate(polylines):
+        POLYLINE.pack_into(out, polylines_ofs + i * POLYLINE.size, *polyline)
+    for i, pt in enumerate(points):
+        POINT.pack_into(out, points_ofs + i * POINT.size, *pt)
+    out[strings_ofs:strings_ofs + len(strings.data)] = strings.data
+
+    return out
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument('filename')
+parser.add_argument('--output', '-o')
+args = parser.parse_args()
+
+with open(args.filename) as f:
+    level = json.load(f)
+
+out = cook(level)
+output = args.output or os.path.splitext(args.filename)[0] + '.lvl'
+with open(output, 'wb') as f:
+    f.write(out)
+
+print('%s: %d bytes' % (output, len(out)))
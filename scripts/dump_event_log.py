@@ -0,0 +1,66 @@
+# dumps a binary event log recorded by EventManager::StartRecording.
+# the log is memory mapped, and the frames are indexed on load, so it's cheap to
+# seek to a given frame of a long recording.
+
+import argparse
+import bisect
+import mmap
+import struct
+
+MAGIC = 0x474c5645
+VERSION = 1
+
+LOG_HEADER = struct.Struct('<IIIIQ')
+FRAME_HEADER = struct.Struct('<QII')
+EVENT_HEADER = struct.Struct('<II')
+
+EVENT_NAMES = ['KeyDown', 'KeyUp']
+
+parser = argparse.ArgumentParser()
+parser.add_argument('filename')
+parser.add_argument('--frame', '-f', type=int, help='first frame to dump')
+parser.add_argument('--count', '-n', type=int, default=1, help='number of frames to dump')
+parser.add_argument('--summary', '-s', action='store_true')
+args = parser.parse_args()
+
+f = open(args.filename, 'rb')
+data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+magic, version, header_size, _, start_frame = LOG_HEADER.unpack_from(data, 0)
+if magic != MAGIC or version != VERSION:
+    raise SystemExit('%s is not an event log' % args.filename)
+
+# index the frames
+frames = []
+offsets = []
+ofs = header_size
+while ofs + FRAME_HEADER.size <= len(data):
+    frame, num_events, size = FRAME_HEADER.unpack_from(data, ofs)
+    frames.append(frame)
+    offsets.append(ofs)
+    ofs += FRAME_HEADER.size + size
+
+
+def dump_frame(idx):
+    frame, num_events, size = FRAME_HEADER.unpack_from(data, offsets[idx])
+    print('frame %d: %d events, %d bytes' % (frame, num_events, size))
+    cur = offsets[idx] + FRAME_HEADER.size
+    end = cur + size
+    while cur < end:
+        event_type, event_len = EVENT_HEADER.unpack_from(data, cur)
+        name = EVENT_NAMES[event_type] if event_type < len(EVENT_NAMES) else str(event_type)
+        payload = data[cur + EVENT_HEADER.size:cur + event_len]
+        print('  %-10s %s' % (name, ' '.join('%02x' % ord(payload[i:i + 1]) for i in range(len(payload)))))
+        cur += event_len
+
+
+if args.summary or args.frame is None:
+    total = sum(FRAME_HEADER.unpack_from(data, o)[1] for o in offsets)
+    last = frames[-1] if frames else start_frame
+    print('start frame: %d, last frame: %d, frames with events: %d, events: %d' % (
+        start_frame, last, len(frames), total))
+
+if args.frame is not None:
+    idx = bisect.bisect_left(frames, args.frame)
+    for i in range(idx, min(idx + args.count, len(frames))):
+        dump_frame(i)
@@ -0,0 +1,126 @@
+#include "bench.hpp"
+#include <lib/arena_allocator.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  // Split between the threads, so the arena is the same size for every thread count
+  const int NUM_ALLOCS = 1 << 20;
+  const u32 ARENA_SIZE = 128 * 1024 * 1024;
+  const int MAX_THREADS = 32;
+
+  // The old arena, a bump pointer behind a lock
+  struct MutexArena
+  {
+    void* Alloc(u32 size, u32 alignment)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      u32 mask = alignment - 1;
+      u32 padding = (alignment - (idx & mask)) & mask;
+      u32 alignedSize = size + padding;
+      if (alignedSize + idx > capacity)
+        return nullptr;
+
+      u8* res = mem + idx + padding;
+      idx += alignedSize;
+      return res;
+    }
+
+    u8* mem = nullptr;
+    u32 idx = 0;
+    u32 capacity = 0;
+    std::mutex mutex;
+  };
+
+  //------------------------------------------------------------------------------
+  // Runs 'numThreads' threads that each do their share of the allocations, with sizes
+  // like the per frame scratch data. The allocations aren't touched, as that would make
+  // it a benchmark of the cache misses. Returns the fastest of a few runs, with the arena
+  // reset between them.
+  template <typename Alloc, typename Reset>
+  double Run(int numThreads, const Alloc& alloc, const Reset& reset, std::atomic<bool>* ok)
+  {
+    vector<u32> sizes(NUM_ALLOCS / numThreads);
+    std::mt19937 rng(1);
+    for (u32& size : sizes)
+      size = 16 + rng() % 112;
+
+    return bench::MinTime(3, [&]() {
+      std::atomic<int> ready{0};
+      std::atomic<bool> go{false};
+      vector<std::thread> threads;
+      for (int t = 0; t < numThreads; ++t)
+      {
+        threads.push_back(std::thread([&]() {
+          ready++;
+          while (!go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+          for (u32 size : sizes)
+          {
+            void* mem = alloc(size);
+            if (!mem)
+            {
+              *ok = false;
+              return;
+            }
+            bench::DoNotOptimize(mem);
+          }
+        }));
+      }
+
+      // the clock already runs, but starting the threads is the same for every arena
+      while (ready.load() < numThreads)
+        std::this_thread::yield();
+      go.store(true, std::memory_order_release);
+      for (std::thread& thread : threads)
+        thread.join();
+      reset();
+    });
+  }
+}
+
+// Small allocations from 1-32 threads, with the old mutex arena, with the lock free
+// Alloc, and with AllocThreadLocal. The same number of allocations is split between the
+// threads, so the rates are directly comparable. Above the number of cores, the threads
+// are time sliced, and the lock holder can be preempted.
+int main()
+{
+  vector<u8> buf(ARENA_SIZE);
+  MutexArena mutexArena;
+  mutexArena.mem = buf.data();
+  mutexArena.capacity = ARENA_SIZE;
+  ArenaAllocator arena;
+  arena.Init(buf.data(), buf.data() + buf.size());
+
+  std::atomic<bool> ok{true};
+  printf("%u hardware threads\n", std::thread::hardware_concurrency());
+  printf("M allocs/s   mutex   Alloc   AllocThreadLocal\n");
+  for (int numThreads = 1; numThreads <= MAX_THREADS; numThreads *= 2)
+  {
+    double tMutex = Run(numThreads,
+        [&](u32 size) { return mutexArena.Alloc(size, 16); },
+        [&]() { mutexArena.idx = 0; },
+        &ok);
+    double tAlloc = Run(numThreads,
+        [&](u32 size) { return arena.Alloc(size, 16); },
+        [&]() { arena.NewFrame(); },
+        &ok);
+    double tThreadLocal = Run(numThreads,
+        [&](u32 size) { return arena.AllocThreadLocal(size, 16); },
+        [&]() { arena.NewFrame(); },
+        &ok);
+
+    double m = (double)(NUM_ALLOCS / numThreads * numThreads) / 1e6;
+    printf("%2d threads %7.1f %7.1f %10.1f\n",
+        numThreads,
+        m / tMutex,
+        m / tAlloc,
+        m / tThreadLocal);
+  }
+
+  printf("%s\n", ok.load() ? "all allocations succeeded" : "ALLOCATIONS FAILED");
+  return ok ? 0 : 1;
+}
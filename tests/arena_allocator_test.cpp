@@ -0,0 +1,182 @@
+#include "test.hpp"
+#include <lib/arena_allocator.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  struct Range
+  {
+    uintptr_t start;
+    uintptr_t end;
+    bool operator<(const Range& rhs) const { return start < rhs.start; }
+  };
+
+  //------------------------------------------------------------------------------
+  void TestFailedAlloc()
+  {
+    vector<u8> buf(4096);
+    ArenaAllocator arena;
+    arena.Init(buf.data(), buf.data() + buf.size());
+    CHECK(arena.Alloc(100, 16));
+
+    // failing allocations don't move the bottom, however many of them there are, so
+    // the arena can't wrap around
+    u32 used = arena.Used();
+    for (int i = 0; i < 10; ++i)
+    {
+      CHECK(!arena.Alloc(0x7fffffff, 16));
+      CHECK(!arena.AllocTop(0x7fffffff, 16));
+      CHECK(!arena.Alloc(4096, 1));
+    }
+    CHECK_EQ(arena.Used(), used);
+
+    // the remaining space can still be used, from both ends, down to the last byte
+    u32 left = arena.Capacity() - arena.Used();
+    CHECK(arena.AllocTop(left / 2, 1));
+    CHECK(arena.Alloc(left - left / 2, 1));
+    CHECK_EQ(arena.Used(), arena.Capacity());
+    CHECK(!arena.Alloc(1, 1));
+    CHECK(!arena.AllocTop(1, 1));
+
+    arena.NewFrame();
+    CHECK_EQ(arena.Used(), 0u);
+  }
+
+  //------------------------------------------------------------------------------
+  // Threads allocating from both ends until the arena is full. The allocations have to
+  // be aligned, inside the arena, and not overlap.
+  void TestThreads(ArenaAllocator& arena)
+  {
+    const int NUM_THREADS = 6;
+    vector<vector<Range>> ranges(NUM_THREADS);
+    vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+      threads.push_back(std::thread([&, t]() {
+        std::mt19937 rng(t);
+        int numFailed = 0;
+        while (numFailed < 100)
+        {
+          u32 size = 1 + rng() % 300;
+          u32 alignment = 1 << (rng() % 7);
+          bool top = t % 2 == 1;
+          u8* mem = (u8*)(top ? arena.AllocTop(size, alignment) : arena.Alloc(size, alignment));
+          if (!mem)
+          {
+            numFailed++;
+            continue;
+          }
+
+          CHECK(((uintptr_t)mem & (alignment - 1)) == 0);
+          memset(mem, t, size);
+          ranges[t].push_back(Range{(uintptr_t)mem, (uintptr_t)mem + size});
+        }
+      }));
+    }
+
+    for (std::thread& thread : threads)
+      thread.join();
+
+    vector<Range> all;
+    for (int t = 0; t < NUM_THREADS; ++t)
+    {
+      for (const Range& range : ranges[t])
+      {
+        // nobody else wrote over the allocation
+        CHECK(*(u8*)range.start == t && *(u8*)(range.end - 1) == t);
+        all.push_back(range);
+      }
+    }
+
+    sort(all.begin(), all.end());
+    CHECK(!all.empty());
+    CHECK(all.front().start >= (uintptr_t)arena.Start());
+    CHECK(all.back().end <= (uintptr_t)arena.Start() + arena.Capacity());
+    for (size_t i = 1; i < all.size(); ++i)
+      CHECK(all[i - 1].end <= all[i].start);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestConcurrent()
+  {
+    vector<u8> buf(256 * 1024);
+    ArenaAllocator arena;
+    arena.Init(buf.data(), buf.data() + buf.size());
+    for (int i = 0; i < 4; ++i)
+    {
+      TestThreads(arena);
+      arena.NewFrame();
+    }
+
+    // a virtual arena commits the pages before the allocations are handed out
+    ArenaAllocator virtualArena;
+    CHECK(virtualArena.InitVirtual(4 * 1024 * 1024));
+    CHECK_EQ(virtualArena.Committed(), 0u);
+    TestThreads(virtualArena);
+  }
+
+  //------------------------------------------------------------------------------
+  // Virtual arenas keep the pages used in the last QUIET_FRAMES frames, and the committed
+  // size counts pages committed by both ends only once
+  void TestDecommit()
+  {
+    const u32 MB = 1024 * 1024;
+    ArenaAllocator arena;
+    CHECK(arena.InitVirtual(4 * MB));
+    CHECK(arena.Alloc(2 * MB, 16));
+    arena.NewFrame();
+    CHECK(arena.Committed() >= 2 * MB);
+
+    // a smaller frame every now and then doesn't release the pages the big one needs
+    for (int i = 0; i < 3 * ArenaAllocator::QUIET_FRAMES; ++i)
+    {
+      CHECK(arena.Alloc(i % 10 == 0 ? 2 * MB : 1000, 16));
+      arena.NewFrame();
+    }
+    CHECK(arena.Committed() >= 2 * MB);
+
+    // but once it stops, they go
+    for (int i = 0; i < 2 * ArenaAllocator::QUIET_FRAMES; ++i)
+    {
+      CHECK(arena.Alloc(1000, 16));
+      arena.NewFrame();
+    }
+    CHECK_EQ(arena.Committed(), (u32)ArenaAllocator::COMMIT_GRANULARITY);
+
+    // the bottom growing into pages the top committed
+    CHECK(arena.AllocTop(3 * MB, 16));
+    arena.NewFrame();
+    CHECK(arena.Alloc(3 * MB, 16));
+    CHECK(arena.Committed() <= arena.Capacity());
+    arena.NewFrame();
+    CHECK(arena.Committed() <= arena.Capacity());
+  }
+
+  //------------------------------------------------------------------------------
+  void TestMarks()
+  {
+    vector<u8> buf(4096);
+    ArenaAllocator arena;
+    arena.Init(buf.data(), buf.data() + buf.size());
+    arena.Alloc(10, 1);
+    {
+      ScopedArena scoped(arena);
+      arena.Alloc(100, 16);
+      arena.AllocTop(200, 16);
+      CHECK(arena.Used() >= 310u);
+    }
+    CHECK_EQ(arena.Used(), 10u);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestFailedAlloc();
+  TestConcurrent();
+  TestDecommit();
+  TestMarks();
+  return test::TestResult();
+}
@@ -0,0 +1,128 @@
+#include "test.hpp"
+#include <lib/base64.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const char* ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  //------------------------------------------------------------------------------
+  string Encode(const vector<u8>& data, bool pad)
+  {
+    string res;
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3)
+    {
+      u32 v = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+      res += ALPHABET[v >> 18];
+      res += ALPHABET[(v >> 12) & 63];
+      res += ALPHABET[(v >> 6) & 63];
+      res += ALPHABET[v & 63];
+    }
+
+    size_t rest = data.size() - i;
+    if (rest == 0)
+      return res;
+
+    u32 v = data[i] << 16 | (rest == 2 ? data[i + 1] << 8 : 0);
+    res += ALPHABET[v >> 18];
+    res += ALPHABET[(v >> 12) & 63];
+    if (rest == 2)
+      res += ALPHABET[(v >> 6) & 63];
+    if (pad)
+      res += rest == 1 ? "==" : "=";
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  // Decodes with both the active kernel and the scalar reference, which must agree
+  bool Decode(const string& src, vector<u8>* dst)
+  {
+    vector<u8> a(Base64DecodedSize(src.size()));
+    vector<u8> b(a.size());
+    size_t lenA = 0, lenB = 0;
+    bool okA = Base64Decode(src.data(), src.size(), a.data(), &lenA);
+    bool okB = Base64DecodeScalar(src.data(), src.size(), b.data(), &lenB);
+    CHECK_EQ(okA, okB);
+    if (!okA || !okB)
+      return false;
+
+    CHECK_EQ(lenA, lenB);
+    CHECK(memcmp(a.data(), b.data(), min(lenA, lenB)) == 0);
+    dst->assign(a.begin(), a.begin() + lenA);
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestRoundTrip()
+  {
+    // the sizes cover all the tails after the 16 character blocks
+    std::mt19937 rng(1);
+    for (size_t size = 0; size < 200; ++size)
+    {
+      vector<u8> data(size);
+      for (u8& b : data)
+        b = (u8)rng();
+
+      for (int pad = 0; pad < 2; ++pad)
+      {
+        vector<u8> decoded;
+        CHECK(Decode(Encode(data, pad == 1), &decoded));
+        CHECK(decoded == data);
+      }
+    }
+
+    // a large buffer, to run the SIMD loop for a while
+    vector<u8> data(1 << 20);
+    for (u8& b : data)
+      b = (u8)rng();
+    vector<u8> decoded;
+    CHECK(Decode(Encode(data, true), &decoded));
+    CHECK(decoded == data);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestInvalid()
+  {
+    // every character, at a position decoded by the SIMD kernel
+    for (int c = 0; c < 256; ++c)
+    {
+      string src(64, 'A');
+      src[5] = (char)c;
+      vector<u8> decoded;
+      bool valid = c != 0 && strchr(ALPHABET, c) != nullptr;
+      CHECK_EQ(Decode(src, &decoded), valid);
+    }
+
+    // corrupted encodings are rejected, by both kernels
+    std::mt19937 rng(2);
+    const char bad[] = {' ', '\n', '-', '_', '*', (char)0x80, (char)0xc3, 0, '@', '[', '`', '{'};
+    for (int i = 0; i < 10000; ++i)
+    {
+      vector<u8> data(1 + rng() % 100);
+      for (u8& b : data)
+        b = (u8)rng();
+      string src = Encode(data, rng() % 2 == 0);
+      src[rng() % src.size()] = bad[rng() % sizeof(bad)];
+      vector<u8> decoded;
+      CHECK(!Decode(src, &decoded));
+    }
+
+    // padding in the middle, or a single character left over
+    vector<u8> decoded;
+    CHECK(!Decode("QUJD=QUJD", &decoded));
+    CHECK(!Decode("QUJDR", &decoded));
+    CHECK(!Decode("QUJDR===", &decoded));
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  printf("kernel: %s\n", Base64KernelName());
+  TestRoundTrip();
+  TestInvalid();
+  return test::TestResult();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+
+// Helpers for the benchmarks. Each benchmark is run a few times, and the fastest run is
+// reported, as that's the one least disturbed by the rest of the system.
+
+namespace world
+{
+  namespace bench
+  {
+    inline double Now()
+    {
+      using namespace std::chrono;
+      return duration<double>(high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+    // Runs 'fn' 'reps' times, and returns the fastest run in seconds
+    template <typename Fn>
+    double MinTime(int reps, const Fn& fn)
+    {
+      double best = 1e30;
+      for (int i = 0; i < reps; ++i)
+      {
+        double start = Now();
+        fn();
+        best = min(best, Now() - start);
+      }
+      return best;
+    }
+
+    // Keeps the compiler from optimizing away results that are otherwise unused
+    template <typename T>
+    void DoNotOptimize(const T& value)
+    {
+      asm volatile("" : : "g"(&value) : "memory");
+    }
+  }
+}
@@ -0,0 +1,249 @@
+#include "test.hpp"
+#include <core/chunk_streamer.hpp>
+#include <core/tmx_level.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  // An infinite map that's far too big for the budget, with a ground layer covering all
+  // of it, a sparse layer on top, and a collision rect in every few chunks, some of them
+  // crossing the chunk borders
+  const int CHUNKS_X = 96;
+  const int CHUNKS_Y = 24;
+  const int CHUNK_SIZE = 16;
+  const int TILE_SIZE = 16;
+  const float CHUNK_PIXELS = (float)(CHUNK_SIZE * TILE_SIZE);
+  const size_t MEMORY_BUDGET = 1024 * 1024;
+
+  struct TestMap
+  {
+    vector<char> json;
+    // non-empty tiles per chunk, for all the layers
+    unordered_map<u64, u32> numQuads;
+    unordered_set<u64> hasCollision;
+  };
+
+  //------------------------------------------------------------------------------
+  void AppendChunk(int cx, int cy, int density, std::mt19937& rng, TestMap* map, string* json)
+  {
+    char buf[128];
+    snprintf(buf,
+        sizeof(buf),
+        "{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"data\":[",
+        cx * CHUNK_SIZE,
+        cy * CHUNK_SIZE,
+        CHUNK_SIZE,
+        CHUNK_SIZE);
+    json->append(buf);
+
+    u32& numQuads = map->numQuads[ChunkStreamer::ChunkKey(cx, cy)];
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+    {
+      u32 gid = (int)(rng() % 100) < density ? 1 + rng() % 64 : 0;
+      numQuads += gid ? 1 : 0;
+      json->append(i ? "," : "");
+      json->append(std::to_string(gid));
+    }
+    json->append("]}");
+  }
+
+  //------------------------------------------------------------------------------
+  TestMap MakeMap()
+  {
+    TestMap map;
+    std::mt19937 rng(1);
+    string json = "{\"width\":0,\"height\":0,\"tilewidth\":16,\"tileheight\":16,"
+                  "\"infinite\":true,\"layers\":[";
+
+    const char* layers[] = {"ground", "decoration"};
+    const int density[] = {100, 20};
+    for (int l = 0; l < 2; ++l)
+    {
+      json.append(l ? "," : "");
+      json.append("{\"name\":\"").append(layers[l]).append("\",\"chunks\":[");
+      bool first = true;
+      for (int cy = 0; cy < CHUNKS_Y; ++cy)
+      {
+        for (int cx = 0; cx < CHUNKS_X; ++cx)
+        {
+          if (l == 1 && (cx + cy) % 3 != 0)
+            continue;
+          json.append(first ? "" : ",");
+          AppendChunk(cx, cy, density[l], rng, &map, &json);
+          first = false;
+        }
+      }
+      json.append("]}");
+    }
+
+    json.append(",{\"name\":\"Collision\",\"objects\":[");
+    bool first = true;
+    for (int cy = 0; cy < CHUNKS_Y; ++cy)
+    {
+      for (int cx = 0; cx < CHUNKS_X; cx += 5)
+      {
+        // every other rect sticks out into the next chunk
+        float x = cx * CHUNK_PIXELS + 32;
+        float y = cy * CHUNK_PIXELS + 64;
+        float w = cx % 2 ? CHUNK_PIXELS : 64;
+        char buf[128];
+        snprintf(buf,
+            sizeof(buf),
+            "%s{\"x\":%g,\"y\":%g,\"width\":%g,\"height\":32,\"rotation\":0}",
+            first ? "" : ",",
+            x,
+            y,
+            w);
+        json.append(buf);
+        first = false;
+
+        map.hasCollision.insert(ChunkStreamer::ChunkKey(cx, cy));
+        if (cx % 2)
+          map.hasCollision.insert(ChunkStreamer::ChunkKey(cx + 1, cy));
+      }
+    }
+
+    json.append("]}],\"tilesets\":[{\"name\":\"tiles\",\"image\":\"tiles.png\",\"firstgid\":1,"
+                "\"imagewidth\":128,\"imageheight\":128,\"margin\":0,\"spacing\":0,"
+                "\"tilecount\":64,\"tilewidth\":16,\"tileheight\":16}]}");
+    map.json.assign(json.begin(), json.end());
+    return map;
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T>
+  size_t VectorBytes(const vector<T>& v)
+  {
+    return v.capacity() * sizeof(T);
+  }
+
+  //------------------------------------------------------------------------------
+  // Keeps its own count of the memory held by the resident chunks, and checks their
+  // contents against the map
+  struct BudgetTarget : public ChunkStreamTarget
+  {
+    virtual void ChunkLoaded(const StreamedChunk& chunk) override
+    {
+      const TileMesh& mesh = chunk.mesh;
+      const StaticChains& collision = chunk.collision;
+      size_t bytes = VectorBytes(mesh.vertices) + VectorBytes(mesh.spans)
+          + VectorBytes(mesh.chunks) + VectorBytes(mesh.chunkSpans) + VectorBytes(mesh.layers)
+          + VectorBytes(collision.points) + VectorBytes(collision.loopSizes)
+          + VectorBytes(collision.chainSizes);
+
+      CHECK(!resident.count(chunk.key));
+      CHECK_EQ(bytes, chunk.bytes);
+      CHECK_EQ(mesh.vertices.size(), 4 * (size_t)map->numQuads[chunk.key]);
+      CHECK_EQ(!collision.loopSizes.empty(), map->hasCollision.count(chunk.key) == 1);
+
+      resident[chunk.key] = bytes;
+      residentBytes += bytes;
+      peakBytes = max(peakBytes, residentBytes);
+      numLoaded++;
+    }
+
+    virtual void ChunkEvicted(const StreamedChunk& chunk) override
+    {
+      auto it = resident.find(chunk.key);
+      CHECK(it != resident.end());
+      if (it == resident.end())
+        return;
+
+      residentBytes -= it->second;
+      resident.erase(it);
+      numEvicted++;
+    }
+
+    TestMap* map = nullptr;
+    unordered_map<u64, size_t> resident;
+    size_t residentBytes = 0;
+    size_t peakBytes = 0;
+    u32 numLoaded = 0;
+    u32 numEvicted = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // Flies the camera diagonally across the map and back, and checks that the chunks
+  // around it get loaded, while the memory for the chunks never goes over the budget
+  void TestFlyCamera()
+  {
+    TestMap map = MakeMap();
+    TmxLevel level;
+    TmxCollision collision;
+    level.jsonFile.Assign(&map.json);
+    CHECK(ReadTmxJson(level.jsonFile.Data(), level.jsonFile.Size(), "test", &level, &collision));
+    CHECK(level.infinite);
+    CHECK_EQ(level.layers.size(), 2u);
+    CHECK_EQ(level.chunkWidth, CHUNK_SIZE);
+    level.collision = collision;
+
+    ChunkStreamerDesc desc;
+    desc.loadRadius = 600;
+    desc.memoryBudget = MEMORY_BUDGET;
+    desc.meshDesc.tileSize = vec2((float)level.tileWidth, (float)level.tileHeight);
+    TileMeshDesc::Tileset ts;
+    ts.tileCount = 64;
+    ts.tilesPerRow = 8;
+    ts.uvSize = vec2(0.125f, 0.125f);
+    desc.meshDesc.tilesets.push_back(ts);
+
+    ChunkStreamer streamer;
+    CHECK(streamer.Start(&level, desc));
+    // the rects in the last column stick out of the map, into chunks without tiles
+    CHECK_EQ(streamer.GetStats().numSources, (u32)((CHUNKS_X + 1) * CHUNKS_Y));
+
+    BudgetTarget target;
+    target.map = &map;
+
+    // map rows go down from the zero level, so the camera's y is negative
+    const int NUM_FRAMES = 2000;
+    vec2 from = vec2(0, 0);
+    vec2 to = vec2(CHUNKS_X * CHUNK_PIXELS, -CHUNKS_Y * CHUNK_PIXELS);
+    for (int frame = 0; frame <= NUM_FRAMES; ++frame)
+    {
+      float t = (float)(frame <= NUM_FRAMES / 2 ? frame : NUM_FRAMES - frame) / (NUM_FRAMES / 2);
+      vec2 cameraPos = from + t * (to - from);
+
+      // let the loader catch up now and then, so the chunks around the camera are all
+      // in, and everything else has to make room for them
+      if (frame % 8 == 0)
+      {
+        streamer.LoadAround(cameraPos, &target);
+        for (const StreamedChunk* chunk : streamer.Resident())
+          CHECK(target.resident.count(chunk->key));
+      }
+      else
+      {
+        streamer.Update(cameraPos, &target);
+      }
+
+      CHECK(streamer.GetStats().committedBytes <= MEMORY_BUDGET);
+      CHECK(target.residentBytes <= MEMORY_BUDGET);
+    }
+
+    const ChunkStreamer::Stats& stats = streamer.GetStats();
+    CHECK(stats.peakCommittedBytes <= MEMORY_BUDGET);
+    CHECK(target.peakBytes <= MEMORY_BUDGET);
+    CHECK_EQ(stats.residentBytes, target.residentBytes);
+
+    // the flight covered a lot more than fits, and the budget was actually used
+    CHECK(target.numLoaded > 2 * CHUNKS_X);
+    CHECK(target.numEvicted > CHUNKS_X);
+    CHECK(target.peakBytes > MEMORY_BUDGET / 2);
+    CHECK_EQ(stats.numLoaded, target.numLoaded);
+    CHECK_EQ(stats.numEvicted, target.numEvicted);
+
+    streamer.Stop(&target);
+    CHECK(target.resident.empty());
+    CHECK_EQ(target.residentBytes, 0u);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestFlyCamera();
+  return test::TestResult();
+}
@@ -0,0 +1,94 @@
+#include "bench.hpp"
+#include "level_files.hpp"
+#include <lib/file_utils.hpp>
+#include <random>
+
+using namespace world;
+using namespace world::level_files;
+
+namespace
+{
+  const int MAP_SIZE = 4096;
+  const char* JSON_FILE = "cooked_level_bench.json";
+  const char* COOKED_FILE = "cooked_level_bench.lvl";
+}
+
+// Level load time for a 4096x4096 map, from the json with the streaming reader, and
+// from the cooked level, where the tiles are used straight from the mapped file. As the
+// cooked tiles aren't read while loading, it's also timed with a pass over all the
+// tiles, which is when their pages are faulted in. Both files come from the page
+// cache, and a memcpy of the tiles is the reference.
+int main()
+{
+  std::mt19937 rng(1);
+  vector<u32> tiles((size_t)MAP_SIZE * MAP_SIZE);
+  for (u32& gid : tiles)
+    gid = rng() % 4 ? 1 + rng() % 1024 : 0;
+
+  u32 expectedSum = 0;
+  for (u32 gid : tiles)
+    expectedSum += gid;
+
+  string json = MakeJson(MAP_SIZE, TileArray(tiles));
+  vector<char> cooked = MakeCooked(MAP_SIZE, tiles);
+  if (!SaveFile(JSON_FILE, json.data(), (int)json.size())
+      || !SaveFile(COOKED_FILE, cooked.data(), (int)cooked.size()))
+  {
+    printf("unable to write the levels\n");
+    return 1;
+  }
+
+  bool ok = true;
+  double tJson = bench::MinTime(3, [&]() {
+    MappedFile file;
+    TmxLevel level;
+    TmxCollision collision;
+    ok &= file.Open(JSON_FILE)
+          && ReadTmxJson(file.Data(), file.Size(), JSON_FILE, &level, &collision)
+          && SumTiles(level) == expectedSum;
+  });
+
+  double tCooked = bench::MinTime(5, [&]() {
+    TmxLevel level;
+    CookedLevel cookedLevel;
+    ok &= level.cookedFile.Open(COOKED_FILE)
+          && cookedLevel.Init(level.cookedFile.Data(), level.cookedFile.Size());
+    ReadCookedLevel(cookedLevel, &level);
+    bench::DoNotOptimize(level);
+  });
+
+  double tCookedRead = bench::MinTime(5, [&]() {
+    TmxLevel level;
+    CookedLevel cookedLevel;
+    ok &= level.cookedFile.Open(COOKED_FILE)
+          && cookedLevel.Init(level.cookedFile.Data(), level.cookedFile.Size());
+    ReadCookedLevel(cookedLevel, &level);
+    ok &= SumTiles(level) == expectedSum;
+  });
+
+  vector<u32> copy(tiles.size());
+  double tCopy = bench::MinTime(5, [&]() {
+    memcpy(copy.data(), tiles.data(), tiles.size() * sizeof(u32));
+    bench::DoNotOptimize(copy[0]);
+  });
+
+  remove(JSON_FILE);
+  remove(COOKED_FILE);
+
+  double mb = 1024 * 1024;
+  printf("json               %8.2f ms, %6.1f MB, %7.1f MB/s\n",
+      tJson * 1e3,
+      json.size() / mb,
+      json.size() / mb / tJson);
+  printf("cooked             %8.3f ms, %6.1f MB\n", tCooked * 1e3, cooked.size() / mb);
+  printf("cooked, read tiles %8.2f ms, %6.1f MB, %7.1f MB/s\n",
+      tCookedRead * 1e3,
+      cooked.size() / mb,
+      cooked.size() / mb / tCookedRead);
+  printf("memcpy             %8.2f ms, %6.1f MB, %7.1f MB/s\n",
+      tCopy * 1e3,
+      copy.size() * sizeof(u32) / mb,
+      copy.size() * sizeof(u32) / mb / tCopy);
+  printf("%s\n", ok ? "levels match" : "LEVELS DON'T MATCH");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "bench.hpp"
+#include <core/entity_quads.hpp>
+#include <core/entity_store.hpp>
+#include <lib/job_pool.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const u32 NUM_ENTITIES = 256 * 1024;
+  const u32 NUM_SPRITES = 64;
+  const u32 NUM_TEXTURES = 8;
+  const float WORLD_SIZE = 8192;
+  // the size of the renderer's dynamic vertex buffer
+  const u32 MAX_QUADS = 32 * 1024;
+
+  //------------------------------------------------------------------------------
+  // Stands in for the dynamic vertex buffer. The draws are only counted.
+  struct BufferTarget : public MappedQuadTarget
+  {
+    BufferTarget() : buffer(MAX_QUADS * 4) {}
+    virtual u32 MaxQuads() const override { return MAX_QUADS; }
+    virtual PosTex* Map(u32) override { return buffer.data(); }
+    virtual void Unmap() override { bench::DoNotOptimize(buffer[0]); }
+    virtual void Draw(ObjectHandle, u32, u32) override { numDraws++; }
+
+    vector<PosTex> buffer;
+    u32 numDraws = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // The previous path, which built all the quads into a staging buffer, and copied each
+  // batch to the mapped buffer
+  void SubmitStaged(const EntityQuadBuilder& builder,
+      vector<PosTex>* staging,
+      BufferTarget* target,
+      JobPool* pool)
+  {
+    u32 numQuads = builder.NumQuads();
+    staging->resize(numQuads * 4);
+    builder.Build(0, numQuads, staging->data(), pool);
+    for (u32 first = 0; first < numQuads; first += MAX_QUADS)
+    {
+      u32 cnt = min(numQuads - first, MAX_QUADS);
+      PosTex* vtx = target->Map(cnt);
+      memcpy(vtx, staging->data() + first * 4, cnt * 4 * sizeof(PosTex));
+      target->Unmap();
+    }
+  }
+}
+
+// Entity quads per second for 256K entities over 8 textures, with about half of them
+// in view, for a range of job pool sizes. "in place" builds straight into the mapped
+// buffer, and "staged" builds into a staging buffer first, and copies it over. Both
+// include the bucketing in Prepare. The worker count is in addition to the calling
+// thread, and going above the number of hardware threads only adds time slicing.
+int main()
+{
+  std::mt19937 rng(1);
+  vector<SpriteQuad> sprites(NUM_SPRITES);
+  vector<u16> textureSlot(NUM_SPRITES);
+  vector<ObjectHandle> textures(NUM_TEXTURES);
+  for (u32 i = 0; i < NUM_SPRITES; ++i)
+  {
+    float uv = (float)i / NUM_SPRITES;
+    sprites[i] = SpriteQuad{uv, uv, uv + 0.015625f, uv + 0.015625f, 32, 32, {0, 0}};
+    textureSlot[i] = (u16)(i % NUM_TEXTURES);
+  }
+
+  EntityStore entities;
+  for (u32 i = 0; i < NUM_ENTITIES; ++i)
+  {
+    vec2 pos((float)(rng() % (u32)WORLD_SIZE), (float)(rng() % (u32)WORLD_SIZE));
+    entities.Add(i, pos, (u16)(rng() % NUM_SPRITES));
+  }
+
+  vec2 minPos(0, 0);
+  vec2 maxPos(WORLD_SIZE / 2, WORLD_SIZE);
+  BufferTarget target;
+  vector<PosTex> staging;
+
+  printf("%u hardware threads\n", std::thread::hardware_concurrency());
+  printf("M quads/s    in place   staged\n");
+  for (int numWorkers : {0, 1, 2, 3, 5, 7, 15})
+  {
+    JobPool pool;
+    pool.Init(numWorkers);
+    EntityQuadBuilder builder;
+    u32 numQuads = 0;
+    double tInPlace = bench::MinTime(10, [&]() {
+      numQuads = builder.Prepare(entities,
+          sprites.data(),
+          textureSlot.data(),
+          NUM_TEXTURES,
+          minPos,
+          maxPos,
+          &pool);
+      builder.Submit(textures.data(), &target, &pool);
+    });
+
+    double tStaged = bench::MinTime(10, [&]() {
+      builder.Prepare(entities,
+          sprites.data(),
+          textureSlot.data(),
+          NUM_TEXTURES,
+          minPos,
+          maxPos,
+          &pool);
+      SubmitStaged(builder, &staging, &target, &pool);
+    });
+
+    printf("%2d workers %10.1f %8.1f\n",
+        numWorkers,
+        numQuads / tInPlace / 1e6,
+        numQuads / tStaged / 1e6);
+  }
+
+  return 0;
+}
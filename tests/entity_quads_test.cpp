@@ -0,0 +1,155 @@
+#include "test.hpp"
+#include <core/entity_quads.hpp>
+#include <core/entity_store.hpp>
+#include <lib/job_pool.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // The handle constructors are only for the graphics code, so the test textures are
+  // made from their raw bits
+  ObjectHandle MakeTexture(u32 id)
+  {
+    u32 raw = ObjectHandle::kTexture | (id << 8);
+    ObjectHandle handle;
+    memcpy((void*)&handle, &raw, sizeof(handle));
+    return handle;
+  }
+
+  //------------------------------------------------------------------------------
+  // Keeps a copy of every mapping, and the draws from it
+  struct RecordingTarget : public MappedQuadTarget
+  {
+    struct DrawCall
+    {
+      u32 texture;
+      vector<PosTex> vertices;
+    };
+
+    RecordingTarget(u32 maxQuads) : maxQuads(maxQuads) {}
+    virtual u32 MaxQuads() const override { return maxQuads; }
+
+    virtual PosTex* Map(u32 numQuads) override
+    {
+      CHECK(numQuads <= maxQuads);
+      buffer.resize(numQuads * 4);
+      numMaps++;
+      return buffer.data();
+    }
+
+    virtual void Unmap() override {}
+
+    virtual void Draw(ObjectHandle texture, u32 firstQuad, u32 numQuads) override
+    {
+      CHECK((firstQuad + numQuads) * 4 <= buffer.size());
+      const PosTex* vtx = buffer.data() + firstQuad * 4;
+      draws.push_back(DrawCall{texture.ToInt(), vector<PosTex>(vtx, vtx + numQuads * 4)});
+    }
+
+    u32 maxQuads;
+    u32 numMaps = 0;
+    vector<PosTex> buffer;
+    vector<DrawCall> draws;
+  };
+
+  //------------------------------------------------------------------------------
+  // Adds entities with random sprites and positions, some without a sprite, and checks
+  // that the quads drawn for each texture match the quads from the serial loop, in
+  // entity order, for pools with and without workers.
+  void TestSubmit(u32 numEntities, u32 numTextures, u32 maxQuads, int numWorkers)
+  {
+    std::mt19937 rng(numEntities * 31 + maxQuads);
+    const u32 numSprites = 16;
+    vector<SpriteQuad> sprites(numSprites);
+    vector<u16> textureSlot(numSprites);
+    vector<ObjectHandle> textures;
+    for (u32 i = 0; i < numTextures; ++i)
+      textures.push_back(MakeTexture(i + 1));
+    for (u32 i = 0; i < numSprites; ++i)
+    {
+      float uv = (float)i / numSprites;
+      sprites[i] = SpriteQuad{uv, uv, uv + 0.0625f, uv + 0.0625f, 16, (float)(8 + i), {0, 0}};
+      textureSlot[i] = (u16)(rng() % numTextures);
+    }
+
+    EntityStore entities;
+    for (u32 i = 0; i < numEntities; ++i)
+    {
+      u16 sprite = rng() % 8 ? (u16)(rng() % numSprites) : (u16)EntityQuadBuilder::INVALID_SPRITE;
+      entities.Add(i, vec2((float)(rng() % 2000), (float)(rng() % 2000)), sprite);
+    }
+
+    vec2 minPos(500, 500);
+    vec2 maxPos(1500, 1500);
+    JobPool pool;
+    pool.Init(numWorkers);
+    EntityQuadBuilder builder;
+    u32 numQuads = builder.Prepare(entities,
+        sprites.data(),
+        textureSlot.data(),
+        numTextures,
+        minPos,
+        maxPos,
+        &pool);
+    RecordingTarget target(maxQuads);
+    builder.Submit(textures.data(), &target, &pool);
+
+    // the serial loop, one texture at a time
+    u32 expectedQuads = 0;
+    for (u32 t = 0; t < numTextures; ++t)
+    {
+      vector<PosTex> expected;
+      for (u32 i = 0; i < entities.Size(); ++i)
+      {
+        u32 sprite = entities.Sprites()[i];
+        if (sprite == EntityQuadBuilder::INVALID_SPRITE || textureSlot[sprite] != t)
+          continue;
+
+        const vec2& p = entities.Pos()[i];
+        const SpriteQuad& quad = sprites[sprite];
+        if (p.x < maxPos.x && p.x + quad.width > minPos.x && p.y > minPos.y
+            && p.y - quad.height < maxPos.y)
+        {
+          PosTex vtx[4];
+          BuildQuadsScalar(&p, &sprite, 1, sprites.data(), 0.5f, vtx);
+          expected.insert(expected.end(), vtx, vtx + 4);
+        }
+      }
+
+      vector<PosTex> drawn;
+      for (const RecordingTarget::DrawCall& draw : target.draws)
+      {
+        if (draw.texture == textures[t].ToInt())
+          drawn.insert(drawn.end(), draw.vertices.begin(), draw.vertices.end());
+      }
+
+      CHECK_EQ(drawn.size(), expected.size());
+      CHECK(memcmp(drawn.data(), expected.data(), expected.size() * sizeof(PosTex)) == 0);
+      CHECK_EQ(builder.Draws()[t].numQuads * 4, (u32)expected.size());
+      expectedQuads += (u32)expected.size() / 4;
+    }
+
+    // the buffer is mapped once for every maxQuads quads
+    CHECK_EQ(numQuads, expectedQuads);
+    CHECK_EQ(target.numMaps, (numQuads + maxQuads - 1) / maxQuads);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  for (int numWorkers : {0, 3})
+  {
+    TestSubmit(0, 1, 16, numWorkers);
+    TestSubmit(1, 1, 16, numWorkers);
+    TestSubmit(1000, 1, 1000, numWorkers);
+    TestSubmit(5000, 4, 100000, numWorkers);
+    TestSubmit(5000, 4, 64, numWorkers);
+    TestSubmit(20000, 7, 333, numWorkers);
+    TestSubmit(3000, 3, 1, numWorkers);
+  }
+  return test::TestResult();
+}
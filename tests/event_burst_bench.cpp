@@ -0,0 +1,117 @@
+#include "bench.hpp"
+#include <core/event_manager.hpp>
+
+using namespace world;
+
+namespace
+{
+  const int BURST_SIZE = 1000000;
+
+  struct KeyCounter
+  {
+    void OnKeyDown(const event::KeyDown& event) { sum += event.key; }
+    u64 sum = 0;
+  };
+
+  // The old event queue, a flat 32 MB buffer that's part of the manager, with a single
+  // std::function listener
+  struct FlatQueue
+  {
+    enum { EVENT_BUF_SIZE = 32 * 1024 * 1024 };
+
+    void AddEvent(event::EventType type, const void* data, int len)
+    {
+      event::EventHeader header = {(u32)type, (u32)(sizeof(header) + len)};
+      memcpy(&buf[ofs], &header, sizeof(header));
+      memcpy(&buf[ofs + sizeof(header)], data, len);
+      ofs += header.len;
+    }
+
+    void Tick()
+    {
+      for (u32 cur = 0; cur < ofs;)
+      {
+        const event::EventHeader* header = (const event::EventHeader*)&buf[cur];
+        listener(header + 1);
+        cur += header->len;
+      }
+      ofs = 0;
+    }
+
+    char buf[EVENT_BUF_SIZE];
+    u32 ofs = 0;
+    std::function<void(const void*)> listener;
+  };
+}
+
+// A burst of 1M events posted in a single frame, and dispatched on the next Tick, for
+// the old flat buffer and the paged queue, timed in total and for just the posting. Also
+// shows the pages the burst needs, and that they're freed again after the quiet frames.
+int main()
+{
+  KeyCounter flatCounter, pagedCounter;
+  FlatQueue* flat = new FlatQueue();
+  flat->listener = [&](const void* event) {
+    flatCounter.OnKeyDown(*(const event::KeyDown*)event);
+  };
+  double tFlat = 1e30;
+  double tFlatPost = 1e30;
+  for (int rep = 0; rep < 5; ++rep)
+  {
+    double start = bench::Now();
+    for (int i = 0; i < BURST_SIZE; ++i)
+    {
+      event::KeyDown event(i);
+      flat->AddEvent(event::kEventKeyDown, &event, sizeof(event));
+    }
+    double posted = bench::Now();
+    flat->Tick();
+    tFlatPost = min(tFlatPost, posted - start);
+    tFlat = min(tFlat, bench::Now() - start);
+  }
+  delete flat;
+
+  // the first burst allocates the pages, and the rest reuse them
+  EventManager::Create();
+  g_eventManager->Subscribe(&pagedCounter, &KeyCounter::OnKeyDown);
+  double tFirst = 0;
+  double tPaged = 1e30;
+  double tPagedPost = 1e30;
+  for (int rep = 0; rep < 5; ++rep)
+  {
+    double start = bench::Now();
+    for (int i = 0; i < BURST_SIZE; ++i)
+      g_eventManager->AddEvent(event::KeyDown(i));
+    double posted = bench::Now();
+    g_eventManager->Tick();
+    double t = bench::Now() - start;
+    tFirst = rep == 0 ? t : tFirst;
+    tPaged = min(tPaged, t);
+    tPagedPost = min(tPagedPost, posted - start);
+  }
+
+  const EventManager::Stats& stats = g_eventManager->_stats;
+  u32 burstPages = stats.numPagesAllocated;
+  // the pages are freed once a whole window of quiet frames has passed, without the burst
+  for (int i = 0; i < 2 * EventManager::QUIET_FRAMES; ++i)
+    g_eventManager->Tick();
+
+  printf("M events/s    post+tick       post\n");
+  printf("flat buffer  %10.1f %10.1f, %u KB resident\n",
+      BURST_SIZE / tFlat / 1e6,
+      BURST_SIZE / tFlatPost / 1e6,
+      (u32)(sizeof(FlatQueue) / 1024));
+  printf("paged queue  %10.1f %10.1f, %.1f on the first burst\n",
+      BURST_SIZE / tPaged / 1e6,
+      BURST_SIZE / tPagedPost / 1e6,
+      BURST_SIZE / tFirst / 1e6);
+  printf("high water mark %u KB, %u pages for the burst, %u after the quiet frames\n",
+      stats.highWaterMark / 1024,
+      burstPages,
+      stats.numPagesAllocated);
+
+  bench::DoNotOptimize(flatCounter.sum);
+  bench::DoNotOptimize(pagedCounter.sum);
+  EventManager::Destroy();
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include "bench.hpp"
+#include <core/event_manager.hpp>
+
+using namespace world;
+
+namespace
+{
+  const int EVENTS_PER_FRAME = 10000;
+  const int NUM_FRAMES = 1000;
+
+  struct KeyCounter
+  {
+    void OnKeyDown(const event::KeyDown& event) { sum += event.key + event.modifiers; }
+    u64 sum = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  // The old dispatch path: events carry their type and length in a base struct, are
+  // copied into a flat buffer, and each listener is a std::function that downcasts.
+  struct EventBase
+  {
+    event::EventType type;
+    int len;
+  };
+
+  struct FlatKeyDown : public EventBase
+  {
+    int key;
+    u8 modifiers;
+  };
+
+  struct FlatEventManager
+  {
+    typedef std::function<void(const EventBase*)> fnEventListener;
+
+    // both out of line, like the real thing
+    __attribute__((noinline)) void AddEvent(EventBase* event, int len)
+    {
+      event->len = len;
+      memcpy(&buf[ofs], event, len);
+      ofs += len;
+    }
+
+    __attribute__((noinline)) void Dispatch(const EventBase* event)
+    {
+      for (const fnEventListener& listener : listeners[event->type])
+        listener(event);
+    }
+
+    void Tick()
+    {
+      for (char* cur = buf.data(); cur < buf.data() + ofs;)
+      {
+        const EventBase* event = (const EventBase*)cur;
+        Dispatch(event);
+        cur += event->len;
+      }
+      ofs = 0;
+    }
+
+    vector<char> buf = vector<char>(EVENTS_PER_FRAME * sizeof(FlatKeyDown));
+    u32 ofs = 0;
+    vector<fnEventListener> listeners[event::kEventCount];
+  };
+
+  //------------------------------------------------------------------------------
+  template <typename Fn>
+  void TimeEventManager(Fn subscribe, double* tDispatch, double* tPostAndTick)
+  {
+    EventManager::Create();
+    subscribe();
+
+    struct Record
+    {
+      event::EventHeader header;
+      event::KeyDown event;
+    };
+    vector<Record> records;
+    for (int i = 0; i < EVENTS_PER_FRAME; ++i)
+      records.push_back(Record{{event::kEventKeyDown, sizeof(Record)}, event::KeyDown(i)});
+
+    *tDispatch = bench::MinTime(3, [&]() {
+      for (int frame = 0; frame < NUM_FRAMES; ++frame)
+      {
+        for (const Record& record : records)
+          g_eventManager->Dispatch(&record.header);
+      }
+    });
+
+    *tPostAndTick = bench::MinTime(3, [&]() {
+      for (int frame = 0; frame < NUM_FRAMES; ++frame)
+      {
+        for (int i = 0; i < EVENTS_PER_FRAME; ++i)
+          g_eventManager->AddEvent(event::KeyDown(i));
+        g_eventManager->Tick();
+      }
+    });
+    EventManager::Destroy();
+  }
+}
+
+// 10M KeyDown events dispatched to a member function listener, with the old std::function
+// path, with Subscribe, and with Subscribe binding the method at compile time. Timed both
+// for just the dispatch, and including posting the events and the Tick.
+int main()
+{
+  double tFlat, tTyped, tBound, tFlatDispatch, tTypedDispatch, tBoundDispatch;
+  KeyCounter flatCounter, typedCounter, boundCounter;
+  {
+    FlatEventManager* mgr = new FlatEventManager();
+    mgr->listeners[event::kEventKeyDown].push_back([&](const EventBase* base) {
+      const FlatKeyDown* event = (const FlatKeyDown*)base;
+      flatCounter.OnKeyDown(event::KeyDown(event->key, event->modifiers));
+    });
+
+    vector<FlatKeyDown> events(EVENTS_PER_FRAME);
+    for (int i = 0; i < EVENTS_PER_FRAME; ++i)
+    {
+      events[i].type = event::kEventKeyDown;
+      events[i].len = sizeof(FlatKeyDown);
+      events[i].key = i;
+      events[i].modifiers = 0;
+    }
+
+    tFlatDispatch = bench::MinTime(3, [&]() {
+      for (int frame = 0; frame < NUM_FRAMES; ++frame)
+      {
+        for (const FlatKeyDown& event : events)
+          mgr->Dispatch(&event);
+      }
+    });
+
+    tFlat = bench::MinTime(3, [&]() {
+      for (int frame = 0; frame < NUM_FRAMES; ++frame)
+      {
+        for (int i = 0; i < EVENTS_PER_FRAME; ++i)
+        {
+          FlatKeyDown event;
+          event.type = event::kEventKeyDown;
+          event.key = i;
+          event.modifiers = 0;
+          mgr->AddEvent(&event, sizeof(event));
+        }
+        mgr->Tick();
+      }
+    });
+    delete mgr;
+  }
+
+  TimeEventManager(
+      [&]() { g_eventManager->Subscribe(&typedCounter, &KeyCounter::OnKeyDown); },
+      &tTypedDispatch,
+      &tTyped);
+  TimeEventManager(
+      [&]() {
+        g_eventManager->Subscribe<event::KeyDown, KeyCounter, &KeyCounter::OnKeyDown>(
+            &boundCounter);
+      },
+      &tBoundDispatch,
+      &tBound);
+
+  bench::DoNotOptimize(flatCounter.sum);
+  bench::DoNotOptimize(typedCounter.sum);
+  bench::DoNotOptimize(boundCounter.sum);
+  double m = (double)EVENTS_PER_FRAME * NUM_FRAMES / 1e6;
+  printf("M events/s      dispatch   post+tick\n");
+  printf("std::function %10.1f  %10.1f\n", m / tFlatDispatch, m / tFlat);
+  printf("Subscribe     %10.1f  %10.1f\n", m / tTypedDispatch, m / tTyped);
+  printf("bound method  %10.1f  %10.1f\n", m / tBoundDispatch, m / tBound);
+  return 0;
+}
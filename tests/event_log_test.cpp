@@ -0,0 +1,203 @@
+#include "test.hpp"
+#include <core/event_log.hpp>
+#include <core/event_manager.hpp>
+#include <fstream>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const char* LOG_FILE = "event_log_test.evl";
+  const char* BAD_LOG_FILE = "event_log_test_bad.evl";
+
+  struct Seen
+  {
+    u64 frame;
+    u32 type;
+    int key;
+    u8 modifiers;
+
+    bool operator==(const Seen& rhs) const
+    {
+      return frame == rhs.frame && type == rhs.type && key == rhs.key
+             && modifiers == rhs.modifiers;
+    }
+  };
+
+  // Keeps the dispatched events, with the frames relative to 'baseFrame'
+  struct EventSink
+  {
+    void OnKeyDown(const event::KeyDown& e) { Add(event::kEventKeyDown, e.key, e.modifiers); }
+    void OnKeyUp(const event::KeyUp& e) { Add(event::kEventKeyUp, e.key, e.modifiers); }
+
+    void Add(u32 type, int key, u8 modifiers)
+    {
+      seen.push_back(Seen{g_eventManager->CurrentFrame() - baseFrame, type, key, modifiers});
+    }
+
+    u64 baseFrame = 0;
+    vector<Seen> seen;
+  };
+
+  //------------------------------------------------------------------------------
+  void CreateManager(EventSink* sink)
+  {
+    EventManager::Create();
+    g_eventManager->Subscribe(sink, &EventSink::OnKeyDown);
+    g_eventManager->Subscribe(sink, &EventSink::OnKeyUp);
+  }
+
+  //------------------------------------------------------------------------------
+  vector<char> ReadFile(const char* filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    return vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  //------------------------------------------------------------------------------
+  void WriteFile(const char* filename, const vector<char>& buf)
+  {
+    std::ofstream file(filename, std::ios::binary);
+    file.write(buf.data(), buf.size());
+  }
+
+  //------------------------------------------------------------------------------
+  // Records a few seconds of events posted with different priorities, from timers, and
+  // from listeners, with some frames that have no events
+  vector<Seen> Record()
+  {
+    EventSink sink;
+    CreateManager(&sink);
+    for (int i = 0; i < 5; ++i)
+      g_eventManager->Tick();
+
+    CHECK(g_eventManager->StartRecording(LOG_FILE));
+    sink.baseFrame = g_eventManager->CurrentFrame() + 1;
+
+    std::mt19937 rng(1);
+    for (int frame = 0; frame < 200; ++frame)
+    {
+      int numEvents = frame % 7 == 3 ? 0 : rng() % 20;
+      for (int i = 0; i < numEvents; ++i)
+      {
+        event::EventPriority priority = (event::EventPriority)(rng() % event::kPriorityCount);
+        if (rng() % 2)
+          g_eventManager->AddEvent(event::KeyDown(frame * 100 + i, (u8)priority), priority);
+        else
+          g_eventManager->AddEvent(event::KeyUp(frame * 100 + i, (u8)priority), priority);
+      }
+
+      if (frame % 10 == 0)
+        g_eventManager->AddEventAtFrame(event::KeyDown(-frame), g_eventManager->CurrentFrame() + 3);
+      g_eventManager->Tick();
+    }
+
+    g_eventManager->StopRecording();
+    EventManager::Destroy();
+    return sink.seen;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestReplay(const vector<Seen>& recorded)
+  {
+    EventSink sink;
+    CreateManager(&sink);
+    for (int i = 0; i < 17; ++i)
+      g_eventManager->Tick();
+
+    // events queued before the replay starts are dropped, and so are the ones posted
+    // while it's running
+    g_eventManager->AddEvent(event::KeyDown(12345));
+    g_eventManager->AddEventAtFrame(event::KeyUp(54321), g_eventManager->CurrentFrame() + 2);
+    CHECK(g_eventManager->StartReplay(LOG_FILE));
+    sink.baseFrame = g_eventManager->CurrentFrame() + 1;
+
+    int numFrames = 0;
+    while (g_eventManager->_replay && numFrames++ < 1000)
+    {
+      g_eventManager->AddEvent(event::KeyUp(-1));
+      g_eventManager->Tick();
+    }
+
+    CHECK(!g_eventManager->_replay);
+    CHECK(!recorded.empty());
+    CHECK(sink.seen == recorded);
+
+    // and once it's done, the live events are back
+    size_t numSeen = sink.seen.size();
+    g_eventManager->AddEvent(event::KeyDown(1));
+    g_eventManager->Tick();
+    CHECK_EQ(sink.seen.size(), numSeen + 1);
+    EventManager::Destroy();
+  }
+
+  //------------------------------------------------------------------------------
+  bool OpenModified(const vector<char>& log, size_t ofs, const void* data, size_t len)
+  {
+    vector<char> buf = log;
+    memcpy(&buf[ofs], data, len);
+    WriteFile(BAD_LOG_FILE, buf);
+    EventLogReader reader;
+    return reader.Open(BAD_LOG_FILE);
+  }
+
+  //------------------------------------------------------------------------------
+  // Logs with a single bad record are refused as a whole
+  void TestCorrupt()
+  {
+    vector<char> log = ReadFile(LOG_FILE);
+    CHECK(log.size() > sizeof(EventLogHeader) + 2 * sizeof(EventLogFrame));
+
+    EventLogReader reader;
+    CHECK(reader.Open(LOG_FILE));
+    CHECK(!OpenModified(log, 0, "xxxx", 4));
+
+    // the first record of the second frame
+    const EventLogHeader* header = (const EventLogHeader*)log.data();
+    const EventLogFrame* frame = (const EventLogFrame*)&log[header->headerSize];
+    size_t frameOfs = header->headerSize + sizeof(EventLogFrame) + frame->size;
+    size_t recordOfs = frameOfs + sizeof(EventLogFrame);
+    event::EventHeader record;
+    memcpy(&record, &log[recordOfs], sizeof(record));
+
+    u32 lens[] = {0, 4, record.len + 4, record.len - 8, 1u << 30};
+    for (u32 len : lens)
+    {
+      event::EventHeader bad = {record.type, len};
+      CHECK(!OpenModified(log, recordOfs, &bad, sizeof(bad)));
+    }
+
+    event::EventHeader badType = {event::kEventCount, record.len};
+    CHECK(!OpenModified(log, recordOfs, &badType, sizeof(badType)));
+
+    // frame headers that don't match the records, or are out of order
+    EventLogFrame badFrame = *(const EventLogFrame*)&log[frameOfs];
+    badFrame.numEvents++;
+    CHECK(!OpenModified(log, frameOfs, &badFrame, sizeof(badFrame)));
+    badFrame.numEvents--;
+    badFrame.frame = frame->frame;
+    CHECK(!OpenModified(log, frameOfs, &badFrame, sizeof(badFrame)));
+
+    u32 headerSize = 4;
+    CHECK(!OpenModified(log, offsetof(EventLogHeader, headerSize), &headerSize, 4));
+
+    // a log cut off in the middle of a frame keeps the frames before it
+    vector<char> truncated(log.begin(), log.begin() + recordOfs + 4);
+    WriteFile(BAD_LOG_FILE, truncated);
+    CHECK(reader.Open(BAD_LOG_FILE));
+    CHECK_EQ(reader.LastFrame(), frame->frame);
+    reader.Close();
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  vector<Seen> recorded = Record();
+  TestReplay(recorded);
+  TestCorrupt();
+  remove(LOG_FILE);
+  remove(BAD_LOG_FILE);
+  return test::TestResult();
+}
@@ -0,0 +1,136 @@
+#include "test.hpp"
+#include <core/event_manager.hpp>
+
+using namespace world;
+
+namespace
+{
+  struct KeyCounter
+  {
+    void OnKeyDown(const event::KeyDown& event) { sum += event.key, count++; }
+    int sum = 0;
+    int count = 0;
+  };
+
+  // Logs the keys it sees, and posts the keys it's told to from its listener
+  struct KeyLog
+  {
+    void OnKeyDown(const event::KeyDown& event)
+    {
+      keys.push_back(event.key);
+      if (event.key == postOn)
+        g_eventManager->AddEvent(event::KeyDown(postKey), postPriority);
+    }
+
+    vector<int> keys;
+    int postOn = -1;
+    int postKey = 0;
+    event::EventPriority postPriority = event::kPriorityHigh;
+  };
+
+  //------------------------------------------------------------------------------
+  void WaitFor(const std::atomic<int>& step, int value)
+  {
+    while (step.load() < value)
+      std::this_thread::yield();
+  }
+
+  //------------------------------------------------------------------------------
+  // The ring of a producer thread that has exited is drained, and then freed
+  void TestRetire()
+  {
+    EventManager::Create();
+    KeyCounter counter;
+    g_eventManager->Subscribe(&counter, &KeyCounter::OnKeyDown);
+
+    std::thread thread([]() {
+      for (int i = 0; i < 100; ++i)
+        g_eventManager->AddEvent(event::KeyDown(1));
+    });
+    thread.join();
+
+    g_eventManager->Tick();
+    CHECK_EQ(counter.count, 100);
+    CHECK(g_eventManager->_producerOrder.empty());
+    EventManager::Destroy();
+  }
+
+  //------------------------------------------------------------------------------
+  // A thread that outlives its event manager gets a new ring from the next one, even if
+  // it ends up at the same address, and frees the old ring itself
+  void TestNewManager()
+  {
+    std::atomic<int> step{0};
+    EventManager::Create();
+
+    std::thread thread([&]() {
+      g_eventManager->AddEvent(event::KeyDown(1));
+      step = 1;
+      WaitFor(step, 2);
+      g_eventManager->AddEvent(event::KeyDown(2));
+      step = 3;
+      WaitFor(step, 4);
+    });
+
+    WaitFor(step, 1);
+    EventManager::Destroy();
+    EventManager::Create();
+    KeyCounter counter;
+    g_eventManager->Subscribe(&counter, &KeyCounter::OnKeyDown);
+    step = 2;
+
+    WaitFor(step, 3);
+    g_eventManager->Tick();
+    CHECK_EQ(counter.count, 1);
+    CHECK_EQ(counter.sum, 2);
+    CHECK_EQ(g_eventManager->_producerOrder.size(), 1u);
+
+    step = 4;
+    thread.join();
+    g_eventManager->Tick();
+    CHECK(g_eventManager->_producerOrder.empty());
+    EventManager::Destroy();
+  }
+  //------------------------------------------------------------------------------
+  // Lanes are dispatched in priority order, and an event that a listener posts to a
+  // higher priority lane goes ahead of the lower priority lanes, but after the lane being
+  // dispatched
+  void TestPriorities()
+  {
+    EventManager::Create();
+    KeyLog log;
+    g_eventManager->Subscribe<event::KeyDown, KeyLog, &KeyLog::OnKeyDown>(&log);
+    log.postOn = 2;
+    log.postKey = 10;
+
+    g_eventManager->AddEvent(event::KeyDown(4), event::kPriorityLow);
+    g_eventManager->AddEvent(event::KeyDown(2), event::kPriorityNormal);
+    g_eventManager->AddEvent(event::KeyDown(3), event::kPriorityNormal);
+    g_eventManager->AddEvent(event::KeyDown(1), event::kPriorityHigh);
+    g_eventManager->Tick();
+    CHECK(log.keys == vector<int>({1, 2, 3, 10, 4}));
+
+    // events posted to the lane being dispatched are dispatched in the same tick, across
+    // page boundaries
+    const int numEvents = 3 * EventPage::PAGE_SIZE / (int)EventManager::RecordSize(8);
+    log.keys.clear();
+    log.postOn = 0;
+    log.postKey = 1;
+    log.postPriority = event::kPriorityNormal;
+    for (int i = 0; i < numEvents; ++i)
+      g_eventManager->AddEvent(event::KeyDown(0));
+    g_eventManager->Tick();
+    CHECK_EQ(log.keys.size(), 2u * numEvents);
+    CHECK(log.keys.back() == 1);
+    EventManager::Destroy();
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestRetire();
+  TestNewManager();
+  TestPriorities();
+  return test::TestResult();
+}
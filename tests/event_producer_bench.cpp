@@ -0,0 +1,82 @@
+#include "bench.hpp"
+#include <core/event_manager.hpp>
+
+using namespace world;
+
+namespace
+{
+  // Each round, every producer posts a burst that fits in its ring, so events are never
+  // dropped, and the main thread ticks until it has seen all of them
+  const int EVENTS_PER_ROUND = 60000;
+  const int NUM_ROUNDS = 16;
+  const int MAX_THREADS = 16;
+
+  // Checks that each producer's events arrive in the order they were posted. The key is
+  // the event's sequence number, and the modifiers the producer.
+  struct OrderChecker
+  {
+    void OnKeyDown(const event::KeyDown& event)
+    {
+      numErrors += event.key != nextKey[event.modifiers];
+      nextKey[event.modifiers] = event.key + 1;
+      numEvents++;
+    }
+
+    int nextKey[MAX_THREADS] = {};
+    u64 numEvents = 0;
+    u64 numErrors = 0;
+  };
+
+  //------------------------------------------------------------------------------
+  void RunProducers(int numThreads)
+  {
+    EventManager::Create();
+    OrderChecker checker;
+    g_eventManager->Subscribe(&checker, &OrderChecker::OnKeyDown);
+
+    std::atomic<int> round{0};
+    vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+      threads.push_back(std::thread([&, t]() {
+        int key = 0;
+        for (int r = 1; r <= NUM_ROUNDS; ++r)
+        {
+          while (round.load(std::memory_order_acquire) < r)
+            std::this_thread::yield();
+          for (int i = 0; i < EVENTS_PER_ROUND; ++i)
+            g_eventManager->AddEvent(event::KeyDown(key++, (u8)t));
+        }
+      }));
+    }
+
+    double start = bench::Now();
+    for (int r = 1; r <= NUM_ROUNDS; ++r)
+    {
+      round.store(r, std::memory_order_release);
+      while (checker.numEvents < (u64)r * numThreads * EVENTS_PER_ROUND)
+        g_eventManager->Tick();
+    }
+    double elapsed = bench::Now() - start;
+
+    for (std::thread& thread : threads)
+      thread.join();
+
+    u64 numEvents = (u64)NUM_ROUNDS * numThreads * EVENTS_PER_ROUND;
+    printf("%2d producers %8.1f M events/s%s\n",
+        numThreads,
+        numEvents / elapsed / 1e6,
+        checker.numErrors || checker.numEvents != numEvents ? " (out of order!)" : "");
+    EventManager::Destroy();
+  }
+}
+
+// Events per second posted from 1-16 producer threads, and dispatched on the main thread.
+// Above the number of cores, the producers compete with the main thread for cpu time.
+int main()
+{
+  printf("%u hardware threads\n", std::thread::hardware_concurrency());
+  for (int numThreads = 1; numThreads <= MAX_THREADS; numThreads *= 2)
+    RunProducers(numThreads);
+  return 0;
+}
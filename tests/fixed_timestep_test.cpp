@@ -0,0 +1,137 @@
+#include "test.hpp"
+#include <lib/fixed_timestep.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const double STEP = 1.0 / 60;
+  const int MAX_STEPS = 5;
+
+  //------------------------------------------------------------------------------
+  // Runs a frame time trace, and checks that no time is lost or made up: the simulated
+  // time plus the remainder is the wall time, minus the time dropped by the clamp.
+  void RunTrace(const vector<double>& frameTimes, int* totalSteps, double* simTime)
+  {
+    FixedTimestep timestep(STEP, MAX_STEPS);
+    double wallTime = 0;
+    *totalSteps = 0;
+    for (double frameTime : frameTimes)
+    {
+      int numSteps = timestep.Advance(frameTime);
+      CHECK(numSteps >= 0 && numSteps <= MAX_STEPS);
+      CHECK(timestep.Alpha() >= 0 && timestep.Alpha() < 1);
+
+      wallTime += max(frameTime, 0.0);
+      *totalSteps += numSteps;
+      double accounted = *totalSteps * STEP + timestep.Alpha() * STEP
+                         + timestep.GetStats().droppedTime;
+      CHECK(fabs(accounted - wallTime) < 1e-6);
+    }
+
+    CHECK_EQ(timestep.GetStats().numFrames, (u32)frameTimes.size());
+    *simTime = *totalSteps * STEP;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestSteadyRates()
+  {
+    // display rates above, at and below the simulation rate
+    double rates[] = {144, 120, 60, 50, 30};
+    for (double rate : rates)
+    {
+      vector<double> trace(10 * (int)rate, 1 / rate);
+      int totalSteps;
+      double simTime;
+      RunTrace(trace, &totalSteps, &simTime);
+
+      // 10 seconds is 600 steps, give or take the one in the accumulator
+      CHECK(totalSteps >= 599 && totalSteps <= 600);
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  void TestJitter()
+  {
+    // frame times anywhere between 1 and 70 ms, so some frames run 4 steps, and some none
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(0.001, 0.070);
+    vector<double> trace(10000);
+    for (double& t : trace)
+      t = dist(rng);
+
+    int totalSteps;
+    double simTime;
+    RunTrace(trace, &totalSteps, &simTime);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestSpike()
+  {
+    FixedTimestep timestep(STEP, MAX_STEPS);
+    for (int i = 0; i < 100; ++i)
+      timestep.Advance(STEP);
+
+    // a 2 second hitch runs the max steps, and drops the rest instead of catching up
+    CHECK_EQ(timestep.Advance(2.0), MAX_STEPS);
+    CHECK_EQ(timestep.GetStats().numClampedFrames, 1u);
+    CHECK(fabs(timestep.GetStats().droppedTime - (2.0 - MAX_STEPS * STEP)) < STEP);
+
+    // and the frames after it are back to normal
+    for (int i = 0; i < 10; ++i)
+    {
+      int numSteps = timestep.Advance(STEP);
+      CHECK(numSteps >= 0 && numSteps <= 2);
+    }
+    CHECK_EQ(timestep.GetStats().numClampedFrames, 1u);
+
+    // the clock going backwards doesn't step, or rewind the accumulator
+    float alpha = timestep.Alpha();
+    CHECK_EQ(timestep.Advance(-1.0), 0);
+    CHECK(timestep.Alpha() == alpha);
+
+    timestep.Reset();
+    CHECK(timestep.Alpha() == 0);
+    CHECK_EQ(timestep.GetStats().numFrames, 0u);
+    CHECK(timestep.GetStats().droppedTime == 0);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestInterpolation()
+  {
+    // A body moving at a constant speed, stepped at the fixed rate, and rendered by
+    // interpolating between the last two steps. That puts it exactly one step behind
+    // the wall clock, however the frame times line up with the steps.
+    const double SPEED = 100;
+    FixedTimestep timestep(STEP, MAX_STEPS);
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> dist(0.002, 0.05);
+
+    double prev = 0, cur = 0;
+    double wallTime = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+      double frameTime = dist(rng);
+      wallTime += frameTime;
+      for (int j = timestep.Advance(frameTime); j > 0; --j)
+      {
+        prev = cur;
+        cur += SPEED * STEP;
+      }
+
+      double rendered = prev + (cur - prev) * timestep.Alpha();
+      CHECK(fabs(rendered - SPEED * (wallTime - STEP)) < 1e-3 || wallTime < STEP);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestSteadyRates();
+  TestJitter();
+  TestSpike();
+  TestInterpolation();
+  return test::TestResult();
+}
@@ -0,0 +1,121 @@
+#include "test.hpp"
+#include <core/sprite_batcher.hpp>
+#include <lib/frame_allocator.hpp>
+
+using namespace world;
+
+namespace
+{
+  const int NUM_FRAMES = 3;
+
+  //------------------------------------------------------------------------------
+  // Pointers stay alive for NUM_FRAMES frames, and are stale once their arena is reused,
+  // whether or not it has been allocated from again. The recycled memory of a virtual
+  // arena can be decommitted, so it's only read back for fixed ones.
+  void TestStale(FrameAllocator& frames, bool isVirtual)
+  {
+    u8* a = frames.Alloc<u8>(100);
+    u8* b = frames.Alloc<u8>(1000, 64);
+    CHECK(a && b);
+    CHECK(((uintptr_t)b & 63) == 0);
+    memset(a, 1, 100);
+    memset(b, 2, 1000);
+
+    for (int i = 1; i < NUM_FRAMES; ++i)
+    {
+      frames.NewFrame();
+      CHECK(frames.IsAlive(a) && frames.IsAlive(b));
+      frames.Alloc<u8>(500);
+    }
+
+    // the arena is reused, and poisoned
+    frames.NewFrame();
+    CHECK(!frames.IsAlive(a) && !frames.IsAlive(b));
+    CHECK(isVirtual || (a[0] != 1 && b[999] != 2));
+
+    // new allocations covering the old ones don't bring them back
+    u8* c = frames.Alloc<u8>(64, 64);
+    u8* d = frames.Alloc<u8>(2000);
+    memset(d, 0, 2000);
+    CHECK(frames.IsAlive(c) && frames.IsAlive(d));
+    CHECK(!frames.IsAlive(a) && !frames.IsAlive(b));
+
+    // memory from the top of the arena, and from elsewhere, can't be checked
+    ScopedArena scoped(frames.Arena());
+    u8* top = scoped.arena.AllocTop<u8>(100);
+    vector<u8> heap(100);
+    CHECK(frames.IsAlive(top));
+    CHECK(frames.IsAlive(heap.data()));
+  }
+
+  //------------------------------------------------------------------------------
+  struct KeepingSubmitTarget : public SpriteSubmitTarget
+  {
+    virtual u32 MaxQuads() const override { return 100; }
+    virtual void Submit(ObjectHandle, const PosTex* vtx, u32) override { batches.push_back(vtx); }
+    vector<const PosTex*> batches;
+  };
+
+  //------------------------------------------------------------------------------
+  // The sprite batcher stages each batch in its own scratch allocation, so the batches it
+  // submits are good for NUM_FRAMES frames
+  void TestSpriteBatches()
+  {
+    CHECK(g_ScratchMemory.InitVirtual(1024 * 1024, 0, NUM_FRAMES));
+    SpriteBatcher batcher;
+    SpriteQuad quad = {0, 0, 1, 1, 8, 8, {0, 0}};
+    for (int i = 0; i < 250; ++i)
+      batcher.Add(ObjectHandle(), quad, vec2((float)i, 0));
+
+    KeepingSubmitTarget target;
+    batcher.Flush(&target);
+    CHECK_EQ(target.batches.size(), 3u);
+    for (int i = 1; i < NUM_FRAMES; ++i)
+    {
+      g_ScratchMemory.NewFrame();
+      for (int j = 0; j < 3; ++j)
+      {
+        CHECK(g_ScratchMemory.IsAlive(target.batches[j]));
+        CHECK_EQ(target.batches[j][0].pos.x, 100.f * j);
+      }
+    }
+
+    g_ScratchMemory.NewFrame();
+    CHECK(!g_ScratchMemory.IsAlive(target.batches[0]));
+  }
+
+  //------------------------------------------------------------------------------
+  void TestVirtual()
+  {
+    // arenas that commit on demand are only poisoned as far as they're committed, and the
+    // stats follow the pages being committed, and released once the arenas have been
+    // quiet for long enough
+    FrameAllocator frames;
+    CHECK(frames.InitVirtual(16 * 1024 * 1024, 0, NUM_FRAMES));
+    CHECK(frames.Alloc<u8>(3 * 1024 * 1024));
+    CHECK(!frames.Alloc<u8>(32 * 1024 * 1024));
+    for (int i = 0; i < NUM_FRAMES; ++i)
+      frames.NewFrame();
+    CHECK(frames.GetStats().committed >= 3u * 1024 * 1024);
+
+    for (int i = 0; i < 2 * ArenaAllocator::QUIET_FRAMES * NUM_FRAMES; ++i)
+      frames.NewFrame();
+
+    CHECK(frames.GetStats().peakFrameUsage >= 3u * 1024 * 1024);
+    CHECK_EQ(frames.GetStats().committed, 0u);
+    TestStale(frames, true);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  vector<u8> buf(256 * 1024);
+  FrameAllocator frames;
+  CHECK(frames.Init(buf.data(), buf.data() + buf.size(), NUM_FRAMES));
+  TestStale(frames, false);
+
+  TestSpriteBatches();
+  TestVirtual();
+  return test::TestResult();
+}
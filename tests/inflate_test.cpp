@@ -0,0 +1,149 @@
+#include "test.hpp"
+#include <lib/inflate.hpp>
+#include <random>
+#include <zlib.h>
+
+using namespace world;
+
+namespace
+{
+  enum class Format
+  {
+    Zlib,
+    Gzip,
+    GzipWithName,
+  };
+
+  //------------------------------------------------------------------------------
+  // Compresses with the reference zlib, in the format and strategy given
+  vector<u8> Compress(const vector<u8>& data, Format format, int level, int strategy)
+  {
+    z_stream stream = {};
+    int windowBits = format == Format::Zlib ? 15 : 15 + 16;
+    int res = deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, strategy);
+    CHECK_EQ(res, Z_OK);
+
+    // Tiled doesn't write a file name, but other tools might, and it has to be skipped
+    gz_header header = {};
+    char name[] = "layer.bin";
+    if (format == Format::GzipWithName)
+    {
+      header.name = (Bytef*)name;
+      deflateSetHeader(&stream, &header);
+    }
+
+    vector<u8> out(deflateBound(&stream, (uLong)data.size()) + 64);
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = (uInt)data.size();
+    stream.next_out = out.data();
+    stream.avail_out = (uInt)out.size();
+    res = deflate(&stream, Z_FINISH);
+    CHECK_EQ(res, Z_STREAM_END);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+  }
+
+  //------------------------------------------------------------------------------
+  bool Inflate(const vector<u8>& src, Format format, u8* dst, size_t dstLen)
+  {
+    if (format == Format::Zlib)
+      return ZlibInflate(src.data(), src.size(), dst, dstLen);
+    return GzipInflate(src.data(), src.size(), dst, dstLen);
+  }
+
+  //------------------------------------------------------------------------------
+  // Tile layer like data: runs of the same gid, and the odd flipped tile
+  vector<u8> MakeTiles(std::mt19937& rng, size_t numTiles)
+  {
+    vector<u32> tiles(numTiles);
+    u32 gid = 0;
+    for (u32& tile : tiles)
+    {
+      if (rng() % 8 == 0)
+        gid = rng() % 4 ? rng() % 200 : 0;
+      tile = gid | (rng() % 32 == 0 ? 0x80000000 : 0);
+    }
+
+    vector<u8> res(numTiles * sizeof(u32));
+    memcpy(res.data(), tiles.data(), res.size());
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestRoundTrip()
+  {
+    // stored blocks, fixed and dynamic huffman codes, and long matches
+    const int levels[] = {0, 1, 6, 9};
+    const int strategies[] = {Z_DEFAULT_STRATEGY, Z_FIXED, Z_HUFFMAN_ONLY, Z_RLE};
+    const Format formats[] = {Format::Zlib, Format::Gzip, Format::GzipWithName};
+    const size_t sizes[] = {1, 7, 100, 4096, 100000};
+
+    std::mt19937 rng(1);
+    for (size_t numTiles : sizes)
+    {
+      vector<u8> data = MakeTiles(rng, numTiles);
+      for (Format format : formats)
+      {
+        for (int level : levels)
+        {
+          for (int strategy : strategies)
+          {
+            vector<u8> compressed = Compress(data, format, level, strategy);
+            vector<u8> out(data.size() + 1, 0xcc);
+            CHECK(Inflate(compressed, format, out.data(), data.size()));
+            CHECK(memcmp(out.data(), data.data(), data.size()) == 0);
+            CHECK_EQ(out[data.size()], 0xcc);
+
+            // the data has to expand to exactly the size given
+            CHECK(!Inflate(compressed, format, out.data(), data.size() - 1));
+            CHECK(!Inflate(compressed, format, out.data(), data.size() + 1));
+          }
+        }
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  void TestInvalid()
+  {
+    std::mt19937 rng(2);
+    vector<u8> data = MakeTiles(rng, 1000);
+    vector<u8> out(data.size());
+
+    for (Format format : {Format::Zlib, Format::Gzip})
+    {
+      vector<u8> compressed = Compress(data, format, 6, Z_DEFAULT_STRATEGY);
+
+      // truncated streams
+      for (size_t len = 0; len < compressed.size() - 8; len += 7)
+      {
+        vector<u8> truncated(compressed.begin(), compressed.begin() + len);
+        CHECK(!Inflate(truncated, format, out.data(), out.size()));
+      }
+
+      // the other format's header
+      Format other = format == Format::Zlib ? Format::Gzip : Format::Zlib;
+      CHECK(!Inflate(compressed, other, out.data(), out.size()));
+
+      // random corruption mustn't crash, or write past the end, but can go either way,
+      // as the checksums aren't verified
+      for (int i = 0; i < 1000; ++i)
+      {
+        vector<u8> corrupt = compressed;
+        corrupt[rng() % corrupt.size()] ^= (u8)(1 << (rng() % 8));
+        vector<u8> dst(out.size() + 1, 0xcc);
+        Inflate(corrupt, format, dst.data(), out.size());
+        CHECK_EQ(dst[out.size()], 0xcc);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestRoundTrip();
+  TestInvalid();
+  return test::TestResult();
+}
@@ -0,0 +1,159 @@
+#include "bench.hpp"
+#include <contrib/picojson.h>
+#include <core/tmx_level.hpp>
+#include <lib/json_reader.hpp>
+#include <random>
+
+using namespace world;
+using namespace world::parser;
+
+namespace
+{
+  const int NUM_OBJECTS = 10000;
+
+  //------------------------------------------------------------------------------
+  // A single layer map, with collision rects
+  string MakeMap(int size, vector<u32>* tiles)
+  {
+    std::mt19937 rng(size);
+    char buf[256];
+    snprintf(buf,
+        sizeof(buf),
+        "{\"width\":%d,\"height\":%d,\"tilewidth\":16,\"tileheight\":16,\"layers\":["
+        "{\"name\":\"ground\",\"x\":0,\"y\":0,\"width\":%d,\"height\":%d,\"data\":[",
+        size,
+        size,
+        size,
+        size);
+    string json = buf;
+
+    tiles->resize((size_t)size * size);
+    json.reserve(tiles->size() * 5);
+    for (size_t i = 0; i < tiles->size(); ++i)
+    {
+      u32 gid = rng() % 4 ? 1 + rng() % 1024 : 0;
+      (*tiles)[i] = gid;
+      json.append(i ? "," : "");
+      json.append(std::to_string(gid));
+    }
+
+    json.append("]},{\"name\":\"Collision\",\"objects\":[");
+    for (int i = 0; i < NUM_OBJECTS; ++i)
+    {
+      snprintf(buf,
+          sizeof(buf),
+          "%s{\"id\":%d,\"name\":\"\",\"type\":\"\",\"visible\":true,\"x\":%u,\"y\":%u,"
+          "\"width\":32,\"height\":16,\"rotation\":0}",
+          i ? "," : "",
+          i,
+          (u32)(rng() % (size * 16)),
+          (u32)(rng() % (size * 16)));
+      json.append(buf);
+    }
+
+    json.append("]}],\"tilesets\":[{\"name\":\"tiles\",\"image\":\"tiles.png\",\"firstgid\":1,"
+                "\"imagewidth\":512,\"imageheight\":512,\"margin\":0,\"spacing\":0,"
+                "\"tilecount\":1024,\"tilewidth\":16,\"tileheight\":16}]}");
+    return json;
+  }
+
+  //------------------------------------------------------------------------------
+  // The tiles the way the original LoadSpriteLayer got them out of the json tree
+  bool PicojsonTiles(const picojson::value& root, vector<u32>* tiles)
+  {
+    const picojson::array& layers = root.get("layers").get<picojson::array>();
+    const picojson::array& data = layers[0].get("data").get<picojson::array>();
+    tiles->clear();
+    tiles->reserve(data.size());
+    for (const picojson::value& d : data)
+      tiles->push_back((u32)d.get<double>());
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  // A straightforward number at a time conversion of the data array, to compare the
+  // reader's fast path against. Both start from an empty vector, like a load does
+  bool StrtoulTiles(const string& json, vector<u32>* tiles)
+  {
+    const char* p = strstr(json.c_str(), "\"data\":[") + 8;
+    vector<u32>().swap(*tiles);
+    while (*p != ']')
+    {
+      char* end;
+      tiles->push_back((u32)strtoul(p, &end, 10));
+      p = *end == ',' ? end + 1 : end;
+    }
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  bool ReaderTiles(const string& json, vector<u32>* tiles)
+  {
+    size_t ofs = json.find("\"data\":") + 7;
+    InputBuffer input(json.data() + ofs, json.size() - ofs);
+    JsonReader reader(input);
+    vector<u32>().swap(*tiles);
+    return reader.ReadU32Array(tiles);
+  }
+
+  //------------------------------------------------------------------------------
+  void Run(int size)
+  {
+    vector<u32> expected;
+    string json = MakeMap(size, &expected);
+    double mb = json.size() / (1024.0 * 1024.0);
+    int reps = size > 2048 ? 2 : 5;
+    printf("%dx%d map, %.1f MB of json\n", size, size, mb);
+
+    auto report = [&](const char* name, double t, bool ok) {
+      printf("  %-28s %9.2f ms, %7.1f MB/s%s\n",
+          name,
+          t * 1e3,
+          mb / t,
+          ok ? "" : " (WRONG TILES)");
+    };
+
+    bool ok = true;
+    double t = bench::MinTime(reps, [&]() {
+      picojson::value root;
+      string err = picojson::parse(root, json);
+      ok &= err.empty();
+    });
+    report("picojson tree", t, ok);
+
+    vector<u32> tiles;
+    t = bench::MinTime(reps, [&]() {
+      picojson::value root;
+      string err = picojson::parse(root, json);
+      ok &= err.empty() && PicojsonTiles(root, &tiles);
+    });
+    report("picojson tree and tiles", t, ok && tiles == expected);
+
+    t = bench::MinTime(reps, [&]() {
+      TmxLevel level;
+      TmxCollision collision;
+      ok &= ReadTmxJson(json.data(), json.size(), "bench", &level, &collision);
+      ok &= collision.rects.size() == NUM_OBJECTS;
+      tiles.swap(level.layers[0].tiles);
+    });
+    report("ReadTmxJson", t, ok && tiles == expected);
+
+    // just the data array, which is most of the file
+    t = bench::MinTime(reps, [&]() { ok &= StrtoulTiles(json, &tiles); });
+    report("data array, strtoul", t, ok && tiles == expected);
+
+    t = bench::MinTime(reps, [&]() { ok &= ReaderTiles(json, &tiles); });
+    report("data array, ReadU32Array", t, ok && tiles == expected);
+  }
+}
+
+// Reading Tiled maps with picojson, building the json tree and copying the tiles out
+// of it like the original loader did, against the streaming reader, that reads the
+// tiles straight into the layer. The data arrays are also timed on their own, against
+// strtoul. The MB/s are for the whole file.
+int main()
+{
+  Run(1024);
+  Run(4096);
+  return 0;
+}
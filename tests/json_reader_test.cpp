@@ -0,0 +1,135 @@
+#include "test.hpp"
+#include <lib/json_reader.hpp>
+#include <random>
+
+using namespace world;
+using namespace world::parser;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // The reader doesn't expect a terminator, so the json is copied into a buffer of
+  // exactly its size, which makes reads past the end show up under the sanitizers
+  bool ReadArray(const string& json, vector<u32>* values)
+  {
+    vector<char> buf(json.begin(), json.end());
+    InputBuffer input(buf);
+    JsonReader reader(input);
+    values->clear();
+    return reader.ReadU32Array(values) && reader.Ok();
+  }
+
+  //------------------------------------------------------------------------------
+  void TestU32Array()
+  {
+    vector<u32> values;
+    CHECK(ReadArray("[0, 1,23 ,4294967295,\n 12345678, 123456789]", &values));
+    const u32 expected[] = {0, 1, 23, 4294967295u, 12345678, 123456789};
+    CHECK(values.size() == 6 && memcmp(values.data(), expected, sizeof(expected)) == 0);
+
+    CHECK(ReadArray(" [ ]", &values));
+    CHECK(values.empty());
+
+    CHECK(!ReadArray("[4294967296]", &values));
+    CHECK(!ReadArray("[12345678901]", &values));
+    CHECK(!ReadArray("[1,]", &values));
+    CHECK(!ReadArray("[-1]", &values));
+    CHECK(!ReadArray("[1 2]", &values));
+    CHECK(!ReadArray("[1, 2", &values));
+
+    // numbers of every length, with the last ones close to the end of the buffer, where
+    // the conversion falls back to the scalar path
+    std::mt19937 rng(1);
+    for (int iter = 0; iter < 100; ++iter)
+    {
+      vector<u32> ref;
+      string json = "[";
+      int count = 1 + rng() % 64;
+      for (int i = 0; i < count; ++i)
+      {
+        u32 value = rng() >> (rng() % 32);
+        ref.push_back(value);
+        json.append(i ? "," : "").append(std::to_string(value));
+      }
+      json.append("]");
+
+      CHECK(ReadArray(json, &values));
+      CHECK(values == ref);
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  void TestWalk()
+  {
+    const char* json = R"({"name": "a\"b\\cé😀", "skip": {"x": [1, "]}", {}]},
+        "flag": false, "num": -1.5e2, "data": "plain", "list": [true, null]})";
+    InputBuffer input(json, strlen(json));
+    JsonReader reader(input);
+
+    string key, name, scratch;
+    bool flag = true;
+    double num = 0;
+    const char* data = nullptr;
+    size_t dataLen = 0;
+    int numElements = 0;
+
+    reader.BeginObject();
+    while (reader.NextKey(&key))
+    {
+      if (key == "name")
+        reader.ReadString(&name);
+      else if (key == "flag")
+        reader.ReadBool(&flag);
+      else if (key == "num")
+        reader.ReadNumber(&num);
+      else if (key == "data")
+        reader.ReadString(&data, &dataLen, &scratch);
+      else if (key == "list")
+      {
+        reader.BeginArray();
+        while (reader.NextElement())
+        {
+          numElements++;
+          reader.SkipValue();
+        }
+      }
+      else
+        reader.SkipValue();
+    }
+
+    CHECK(reader.Ok());
+    CHECK(name == "a\"b\\c\xc3\xa9\xf0\x9f\x98\x80");
+    CHECK(!flag);
+    CHECK_EQ(num, -150.0);
+    // strings without escapes point into the json
+    CHECK(data > json && data < json + strlen(json));
+    CHECK(dataLen == 5 && memcmp(data, "plain", 5) == 0);
+    CHECK_EQ(numElements, 2);
+  }
+
+  //------------------------------------------------------------------------------
+  // Once something fails, everything else does too
+  void TestErrors()
+  {
+    const char* json = R"({"a": tru, "b": 1})";
+    InputBuffer input(json, strlen(json));
+    JsonReader reader(input);
+
+    string key;
+    bool value;
+    CHECK(reader.BeginObject());
+    CHECK(reader.NextKey(&key));
+    CHECK(!reader.ReadBool(&value));
+    CHECK(!reader.NextKey(&key));
+    CHECK(!reader.Ok());
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestU32Array();
+  TestWalk();
+  TestErrors();
+  return test::TestResult();
+}
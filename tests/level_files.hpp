@@ -0,0 +1,108 @@
+#pragma once
+#include <core/cooked_level.hpp>
+#include <core/tmx_level.hpp>
+
+// Synthetic single layer levels for the load benchmarks, as Tiled json and as a cooked
+// level, with a 16x16 tileset of 1024 tiles.
+
+namespace world
+{
+  namespace level_files
+  {
+    //------------------------------------------------------------------------------
+    inline u32 Align(u32 ofs)
+    {
+      return (ofs + CookedLevelHeader::ALIGNMENT - 1) & ~(CookedLevelHeader::ALIGNMENT - 1);
+    }
+
+    //------------------------------------------------------------------------------
+    // The tiles as a json int array, the way Tiled writes uncompressed layers
+    inline string TileArray(const vector<u32>& tiles)
+    {
+      string data = "[";
+      data.reserve(tiles.size() * 5);
+      for (size_t i = 0; i < tiles.size(); ++i)
+      {
+        data.append(i ? "," : "");
+        data.append(std::to_string(tiles[i]));
+      }
+      data.append("]");
+      return data;
+    }
+
+    //------------------------------------------------------------------------------
+    // A size x size map, with 'data' as the layer's data, followed by 'layerKeys'
+    inline string MakeJson(int size, const string& data, const char* layerKeys = "")
+    {
+      char buf[256];
+      snprintf(buf,
+          sizeof(buf),
+          "{\"width\":%d,\"height\":%d,\"tilewidth\":16,\"tileheight\":16,\"layers\":["
+          "{\"name\":\"ground\",\"x\":0,\"y\":0,\"width\":%d,\"height\":%d,\"data\":",
+          size,
+          size,
+          size,
+          size);
+      string json = buf;
+      json.reserve(json.size() + data.size() + 512);
+      json.append(data);
+      json.append(layerKeys);
+      json.append("}],\"tilesets\":[{\"name\":\"tiles\",\"image\":\"tiles.png\",\"firstgid\":1,"
+                  "\"imagewidth\":512,\"imageheight\":512,\"margin\":0,\"spacing\":0,"
+                  "\"tilecount\":1024,\"tilewidth\":16,\"tileheight\":16}]}");
+      return json;
+    }
+
+    //------------------------------------------------------------------------------
+    // The same level as MakeJson, laid out like scripts/cook_level.py does
+    inline vector<char> MakeCooked(int size, const vector<u32>& tiles)
+    {
+      const char strings[] = "ground\0tiles\0tiles.png\0";
+
+      CookedLevelHeader header = {};
+      header.magic = CookedLevelHeader::MAGIC;
+      header.version = CookedLevelHeader::VERSION;
+      header.headerSize = sizeof(CookedLevelHeader);
+      header.width = header.height = size;
+      header.tileWidth = header.tileHeight = 16;
+
+      u32 ofs = Align(sizeof(CookedLevelHeader));
+      header.numLayers = 1;
+      header.layersOfs = ofs;
+      ofs = Align(ofs + sizeof(CookedLayer));
+      header.numTilesets = 1;
+      header.tilesetsOfs = ofs;
+      ofs = Align(ofs + sizeof(CookedTileset));
+      header.rectsOfs = header.polylinesOfs = header.pointsOfs = ofs;
+      header.stringsSize = sizeof(strings);
+      header.stringsOfs = ofs;
+      ofs = Align(ofs + sizeof(strings));
+
+      CookedLayer layer = {0, 0, 0, size, size, ofs};
+      CookedTileset tileset = {7, 13, 1, 512, 512, 0, 0, 1024, 16, 16};
+      ofs = Align(ofs + (u32)(tiles.size() * sizeof(u32)));
+      header.fileSize = ofs;
+
+      vector<char> cooked(ofs);
+      memcpy(&cooked[0], &header, sizeof(header));
+      memcpy(&cooked[header.layersOfs], &layer, sizeof(layer));
+      memcpy(&cooked[header.tilesetsOfs], &tileset, sizeof(tileset));
+      memcpy(&cooked[header.stringsOfs], strings, sizeof(strings));
+      memcpy(&cooked[layer.tilesOfs], tiles.data(), tiles.size() * sizeof(u32));
+      return cooked;
+    }
+
+    //------------------------------------------------------------------------------
+    // Reads all the tiles of the first layer, which is when a cooked level's pages are
+    // faulted in
+    inline u32 SumTiles(const TmxLevel& level)
+    {
+      const TmxLayer& layer = level.layers[0];
+      const u32* tiles = layer.Tiles();
+      u32 sum = 0;
+      for (size_t i = 0; i < (size_t)layer.width * layer.height; ++i)
+        sum += tiles[i];
+      return sum;
+    }
+  }
+}
@@ -0,0 +1,374 @@
+#include "bench.hpp"
+#include <contrib/picojson.h>
+#include <core/tmx_level.hpp>
+#include <lib/file_utils.hpp>
+#include <lib/frame_allocator.hpp>
+#include <random>
+
+using namespace world;
+
+// Counts the heap allocations made while loading, by replacing the global operator new
+namespace
+{
+  size_t g_numAllocs;
+  size_t g_allocBytes;
+}
+
+//------------------------------------------------------------------------------
+void* operator new(size_t size)
+{
+  g_numAllocs++;
+  g_allocBytes += size;
+  if (void* p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+  const int MAP_SIZE = 512;
+  const int NUM_RECTS = 5000;
+  const int NUM_POLYLINES = 1000;
+  const int POLYLINE_POINTS = 8;
+  const char* MAP_FILE = "level_load_bench.json";
+
+  //------------------------------------------------------------------------------
+  // Two full layers, and a collision layer with rects and polylines, like the levels
+  // saved by Tiled
+  string MakeMap()
+  {
+    std::mt19937 rng(1);
+    char buf[256];
+    snprintf(buf,
+        sizeof(buf),
+        "{\"width\":%d,\"height\":%d,\"tilewidth\":16,\"tileheight\":16,"
+        "\"properties\":{\"zerolevel\":\"%d\"},\"layers\":[",
+        MAP_SIZE,
+        MAP_SIZE,
+        MAP_SIZE);
+    string json = buf;
+
+    for (int l = 0; l < 2; ++l)
+    {
+      snprintf(buf,
+          sizeof(buf),
+          "{\"name\":\"layer%d\",\"x\":0,\"y\":0,\"width\":%d,\"height\":%d,\"data\":[",
+          l,
+          MAP_SIZE,
+          MAP_SIZE);
+      json.append(buf);
+      for (int i = 0; i < MAP_SIZE * MAP_SIZE; ++i)
+      {
+        json.append(i ? "," : "");
+        json.append(std::to_string(rng() % 4 ? 1 + rng() % 256 : 0));
+      }
+      json.append("]},");
+    }
+
+    json.append("{\"name\":\"Collision\",\"objects\":[");
+    for (int i = 0; i < NUM_RECTS + NUM_POLYLINES; ++i)
+    {
+      int x = rng() % (MAP_SIZE * 16);
+      int y = rng() % (MAP_SIZE * 16);
+      snprintf(buf,
+          sizeof(buf),
+          "%s{\"id\":%d,\"name\":\"\",\"type\":\"\",\"visible\":true,\"x\":%d,\"y\":%d,"
+          "\"width\":%d,\"height\":%d,\"rotation\":0",
+          i ? "," : "",
+          i,
+          x,
+          y,
+          i < NUM_RECTS ? 16 + 16 * (int)(rng() % 8) : 0,
+          i < NUM_RECTS ? 16 : 0);
+      json.append(buf);
+      if (i >= NUM_RECTS)
+      {
+        json.append(",\"polyline\":[");
+        for (int j = 0; j < POLYLINE_POINTS; ++j)
+        {
+          snprintf(buf, sizeof(buf), "%s{\"x\":%d,\"y\":%d}", j ? "," : "", j * 16, j % 2 * 8);
+          json.append(buf);
+        }
+        json.append("]");
+      }
+      json.append("}");
+    }
+
+    json.append("]}],\"tilesets\":[{\"name\":\"tiles\",\"image\":\"tiles.png\",\"firstgid\":1,"
+                "\"imagewidth\":256,\"imageheight\":256,\"margin\":0,\"spacing\":0,"
+                "\"tilecount\":256,\"tilewidth\":16,\"tileheight\":16}]}");
+    return json;
+  }
+
+  //------------------------------------------------------------------------------
+  bool LoadFileVector(const char* filename, vector<char>* buf)
+  {
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+      return false;
+
+    fseek(f, 0, SEEK_END);
+    buf->resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool res = fread(buf->data(), 1, buf->size(), f) == buf->size();
+    fclose(f);
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T, typename TOrg, typename U>
+  bool CheckedGet(const U& m, const string& key, T* res)
+  {
+    auto it = m.find(key);
+    if (it == m.end() || !it->second.template is<TOrg>())
+      return false;
+
+    *res = (T)it->second.template get<TOrg>();
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T, typename U>
+  const T* CheckedGetRef(const U& m, const string& key)
+  {
+    auto it = m.find(key);
+    return it == m.end() || !it->second.template is<T>() ? nullptr : &it->second.template get<T>();
+  }
+
+  //------------------------------------------------------------------------------
+  // The original SpriteManager::LoadTmx: the file goes into a vector, and the arrays and
+  // objects are copied out of the json tree, before their values are read. The Box2D
+  // bodies aren't created, but the polyline points are gathered in a vector for them.
+  bool LoadCopies(TmxLevel* level, vector<vec2>* lastPolyline)
+  {
+    vector<char> ss;
+    if (!LoadFileVector(MAP_FILE, &ss))
+      return false;
+
+    picojson::value res;
+    auto first = ss.begin();
+    string err = picojson::parse(res, first, ss.end());
+    if (!err.empty())
+      return false;
+
+    const auto& levelObj = res.get<picojson::object>();
+    if (!CheckedGet<int, double>(levelObj, "width", &level->width)
+        || !CheckedGet<int, double>(levelObj, "tileheight", &level->tileHeight))
+      return false;
+
+    picojson::array layers;
+    if (!CheckedGet<picojson::array, picojson::array>(levelObj, "layers", &layers))
+      return false;
+
+    for (auto& layer : layers)
+    {
+      const picojson::object& layerObj = layer.get<picojson::object>();
+      string name;
+      if (!CheckedGet<string, string>(layerObj, "name", &name))
+        return false;
+
+      if (name == "Collision")
+      {
+        picojson::array objects;
+        if (!CheckedGet<picojson::array, picojson::array>(layerObj, "objects", &objects))
+          return false;
+
+        for (auto& obj : objects)
+        {
+          picojson::object cur = obj.get<picojson::object>();
+          if (!cur.count("polyline"))
+            continue;
+
+          vector<vec2> points;
+          picojson::array polylineObj = cur.find("polyline")->second.get<picojson::array>();
+          for (auto& pt : polylineObj)
+          {
+            picojson::object ptObj = pt.get<picojson::object>();
+            float x, y;
+            if (!CheckedGet<float, double>(ptObj, "x", &x)
+                || !CheckedGet<float, double>(ptObj, "y", &y))
+              return false;
+            points.push_back(vec2(x, y));
+          }
+          *lastPolyline = points;
+        }
+        continue;
+      }
+
+      level->layers.push_back(TmxLayer());
+      picojson::array data;
+      if (!CheckedGet<picojson::array, picojson::array>(layerObj, "data", &data))
+        return false;
+
+      TmxLayer& tmxLayer = level->layers.back();
+      tmxLayer.tiles.reserve(data.size());
+      for (auto& d : data)
+        tmxLayer.tiles.push_back((int)d.get<double>());
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  // LoadTmx after arena temporaries were added: the file is read into the top of the
+  // scratch memory, and so are the polyline points, while the json tree is read through
+  // references. The tree itself is still built on the heap.
+  bool LoadArena(TmxLevel* level, vector<vec2>* lastPolyline)
+  {
+    ScopedArena scratch(g_ScratchMemory.Arena());
+    char* buf;
+    u32 len;
+    if (!LoadFile(MAP_FILE, &scratch.arena, &buf, &len))
+      return false;
+
+    picojson::value res;
+    const char* first = buf;
+    string err = picojson::parse(res, first, (const char*)buf + len);
+    if (!err.empty())
+      return false;
+
+    const auto& levelObj = res.get<picojson::object>();
+    if (!CheckedGet<int, double>(levelObj, "width", &level->width)
+        || !CheckedGet<int, double>(levelObj, "tileheight", &level->tileHeight))
+      return false;
+
+    const picojson::array* layers = CheckedGetRef<picojson::array>(levelObj, "layers");
+    if (!layers)
+      return false;
+
+    for (auto& layer : *layers)
+    {
+      const picojson::object& layerObj = layer.get<picojson::object>();
+      const string* name = CheckedGetRef<string>(layerObj, "name");
+      if (!name)
+        return false;
+
+      if (*name == "Collision")
+      {
+        const picojson::array* objects = CheckedGetRef<picojson::array>(layerObj, "objects");
+        if (!objects)
+          return false;
+
+        for (auto& obj : *objects)
+        {
+          const picojson::object& cur = obj.get<picojson::object>();
+          const picojson::array* polylineObj = CheckedGetRef<picojson::array>(cur, "polyline");
+          if (!polylineObj)
+            continue;
+
+          ScopedArena pointScratch(g_ScratchMemory.Arena());
+          vec2* points = pointScratch.arena.AllocTop<vec2>((u32)polylineObj->size());
+          if (!points)
+            return false;
+
+          int numPoints = 0;
+          for (auto& pt : *polylineObj)
+          {
+            const picojson::object& ptObj = pt.get<picojson::object>();
+            float x, y;
+            if (!CheckedGet<float, double>(ptObj, "x", &x)
+                || !CheckedGet<float, double>(ptObj, "y", &y))
+              return false;
+            points[numPoints++] = vec2(x, y);
+          }
+          lastPolyline->assign(points, points + numPoints);
+        }
+        continue;
+      }
+
+      level->layers.push_back(TmxLayer());
+      const picojson::array* data = CheckedGetRef<picojson::array>(layerObj, "data");
+      if (!data)
+        return false;
+
+      TmxLayer& tmxLayer = level->layers.back();
+      tmxLayer.tiles.resize(data->size());
+      for (size_t i = 0; i < data->size(); ++i)
+        tmxLayer.tiles[i] = (u32)(*data)[i].get<double>();
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  // The current loader, reading the file from the scratch memory without a json tree
+  bool LoadReader(TmxLevel* level, TmxCollision* collision)
+  {
+    ScopedArena scratch(g_ScratchMemory.Arena());
+    char* buf;
+    u32 len;
+    if (!LoadFile(MAP_FILE, &scratch.arena, &buf, &len))
+      return false;
+
+    return ReadTmxJson(buf, len, MAP_FILE, level, collision);
+  }
+
+  //------------------------------------------------------------------------------
+  // Loads the map a few times, and reports the fastest load, and the heap allocations
+  // made by a single load
+  template <typename Fn>
+  void Report(const char* name, const Fn& fn)
+  {
+    g_numAllocs = g_allocBytes = 0;
+    bool ok = fn();
+    size_t numAllocs = g_numAllocs;
+    size_t allocBytes = g_allocBytes;
+
+    double t = bench::MinTime(5, fn);
+    printf("%-22s %8.3f ms, %8zu allocations, %8.2f MB allocated%s\n",
+        name,
+        t * 1e3,
+        numAllocs,
+        allocBytes / (1024.0 * 1024.0),
+        ok ? "" : " (FAILED)");
+  }
+}
+
+// Heap allocations made while loading a 512x512 level with 6000 collision objects, for
+// the original loader that copied the arrays and objects out of the json tree, for the
+// loader using the scratch memory for its temporaries, and for the current one that
+// reads the json without building a tree. The tiles and the collision objects that are
+// kept are included in all three.
+int main()
+{
+  string json = MakeMap();
+  if (!SaveFile(MAP_FILE, json.data(), (int)json.size()))
+  {
+    printf("unable to write %s\n", MAP_FILE);
+    return 1;
+  }
+  printf("map: %.2f MB of json\n", json.size() / (1024.0 * 1024.0));
+
+  if (!g_ScratchMemory.InitVirtual(64 * 1024 * 1024, 0))
+    return 1;
+
+  vector<vec2> lastPolyline;
+  Report("vectors and copies", [&]() {
+    TmxLevel level;
+    return LoadCopies(&level, &lastPolyline);
+  });
+
+  Report("arena and references", [&]() {
+    TmxLevel level;
+    return LoadArena(&level, &lastPolyline);
+  });
+
+  Report("json reader", [&]() {
+    TmxLevel level;
+    TmxCollision collision;
+    return LoadReader(&level, &collision);
+  });
+
+  remove(MAP_FILE);
+  return 0;
+}
@@ -0,0 +1,195 @@
+#include "test.hpp"
+#include <game/level.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  // A level that's not a multiple of the page size, with noise, solid blocks, and
+  // 1 pixel lines
+  const int WIDTH = 700;
+  const int HEIGHT = 530;
+
+  struct TestLevel
+  {
+    Level level;
+    vector<u8> walls;
+
+    bool IsWall(int x, int y) const
+    {
+      return x >= 0 && y >= 0 && x < WIDTH && y < HEIGHT && walls[y * WIDTH + x];
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  void MakeLevel(TestLevel* test)
+  {
+    std::mt19937 rng(1);
+    vector<u8>& walls = test->walls;
+    walls.resize(WIDTH * HEIGHT);
+    for (u8& wall : walls)
+      wall = rng() % 100 < 3;
+
+    for (int i = 0; i < 150; ++i)
+    {
+      int x0 = rng() % WIDTH;
+      int y0 = rng() % HEIGHT;
+      int w = i % 3 == 0 ? 1 : 5 + rng() % 60;
+      int h = i % 3 == 1 ? 1 : 5 + rng() % 60;
+      for (int y = y0; y < min(HEIGHT, y0 + h); ++y)
+      {
+        for (int x = x0; x < min(WIDTH, x0 + w); ++x)
+          walls[y * WIDTH + x] = 1;
+      }
+    }
+
+    // the walls are the opaque pixels that aren't black
+    vector<u32> pixels(WIDTH * HEIGHT);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+      if (walls[i])
+        pixels[i] = 0xff000000 | (rng() % 0xffffff + 1);
+      else
+        pixels[i] = rng() % 2 ? 0xff000000 : rng() % 0xffffff;
+    }
+
+    test->level.Init(pixels.data(), WIDTH, HEIGHT);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestRects(const TestLevel& test)
+  {
+    for (int y = -2; y < HEIGHT + 2; ++y)
+    {
+      for (int x = -2; x < WIDTH + 2; ++x)
+        CHECK_EQ(test.level.IsWall(x, y), test.IsWall(x, y));
+    }
+
+    // rects of all shapes, including single rows and columns, and ones crossing pages
+    // and the level's edges
+    std::mt19937 rng(2);
+    for (int i = 0; i < 20000; ++i)
+    {
+      int x0 = (int)(rng() % (WIDTH + 100)) - 50;
+      int y0 = (int)(rng() % (HEIGHT + 100)) - 50;
+      int x1 = x0 + (i % 4 == 0 ? 0 : rng() % 300);
+      int y1 = y0 + (i % 4 == 1 ? 0 : rng() % 300);
+
+      u32 expected = 0;
+      for (int y = y0; y <= y1; ++y)
+      {
+        for (int x = x0; x <= x1; ++x)
+          expected += test.IsWall(x, y);
+      }
+
+      CHECK_EQ(test.level.CountWalls(x0, y0, x1, y1), expected);
+      CHECK_EQ(test.level.AnyWall(x0, y0, x1, y1), expected > 0);
+    }
+
+    // empty rects
+    CHECK_EQ(test.level.CountWalls(10, 10, 9, 10), 0u);
+    CHECK(!test.level.AnyWall(-10, -10, -1, -1));
+  }
+
+  //------------------------------------------------------------------------------
+  // Where the segment enters the cell, and how long it stays in it, in [0, 1] along the
+  // segment. Returns false if it doesn't touch the cell. A segment running along an edge
+  // is in the cell to the right of, or below, the edge, like for the raycast.
+  bool EnterCell(const vec2& a, const vec2& b, int x, int y, float* tEnter, float* tLen)
+  {
+    float t0 = 0, t1 = 1;
+    float o[] = {a.x, a.y};
+    float d[] = {b.x - a.x, b.y - a.y};
+    float lo[] = {(float)x, (float)y};
+    for (int k = 0; k < 2; ++k)
+    {
+      if (d[k] == 0)
+      {
+        if (o[k] < lo[k] || o[k] >= lo[k] + 1)
+          return false;
+        continue;
+      }
+
+      float ta = (lo[k] - o[k]) / d[k];
+      float tb = (lo[k] + 1 - o[k]) / d[k];
+      t0 = max(t0, min(ta, tb));
+      t1 = min(t1, max(ta, tb));
+    }
+
+    *tEnter = t0;
+    *tLen = t1 - t0;
+    return t0 <= t1 + 1e-6f;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestRays(const TestLevel& test)
+  {
+    // The reference is the first wall cell the segment enters, from testing every cell
+    // around it. Segments that only graze a cell, at a corner or along an edge, can go
+    // either way, as the raycast gives edge points to the cell to the right or below.
+    const float GRAZE = 1e-3f;
+    std::mt19937 rng(3);
+    int numHits = 0;
+    for (int i = 0; i < 20000; ++i)
+    {
+      vec2 a((float)(rng() % (WIDTH * 10)) / 10 - 20, (float)(rng() % (HEIGHT * 10)) / 10 - 20);
+      float angle = (rng() % 6283) / 1000.f;
+      float len = (float)(rng() % 300);
+      vec2 dir(cosf(angle), sinf(angle));
+      // axis aligned rays, and ones along the cell edges
+      const vec2 axes[] = {vec2(1, 0), vec2(0, 1), vec2(-1, 0), vec2(0, -1)};
+      if (i % 10 == 0)
+        dir = axes[rng() % 4];
+      if (i % 20 == 0)
+        a = vec2((float)(int)a.x, (float)(int)a.y);
+      vec2 b(a.x + dir.x * len, a.y + dir.y * len);
+
+      float best = 2, bestLen = 0;
+      int x0 = (int)floorf(min(a.x, b.x)) - 1;
+      int x1 = (int)floorf(max(a.x, b.x)) + 1;
+      int y0 = (int)floorf(min(a.y, b.y)) - 1;
+      int y1 = (int)floorf(max(a.y, b.y)) + 1;
+      for (int y = y0; y <= y1; ++y)
+      {
+        for (int x = x0; x <= x1; ++x)
+        {
+          float t, tLen;
+          if (test.IsWall(x, y) && EnterCell(a, b, x, y, &t, &tLen) && t < best)
+          {
+            best = t;
+            bestLen = tLen * len;
+          }
+        }
+      }
+
+      vec2i hit;
+      if (test.level.Raycast(a, b, &hit))
+      {
+        // a wall on the segment, and no wall the segment properly passes through first
+        numHits++;
+        float t, tLen;
+        CHECK(test.IsWall(hit.x, hit.y));
+        CHECK(EnterCell(a, b, hit.x, hit.y, &t, &tLen));
+        CHECK(t <= best + 1e-3f || bestLen < GRAZE);
+      }
+      else
+      {
+        CHECK(best > 1 || bestLen < GRAZE);
+      }
+    }
+
+    // most of the rays hit something, so the hits are tested as well as the misses
+    CHECK(numHits > 5000);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestLevel test;
+  MakeLevel(&test);
+  TestRects(test);
+  TestRays(test);
+  return test::TestResult();
+}
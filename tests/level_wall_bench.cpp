@@ -0,0 +1,224 @@
+#include "bench.hpp"
+#include <game/level.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const int WIDTH = 2000;
+  const int HEIGHT = 1500;
+  const int PAGE_SIZE = BackgroundPage::SIZE;
+  const int RECT_SIZE = 32;
+  const int NUM_QUERIES = 1 << 16;
+
+  //------------------------------------------------------------------------------
+  // The old representation, with a vector of the wall cells per page, in row order. A
+  // query has to look at every wall of the pages it touches.
+  struct VectorLevel
+  {
+    struct Page
+    {
+      vector<vec2i> walls;
+    };
+
+    void Init(const vector<u8>& walls)
+    {
+      pageCountX = (WIDTH + PAGE_SIZE - 1) / PAGE_SIZE;
+      pageCountY = (HEIGHT + PAGE_SIZE - 1) / PAGE_SIZE;
+      pages.resize(pageCountX * pageCountY);
+      for (int y = 0; y < HEIGHT; ++y)
+      {
+        for (int x = 0; x < WIDTH; ++x)
+        {
+          if (walls[y * WIDTH + x])
+          {
+            Page& page = pages[(y / PAGE_SIZE) * pageCountX + x / PAGE_SIZE];
+            page.walls.push_back(vec2i{x % PAGE_SIZE, y % PAGE_SIZE});
+          }
+        }
+      }
+    }
+
+    size_t Bytes() const
+    {
+      size_t bytes = pages.capacity() * sizeof(Page);
+      for (const Page& page : pages)
+        bytes += page.walls.capacity() * sizeof(vec2i);
+      return bytes;
+    }
+
+    bool IsWall(int x, int y) const
+    {
+      if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT)
+        return false;
+
+      const Page& page = pages[(y / PAGE_SIZE) * pageCountX + x / PAGE_SIZE];
+      vec2i local = vec2i{x % PAGE_SIZE, y % PAGE_SIZE};
+      for (const vec2i& wall : page.walls)
+      {
+        if (wall.x == local.x && wall.y == local.y)
+          return true;
+      }
+      return false;
+    }
+
+    u32 CountWalls(int x0, int y0, int x1, int y1) const
+    {
+      x0 = max(x0, 0);
+      y0 = max(y0, 0);
+      x1 = min(x1, WIDTH - 1);
+      y1 = min(y1, HEIGHT - 1);
+      u32 count = 0;
+      for (int py = y0 / PAGE_SIZE; py <= y1 / PAGE_SIZE; ++py)
+      {
+        for (int px = x0 / PAGE_SIZE; px <= x1 / PAGE_SIZE; ++px)
+        {
+          for (const vec2i& wall : pages[py * pageCountX + px].walls)
+          {
+            int x = px * PAGE_SIZE + wall.x;
+            int y = py * PAGE_SIZE + wall.y;
+            count += x >= x0 && x <= x1 && y >= y0 && y <= y1;
+          }
+        }
+      }
+      return count;
+    }
+
+    bool AnyWall(int x0, int y0, int x1, int y1) const
+    {
+      x0 = max(x0, 0);
+      y0 = max(y0, 0);
+      x1 = min(x1, WIDTH - 1);
+      y1 = min(y1, HEIGHT - 1);
+      for (int py = y0 / PAGE_SIZE; py <= y1 / PAGE_SIZE; ++py)
+      {
+        for (int px = x0 / PAGE_SIZE; px <= x1 / PAGE_SIZE; ++px)
+        {
+          for (const vec2i& wall : pages[py * pageCountX + px].walls)
+          {
+            int x = px * PAGE_SIZE + wall.x;
+            int y = py * PAGE_SIZE + wall.y;
+            if (x >= x0 && x <= x1 && y >= y0 && y <= y1)
+              return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    int pageCountX = 0;
+    int pageCountY = 0;
+    vector<Page> pages;
+  };
+
+  //------------------------------------------------------------------------------
+  // Noise, with solid blocks and 1 pixel lines, for about 17% walls
+  vector<u8> MakeWalls()
+  {
+    std::mt19937 rng(1);
+    vector<u8> walls(WIDTH * HEIGHT);
+    for (u8& wall : walls)
+      wall = rng() % 100 < 9;
+
+    for (int i = 0; i < 600; ++i)
+    {
+      int x0 = rng() % WIDTH;
+      int y0 = rng() % HEIGHT;
+      int w = i % 3 == 0 ? 1 : 5 + rng() % 60;
+      int h = i % 3 == 1 ? 1 : 5 + rng() % 60;
+      for (int y = y0; y < min(HEIGHT, y0 + h); ++y)
+      {
+        for (int x = x0; x < min(WIDTH, x0 + w); ++x)
+          walls[y * WIDTH + x] = 1;
+      }
+    }
+    return walls;
+  }
+
+  //------------------------------------------------------------------------------
+  // Returns the queries per second
+  template <typename Fn>
+  double Rate(int numQueries, const Fn& fn)
+  {
+    double t = bench::MinTime(3, [&]() {
+      u32 sum = 0;
+      for (int i = 0; i < numQueries; ++i)
+        sum += fn(i);
+      bench::DoNotOptimize(sum);
+    });
+    return numQueries / t;
+  }
+}
+
+// Memory use and query rates for the walls of a 2000x1500 level, with the bit per cell
+// pages, and with the vector of wall cells per page they replaced. The rects are 32x32,
+// and both get the same random points and rects, partly outside the level. The vector
+// pages only get a sixteenth of the queries, as every query scans the walls of the pages
+// it touches.
+int main()
+{
+  vector<u8> walls = MakeWalls();
+  u32 numWalls = 0;
+  vector<u32> pixels(WIDTH * HEIGHT);
+  for (size_t i = 0; i < walls.size(); ++i)
+  {
+    pixels[i] = walls[i] ? 0xffffffff : 0xff000000;
+    numWalls += walls[i];
+  }
+
+  Level level;
+  level.Init(pixels.data(), WIDTH, HEIGHT);
+  VectorLevel vectorLevel;
+  vectorLevel.Init(walls);
+
+  std::mt19937 rng(2);
+  vector<vec2i> rects(NUM_QUERIES);
+  for (vec2i& p : rects)
+  {
+    p.x = (int)(rng() % (WIDTH + RECT_SIZE)) - RECT_SIZE;
+    p.y = (int)(rng() % (HEIGHT + RECT_SIZE)) - RECT_SIZE;
+  }
+
+  // the queries, for either representation
+  auto isWall = [&](const auto& walls, int i) {
+    return walls.IsWall(rects[i].x, rects[i].y) ? 1u : 0u;
+  };
+  auto countWalls = [&](const auto& walls, int i) {
+    const vec2i& p = rects[i];
+    return walls.CountWalls(p.x, p.y, p.x + RECT_SIZE - 1, p.y + RECT_SIZE - 1);
+  };
+  auto anyWall = [&](const auto& walls, int i) {
+    const vec2i& p = rects[i];
+    return walls.AnyWall(p.x, p.y, p.x + RECT_SIZE - 1, p.y + RECT_SIZE - 1) ? 1u : 0u;
+  };
+
+  bool ok = true;
+  const int numVectorQueries = NUM_QUERIES / 16;
+  for (int i = 0; i < numVectorQueries; ++i)
+  {
+    ok &= isWall(level, i) == isWall(vectorLevel, i);
+    ok &= countWalls(level, i) == countWalls(vectorLevel, i);
+    ok &= anyWall(level, i) == anyWall(vectorLevel, i);
+  }
+
+  double mb = 1024 * 1024;
+  printf("%dx%d level, %.1f%% walls, %d pages\n",
+      WIDTH,
+      HEIGHT,
+      100.0 * numWalls / walls.size(),
+      (int)level.pages.size());
+  printf("queries/s    memory      IsWall  CountWalls     AnyWall\n");
+  printf("bitmap  %7.2f MB %11.3g %11.3g %11.3g\n",
+      level.pages.capacity() * sizeof(BackgroundPage) / mb,
+      Rate(NUM_QUERIES, [&](int i) { return isWall(level, i); }),
+      Rate(NUM_QUERIES, [&](int i) { return countWalls(level, i); }),
+      Rate(NUM_QUERIES, [&](int i) { return anyWall(level, i); }));
+  printf("vector  %7.2f MB %11.3g %11.3g %11.3g\n",
+      vectorLevel.Bytes() / mb,
+      Rate(numVectorQueries, [&](int i) { return isWall(vectorLevel, i); }),
+      Rate(numVectorQueries, [&](int i) { return countWalls(vectorLevel, i); }),
+      Rate(numVectorQueries, [&](int i) { return anyWall(vectorLevel, i); }));
+  printf("%s\n", ok ? "results match" : "RESULTS DON'T MATCH");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+// the third party headers below aren't built with our warnings
+#pragma GCC system_header
+
+// Stand-in for the root precompiled.hpp, for building the platform independent parts of
+// the engine on Linux. Force included into every source file, like the real one.
+
+#define WITH_SCRATCH_MEMORY_CHECKS 1
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include <stdint.h>
+#include <assert.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <unordered_set>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include <stb/stb_image.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+namespace world
+{
+  using std::vector;
+  using std::string;
+  using std::deque;
+  using std::unordered_map;
+  using std::unordered_set;
+  using std::set;
+  using std::map;
+  using std::pair;
+  using std::make_pair;
+  using std::function;
+
+  using std::conditional;
+  using std::is_void;
+
+  using std::min;
+  using std::max;
+
+  using std::unique_ptr;
+}
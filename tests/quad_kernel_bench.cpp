@@ -0,0 +1,47 @@
+#include "bench.hpp"
+#include <core/quad_kernel.hpp>
+#include <random>
+
+using namespace world;
+
+// Quad kernel throughput, in quads per second, for the scalar reference and the SIMD
+// kernels supported by the cpu. The sprite ids are random, so the uv table lookups
+// aren't sequential, like for the entity sprites.
+int main()
+{
+  const u32 NUM_QUADS = 64 * 1024;
+  const int NUM_PASSES = 16;
+
+  std::mt19937 rng(1);
+  vector<SpriteQuad> sprites(256);
+  for (u32 i = 0; i < sprites.size(); ++i)
+    sprites[i] = SpriteQuad{i * 0.1f, i * 0.2f, i * 0.3f, i * 0.4f, 32, 32, {0, 0}};
+
+  vector<vec2> pos(NUM_QUADS);
+  vector<u32> ids(NUM_QUADS);
+  for (u32 i = 0; i < NUM_QUADS; ++i)
+  {
+    pos[i] = vec2((float)(rng() % 4096), (float)(rng() % 4096));
+    ids[i] = rng() % sprites.size();
+  }
+
+  vector<PosTex> out(NUM_QUADS * 4);
+  const char* kernels[] = {"scalar", "sse", "avx", "neon"};
+  for (const char* kernel : kernels)
+  {
+    if (!SetQuadKernel(kernel))
+      continue;
+
+    double t = bench::MinTime(10, [&]() {
+      for (int i = 0; i < NUM_PASSES; ++i)
+      {
+        BuildQuads(pos.data(), ids.data(), NUM_QUADS, sprites.data(), 0.5f, out.data());
+        bench::DoNotOptimize(out[0]);
+      }
+    });
+
+    printf("%-8s %8.1f M quads/s\n", kernel, NUM_QUADS * NUM_PASSES / t / 1e6);
+  }
+
+  return 0;
+}
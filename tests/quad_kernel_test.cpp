@@ -0,0 +1,99 @@
+#include "test.hpp"
+#include <core/quad_kernel.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const char* KERNELS[] = {"sse", "avx", "neon"};
+
+  //------------------------------------------------------------------------------
+  // Compares the active kernel against the scalar reference, for every count up to a few
+  // times the widest kernel, so all the tail paths are covered. The kernels must match
+  // bit for bit, and not write past the last quad.
+  void CompareWithScalar(std::mt19937& rng)
+  {
+    std::uniform_real_distribution<float> dist(-1000, 1000);
+    vector<SpriteQuad> sprites(50);
+    for (SpriteQuad& s : sprites)
+      s = SpriteQuad{dist(rng), dist(rng), dist(rng), dist(rng), dist(rng), dist(rng), {0, 0}};
+
+    const PosTex GUARD = {vec3{1234, 5678, 9012}, vec2{3456, 7890}};
+    for (u32 count = 0; count < 40; ++count)
+    {
+      // the positions start at an odd index, so the loads aren't 16 byte aligned
+      vector<vec2> pos(count + 1);
+      vector<u32> ids(count);
+      for (u32 i = 0; i < count; ++i)
+      {
+        pos[i + 1] = vec2(dist(rng), dist(rng));
+        ids[i] = rng() % sprites.size();
+      }
+
+      vector<PosTex> expected(count * 4);
+      BuildQuadsScalar(pos.data() + 1, ids.data(), count, sprites.data(), 0.25f, expected.data());
+
+      // same for the output, and there's a guard vertex after the last quad
+      vector<PosTex> out(count * 4 + 2, GUARD);
+      BuildQuads(pos.data() + 1, ids.data(), count, sprites.data(), 0.25f, out.data() + 1);
+
+      bool match = memcmp(out.data() + 1, expected.data(), count * 4 * sizeof(PosTex)) == 0;
+      if (!match)
+        fprintf(stderr, "%s: mismatch at count: %u\n", QuadKernelName(), count);
+      CHECK(match);
+      CHECK(memcmp(&out[0], &GUARD, sizeof(PosTex)) == 0);
+      CHECK(memcmp(&out[count * 4 + 1], &GUARD, sizeof(PosTex)) == 0);
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  void TestScalarLayout()
+  {
+    // the vertex order matches the quad indices
+    SpriteQuad sprite = {0.1f, 0.2f, 0.3f, 0.4f, 10, 20, {0, 0}};
+    vec2 pos(100, 200);
+    u32 id = 0;
+    PosTex out[4];
+    BuildQuadsScalar(&pos, &id, 1, &sprite, 0.5f, out);
+
+    CHECK(out[0].pos.x == 100 && out[0].pos.y == 200 && out[0].pos.z == 0.5f);
+    CHECK(out[0].tex.x == 0.1f && out[0].tex.y == 0.2f);
+    CHECK(out[1].pos.x == 110 && out[1].pos.y == 200);
+    CHECK(out[1].tex.x == 0.3f && out[1].tex.y == 0.2f);
+    CHECK(out[2].pos.x == 110 && out[2].pos.y == 180);
+    CHECK(out[2].tex.x == 0.3f && out[2].tex.y == 0.4f);
+    CHECK(out[3].pos.x == 100 && out[3].pos.y == 180);
+    CHECK(out[3].tex.x == 0.1f && out[3].tex.y == 0.4f);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestScalarLayout();
+
+  std::mt19937 rng(1);
+  int numTested = 0;
+  for (const char* kernel : KERNELS)
+  {
+    if (!SetQuadKernel(kernel))
+    {
+      printf("%s: not supported\n", kernel);
+      continue;
+    }
+
+    printf("%s: testing\n", kernel);
+    CompareWithScalar(rng);
+    numTested++;
+  }
+
+  // x86 always has SSE, and arm64 always has NEON, so only other cpus get away without a
+  // SIMD kernel
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+  CHECK(numTested > 0);
+#endif
+
+  CHECK(!SetQuadKernel("unknown"));
+  return test::TestResult();
+}
@@ -0,0 +1,247 @@
+#include "bench.hpp"
+#include <lib/rect_outline.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const int LEVEL_WIDTH = 1024;
+  const int LEVEL_HEIGHT = 128;
+  const float TILE_SIZE = 0.5f;
+  // Box2D's b2_aabbExtension, that the broadphase proxies are fattened by
+  const float AABB_EXTENSION = 0.1f;
+  const vec2 PLAYER_SIZE = vec2(1, 2);
+
+  struct Level
+  {
+    vector<u8> solid;
+    vector<int> groundHeight;
+  };
+
+  struct Aabb
+  {
+    vec2 minPos;
+    vec2 maxPos;
+  };
+
+  //------------------------------------------------------------------------------
+  // Rolling ground, with caves dug into it and platforms floating above it
+  Level MakeLevel()
+  {
+    std::mt19937 rng(1);
+    Level level;
+    level.solid.resize(LEVEL_WIDTH * LEVEL_HEIGHT);
+    level.groundHeight.resize(LEVEL_WIDTH);
+
+    int height = LEVEL_HEIGHT / 3;
+    for (int x = 0; x < LEVEL_WIDTH; ++x)
+    {
+      if (rng() % 4 == 0)
+        height = min(LEVEL_HEIGHT / 2, max(4, height + (int)(rng() % 3) - 1));
+      level.groundHeight[x] = height;
+      for (int y = 0; y < height; ++y)
+        level.solid[y * LEVEL_WIDTH + x] = 1;
+    }
+
+    for (int i = 0; i < LEVEL_WIDTH / 8; ++i)
+    {
+      int x0 = rng() % LEVEL_WIDTH;
+      int y0 = 2 + rng() % (LEVEL_HEIGHT / 4);
+      int w = 3 + rng() % 12;
+      int h = 2 + rng() % 4;
+      for (int y = y0; y < y0 + h; ++y)
+      {
+        for (int x = x0; x < min(LEVEL_WIDTH, x0 + w); ++x)
+          level.solid[y * LEVEL_WIDTH + x] = 0;
+      }
+
+      int px = rng() % LEVEL_WIDTH;
+      int py = level.groundHeight[px] + 4 + rng() % 16;
+      int pw = 2 + rng() % 10;
+      for (int x = px; x < min(LEVEL_WIDTH, px + pw); ++x)
+        level.solid[min(LEVEL_HEIGHT - 1, py) * LEVEL_WIDTH + x] = 1;
+    }
+
+    return level;
+  }
+
+  //------------------------------------------------------------------------------
+  OutlineRect TileRect(int x0, int y0, int x1, int y1)
+  {
+    return OutlineRect{
+        vec2(x0 * TILE_SIZE, y0 * TILE_SIZE), vec2(x1 * TILE_SIZE, y1 * TILE_SIZE)};
+  }
+
+  //------------------------------------------------------------------------------
+  // A rect for every solid tile, like a collision layer made with the tile stamp
+  vector<OutlineRect> TileRects(const Level& level)
+  {
+    vector<OutlineRect> rects;
+    for (int y = 0; y < LEVEL_HEIGHT; ++y)
+    {
+      for (int x = 0; x < LEVEL_WIDTH; ++x)
+      {
+        if (level.solid[y * LEVEL_WIDTH + x])
+          rects.push_back(TileRect(x, y, x + 1, y + 1));
+      }
+    }
+    return rects;
+  }
+
+  //------------------------------------------------------------------------------
+  // A rect for every horizontal run of solid tiles, like a collision layer drawn by hand
+  vector<OutlineRect> RowRects(const Level& level)
+  {
+    vector<OutlineRect> rects;
+    for (int y = 0; y < LEVEL_HEIGHT; ++y)
+    {
+      for (int x = 0; x < LEVEL_WIDTH;)
+      {
+        if (!level.solid[y * LEVEL_WIDTH + x])
+        {
+          ++x;
+          continue;
+        }
+
+        int x0 = x;
+        while (x < LEVEL_WIDTH && level.solid[y * LEVEL_WIDTH + x])
+          ++x;
+        rects.push_back(TileRect(x0, y, x, y + 1));
+      }
+    }
+    return rects;
+  }
+
+  //------------------------------------------------------------------------------
+  // Rects that don't touch, which is the worst case for the merging
+  vector<OutlineRect> ScatteredRects()
+  {
+    vector<OutlineRect> rects;
+    for (int y = 0; y < LEVEL_HEIGHT; y += 4)
+    {
+      for (int x = 0; x < LEVEL_WIDTH; x += 4)
+        rects.push_back(TileRect(x, y, x + 2, y + 1));
+    }
+    return rects;
+  }
+
+  //------------------------------------------------------------------------------
+  bool Overlaps(const Aabb& a, const Aabb& b)
+  {
+    return a.minPos.x <= b.maxPos.x && b.minPos.x <= a.maxPos.x && a.minPos.y <= b.maxPos.y
+        && b.minPos.y <= a.maxPos.y;
+  }
+
+  //------------------------------------------------------------------------------
+  Aabb Fatten(vec2 minPos, vec2 maxPos)
+  {
+    vec2 ext = vec2(AABB_EXTENSION, AABB_EXTENSION);
+    return Aabb{minPos - ext, maxPos + ext};
+  }
+
+  //------------------------------------------------------------------------------
+  // The average number of static proxies whose fat aabbs overlap the player's, with the
+  // player standing on the ground at every column. Each overlap is a contact that the
+  // broadphase creates, and the narrowphase updates every step.
+  float ContactsPerStep(const Level& level, const vector<Aabb>& proxies)
+  {
+    u32 numContacts = 0;
+    for (int x = 0; x < LEVEL_WIDTH; ++x)
+    {
+      vec2 feet = vec2((x + 0.5f) * TILE_SIZE, level.groundHeight[x] * TILE_SIZE);
+      vec2 halfWidth = vec2(PLAYER_SIZE.x / 2, 0);
+      Aabb player = Fatten(feet - halfWidth, feet + halfWidth + vec2(0, PLAYER_SIZE.y));
+      for (const Aabb& proxy : proxies)
+        numContacts += Overlaps(player, proxy) ? 1 : 0;
+    }
+    return (float)numContacts / LEVEL_WIDTH;
+  }
+
+  //------------------------------------------------------------------------------
+  void Run(const char* name, const Level& level, const vector<OutlineRect>& rects)
+  {
+    vector<vec2> points;
+    vector<u32> loopSizes;
+    double t = bench::MinTime(5, [&]() {
+      points.clear();
+      loopSizes.clear();
+      TraceRectOutlines(rects.data(), (u32)rects.size(), &points, &loopSizes);
+    });
+
+    // a box fixture has a single proxy, and a chain loop has one per edge
+    vector<Aabb> boxProxies;
+    for (const OutlineRect& rect : rects)
+      boxProxies.push_back(Fatten(rect.minPos, rect.maxPos));
+
+    // CreateCollisionBodies turns the outer loops with 4 corners, which are isolated
+    // rects, into boxes, and keeps the rest as chains
+    vector<Aabb> edgeProxies;
+    vector<Aabb> hybridProxies;
+    u32 numHybridBoxes = 0;
+    u32 firstPoint = 0;
+    for (u32 numPoints : loopSizes)
+    {
+      const vec2* outline = &points[firstPoint];
+      firstPoint += numPoints;
+
+      float area = 0;
+      for (u32 i = 0; i < numPoints; ++i)
+      {
+        vec2 a = outline[i];
+        vec2 b = outline[(i + 1) % numPoints];
+        area += a.x * b.y - b.x * a.y;
+        edgeProxies.push_back(
+            Fatten(vec2(min(a.x, b.x), min(a.y, b.y)), vec2(max(a.x, b.x), max(a.y, b.y))));
+      }
+
+      if (numPoints == 4 && area > 0)
+      {
+        vec2 a = outline[0];
+        vec2 b = outline[2];
+        hybridProxies.push_back(
+            Fatten(vec2(min(a.x, b.x), min(a.y, b.y)), vec2(max(a.x, b.x), max(a.y, b.y))));
+        numHybridBoxes++;
+      }
+      else
+      {
+        hybridProxies.insert(
+            hybridProxies.end(), edgeProxies.end() - numPoints, edgeProxies.end());
+      }
+    }
+
+    printf("%s\n", name);
+    printf("  boxes:  %6u bodies, %6u fixtures, %6u proxies, %5.2f contacts\n",
+        (u32)rects.size(),
+        (u32)rects.size(),
+        (u32)boxProxies.size(),
+        ContactsPerStep(level, boxProxies));
+    printf("  chains: %6u bodies, %6u fixtures, %6u proxies, %5.2f contacts, traced in %.3f ms\n",
+        1,
+        (u32)loopSizes.size(),
+        (u32)edgeProxies.size(),
+        ContactsPerStep(level, edgeProxies),
+        t * 1e3);
+    printf("  hybrid: %6u bodies, %6u fixtures, %6u proxies, %5.2f contacts, %u of them boxes\n",
+        1,
+        (u32)loopSizes.size(),
+        (u32)hybridProxies.size(),
+        ContactsPerStep(level, hybridProxies),
+        numHybridBoxes);
+  }
+}
+
+// The static bodies, fixtures and broadphase proxies for the collision layer of a dense
+// 1024x128 tile level, with a box body per rect, with the rects merged into chain loops
+// on a single body, and with the isolated rects of those loops as boxes on that body.
+// Box2D isn't built here, so instead of timing its broadphase and step, the contacts a
+// player standing on the ground would have with the static proxies are counted, as
+// those are what the step pays for.
+int main()
+{
+  Level level = MakeLevel();
+  Run("rect per tile", level, TileRects(level));
+  Run("rect per row of tiles", level, RowRects(level));
+  Run("scattered rects", level, ScatteredRects());
+  return 0;
+}
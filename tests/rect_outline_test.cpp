@@ -0,0 +1,122 @@
+#include "test.hpp"
+#include <lib/rect_outline.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  struct Outlines
+  {
+    vector<vec2> points;
+    vector<u32> loopSizes;
+  };
+
+  //------------------------------------------------------------------------------
+  Outlines Trace(const vector<OutlineRect>& rects)
+  {
+    Outlines res;
+    TraceRectOutlines(rects.data(), (u32)rects.size(), &res.points, &res.loopSizes);
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  // Positive for counter clockwise loops
+  float SignedArea(const Outlines& outlines, u32 loop)
+  {
+    u32 first = 0;
+    for (u32 i = 0; i < loop; ++i)
+      first += outlines.loopSizes[i];
+
+    u32 numPoints = outlines.loopSizes[loop];
+    float area = 0;
+    for (u32 i = 0; i < numPoints; ++i)
+    {
+      vec2 a = outlines.points[first + i];
+      vec2 b = outlines.points[first + (i + 1) % numPoints];
+      area += a.x * b.y - b.x * a.y;
+    }
+    return area / 2;
+  }
+
+  //------------------------------------------------------------------------------
+  OutlineRect Rect(float x0, float y0, float x1, float y1)
+  {
+    return OutlineRect{vec2(x0, y0), vec2(x1, y1)};
+  }
+
+  //------------------------------------------------------------------------------
+  void TestShapes()
+  {
+    // neighbouring rects merge into one, and only the corners are kept
+    Outlines merged = Trace({Rect(0, 0, 2, 1), Rect(2, 0, 5, 1)});
+    CHECK_EQ(merged.loopSizes.size(), 1u);
+    CHECK_EQ(merged.points.size(), 4u);
+    CHECK_EQ(SignedArea(merged, 0), 5.f);
+
+    // a ring has an outer loop, and a hole winding the other way
+    Outlines ring = Trace(
+        {Rect(0, 0, 3, 1), Rect(0, 2, 3, 3), Rect(0, 1, 1, 2), Rect(2, 1, 3, 2)});
+    CHECK_EQ(ring.loopSizes.size(), 2u);
+    if (ring.loopSizes.size() == 2)
+    {
+      float a = SignedArea(ring, 0);
+      float b = SignedArea(ring, 1);
+      CHECK_EQ(min(a, b), -1.f);
+      CHECK_EQ(max(a, b), 9.f);
+    }
+
+    // rects touching at a corner stay apart
+    Outlines corner = Trace({Rect(0, 0, 1, 1), Rect(1, 1, 2, 2)});
+    CHECK_EQ(corner.loopSizes.size(), 2u);
+    CHECK_EQ(corner.points.size(), 8u);
+
+    CHECK(Trace({}).loopSizes.empty());
+  }
+
+  //------------------------------------------------------------------------------
+  // The loops of random overlapping rects cover the same area as the rects
+  void TestRandom()
+  {
+    const int GRID_SIZE = 32;
+    std::mt19937 rng(1);
+    for (int iter = 0; iter < 50; ++iter)
+    {
+      vector<OutlineRect> rects;
+      vector<u8> grid(GRID_SIZE * GRID_SIZE, 0);
+      for (int i = 0; i < 20; ++i)
+      {
+        int x0 = rng() % (GRID_SIZE - 1);
+        int y0 = rng() % (GRID_SIZE - 1);
+        int x1 = x0 + 1 + rng() % min(8, GRID_SIZE - x0);
+        int y1 = y0 + 1 + rng() % min(8, GRID_SIZE - y0);
+        x1 = min(x1, GRID_SIZE);
+        y1 = min(y1, GRID_SIZE);
+        rects.push_back(Rect((float)x0, (float)y0, (float)x1, (float)y1));
+        for (int y = y0; y < y1; ++y)
+        {
+          for (int x = x0; x < x1; ++x)
+            grid[y * GRID_SIZE + x] = 1;
+        }
+      }
+
+      int filled = 0;
+      for (u8 cell : grid)
+        filled += cell;
+
+      Outlines outlines = Trace(rects);
+      float area = 0;
+      for (u32 i = 0; i < (u32)outlines.loopSizes.size(); ++i)
+        area += SignedArea(outlines, i);
+      CHECK_EQ(area, (float)filled);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestShapes();
+  TestRandom();
+  return test::TestResult();
+}
@@ -0,0 +1,159 @@
+#include "test.hpp"
+#include <core/sprite_batcher.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  //------------------------------------------------------------------------------
+  // The handle constructors are only for the graphics code, so the test textures are
+  // made from their raw bits
+  ObjectHandle MakeTexture(u32 id)
+  {
+    u32 raw = ObjectHandle::kTexture | (id << 8);
+    ObjectHandle handle;
+    memcpy((void*)&handle, &raw, sizeof(handle));
+    return handle;
+  }
+
+  //------------------------------------------------------------------------------
+  struct RecordingSubmitTarget : public SpriteSubmitTarget
+  {
+    struct Batch
+    {
+      u32 texture;
+      vector<PosTex> vertices;
+      const PosTex* vtx;
+    };
+
+    RecordingSubmitTarget(u32 maxQuads) : maxQuads(maxQuads) {}
+    virtual u32 MaxQuads() const override { return maxQuads; }
+    virtual void Submit(ObjectHandle texture, const PosTex* vtx, u32 numQuads) override
+    {
+      batches.push_back(Batch{texture.ToInt(), vector<PosTex>(vtx, vtx + numQuads * 4), vtx});
+    }
+
+    u32 maxQuads;
+    vector<Batch> batches;
+  };
+
+  struct Sprite
+  {
+    u32 texture;
+    SpriteQuad quad;
+    vec2 pos;
+  };
+
+  //------------------------------------------------------------------------------
+  // Adds sprites from a few textures in a random order, and checks that each texture
+  // is submitted in as few batches as the target allows, with the sprites in the order
+  // they were added.
+  void TestFlush(u32 numSprites, u32 numTextures, u32 maxQuads)
+  {
+    std::mt19937 rng(numSprites * 31 + maxQuads);
+    vector<Sprite> sprites;
+    SpriteBatcher batcher;
+    for (u32 i = 0; i < numSprites; ++i)
+    {
+      // sprites come in runs from the same texture
+      u32 texture = i > 0 && rng() % 4 ? sprites.back().texture : rng() % numTextures;
+      float uv = (float)(rng() % 16) / 16;
+      SpriteQuad quad = {uv, uv, uv + 0.0625f, uv + 0.0625f, 16, (float)(rng() % 32), {0, 0}};
+      Sprite sprite = {MakeTexture(texture).ToInt(), quad, vec2((float)i, (float)(rng() % 100))};
+      sprites.push_back(sprite);
+      batcher.Add(MakeTexture(texture), quad, sprite.pos);
+    }
+
+    CHECK_EQ(batcher.NumSprites(), numSprites);
+    RecordingSubmitTarget target(maxQuads);
+    batcher.Flush(&target);
+    CHECK_EQ(batcher.NumSprites(), 0u);
+
+    // the expected batches, with the textures in the order they were first used
+    vector<u32> textures;
+    for (const Sprite& sprite : sprites)
+    {
+      if (find(textures.begin(), textures.end(), sprite.texture) == textures.end())
+        textures.push_back(sprite.texture);
+    }
+
+    u32 numBatches = 0;
+    size_t batch = 0;
+    for (u32 texture : textures)
+    {
+      vector<PosTex> expected;
+      for (const Sprite& sprite : sprites)
+      {
+        if (sprite.texture != texture)
+          continue;
+        PosTex quad[4];
+        u32 id = 0;
+        BuildQuadsScalar(&sprite.pos, &id, 1, &sprite.quad, 0.5f, quad);
+        expected.insert(expected.end(), quad, quad + 4);
+      }
+
+      u32 numQuads = (u32)expected.size() / 4;
+      numBatches += (numQuads + maxQuads - 1) / maxQuads;
+
+      // the texture's sprites are split into full batches, and one with the rest
+      vector<PosTex> submitted;
+      for (; batch < target.batches.size() && target.batches[batch].texture == texture; ++batch)
+      {
+        const vector<PosTex>& vertices = target.batches[batch].vertices;
+        CHECK(vertices.size() / 4 <= maxQuads);
+        submitted.insert(submitted.end(), vertices.begin(), vertices.end());
+      }
+
+      CHECK_EQ(submitted.size(), expected.size());
+      CHECK(memcmp(submitted.data(), expected.data(), expected.size() * sizeof(PosTex)) == 0);
+    }
+
+    CHECK_EQ(target.batches.size(), numBatches);
+
+    // without scratch memory, the batches come from the heap staging, and the later ones
+    // don't overwrite the earlier ones
+    for (const RecordingSubmitTarget::Batch& batch : target.batches)
+    {
+      size_t size = batch.vertices.size() * sizeof(PosTex);
+      CHECK(memcmp(batch.vtx, batch.vertices.data(), size) == 0);
+    }
+    CHECK_EQ(batcher.GetStats().numSprites, numSprites);
+    CHECK_EQ(batcher.GetStats().numTextures, (u32)textures.size());
+    CHECK_EQ(batcher.GetStats().numSubmits, numBatches);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestNullTarget()
+  {
+    SpriteBatcher batcher;
+    SpriteQuad quad = {0, 0, 1, 1, 8, 8, {0, 0}};
+    for (int i = 0; i < 250; ++i)
+      batcher.Add(MakeTexture(i % 3 ? 1 : 2), quad, vec2((float)i, 0));
+
+    // 167 and 83 sprites, in batches of 100
+    NullSubmitTarget target(100);
+    batcher.Flush(&target);
+    CHECK_EQ(target.numSubmits, 3u);
+    CHECK_EQ(target.totalQuads, 250u);
+
+    // nothing is left over for the next frame
+    batcher.Flush(&target);
+    CHECK_EQ(target.numSubmits, 3u);
+    CHECK_EQ(batcher.GetStats().numSprites, 0u);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestFlush(0, 1, 16);
+  TestFlush(1, 1, 16);
+  TestFlush(100, 1, 1000);
+  TestFlush(1000, 5, 1000);
+  TestFlush(1000, 5, 64);
+  TestFlush(5000, 20, 7);
+  TestFlush(300, 3, 1);
+  TestNullTarget();
+  return test::TestResult();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Minimal check macros for the tests. A failed check is logged and counted, and the test
+// keeps going, so a single run shows all the failures. Tests return TestResult() from main.
+
+namespace world
+{
+  namespace test
+  {
+    inline int& NumFailures()
+    {
+      static int numFailures = 0;
+      return numFailures;
+    }
+
+    inline int TestResult()
+    {
+      if (NumFailures())
+        fprintf(stderr, "%d check(s) failed\n", NumFailures());
+      return NumFailures() ? 1 : 0;
+    }
+  }
+}
+
+#define CHECK(x)                                                                                   \
+  do                                                                                               \
+  {                                                                                                \
+    if (!(x))                                                                                      \
+    {                                                                                              \
+      fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      world::test::NumFailures()++;                                                                \
+    }                                                                                              \
+  } while (false)
+
+#define CHECK_EQ(a, b)                                                                             \
+  do                                                                                               \
+  {                                                                                                \
+    if (!((a) == (b)))                                                                             \
+    {                                                                                              \
+      fprintf(stderr, "%s(%d): check failed: %s == %s\n", __FILE__, __LINE__, #a, #b);             \
+      world::test::NumFailures()++;                                                                \
+    }                                                                                              \
+  } while (false)
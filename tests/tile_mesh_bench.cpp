@@ -0,0 +1,145 @@
+#include "bench.hpp"
+#include <core/tile_mesh.hpp>
+#include <core/tmx_level.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const int MAP_SIZE = 1000;
+  const float TILE_SIZE = 32;
+  const vec2 VIEW_SIZE = vec2(1920, 1080);
+  const int NUM_VIEWS = 64;
+
+  //------------------------------------------------------------------------------
+  // The old per-frame loop from SpriteManager::Render, which writes a quad for every
+  // non-empty tile of the layer, whether it's on screen or not
+  u32 BuildAllTiles(const TmxLevel& level, PosTex* vtx)
+  {
+    const TmxLayer& layer = level.layers[0];
+    const TmxTileset& tileset = level.tilesets[0];
+    float sx = (float)tileset.tileWidth / tileset.imageWidth;
+    float sy = (float)tileset.tileHeight / tileset.imageHeight;
+    float xInc = TILE_SIZE;
+    float yInc = TILE_SIZE;
+    float y = level.zeroLevel;
+    float z = 0.5f;
+    int idx = 0;
+    u32 numQuads = 0;
+    for (int i = 0; i < layer.height; ++i)
+    {
+      float x = 0;
+      for (int j = 0; j < layer.width; ++j)
+      {
+        int spriteId = layer.tiles[idx];
+        if (spriteId != 0)
+        {
+          spriteId -= 1;
+          int ww = tileset.imageWidth / tileset.tileWidth;
+          int spriteX = spriteId % ww;
+          int spriteY = spriteId / ww;
+
+          vtx[0] = PosTex{vec3{x, y, z}, vec2{sx * spriteX, sy * spriteY}};
+          vtx[1] = PosTex{vec3{x + xInc, y, z}, vec2{sx * spriteX + sx, sy * spriteY}};
+          vtx[2] = PosTex{
+              vec3{x + xInc, y - yInc, z}, vec2{sx * spriteX + sx, sy * spriteY + sy}};
+          vtx[3] = PosTex{vec3{x, y - yInc, z}, vec2{sx * spriteX, sy * spriteY + sy}};
+          vtx += 4;
+          numQuads++;
+        }
+        x += xInc;
+        idx++;
+      }
+      y -= yInc;
+    }
+
+    return numQuads;
+  }
+}
+
+// CPU cost per frame of the tile geometry for a 1000x1000 map, with 3 in 4 tiles set,
+// for the old loop that rebuilds every tile each frame, and for the baked mesh, where a
+// frame only culls the chunks against the view. The baked numbers are the average over
+// views spread over the map, with and without copying the visible quads, which is what
+// the streamed maps do.
+int main()
+{
+  TmxLevel level;
+  level.tileWidth = level.tileHeight = (int)TILE_SIZE;
+  level.zeroLevel = 0;
+  level.tilesets.push_back(TmxTileset{1, "tiles.png", 512, 512, "tiles", 0, 0, 256, 32, 32});
+
+  std::mt19937 rng(1);
+  level.layers.push_back(TmxLayer());
+  TmxLayer& layer = level.layers[0];
+  layer.width = layer.height = MAP_SIZE;
+  layer.tiles.resize(MAP_SIZE * MAP_SIZE);
+  for (u32& gid : layer.tiles)
+    gid = rng() % 4 ? 1 + rng() % 256 : 0;
+
+  vector<PosTex> all(MAP_SIZE * MAP_SIZE * 4);
+  u32 numQuads = 0;
+  double tLoop = bench::MinTime(5, [&]() {
+    numQuads = BuildAllTiles(level, all.data());
+    bench::DoNotOptimize(all[0]);
+  });
+
+  TileMeshDesc desc;
+  desc.origin = vec2(0, level.zeroLevel);
+  desc.tileSize = vec2(TILE_SIZE, TILE_SIZE);
+  desc.layers.push_back(TileMeshDesc::Layer{layer.tiles.data(), layer.width, layer.height});
+  desc.tilesets.push_back(TileMeshDesc::Tileset());
+  TmxTilesetLayout(level.tilesets[0], &desc.tilesets[0]);
+
+  TileMesh mesh;
+  double tBake = bench::MinTime(3, [&]() { mesh.Bake(desc); });
+
+  // the bottom left corners of the views, inside the map. nb: the rows go down from the
+  // zero level
+  vector<vec2> views;
+  for (int i = 0; i < NUM_VIEWS; ++i)
+  {
+    float x = (float)(rng() % (u32)(MAP_SIZE * TILE_SIZE - VIEW_SIZE.x));
+    float y = (float)(rng() % (u32)(MAP_SIZE * TILE_SIZE - VIEW_SIZE.y));
+    views.push_back(vec2(x, -MAP_SIZE * TILE_SIZE + y));
+  }
+
+  vector<TileMesh::Draw> draws;
+  u32 numVisible = 0;
+  double tCull = bench::MinTime(5, [&]() {
+    numVisible = 0;
+    for (const vec2& view : views)
+    {
+      draws.clear();
+      mesh.CullChunks(view, view + VIEW_SIZE, 32 * 1024, &draws);
+      for (const TileMesh::Draw& draw : draws)
+        numVisible += draw.numQuads;
+    }
+  });
+
+  vector<PosTex> visible(4 * 32 * 1024);
+  double tCopy = bench::MinTime(5, [&]() {
+    for (const vec2& view : views)
+    {
+      draws.clear();
+      mesh.CullChunks(view, view + VIEW_SIZE, 32 * 1024, &draws);
+      u32 ofs = 0;
+      for (const TileMesh::Draw& draw : draws)
+      {
+        u32 cnt = min(draw.numQuads, (u32)visible.size() / 4 - ofs);
+        memcpy(&visible[ofs * 4], &mesh.vertices[draw.firstVertex], cnt * 4 * sizeof(PosTex));
+        ofs += cnt;
+      }
+      bench::DoNotOptimize(visible[0]);
+    }
+  });
+
+  printf("per frame loop   %8.3f ms, %u quads\n", tLoop * 1e3, numQuads);
+  printf("bake once        %8.3f ms, %u chunks\n", tBake * 1e3, (u32)mesh.chunks.size());
+  printf("cull             %8.3f ms, %u quads visible\n",
+      tCull / NUM_VIEWS * 1e3,
+      numVisible / NUM_VIEWS);
+  printf("cull and copy    %8.3f ms\n", tCopy / NUM_VIEWS * 1e3);
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include "test.hpp"
+#include <core/tile_mesh.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  // A two layer map using three tilesets, where the first two share a texture
+  const int MAP_WIDTH = 150;
+  const int MAP_HEIGHT = 90;
+  const u32 NUM_TEXTURES = 2;
+
+  struct TestMap
+  {
+    TileMeshDesc desc;
+    vector<vector<u32>> tiles;
+  };
+
+  //------------------------------------------------------------------------------
+  TestMap MakeMap()
+  {
+    TestMap map;
+    TileMeshDesc& desc = map.desc;
+    desc.origin = vec2(-100, 400);
+    desc.tileSize = vec2(16, 8);
+
+    TileMeshDesc::Tileset ts;
+    ts.firstGid = 1;
+    ts.tileCount = 20;
+    ts.tilesPerRow = 5;
+    ts.uvSize = vec2(0.2f, 0.25f);
+    ts.texture = 0;
+    desc.tilesets.push_back(ts);
+
+    ts.firstGid = 21;
+    ts.tileCount = 10;
+    ts.tilesPerRow = 10;
+    ts.uvSize = vec2(0.1f, 1);
+    desc.tilesets.push_back(ts);
+
+    ts.firstGid = 40;
+    ts.tileCount = 8;
+    ts.tilesPerRow = 4;
+    ts.uvSize = vec2(0.25f, 0.5f);
+    ts.texture = 1;
+    desc.tilesets.push_back(ts);
+
+    // a mix of empty tiles, tiles from every tileset, flipped tiles, and gids that aren't
+    // in any tileset (31-39, and 48+)
+    std::mt19937 rng(1);
+    for (int l = 0; l < 2; ++l)
+    {
+      vector<u32> layer(MAP_WIDTH * MAP_HEIGHT);
+      for (u32& gid : layer)
+      {
+        gid = rng() % 4 ? rng() % 50 : 0;
+        if (rng() % 8 == 0)
+          gid |= 0x80000000;
+      }
+      map.tiles.push_back(layer);
+      desc.layers.push_back(TileMeshDesc::Layer{map.tiles.back().data(), MAP_WIDTH, MAP_HEIGHT});
+    }
+
+    return map;
+  }
+
+  //------------------------------------------------------------------------------
+  int TilesetForGid(const TileMeshDesc& desc, u32 gid)
+  {
+    for (size_t i = 0; i < desc.tilesets.size(); ++i)
+    {
+      const TileMeshDesc::Tileset& ts = desc.tilesets[i];
+      if (gid >= ts.firstGid && gid < ts.firstGid + ts.tileCount)
+        return (int)i;
+    }
+    return -1;
+  }
+
+  //------------------------------------------------------------------------------
+  // Number of drawn tiles per (layer, texture), for tiles in [x0, x1] x [y0, y1]
+  vector<u32> CountTiles(const TestMap& map, int x0, int y0, int x1, int y1)
+  {
+    vector<u32> res(map.desc.layers.size() * NUM_TEXTURES);
+    for (size_t l = 0; l < map.desc.layers.size(); ++l)
+    {
+      for (int y = max(y0, 0); y <= min(y1, MAP_HEIGHT - 1); ++y)
+      {
+        for (int x = max(x0, 0); x <= min(x1, MAP_WIDTH - 1); ++x)
+        {
+          u32 gid = map.tiles[l][y * MAP_WIDTH + x] & TileMesh::GID_MASK;
+          int ts = TilesetForGid(map.desc, gid);
+          if (ts >= 0)
+            res[l * NUM_TEXTURES + map.desc.tilesets[ts].texture]++;
+        }
+      }
+    }
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  void TestBake()
+  {
+    TestMap map = MakeMap();
+    TileMesh mesh;
+    mesh.Bake(map.desc);
+
+    vector<u32> expected = CountTiles(map, 0, 0, MAP_WIDTH - 1, MAP_HEIGHT - 1);
+    u32 total = 0;
+    for (u32 cnt : expected)
+      total += cnt;
+    CHECK_EQ(mesh.vertices.size(), total * 4);
+
+    // every gid maps to its tileset, and to the uv rect of its tile
+    for (size_t l = 0; l < map.desc.layers.size(); ++l)
+    {
+      for (int y = 0; y < MAP_HEIGHT; ++y)
+      {
+        for (int x = 0; x < MAP_WIDTH; ++x)
+        {
+          u32 gid = map.tiles[l][y * MAP_WIDTH + x] & TileMesh::GID_MASK;
+          int ts = TilesetForGid(map.desc, gid);
+          if (ts < 0)
+            continue;
+
+          CHECK_EQ(mesh.gidToTileset[gid], ts);
+          const TileMeshDesc::Tileset& tileset = map.desc.tilesets[ts];
+          const SpriteQuad& quad = mesh.gidSprites[gid];
+          u32 idx = gid - tileset.firstGid;
+          CHECK(quad.u0 == tileset.uvSize.x * (idx % tileset.tilesPerRow));
+          CHECK(quad.v0 == tileset.uvSize.y * (idx / tileset.tilesPerRow));
+          CHECK(quad.width == map.desc.tileSize.x && quad.height == map.desc.tileSize.y);
+        }
+      }
+    }
+
+    // the spans of a chunk only hold the tiles within the chunk
+    for (const TileMesh::Layer& layer : mesh.layers)
+    {
+      for (int i = 0; i < layer.chunksX * layer.chunksY; ++i)
+      {
+        const TileMesh::Chunk& chunk = mesh.chunks[layer.firstChunk + i];
+        for (u32 j = 0; j < chunk.numSpans; ++j)
+        {
+          const TileMesh::Span& span = mesh.spans[mesh.chunkSpans[chunk.firstSpan + j]];
+          CHECK(span.numQuads <= TileMesh::MAX_QUADS_PER_CHUNK);
+          for (u32 k = 0; k < span.numQuads; ++k)
+          {
+            const PosTex& v = mesh.vertices[span.firstVertex + k * 4];
+            int tx = (int)((v.pos.x - mesh.origin.x) / mesh.tileSize.x);
+            int ty = (int)((mesh.origin.y - v.pos.y) / mesh.tileSize.y);
+            CHECK_EQ(tx / TileMesh::CHUNK_SIZE, i % layer.chunksX);
+            CHECK_EQ(ty / TileMesh::CHUNK_SIZE, i / layer.chunksX);
+          }
+        }
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  // Culls the tile rect [x0, x1] x [y0, y1], and checks that the draws are sorted and
+  // merged, and cover the tiles in the chunks overlapping the rect.
+  void CheckCull(TileMesh& mesh, const TestMap& map, int x0, int y0, int x1, int y1, u32 maxQuads)
+  {
+    // nb: the rows go down from the origin, and the edges belong to the next tile
+    const vec2& ts = mesh.tileSize;
+    vec2 minPos(mesh.origin.x + x0 * ts.x, mesh.origin.y - (y1 + 1) * ts.y + 1);
+    vec2 maxPos(mesh.origin.x + (x1 + 1) * ts.x - 1, mesh.origin.y - y0 * ts.y - 1);
+
+    vector<TileMesh::Draw> draws;
+    mesh.CullChunks(minPos, maxPos, maxQuads, &draws);
+
+    // the culling works on whole chunks
+    const int CS = TileMesh::CHUNK_SIZE;
+    vector<u32> expected = CountTiles(
+        map, x0 / CS * CS, y0 / CS * CS, (x1 / CS + 1) * CS - 1, (y1 / CS + 1) * CS - 1);
+
+    vector<u32> drawn(expected.size());
+    for (size_t i = 0; i < draws.size(); ++i)
+    {
+      const TileMesh::Draw& draw = draws[i];
+      CHECK(draw.numQuads > 0 && draw.numQuads <= maxQuads);
+      drawn[draw.layer * NUM_TEXTURES + draw.texture] += draw.numQuads;
+
+      if (i == 0)
+        continue;
+
+      // sorted on (layer, texture), and adjacent draws that could be merged have been
+      const TileMesh::Draw& prev = draws[i - 1];
+      u32 prevKey = prev.layer * NUM_TEXTURES + prev.texture;
+      u32 key = draw.layer * NUM_TEXTURES + draw.texture;
+      CHECK(prevKey <= key);
+      if (prevKey == key && prev.firstVertex + prev.numQuads * 4 == draw.firstVertex)
+        CHECK(prev.numQuads + draw.numQuads > maxQuads);
+    }
+
+    CHECK(drawn == expected);
+  }
+
+  //------------------------------------------------------------------------------
+  void TestCull()
+  {
+    TestMap map = MakeMap();
+    TileMesh mesh;
+    mesh.Bake(map.desc);
+
+    // the whole map is a single draw per layer and texture
+    vector<TileMesh::Draw> draws;
+    mesh.CullChunks(vec2(-1e6f, -1e6f), vec2(1e6f, 1e6f), ~0u, &draws);
+    CHECK_EQ(draws.size(), map.desc.layers.size() * NUM_TEXTURES);
+    CheckCull(mesh, map, 0, 0, MAP_WIDTH - 1, MAP_HEIGHT - 1, ~0u);
+
+    // split into draws no larger than a chunk
+    CheckCull(mesh, map, 0, 0, MAP_WIDTH - 1, MAP_HEIGHT - 1, TileMesh::MAX_QUADS_PER_CHUNK);
+
+    // views of a part of the map, or partially outside it
+    std::mt19937 rng(2);
+    for (int i = 0; i < 200; ++i)
+    {
+      int x0 = (int)(rng() % (MAP_WIDTH + 40)) - 20;
+      int y0 = (int)(rng() % (MAP_HEIGHT + 40)) - 20;
+      int x1 = x0 + (int)(rng() % 80);
+      int y1 = y0 + (int)(rng() % 60);
+      if (x1 < 0 || y1 < 0 || x0 >= MAP_WIDTH || y0 >= MAP_HEIGHT)
+        continue;
+      CheckCull(mesh, map, max(x0, 0), max(y0, 0), x1, y1, TileMesh::MAX_QUADS_PER_CHUNK * 2);
+    }
+
+    // nothing to draw outside the map
+    draws.clear();
+    mesh.CullChunks(vec2(1e5f, 1e5f), vec2(2e5f, 2e5f), ~0u, &draws);
+    CHECK(draws.empty());
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestBake();
+  TestCull();
+  return test::TestResult();
+}
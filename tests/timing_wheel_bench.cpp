@@ -0,0 +1,101 @@
+#include "bench.hpp"
+#include <lib/timing_wheel.hpp>
+#include <queue>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  const u32 MAX_DELAY = 1 << 16;
+  const u32 NUM_EXPIRED = 1000000;
+
+  struct Result
+  {
+    double insert;
+    double expire;
+  };
+
+  //------------------------------------------------------------------------------
+  // ns per insert, filling the wheel with 'numPending' timers, and ns per expired timer,
+  // advancing until a million timers have fired, re-adding each one as it does so the
+  // number of pending timers stays the same
+  Result RunWheel(u32 numPending)
+  {
+    std::mt19937 rng(numPending);
+    vector<u32> delays(NUM_EXPIRED);
+    for (u32& delay : delays)
+      delay = 1 + rng() % MAX_DELAY;
+
+    TimingWheel wheel;
+    double start = bench::Now();
+    for (u32 i = 0; i < numPending; ++i)
+      wheel.Add(delays[i % NUM_EXPIRED], i);
+    double insert = bench::Now() - start;
+
+    u32 numExpired = 0;
+    start = bench::Now();
+    while (numExpired < NUM_EXPIRED)
+    {
+      wheel.Advance(wheel.Now() + 1, [&](u32 value) {
+        wheel.Add(wheel.Now() + delays[numExpired++ % NUM_EXPIRED], value);
+      });
+    }
+    double expire = bench::Now() - start;
+    return Result{insert / numPending * 1e9, expire / numExpired * 1e9};
+  }
+
+  //------------------------------------------------------------------------------
+  // The same with a binary heap, for comparison
+  Result RunHeap(u32 numPending)
+  {
+    std::mt19937 rng(numPending);
+    vector<u32> delays(NUM_EXPIRED);
+    for (u32& delay : delays)
+      delay = 1 + rng() % MAX_DELAY;
+
+    typedef pair<u64, u32> Timer;
+    std::priority_queue<Timer, vector<Timer>, std::greater<Timer>> heap;
+    double start = bench::Now();
+    for (u32 i = 0; i < numPending; ++i)
+      heap.push(Timer(delays[i % NUM_EXPIRED], i));
+    double insert = bench::Now() - start;
+
+    u64 now = 0;
+    u32 numExpired = 0;
+    start = bench::Now();
+    while (numExpired < NUM_EXPIRED)
+    {
+      ++now;
+      while (!heap.empty() && heap.top().first <= now)
+      {
+        u32 value = heap.top().second;
+        heap.pop();
+        heap.push(Timer(now + delays[numExpired++ % NUM_EXPIRED], value));
+      }
+    }
+    double expire = bench::Now() - start;
+    return Result{insert / numPending * 1e9, expire / numExpired * 1e9};
+  }
+}
+
+// Insert and expire cost per timer for a growing number of pending timers, with delays of
+// up to 65536 ticks. The expire times include re-adding the timer, and the ticks where
+// nothing expires, which are most of them for the smaller timer counts.
+int main()
+{
+  printf("ns per timer    wheel insert  expire    heap insert  expire\n");
+  u32 counts[] = {1000, 10000, 100000, 1000000};
+  for (u32 numPending : counts)
+  {
+    Result wheel = RunWheel(numPending);
+    Result heap = RunHeap(numPending);
+    printf("%7u pending %12.1f %7.1f %14.1f %7.1f\n",
+        numPending,
+        wheel.insert,
+        wheel.expire,
+        heap.insert,
+        heap.expire);
+  }
+  return 0;
+}
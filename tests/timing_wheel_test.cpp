@@ -0,0 +1,99 @@
+#include "test.hpp"
+#include <lib/timing_wheel.hpp>
+#include <random>
+
+using namespace world;
+
+namespace
+{
+  struct Timer
+  {
+    u64 expire;
+    u32 value;
+  };
+
+  //------------------------------------------------------------------------------
+  // Adds timers at random times, some of them while the wheel is advancing, and checks
+  // that they fire on their tick, in (expiry, insertion) order. The expiry times cover
+  // every level of the wheel, and beyond its range, so timers added early are cascaded
+  // into the same slots as ones added later.
+  void TestOrder(u64 maxDelay, u32 numTimers)
+  {
+    std::mt19937 rng((u32)maxDelay);
+    TimingWheel wheel;
+    vector<Timer> timers;
+    vector<u32> fired;
+    u64 lastExpire = 0;
+
+    auto add = [&](u64 delay) {
+      Timer timer = {wheel.Now() + max(delay, (u64)1), (u32)timers.size()};
+      timers.push_back(timer);
+      wheel.Add(timer.expire, timer.value);
+      lastExpire = max(lastExpire, timer.expire);
+    };
+
+    for (u32 i = 0; i < numTimers / 2; ++i)
+      add(rng() % maxDelay);
+
+    // advance in uneven steps, adding timers as we go, some expiring on the same ticks
+    // as the ones already in the wheel
+    while (wheel.NumPending() > 0 || timers.size() < numTimers)
+    {
+      u64 now = wheel.Now() + 1 + rng() % 100;
+      wheel.Advance(now, [&](u32 value) {
+        CHECK_EQ(timers[value].expire, wheel.Now());
+        fired.push_back(value);
+      });
+
+      for (int i = 0; i < 4 && timers.size() < numTimers; ++i)
+      {
+        u64 expire = timers[rng() % timers.size()].expire;
+        add(i % 2 && expire > wheel.Now() ? expire - wheel.Now() : rng() % maxDelay);
+      }
+    }
+
+    CHECK_EQ(fired.size(), timers.size());
+    CHECK(wheel.Now() >= lastExpire);
+    for (size_t i = 1; i < fired.size(); ++i)
+    {
+      const Timer& a = timers[fired[i - 1]];
+      const Timer& b = timers[fired[i]];
+      CHECK(a.expire < b.expire || (a.expire == b.expire && a.value < b.value));
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  void TestReentrant()
+  {
+    // timers added from the callback, including ones that have already expired, fire on
+    // the next tick
+    TimingWheel wheel;
+    wheel.Add(10, 0);
+    vector<pair<u64, u32>> fired;
+    wheel.Advance(20, [&](u32 value) {
+      fired.push_back(make_pair(wheel.Now(), value));
+      if (value < 5)
+        wheel.Add(value % 2 ? 0 : wheel.Now() + 3, value + 1);
+    });
+
+    u64 expected[] = {10, 13, 14, 17, 18};
+    CHECK_EQ(fired.size(), 5u);
+    for (size_t i = 0; i < fired.size(); ++i)
+    {
+      CHECK_EQ(fired[i].first, expected[i]);
+      CHECK_EQ(fired[i].second, (u32)i);
+    }
+    CHECK_EQ(wheel.NumPending(), 1u);
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestOrder(64, 2000);
+  TestOrder(64 * 64 * 4, 20000);
+  TestOrder(64 * 64 * 64 * 3, 20000);
+  TestOrder(1ull << 26, 5000);
+  TestReentrant();
+  return test::TestResult();
+}
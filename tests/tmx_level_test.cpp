@@ -0,0 +1,100 @@
+#include "test.hpp"
+#include <core/tmx_level.hpp>
+
+using namespace world;
+
+namespace
+{
+  const char* TEST_MAP = R"({
+    "width": 4, "height": 2, "tilewidth": 16, "tileheight": 16,
+    "properties": {"zerolevel": "10"},
+    "layers": [
+      {"name": "ground", "width": 4, "height": 2, "data": [1, 2, 0, 3, 4, 0, 0, 5]},
+      {"name": "Collision", "objects": [
+        {"x": 0, "y": 16, "width": 64, "height": 16, "rotation": 0},
+        {"x": 0, "y": 0, "width": 0, "height": 0, "rotation": 0,
+         "polyline": [{"x": 0, "y": 0}, {"x": 8, "y": 8}]}]}
+    ],
+    "tilesets": [
+      {"name": "tiles", "image": "tiles.png", "firstgid": 1, "imagewidth": 139,
+       "imageheight": 71, "margin": 2, "spacing": 1, "tilecount": 32,
+       "tilewidth": 16, "tileheight": 16}
+    ]})";
+
+  //------------------------------------------------------------------------------
+  // Reading the same map twice into a reset level gives the same level
+  void TestRead()
+  {
+    TmxLevel level;
+    for (int i = 0; i < 2; ++i)
+    {
+      level.Reset();
+      TmxCollision collision;
+      CHECK(ReadTmxJson(TEST_MAP, strlen(TEST_MAP), "test", &level, &collision));
+      CHECK_EQ(level.layers.size(), 1u);
+      CHECK_EQ(level.tilesets.size(), 1u);
+      CHECK_EQ(level.zeroLevel, 160.f);
+      CHECK_EQ(collision.rects.size(), 1u);
+      CHECK_EQ(collision.polylines.size(), 1u);
+      CHECK_EQ(collision.points.size(), 2u);
+      if (level.layers.empty())
+        continue;
+
+      const TmxLayer& layer = level.layers[0];
+      const u32 tiles[] = {1, 2, 0, 3, 4, 0, 0, 5};
+      CHECK(layer.tiles.size() == 8 && memcmp(layer.Tiles(), tiles, sizeof(tiles)) == 0);
+    }
+
+    level.Reset();
+    CHECK(level.layers.empty() && level.tilesets.empty() && !level.infinite);
+  }
+
+  //------------------------------------------------------------------------------
+  // The tiles start 'margin' pixels in from the edge of the image, with 'spacing' pixels
+  // between them, and the uvs in the baked mesh follow
+  void TestTilesetLayout()
+  {
+    TmxTileset tileset = {1, "tiles.png", 139, 71, "tiles", 2, 1, 32, 16, 16};
+    TileMeshDesc::Tileset layout;
+    CHECK(TmxTilesetLayout(tileset, &layout));
+
+    // (139 - 4 + 1) / 17 = 8 tiles per row, and 4 rows
+    CHECK_EQ(layout.tilesPerRow, 8);
+    CHECK_EQ(layout.tileCount, 32u);
+
+    TileMeshDesc desc;
+    desc.tilesets.push_back(layout);
+    TileMesh mesh;
+    mesh.Bake(desc);
+
+    // the second tile on the second row
+    const SpriteQuad& quad = mesh.gidSprites[1 + 9];
+    CHECK(fabsf(quad.u0 - (2 + 17) / 139.f) < 1e-6f);
+    CHECK(fabsf(quad.v0 - (2 + 17) / 71.f) < 1e-6f);
+    CHECK(fabsf(quad.u1 - (2 + 17 + 16) / 139.f) < 1e-6f);
+    CHECK(fabsf(quad.v1 - (2 + 17 + 16) / 71.f) < 1e-6f);
+
+    // the last tile ends 'margin' pixels from the right edge
+    const SpriteQuad& last = mesh.gidSprites[1 + 7];
+    CHECK(fabsf(last.u1 - (139 - 2) / 139.f) < 1e-6f);
+
+    // images without room for a tile, and empty tiles, are refused
+    TmxTileset bad = tileset;
+    bad.imageWidth = 16;
+    CHECK(!TmxTilesetLayout(bad, &layout));
+    bad = tileset;
+    bad.tileWidth = 0;
+    CHECK(!TmxTilesetLayout(bad, &layout));
+    bad = tileset;
+    bad.spacing = -17;
+    CHECK(!TmxTilesetLayout(bad, &layout));
+  }
+}
+
+//------------------------------------------------------------------------------
+int main()
+{
+  TestRead();
+  TestTilesetLayout();
+  return test::TestResult();
+}
@@ -0,0 +1,183 @@
+#include "bench.hpp"
+#include "level_files.hpp"
+#include <lib/base64.hpp>
+#include <lib/file_utils.hpp>
+#include <lib/frame_allocator.hpp>
+#include <random>
+#include <zlib.h>
+
+using namespace world;
+using namespace world::level_files;
+
+namespace
+{
+  const int MAP_SIZE = 4096;
+  const char* FILENAME = "tmx_load_bench.tmp";
+  const char* ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  //------------------------------------------------------------------------------
+  // Padded base64 of the tiles, as a json string
+  string Base64String(const u8* data, size_t len)
+  {
+    string res = "\"";
+    res.reserve((len + 2) / 3 * 4 + 2);
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3)
+    {
+      u32 v = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+      res += ALPHABET[v >> 18];
+      res += ALPHABET[(v >> 12) & 63];
+      res += ALPHABET[(v >> 6) & 63];
+      res += ALPHABET[v & 63];
+    }
+
+    size_t rest = len - i;
+    if (rest)
+    {
+      u32 v = data[i] << 16 | (rest == 2 ? data[i + 1] << 8 : 0);
+      res += ALPHABET[v >> 18];
+      res += ALPHABET[(v >> 12) & 63];
+      res += rest == 2 ? ALPHABET[(v >> 6) & 63] : '=';
+      res += '=';
+    }
+
+    res += '"';
+    return res;
+  }
+
+  //------------------------------------------------------------------------------
+  // Compresses with the reference zlib, at its default level, like Tiled does
+  vector<u8> Compress(const vector<u32>& tiles, bool gzip)
+  {
+    z_stream stream = {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, 0);
+    uLong size = (uLong)(tiles.size() * sizeof(u32));
+    vector<u8> out(deflateBound(&stream, size) + 64);
+    stream.next_in = (Bytef*)tiles.data();
+    stream.avail_in = (uInt)size;
+    stream.next_out = out.data();
+    stream.avail_out = (uInt)out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+  }
+
+  //------------------------------------------------------------------------------
+  // Tile layer like data: runs of the same gid, with some empty tiles
+  vector<u32> MakeTiles()
+  {
+    std::mt19937 rng(1);
+    vector<u32> tiles((size_t)MAP_SIZE * MAP_SIZE);
+    u32 gid = 0;
+    for (u32& tile : tiles)
+    {
+      if (rng() % 8 == 0)
+        gid = rng() % 4 ? 1 + rng() % 1024 : 0;
+      tile = gid;
+    }
+    return tiles;
+  }
+
+  //------------------------------------------------------------------------------
+  // Writes the file, and returns the fastest time to load it, or 0 if it doesn't load
+  // to the expected tiles
+  double TimeJson(const string& json, u32 expectedSum)
+  {
+    if (!SaveFile(FILENAME, json.data(), (int)json.size()))
+      return 0;
+
+    bool ok = true;
+    double t = bench::MinTime(3, [&]() {
+      MappedFile file;
+      TmxLevel level;
+      TmxCollision collision;
+      ok &= file.Open(FILENAME)
+            && ReadTmxJson(file.Data(), file.Size(), FILENAME, &level, &collision)
+            && SumTiles(level) == expectedSum;
+    });
+
+    remove(FILENAME);
+    return ok ? t : 0;
+  }
+
+  //------------------------------------------------------------------------------
+  double TimeCooked(const vector<char>& cooked, u32 expectedSum)
+  {
+    if (!SaveFile(FILENAME, cooked.data(), (int)cooked.size()))
+      return 0;
+
+    bool ok = true;
+    double t = bench::MinTime(5, [&]() {
+      TmxLevel level;
+      CookedLevel cookedLevel;
+      ok &= level.cookedFile.Open(FILENAME)
+            && cookedLevel.Init(level.cookedFile.Data(), level.cookedFile.Size());
+      ReadCookedLevel(cookedLevel, &level);
+      ok &= SumTiles(level) == expectedSum;
+    });
+
+    remove(FILENAME);
+    return ok ? t : 0;
+  }
+
+  //------------------------------------------------------------------------------
+  void Report(const char* name, double t, size_t size, double tJson)
+  {
+    if (t == 0)
+    {
+      printf("%-16s FAILED\n", name);
+      return;
+    }
+
+    printf("%-16s %8.2f ms %7.1f MB %6.1fx\n", name, t * 1e3, size / (1024. * 1024), tJson / t);
+  }
+}
+
+// Load time for a 4096x4096 layer, with every way the tiles can be stored: the json int
+// array, base64, base64 with zlib or gzip, and the cooked level. The tiles come in runs,
+// like a real layer, so they compress well. Every load reads all the tiles, so the
+// cooked level's pages are faulted in as well. The files come from the page cache, and
+// the speedups are against the json int array.
+int main()
+{
+  // the encoded layers are decoded in the scratch memory, like when the game loads them
+  if (!g_ScratchMemory.InitVirtual(128 * 1024 * 1024, 0))
+    return 1;
+
+  vector<u32> tiles = MakeTiles();
+  u32 expectedSum = 0;
+  for (u32 gid : tiles)
+    expectedSum += gid;
+
+  const u8* raw = (const u8*)tiles.data();
+  size_t rawSize = tiles.size() * sizeof(u32);
+  vector<u8> zlib = Compress(tiles, false);
+  vector<u8> gzip = Compress(tiles, true);
+
+  string json = MakeJson(MAP_SIZE, TileArray(tiles));
+  string base64 = MakeJson(MAP_SIZE, Base64String(raw, rawSize), ",\"encoding\":\"base64\"");
+  string base64Zlib = MakeJson(MAP_SIZE,
+      Base64String(zlib.data(), zlib.size()),
+      ",\"encoding\":\"base64\",\"compression\":\"zlib\"");
+  string base64Gzip = MakeJson(MAP_SIZE,
+      Base64String(gzip.data(), gzip.size()),
+      ",\"encoding\":\"base64\",\"compression\":\"gzip\"");
+  vector<char> cooked = MakeCooked(MAP_SIZE, tiles);
+
+  double tJson = TimeJson(json, expectedSum);
+  double tBase64 = TimeJson(base64, expectedSum);
+  double tZlib = TimeJson(base64Zlib, expectedSum);
+  double tGzip = TimeJson(base64Gzip, expectedSum);
+  double tCooked = TimeCooked(cooked, expectedSum);
+
+  printf("base64 kernel: %s\n", Base64KernelName());
+  Report("json int array", tJson, json.size(), tJson);
+  Report("base64", tBase64, base64.size(), tJson);
+  Report("base64 + zlib", tZlib, base64Zlib.size(), tJson);
+  Report("base64 + gzip", tGzip, base64Gzip.size(), tJson);
+  Report("cooked", tCooked, cooked.size(), tJson);
+
+  bool ok = tJson && tBase64 && tZlib && tGzip && tCooked;
+  return ok ? 0 : 1;
+}
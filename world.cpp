@@ -6,8 +6,10 @@
 #include "lib/init_sequence.hpp"
 #include "lib/rolling_average.hpp"
 #include "lib/stop_watch.hpp"
-#include "lib/arena_allocator.hpp"
+#include "lib/frame_allocator.hpp"
 #include "lib/file_utils.hpp"
+#include "lib/job_pool.hpp"
+#include "lib/utils.hpp"
 #include "world.hpp"
 #include "game/level.hpp"
 
@@ -20,8 +22,13 @@ const TCHAR* g_AppWindowTitle = _T("World");
 
 using namespace world;
 static const int WM_APP_CLOSE = WM_APP + 2;
+// The scratch arenas are sized for the worst case level, but only the touched pages
+// are committed, and anything past SCRATCH_MEMORY_KEEP is decommitted when an arena is
+// reused.
+static const u32 SCRATCH_MEMORY_RESERVE = 256 * 1024 * 1024;
+static const u32 SCRATCH_MEMORY_KEEP = 16 * 1024 * 1024;
 
-ArenaAllocator world::g_ScratchMemory;
+JobPool world::g_JobPool;
 KeyUpTrigger world::g_KeyUpTrigger;
 
 namespace world
@@ -39,6 +46,10 @@ bool World::Init(HINSTANCE hinstance)
 
   FindAppRoot("app.gb");
 
+  INIT_FATAL(g_ScratchMemory.InitVirtual(SCRATCH_MEMORY_RESERVE, SCRATCH_MEMORY_KEEP));
+  // the main thread works on the jobs too
+  INIT_FATAL(g_JobPool.Init(max(1, (int)std::thread::hardware_concurrency()) - 1));
+
   INIT_FATAL(ResourceManager::Create("resources.txt", _appRoot.c_str()));
   g_ResourceManager->AddPath("D:/OneDrive/world");
   g_ResourceManager->AddPath("C:/OneDrive/world");
@@ -78,6 +89,7 @@ bool World::Close()
   ResourceManager::Destroy();
   Graphics::Destroy();
   EventManager::Destroy();
+  g_JobPool.Close();
   return true;
 }
 
@@ -152,15 +164,15 @@ LRESULT World::WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     switch (wParam)
     {
     case VK_LEFT:
-      g_SpriteManager->_dynamicBody->ApplyForceToCenter(b2Vec2(-15, 0), true);
+      g_SpriteManager->ApplyForce(b2Vec2(-15, 0));
       return 0;
 
     case VK_RIGHT:
-      g_SpriteManager->_dynamicBody->ApplyForceToCenter(b2Vec2(+15, 0), true);
+      g_SpriteManager->ApplyForce(b2Vec2(+15, 0));
       return 0;
 
     case VK_UP:
-      g_SpriteManager->_dynamicBody->ApplyForceToCenter(b2Vec2(0, 15), true);
+      g_SpriteManager->ApplyForce(b2Vec2(0, 15));
       return 0;
 
     case VK_DOWN:
@@ -224,7 +236,6 @@ bool World::Run()
 
   while (WM_QUIT != msg.message)
   {
-    g_ScratchMemory.NewFrame();
     if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
     {
       TranslateMessage(&msg);
@@ -233,6 +244,9 @@ bool World::Run()
     }
     stopWatch.Start();
 
+    // nb: only advance the scratch memory on actual frames, and not for every message
+    g_ScratchMemory.NewFrame();
+
     g_eventManager->Tick();
     //UpdateIoState();
 
@@ -262,6 +276,20 @@ bool World::Run()
         minValue * 1000,
         maxValue * 1000,
         avgFrameTime.GetAverage() * 1000);
+      ImGui::Text("Event queue peak: %.1f KB, pages: %d",
+        g_eventManager->_stats.highWaterMark / 1024.f,
+        g_eventManager->_stats.numPagesAllocated);
+      ImGui::Text("Tile draws: %d", (int)g_SpriteManager->_tileDraws.size());
+      const PhysicsSnapshot& physics = *g_SpriteManager->_physicsSnapshot;
+      ImGui::Text("Sim step: %.2f ms, clamped frames: %u, dropped: %.1f ms",
+        physics.stepCost * 1000,
+        physics.stats.numClampedFrames,
+        physics.stats.droppedTime * 1000);
+      const FrameAllocator::Stats& scratchStats = g_ScratchMemory.GetStats();
+      ImGui::Text("Scratch: %.1f KB, peak: %.1f KB, committed: %.1f MB",
+        scratchStats.lastFrameUsage / 1024.f,
+        scratchStats.peakFrameUsage / 1024.f,
+        scratchStats.committed / (1024.f * 1024.f));
       ImGui::PlotLines(
         "Frame time", times, (int)numSamples, 0, 0, FLT_MAX, FLT_MAX, ImVec2(200, 50));
 